@@ -0,0 +1,42 @@
+#pragma once
+
+#include "neuroctx/kernels.h"
+#include "neuroctx/kv_cache.h"
+
+#include <cstdint>
+
+namespace neuroctx {
+
+inline constexpr int32_t kMaxHeadDim = 256;
+// Bounds of TuningProfile::attention_query_tile and attention_key_tile,
+// which size the attention scratch on the stack.
+inline constexpr int32_t kMaxQueryTile = 32;
+inline constexpr int32_t kMaxKeyTile = 32;
+
+struct AttentionShape {
+    int32_t n_head = 0;
+    int32_t n_kv_head = 0; // grouped-query attention when < n_head
+    int32_t head_dim = 0;
+    float scale = 1.0f;
+};
+
+// Query rows worth one tile: with the query heads sharing a KV head they
+// make up to tuning().attention_query_tile (16 by default) query vectors
+// that reuse every K/V tile.
+int64_t attention_row_tile(const AttentionShape& shape);
+
+// Causal attention for query rows [row_begin, row_end) of one sequence and
+// every query head that reads KV head `kv_head`. Row r is at position
+// pos0 + r and attends to positions [0, pos0 + r], whose K/V must already
+// be stored in `kv` for `layer`.
+//
+// Flash-style: K/V are read straight from the paged cache in tiles of up to
+// tuning().attention_key_tile positions, dequantized once per tile into L1-resident scratch and
+// shared by the whole query tile. Scores exist for one tile at a time with
+// a running max and sum (online softmax), so memory stays constant in the
+// context length and nothing of size rows x context is ever stored.
+void paged_attention(const kernels::KernelSet& ks, const KvCache& kv, SeqId seq, int32_t layer,
+                     const AttentionShape& shape, int64_t pos0, int64_t row_begin, int64_t row_end,
+                     int32_t kv_head, const float* q, int64_t ldq, float* out, int64_t ldo);
+
+} // namespace neuroctx
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "neuroctx/executor.h"
+#include "neuroctx/graph.h"
+#include "neuroctx/kernels.h"
+#include "neuroctx/memory_plan.h"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace neuroctx {
+
+enum class DeviceKind : uint8_t {
+    kCpu,
+    kGpu, // e.g. Mali through Vulkan compute
+    kNpu, // e.g. Ethos through the vendor delegate
+};
+
+const char* device_kind_name(DeviceKind kind);
+
+inline constexpr uint32_t op_bit(OpType op) { return 1u << static_cast<uint32_t>(op); }
+inline constexpr uint32_t kAllOps = (1u << static_cast<uint32_t>(OpType::kCount)) - 1;
+
+// Throughput model of one device for the partitioner. Rates are sustained
+// figures; they only need to be right relative to the other devices.
+struct DeviceProfile {
+    std::string name;
+    DeviceKind kind = DeviceKind::kCpu;
+    double int8_ops_per_s = 0; // matmuls; a multiply-add counts as two ops
+    double f32_ops_per_s = 0;  // element-wise and attention work
+    double bytes_per_s = 0;    // DRAM streaming bandwidth
+    double launch_s = 0;       // fixed cost of dispatching one segment
+    double sync_s = 0;         // cache maintenance handing the arena over
+    uint32_t ops = 0;          // op_bit() of every OpType it can run
+
+    bool supports(OpType op) const { return (ops & op_bit(op)) != 0; }
+};
+
+// Nominal profile of `threads` cores running `kernels`, at 2 GHz with
+// per-variant int8 throughput (SDOT 4x, SMMLA 8x that of plain NEON).
+DeviceProfile cpu_profile(const kernels::KernelSet& kernels, int threads);
+
+// Executes node segments on an accelerator.
+//
+// Activations stay in the model's shared arena: a backend imports
+// Arena::fd() once in prepare() (VK_EXT_external_memory_dma_buf, the NPU
+// driver's dma-buf import) and reads and writes every value in place at its
+// MemoryPlan offset, so a device switch costs a cache sync, not a copy.
+// Weights are the node.weight pointers into the mapped packed cache.
+class Backend {
+public:
+    virtual ~Backend() = default;
+
+    virtual const DeviceProfile& profile() const = 0;
+
+    // Called once, before the first step, with every node any placement
+    // puts on this backend. Throws neuroctx::Error when one cannot be
+    // compiled for the device.
+    virtual void prepare(const Graph& graph, const MemoryPlan& plan, const Arena& arena,
+                         std::span<const int32_t> nodes) = 0;
+
+    // Runs one segment and waits for it. Called on the step's hot path; it
+    // must not throw or allocate.
+    virtual void run(const Graph& graph, const Segment& segment, const ExecContext& ctx) = 0;
+};
+
+// An accelerator device node found on this system.
+struct AcceleratorInfo {
+    DeviceKind kind = DeviceKind::kGpu;
+    std::string name; // "mali", "adreno", "ethos-n", "ethos-u"
+    std::string path;
+};
+
+// Lists the GPU and NPU device nodes under `dev_root`. Finding one does not
+// mean a backend for it is available; it tells the application which
+// delegate is worth loading.
+std::vector<AcceleratorInfo> probe_accelerators(const std::string& dev_root = "/dev");
+
+} // namespace neuroctx
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace neuroctx {
+
+// All configuration and I/O failures surface as neuroctx::Error. Hot paths
+// (kernels, executor steps) never throw; they are validated up front.
+class Error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+[[noreturn]] void throw_error(const std::string& what);
+
+// Throws with strerror(errno) appended, e.g. "open model.gguf: No such file".
+[[noreturn]] void throw_errno(const std::string& what);
+
+inline constexpr size_t kCacheLine = 64;
+
+constexpr size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+constexpr size_t align_down(size_t value, size_t alignment) {
+    return value / alignment * alignment;
+}
+
+} // namespace neuroctx
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "neuroctx/kernels.h"
+#include "neuroctx/mapped_file.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace neuroctx {
+
+struct ContextStoreOptions {
+    int32_t dim = 0;                      // embedding width; must match an existing store
+    int64_t seal_records = 16384;         // open-segment size that triggers seal()
+    int64_t max_segment_records = 262144; // compact() stops merging at this size
+    int32_t nprobe = 8;                   // default inverted lists scanned per segment
+    bool sync = false;                    // fdatasync the log after every add()
+};
+
+struct ContextHit {
+    uint64_t id = 0;
+    float score = 0.0f; // approximate cosine similarity
+};
+
+// Persistent embedding store for retrieved context, searched by cosine
+// similarity.
+//
+// Embeddings are normalized and scalar-quantized to int8 with one scale per
+// record; a dot product over that form ranks within about a percent of the
+// float cosine and is one SDOT per 16 values (kernels::DotI8Fn).
+//
+// On disk the store is a directory of segments named by sequence number:
+//
+//   NNNNNNNN.log  the open segment: a header and fixed-size records
+//                 {id, scale, int8[stride]}, append-only, mirrored in RAM
+//                 and scanned exhaustively.
+//   NNNNNNNN.ivf  a sealed segment: an IVF index (spherical k-means
+//                 centroids, about sqrt(records) of them) followed by the
+//                 records grouped by list as ids[], scales[] and vectors[].
+//
+// Sealed segments are immutable and memory-mapped with random-access
+// advice. A search scores the centroids and scans only the `nprobe` nearest
+// lists, so it faults in the centroid table plus a few contiguous runs of
+// vectors per segment and never reads the rest of the index.
+//
+// Sealing and compaction write the new segment to a temporary file, fsync
+// it and rename it into place before removing what it replaces; open()
+// finishes or discards whatever a crash left behind. A torn record at the
+// end of the log is dropped.
+//
+// Writers (add, seal, compact, flush) need exclusive access; concurrent
+// search() calls are safe between them. Ids are not deduplicated.
+class ContextStore {
+public:
+    static constexpr uint32_t kFormatVersion = 1;
+
+    ContextStore();
+    ~ContextStore();
+    ContextStore(ContextStore&&) noexcept;
+    ContextStore& operator=(ContextStore&&) noexcept;
+    ContextStore(const ContextStore&) = delete;
+    ContextStore& operator=(const ContextStore&) = delete;
+
+    // Opens or creates the store in `dir`. Throws neuroctx::Error on I/O
+    // errors, corrupt segments or a dimension mismatch.
+    static ContextStore open(const std::string& dir, const ContextStoreOptions& options,
+                             const kernels::KernelSet& kernels = kernels::active());
+
+    // Appends one embedding of dim() floats. Seals the open segment once it
+    // holds seal_records. An all-zero embedding is stored but never matches.
+    void add(uint64_t id, std::span<const float> embedding);
+    // Appends `embeddings` [ids.size(), dim()] in one write (and one
+    // fdatasync with `sync`); what bulk indexing should use.
+    void add(std::span<const uint64_t> ids, std::span<const float> embeddings);
+
+    // The k most similar records, best first. nprobe <= 0 uses the store's
+    // default; nprobe >= the list count makes the search exact.
+    std::vector<ContextHit> search(std::span<const float> query, int32_t k, int32_t nprobe = 0) const;
+
+    // Turns the open segment into a sealed one; no-op when it is empty.
+    void seal();
+    // Merges adjacent sealed segments into ones of up to
+    // max_segment_records, retraining their lists.
+    void compact();
+    // Makes every add() so far durable.
+    void flush();
+
+    int64_t size() const;
+    int32_t dim() const { return options_.dim; }
+    size_t segment_count() const { return segments_.size(); }
+    const std::string& directory() const { return dir_; }
+
+private:
+    struct Segment;
+
+    static std::unique_ptr<Segment> load_segment(const std::string& path, int64_t dim, int64_t stride);
+    void open_log(uint32_t seq);
+    void close_log();
+    void search_segment(const Segment& segment, const int8_t* query, float query_scale, int32_t nprobe,
+                        std::vector<ContextHit>& heap, size_t k) const;
+
+    std::string dir_;
+    ContextStoreOptions options_;
+    const kernels::KernelSet* kernels_ = nullptr;
+    int64_t stride_ = 0; // dim rounded up to kernels::kDotAlign
+    std::vector<std::unique_ptr<Segment>> segments_; // sealed, by sequence
+
+    // The open segment.
+    int log_fd_ = -1;
+    uint32_t log_seq_ = 0;
+    std::vector<uint64_t> ids_;
+    std::vector<float> scales_;
+    std::vector<int8_t> vectors_;
+};
+
+} // namespace neuroctx
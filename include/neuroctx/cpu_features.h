@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace neuroctx {
+
+// Instruction-set extensions relevant to the kernel library, read from
+// AT_HWCAP/AT_HWCAP2 on Linux and Android.
+struct CpuFeatures {
+    bool neon = false;    // ASIMD (baseline on AArch64)
+    bool fp16 = false;    // FEAT_FP16 arithmetic
+    bool dotprod = false; // SDOT/UDOT
+    bool i8mm = false;    // SMMLA/UMMLA
+    bool bf16 = false;
+    bool sve = false;
+    bool sve2 = false;
+    bool sve_i8mm = false;
+    uint32_t sve_vector_bytes = 0; // current SVE vector length, 0 without SVE
+
+    // Stable encoding for cache keys: one bit per flag, vector length in
+    // the upper 32 bits.
+    uint64_t bits() const;
+    std::string describe() const;
+};
+
+CpuFeatures detect_cpu_features();
+
+// Detected once per process.
+const CpuFeatures& cpu_features();
+
+} // namespace neuroctx
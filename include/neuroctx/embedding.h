@@ -0,0 +1,82 @@
+#pragma once
+
+#include "neuroctx/executor.h"
+#include "neuroctx/kv_cache.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace neuroctx {
+
+class ContextStore;
+class Model;
+class ThreadPool;
+
+struct EmbedderOptions {
+    int64_t max_tokens = 512; // longer items are cut to their first max_tokens
+    KvDType kv_dtype = KvDType::kF16;
+};
+
+struct EmbedderStats {
+    int64_t items = 0;
+    int64_t steps = 0;
+    int64_t tokens = 0;               // token rows computed
+    int64_t prefix_tokens_reused = 0; // shared leading pages, e.g. an instruction prefix
+    int64_t truncated = 0;
+};
+
+// Embeddings of many short items (messages, events, snippets) for the
+// context store, from a decoder: the final hidden state of each item's last
+// token through output_norm, L2-normalized. That is the pooling of
+// decoder embedding models (e5-mistral, gte-Qwen2, Qwen3-Embedding), whose
+// items end in EOS; append it before embedding.
+//
+// Steps are ragged, never padded: items are sorted by length, and each
+// step is packed with the longest items left, then topped up with the
+// shortest, up to the model's planned batch rows and output rows. Sorting
+// keeps the items of a step alike in length, so the step runs at full
+// width and no sequence's attention trails the rest. Items run as causal
+// sequences in a KV cache of the embedder's own; full pages they share,
+// such as a common instruction prefix, are computed once.
+//
+// Uses the model's arena: do not run a Scheduler on the same model at the
+// same time. Not thread-safe.
+class Embedder {
+public:
+    Embedder(Model& model, ThreadPool* pool = nullptr, const EmbedderOptions& options = {});
+
+    int64_t dim() const;
+
+    // Writes the embedding of every item (token ids) to `out`, [items,
+    // dim()]. Throws neuroctx::Error for an empty item.
+    void embed(std::span<const std::span<const int32_t>> items, std::span<float> out);
+
+    // Embeds the items and appends them to `store` as ids[i], int8
+    // quantized, in one batched write.
+    void embed_into(ContextStore& store, std::span<const uint64_t> ids,
+                    std::span<const std::span<const int32_t>> items);
+
+    const EmbedderStats& stats() const { return stats_; }
+
+private:
+    // Runs `items` (indices, longer than one step) one at a time in chunks.
+    void embed_long(std::span<const std::span<const int32_t>> items, int32_t item, float* out);
+    void pool_rows(const float* hidden, float* out) const;
+
+    Model& model_;
+    ThreadPool* pool_;
+    EmbedderOptions options_;
+    KvCache kv_;
+    std::vector<float> norm_; // output_norm weights
+
+    // Per-step buffers.
+    std::vector<int32_t> tokens_;
+    std::vector<StepSequence> seqs_;
+    std::vector<int32_t> outputs_;
+    std::vector<int32_t> owners_; // item of each sequence
+    std::vector<float> scratch_;
+    EmbedderStats stats_;
+};
+
+} // namespace neuroctx
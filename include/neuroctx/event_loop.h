@@ -0,0 +1,207 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace neuroctx {
+
+template <typename T = void>
+class Task;
+
+namespace detail {
+
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr error;
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+            return h.promise().continuation;
+        }
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    FinalAwaiter final_suspend() const noexcept { return {}; }
+    void unhandled_exception() noexcept { error = std::current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+    template <typename U>
+    void return_value(U&& v) {
+        value.emplace(std::forward<U>(v));
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object();
+    void return_void() const noexcept {}
+};
+
+} // namespace detail
+
+// Lazily started coroutine returning T. Awaiting it starts the body and
+// resumes the awaiter when it finishes (by symmetric transfer, so chains of
+// tasks do not grow the stack); an exception thrown in the body is rethrown
+// from the co_await. Move-only; the frame is destroyed with the Task.
+template <typename T>
+class Task {
+public:
+    using promise_type = detail::TaskPromise<T>;
+
+    Task() = default;
+    explicit Task(std::coroutine_handle<promise_type> h) : h_(h) {}
+    Task(Task&& other) noexcept : h_(std::exchange(other.h_, nullptr)) {}
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (h_) {
+                h_.destroy();
+            }
+            h_ = std::exchange(other.h_, nullptr);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (h_) {
+            h_.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept {
+        h_.promise().continuation = awaiter;
+        return h_;
+    }
+    T await_resume() {
+        if (h_.promise().error) {
+            std::rethrow_exception(h_.promise().error);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*h_.promise().value);
+        }
+    }
+
+private:
+    std::coroutine_handle<promise_type> h_;
+};
+
+namespace detail {
+
+template <typename T>
+Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+} // namespace detail
+
+// Single-threaded epoll event loop that coroutines run on.
+//
+// A daemon keeps one loop for all of its clients: each client is a Task
+// spawned on the loop that awaits socket readiness, timers and
+// Session::generate(), so a connection costs a coroutine frame instead of
+// a thread and its stack. Work finished on other threads comes back
+// through post(), which wakes the loop with an eventfd.
+//
+// Everything except post() and stop() must be called on the loop thread,
+// and coroutines are only ever resumed there.
+class EventLoop {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    EventLoop();
+    ~EventLoop();
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Starts `task` now, up to its first suspension, and owns it until it
+    // finishes. An exception escaping it terminates the process, as from a
+    // std::thread.
+    void spawn(Task<void> task);
+
+    // Runs `fn` on the loop thread at its next iteration. Thread-safe.
+    void post(std::function<void()> fn);
+
+    // Runs until every spawned task has finished or stop() is called.
+    void run();
+    // Makes run() return after the current iteration. Thread-safe.
+    void stop();
+
+    struct FdAwaiter {
+        EventLoop* loop;
+        int fd;
+        bool write;
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { loop->watch(fd, write, h); }
+        void await_resume() const noexcept {}
+    };
+
+    struct TimerAwaiter {
+        EventLoop* loop;
+        Clock::time_point when;
+        bool await_ready() const noexcept { return when <= Clock::now(); }
+        void await_suspend(std::coroutine_handle<> h) { loop->add_timer(when, h); }
+        void await_resume() const noexcept {}
+    };
+
+    // co_await loop.readable(fd): resumes once `fd` is readable (or hung
+    // up). One waiter per fd at a time. Throws neuroctx::Error when epoll
+    // rejects the fd.
+    FdAwaiter readable(int fd) { return {this, fd, false}; }
+    FdAwaiter writable(int fd) { return {this, fd, true}; }
+    TimerAwaiter sleep_until(Clock::time_point when) { return {this, when}; }
+    TimerAwaiter sleep_for(Clock::duration d) { return {this, Clock::now() + d}; }
+
+private:
+    struct Timer {
+        Clock::time_point when;
+        uint64_t order; // FIFO among equal deadlines
+        std::coroutine_handle<> h;
+        bool operator>(const Timer& o) const { return when != o.when ? when > o.when : order > o.order; }
+    };
+
+    void watch(int fd, bool write, std::coroutine_handle<> h);
+    void add_timer(Clock::time_point when, std::coroutine_handle<> h);
+    void wake();
+    void run_posted();
+    void run_timers();
+    friend struct SpawnedTask;
+    void task_done() { --spawned_; }
+
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> stop_{false};
+    size_t spawned_ = 0;
+    std::unordered_map<int, std::coroutine_handle<>> watchers_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers_;
+    uint64_t timer_order_ = 0;
+
+    std::mutex mutex_;
+    std::vector<std::function<void()>> posted_;
+    std::vector<std::function<void()>> running_; // the batch being run
+};
+
+} // namespace neuroctx
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "neuroctx/graph.h"
+#include "neuroctx/kernels.h"
+#include "neuroctx/kv_cache.h"
+#include "neuroctx/memory_plan.h"
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace neuroctx {
+
+class Backend;
+class LayerStreamer;
+class LoraAdapter;
+class ThreadPool;
+struct Placement;
+
+// Token rows [first_row, first_row + rows) of a step belong to `seq` and
+// hold its positions [pos, pos + rows).
+struct StepSequence {
+    SeqId seq = -1;
+    int64_t pos = 0;
+    int64_t first_row = 0;
+    int64_t rows = 0;
+    // Applied to the matmuls of these rows; null runs the base weights.
+    const LoraAdapter* adapter = nullptr;
+};
+
+// Nodes [begin, end) of a graph, consecutive in execution order, placed on
+// one device.
+struct Segment {
+    int32_t device = 0;
+    int32_t begin = 0;
+    int32_t end = 0;
+};
+
+// Per-step bindings. `rows` must not exceed the bounds the plan was made
+// for. Attention nodes need `kv` and `sequences`, which must cover the
+// token rows in order.
+struct ExecContext {
+    const kernels::KernelSet* kernels = nullptr; // defaults to kernels::active()
+    ThreadPool* pool = nullptr;                  // matmuls and attention split across workers
+    KvCache* kv = nullptr;
+    std::span<const StepSequence> sequences;
+    RowBounds rows;
+};
+
+class Executor;
+
+// Called after each node run on the CPU, with the node's values still in
+// the arena; e.g. to gather calibration statistics.
+using NodeObserver = std::function<void(const Node& node, const Executor& executor, const ExecContext& ctx)>;
+
+// Runs a planned graph over one arena. Every pointer is resolved at
+// construction and the LoRA scratch sized once by reserve_lora() at load;
+// run() performs no heap allocation, and throws for an adapted step that
+// does not fit the scratch.
+class Executor {
+public:
+    // `graph` must outlive the executor. The arena is grown to the plan
+    // size here and then only indexed.
+    Executor(const Graph& graph, const MemoryPlan& plan, Arena& arena);
+
+    void run(const ExecContext& ctx);
+
+    // Offloads the segments a placement puts on other devices: device d
+    // runs on backends[d - 1], device 0 here. Steps of one token row use
+    // `decode`, larger ones `prefill`. The arena must be ArenaMemory::kShared
+    // and every backend prepared for its nodes.
+    void set_offload(std::vector<Backend*> backends, const Placement& decode, const Placement& prefill);
+    // Tells `streamer` (non-owning, may be null) every layer boundary, so it
+    // can read the next layers ahead and drop the last.
+    void set_layer_streamer(LayerStreamer* streamer) { streamer_ = streamer; }
+    // Runs `observer` after every node from now on; an empty one stops it.
+    void set_observer(NodeObserver observer) { observer_ = std::move(observer); }
+    // Sizes the scratch of LoRA deltas (lora_apply) for sequences of up to
+    // `rows` token rows at up to `rank`; steps only read it and throw for an
+    // adapter that does not fit.
+    void reserve_lora(int64_t rows, int64_t rank);
+    // Segments of the placement used for a step of `tokens` rows; empty
+    // without offload.
+    std::span<const Segment> segments(int64_t tokens) const;
+
+    uint8_t* data(int32_t value) const { return base_ + plan_.offsets[value]; }
+    float* f32(int32_t value) const { return reinterpret_cast<float*>(data(value)); }
+    int32_t* i32(int32_t value) const { return reinterpret_cast<int32_t*>(data(value)); }
+    // Q8 values: int8 rows for the full row bound, then the block scales.
+    kernels::QuantizedRows q8(int32_t value, int64_t rows) const;
+
+    const Graph& graph() const { return graph_; }
+    const MemoryPlan& plan() const { return plan_; }
+
+private:
+    void run_layered(const ExecContext& ctx, const kernels::KernelSet& ks);
+    void run_node(const Node& node, const ExecContext& ctx, const kernels::KernelSet& ks);
+    void run_attention(const Node& node, const ExecContext& ctx);
+    void run_matmul(const Node& node, const ExecContext& ctx, const kernels::KernelSet& ks, int64_t rows);
+    int64_t rows_of(int32_t value, const ExecContext& ctx) const;
+
+    const Graph& graph_;
+    MemoryPlan plan_;
+    const Arena* arena_ = nullptr;
+    uint8_t* base_ = nullptr;
+    std::vector<Backend*> backends_;
+    std::vector<Segment> decode_segments_;
+    std::vector<Segment> prefill_segments_;
+    LayerStreamer* streamer_ = nullptr;
+    NodeObserver observer_;
+    std::vector<float> lora_scratch_; // reserve_lora()
+};
+
+} // namespace neuroctx
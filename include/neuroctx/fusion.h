@@ -0,0 +1,34 @@
+#pragma once
+
+#include "neuroctx/graph.h"
+
+#include <cstdint>
+
+namespace neuroctx {
+
+struct FusionStats {
+    int32_t bias = 0;          // kBias folded into the preceding kMatMul
+    int32_t rope = 0;          // kRope folded into its projection (kMatMulRope)
+    int32_t swiglu = 0;        // silu(gate) * up folded into the up projection
+    int32_t norm_quantize = 0; // kQuantize folded into the preceding kRmsNorm
+    int32_t add_norm = 0;      // kRmsNorm of a residual add (kAddRmsNorm)
+
+    int32_t total() const { return bias + rope + swiglu + norm_quantize + add_norm; }
+};
+
+// Rewrites chains of element-wise work into the node that produces their
+// input, so the intermediate values are never written to and read back
+// from the arena:
+//
+//   matmul -> bias                 matmul with aux bias
+//   matmul -> rope                 matmul_rope
+//   silu(matmul a) * matmul b      matmul b with Activation::kSiluGate on a
+//   rms_norm -> quantize           rms_norm with a Q8 output
+//   add -> rms_norm                add_rms_norm with both outputs
+//
+// A chain is only fused when the intermediate has no other consumer and is
+// not a graph output. Node order is kept, so liveness only gets shorter;
+// run plan_memory() afterwards. Value ids are renumbered by Graph::compact().
+FusionStats fuse_graph(Graph& graph);
+
+} // namespace neuroctx
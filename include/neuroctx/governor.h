@@ -0,0 +1,120 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace neuroctx {
+
+class Scheduler;
+class ThreadPool;
+
+struct ThermalReading {
+    std::optional<double> soc_celsius; // hottest CPU/SoC zone
+    std::optional<double> battery_celsius;
+    std::optional<int> battery_percent;
+    bool charging = false;
+};
+
+// Thermal zones and the battery gauge from sysfs. Zones whose type names a
+// CPU, GPU or SoC sensor count toward soc_celsius; when no type matches,
+// every zone does.
+class ThermalSensors {
+public:
+    explicit ThermalSensors(const std::string& sysfs_class = "/sys/class");
+
+    ThermalReading read() const;
+    bool empty() const { return zones_.empty() && battery_.empty(); }
+    std::string describe() const; // e.g. "4 zones, battery:battery"
+
+private:
+    std::vector<std::string> zones_; // temp files, millidegrees
+    std::string battery_;            // power_supply directory
+};
+
+// One setting of the knobs the governor turns.
+struct OperatingPoint {
+    int threads = 1;       // ThreadPool::set_active()
+    int skip_clusters = 0; // fastest clusters left idle
+    int64_t batch_tokens = 1;
+    int variant = 0; // index into the model variants, 0 = the largest
+
+    bool operator==(const OperatingPoint&) const = default;
+};
+
+// A ladder from full speed down, for `pool`, a scheduler batch of
+// `batch_tokens` and `variants` model variants: halve the batch first
+// (prefill bursts heat fastest), then drop threads, then leave the prime
+// cluster, then fall back to smaller variants.
+std::vector<OperatingPoint> default_operating_points(const ThreadPool& pool, int64_t batch_tokens,
+                                                     int variants = 1);
+
+// The .gguf files in `dir`, largest first: the variants an
+// OperatingPoint::variant indexes.
+std::vector<std::string> list_model_variants(const std::string& dir);
+
+struct GovernorOptions {
+    double target_celsius = 75.0;   // SoC temperature to hold under sustained load
+    double hysteresis_celsius = 5.0; // below target before stepping back up
+    double critical_celsius = 90.0;  // drop straight to the last point
+    double battery_max_celsius = 42.0;
+    int low_battery_percent = 20; // when discharging, stay in the lower half of the ladder
+    std::chrono::milliseconds lookahead{10000}; // the temperature trend is extrapolated this far
+    std::chrono::milliseconds down_dwell{2000}; // minimum time between steps down
+    std::chrono::milliseconds up_dwell{15000};  // and before a step up; doubles on each relapse
+    std::chrono::milliseconds max_up_dwell{240000};
+    double smoothing = 0.3; // weight of a new reading in the average
+};
+
+// Picks the operating point the device can sustain.
+//
+// Phones throttle by clocking cores down once a zone passes its trip point,
+// which halves throughput without warning; a runtime that keeps running
+// flat out then swings between full speed and throttled. The governor
+// steps down a ladder of operating points before that, when the smoothed
+// SoC temperature, extrapolated along its trend, would cross the target,
+// and steps back up only after it has stayed well below it for a while.
+// Stepping up into a point that overheats again doubles that wait, so the
+// ladder settles on the highest point the cooling can carry instead of
+// oscillating around it. A hot battery counts as over target; a low
+// battery off the charger caps the ladder at its midpoint.
+//
+// Not thread-safe. Feed it a reading about once a second.
+class Governor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // `points` most demanding first; must not be empty.
+    explicit Governor(std::vector<OperatingPoint> points, const GovernorOptions& options = {});
+
+    // Returns the point to run at from now on.
+    const OperatingPoint& update(const ThermalReading& reading, Clock::time_point now = Clock::now());
+
+    const OperatingPoint& current() const { return points_[level_]; }
+    size_t level() const { return level_; }
+    const std::vector<OperatingPoint>& points() const { return points_; }
+    std::optional<double> smoothed_celsius() const { return started_ ? std::optional<double>(average_) : std::nullopt; }
+
+    // Sets the thread count and batch budget of `point` (either may be null);
+    // the variant is the caller's to load. Call on the thread that steps
+    // the scheduler, e.g. through Session::between_steps().
+    static void apply(const OperatingPoint& point, ThreadPool* pool, Scheduler* scheduler);
+
+private:
+    void step_to(size_t level, Clock::time_point now);
+
+    std::vector<OperatingPoint> points_;
+    GovernorOptions options_;
+    size_t level_ = 0;
+    bool started_ = false;
+    double average_ = 0;
+    double trend_ = 0; // degrees per second
+    Clock::time_point last_reading_;
+    Clock::time_point last_change_;
+    Clock::time_point last_up_;
+    std::chrono::milliseconds up_dwell_;
+};
+
+} // namespace neuroctx
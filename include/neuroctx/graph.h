@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace neuroctx {
+
+// Storage type of a graph value. Q8 values carry int8 rows followed by
+// their per-32 block scales (kernels::QuantizedRows).
+enum class ValueType : uint8_t {
+    kF32,
+    kI32,
+    kQ8,
+};
+
+// Symbolic row count of a value, bound per step. The memory planner sizes
+// every value for the upper bound of its dimension.
+enum class RowDim : uint8_t {
+    kTokens,  // tokens in the step
+    kOutputs, // rows that need logits
+    kOne,     // exactly one row
+    kCount,
+};
+
+enum class ValueRole : uint8_t {
+    kIntermediate,
+    kInput,  // written by the caller before a step
+    kOutput, // read by the caller after a step; kept live to the end
+};
+
+struct Value {
+    std::string name;
+    ValueType type = ValueType::kF32;
+    RowDim rows = RowDim::kTokens;
+    ValueRole role = ValueRole::kIntermediate;
+    int64_t cols = 0;
+};
+
+size_t value_row_bytes(const Value& value);
+
+enum class OpType : uint8_t {
+    kAdd,       // out = in0 + in1 (in1 may be a single broadcast row)
+    kMul,       // out = in0 * in1 (in1 may be a single broadcast row)
+    kSilu,      // out = in0 * sigmoid(in0)
+    kRmsNorm,   // out = in0 / rms(in0) * weight (float[cols]); f0 = eps. A Q8
+                // out quantizes the normalized rows directly
+    kQuantize,  // F32 -> Q8
+    kMatMul,    // Q8 in0 x packed weight (kernels::PackedWeights) -> F32, then
+                // + aux (float[cols]) when set and the Activation in i0
+    kCopy,      // out = in0 rows [i0, i0 + rows(out))
+    kBias,      // out = in0 + weight (float[cols])
+    kEmbed,     // out = rows of weight (TensorView) selected by I32 in0
+    kGather,    // out = rows of in0 selected by I32 in1
+    kRope,      // rotary embedding of in0 at I32 positions in1; i0 = head_dim,
+                // i1 = RopeMode, f0 = frequency base
+    kAttention, // causal attention of q = in0 over the paged KV cache after
+                // storing k = in1, v = in2 for `layer`; i0 = head_dim,
+                // f0 = score scale
+    // Fused by fuse_graph():
+    kMatMulRope, // kMatMul (+ aux bias), then kRope at I32 positions in1 with
+                 // kRope's i0, i1 and f0
+    kAddRmsNorm, // out0 = in0 + in1, out1 = kRmsNorm of out0 (F32 or Q8)
+    kCount,
+};
+
+enum class RopeMode : uint8_t {
+    kNorm, // rotate adjacent pairs (x[2i], x[2i + 1]), llama layout
+    kNeox, // rotate halves (x[i], x[i + head_dim / 2])
+};
+
+// Epilogue of kMatMul applied while the output tile is still in cache.
+enum class Activation : uint8_t {
+    kNone,
+    kSiluGate, // out *= silu(in1): the SwiGLU product with an F32 gate
+};
+
+const char* op_name(OpType op);
+
+inline constexpr int kMaxNodeInputs = 4;
+inline constexpr int kMaxNodeOutputs = 2;
+
+struct Node {
+    OpType op = OpType::kCopy;
+    std::array<int32_t, kMaxNodeInputs> in = {-1, -1, -1, -1};
+    std::array<int32_t, kMaxNodeOutputs> out = {-1, -1};
+    const void* weight = nullptr; // op-specific constant data, owned elsewhere
+    const void* aux = nullptr;    // second constant operand of fused ops
+    float f0 = 0.0f;
+    int64_t i0 = 0;
+    int64_t i1 = 0;
+    int32_t layer = -1; // transformer layer, -1 outside the layer stack
+    std::string label;
+
+    int inputs() const;
+    int outputs() const;
+};
+
+// Static dataflow graph for one step of the model. Nodes are stored in
+// execution order; every value has exactly one producer unless it is an
+// input.
+class Graph {
+public:
+    int32_t add_value(std::string name, ValueType type, int64_t cols, RowDim rows = RowDim::kTokens,
+                      ValueRole role = ValueRole::kIntermediate);
+    Node& add_node(OpType op, std::initializer_list<int32_t> in, std::initializer_list<int32_t> out,
+                   std::string label = {});
+
+    std::vector<Value>& values() { return values_; }
+    const std::vector<Value>& values() const { return values_; }
+    std::vector<Node>& nodes() { return nodes_; }
+    const std::vector<Node>& nodes() const { return nodes_; }
+
+    // Checks producer/consumer ordering and value ids; throws neuroctx::Error.
+    void validate() const;
+
+    // Drops values no node references that are not inputs or outputs, and
+    // renumbers the rest. Used after rewriting passes.
+    void compact();
+
+    // Id of the value called `name`, or -1. Lets callers re-resolve their
+    // inputs and outputs after compact().
+    int32_t find_value(const std::string& name) const;
+
+private:
+    std::vector<Value> values_;
+    std::vector<Node> nodes_;
+};
+
+} // namespace neuroctx
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace neuroctx {
+
+inline constexpr uint64_t kFnvOffset = 0xcbf29ce484222325ull;
+
+// FNV-1a; used for cache keys and content addressing, never for security.
+inline uint64_t fnv1a64(const void* data, size_t len, uint64_t seed = kFnvOffset) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    uint64_t h = seed;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+// 64-bit finalizer (splitmix64) to combine already-hashed words.
+inline uint64_t hash_mix(uint64_t h, uint64_t v) {
+    uint64_t x = h ^ (v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2));
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+} // namespace neuroctx
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+
+namespace neuroctx {
+
+struct IpcOptions {
+    uint32_t ring_slots = 256;  // per direction; rounded up to a power of two
+    uint32_t block_bytes = 4096; // payload allocation unit
+    uint32_t heap_blocks = 4096; // payload heap of heap_blocks * block_bytes
+    // Time a receiver polls before it sleeps on the futex. Polling is what
+    // gets a round trip down to a few microseconds; sleeping costs a wakeup.
+    // Ignored on a single core.
+    std::chrono::microseconds spin{50};
+};
+
+// A payload in the channel's shared heap: a byte range both processes
+// address by offset.
+struct IpcBuffer {
+    uint32_t offset = 0;
+    uint32_t bytes = 0;
+};
+
+// One ring slot: 120 bytes of message next to the slot's sequence word.
+struct IpcMessage {
+    static constexpr size_t kMaxBuffers = 4;
+    static constexpr size_t kInlineBytes = 72;
+
+    uint32_t type = 0; // application-defined
+    uint32_t inline_bytes = 0;
+    uint64_t tag = 0; // correlates a response with its request
+    IpcBuffer buffers[kMaxBuffers] = {};
+    uint8_t data[kInlineBytes] = {}; // small payloads travel in the slot
+
+    // Copies up to kInlineBytes; false when `bytes` does not fit.
+    bool set_inline(std::span<const uint8_t> bytes);
+    std::span<const uint8_t> inline_data() const;
+};
+
+static_assert(sizeof(IpcMessage) == 120);
+
+// Shared-memory transport between an app and the runtime.
+//
+// One channel is one memfd mapped by both processes, holding
+//   - a request ring (app -> runtime), multi-producer so any app thread
+//     can submit without a lock, single consumer;
+//   - a response ring (runtime -> app);
+//   - a payload heap of fixed-size blocks with a lock-free bitmap
+//     allocator, for prompts, embeddings and logits. A message carries
+//     IpcBuffer descriptors into it, so a tensor is written once where the
+//     other side reads it; whoever receives a buffer frees it.
+//
+// Rings are bounded queues with a sequence word per slot (Vyukov). A
+// receiver polls for `spin`, then sleeps on a shared futex that senders
+// only wake when someone sleeps, so an idle channel costs nothing and a
+// busy one never makes a syscall.
+//
+// The runtime creates the channel and hands fd() to the app over a Unix
+// socket (send_fd / receive_fd); that socket staying open doubles as the
+// liveness signal. The runtime treats everything in the mapping as
+// untrusted: descriptors are bounds-checked, its own ring indices live in
+// private memory, and a corrupt ring can only break that one channel.
+class IpcChannel {
+public:
+    IpcChannel();
+    ~IpcChannel();
+    IpcChannel(IpcChannel&&) noexcept;
+    IpcChannel& operator=(IpcChannel&&) noexcept;
+    IpcChannel(const IpcChannel&) = delete;
+    IpcChannel& operator=(const IpcChannel&) = delete;
+
+    // Runtime side: a new channel in a sealed-size memfd. Throws
+    // neuroctx::Error on failure.
+    static IpcChannel create(const IpcOptions& options = {});
+    // App side: maps a channel received from the runtime. Takes ownership
+    // of `fd`. Throws neuroctx::Error when it is not a valid channel.
+    static IpcChannel attach(int fd, std::chrono::microseconds spin = std::chrono::microseconds(50));
+
+    int fd() const { return fd_; }
+    bool is_runtime() const { return runtime_; }
+
+    // Enqueues on the outgoing ring: requests from the app, responses from
+    // the runtime. try_send() fails when the ring is full (or, for the
+    // runtime, corrupt); send() waits up to `timeout` for room. Thread-safe.
+    bool try_send(const IpcMessage& message);
+    bool send(const IpcMessage& message, std::chrono::nanoseconds timeout);
+
+    // Dequeues from the incoming ring, waiting up to `timeout`. One thread
+    // receives per channel side.
+    bool try_receive(IpcMessage& message);
+    bool receive(IpcMessage& message, std::chrono::nanoseconds timeout);
+
+    // A run of blocks holding at least `bytes`, or nullopt when `bytes` is 0
+    // or the heap has no such run. Thread-safe.
+    std::optional<IpcBuffer> allocate(size_t bytes);
+    // Returns a buffer's blocks; invalid descriptors are ignored.
+    void free(IpcBuffer buffer);
+    // The buffer's bytes, or an empty span when the descriptor is out of
+    // bounds.
+    std::span<uint8_t> data(IpcBuffer buffer) const;
+
+    uint32_t block_bytes() const { return block_bytes_; }
+    size_t heap_bytes() const { return size_t(heap_blocks_) * block_bytes_; }
+
+private:
+    struct Ring;
+    struct Slot;
+
+    static IpcChannel map(int fd, bool runtime, std::chrono::microseconds spin);
+    bool push(Ring& ring, const IpcMessage& message);
+    bool pop(Ring& ring, IpcMessage& message);
+    void reset() noexcept;
+
+    int fd_ = -1;
+    bool runtime_ = false;
+    uint8_t* base_ = nullptr;
+    size_t size_ = 0;
+    std::chrono::microseconds spin_{50};
+    uint32_t block_bytes_ = 0;
+    uint32_t heap_blocks_ = 0;
+    std::atomic<uint64_t>* bitmap_ = nullptr;
+    uint8_t* heap_ = nullptr;
+    std::unique_ptr<Ring> tx_;
+    std::unique_ptr<Ring> rx_;
+};
+
+// Passes a file descriptor over a connected Unix socket (SCM_RIGHTS).
+// Throws neuroctx::Error on failure.
+void send_fd(int socket, int fd);
+// Receives one; the caller owns it. Throws when the peer sent none or hung
+// up.
+int receive_fd(int socket);
+
+} // namespace neuroctx
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "neuroctx/cpu_features.h"
+#include "neuroctx/tensor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace neuroctx::kernels {
+
+// Quantization block shared by weights and activations: every run of 32
+// consecutive K elements carries one fp32 scale.
+inline constexpr int64_t kBlock = 32;
+
+enum class KernelVariant : uint32_t {
+    kReference = 0, // portable scalar code
+    kNeon = 1,      // ARMv8.0 ASIMD (SMULL/SADALP)
+    kDotprod = 2,   // ARMv8.2 SDOT
+    kI8mm = 3,      // ARMv8.6 SMMLA
+    kSve = 4,       // SVE indexed SDOT, vector-length agnostic
+};
+
+const char* variant_name(KernelVariant variant);
+
+enum class WeightFormat : uint32_t {
+    kInt8 = 0, // signed 8-bit
+    kInt4 = 1, // 4-bit, stored offset by +8 (value = nibble - 8)
+};
+
+// Panel layout consumed by a kernel variant. Weight rows are grouped into
+// panels of `panel_rows`. Inside a panel, each K block stores the
+// `panel_rows` fp32 scales followed by the quantized values, interleaved
+// as `k_interleave` consecutive K elements per row:
+//
+//   for chunk in 0 .. 32 / k_interleave:
+//     for row in panel: values[row][chunk * k_interleave .. +k_interleave]
+//
+// Int4 panels halve the value bytes: byte t of the first half holds value
+// t in its low nibble and value t + half in its high nibble, so one 16-byte
+// load expands to two consecutive-chunk vectors with AND/shift only.
+struct PackFormat {
+    uint32_t panel_rows = 4;
+    uint32_t k_interleave = 4;
+
+    bool operator==(const PackFormat&) const = default;
+};
+
+// Packed weight matrix [n, k] (n output channels), non-owning.
+struct PackedWeights {
+    const uint8_t* data = nullptr;
+    int64_t n = 0;
+    int64_t k = 0;
+    WeightFormat format = WeightFormat::kInt8;
+    PackFormat layout;
+
+    int64_t panels() const { return (n + layout.panel_rows - 1) / layout.panel_rows; }
+};
+
+size_t packed_block_bytes(WeightFormat format, const PackFormat& layout);
+size_t packed_panel_bytes(int64_t k, WeightFormat format, const PackFormat& layout);
+size_t packed_bytes(int64_t n, int64_t k, WeightFormat format, const PackFormat& layout);
+
+// Activations quantized per 32-element block: `q` is [rows, k] int8 and
+// `scales` is [rows, k / 32].
+struct QuantizedRows {
+    const int8_t* q = nullptr;
+    const float* scales = nullptr;
+    int64_t rows = 0;
+    int64_t k = 0;
+};
+
+// Symmetric absmax quantization of `rows` rows of `x` (row stride k).
+// k must be a multiple of kBlock.
+void quantize_rows(const float* x, int64_t rows, int64_t k, int8_t* q, float* scales);
+
+// Weight format the kernels use for a source tensor type: Q4_0 keeps its
+// 4-bit values, everything else is (re)quantized to int8.
+WeightFormat native_format(DType type);
+
+// Whether pack_tensor() accepts `type` as a source.
+bool can_pack(DType type);
+
+// Repacks a 2-D tensor (ne[0] = k, rows = n) into `dst`, which must hold
+// packed_bytes(n, k, format, layout) bytes. Q8_0 and Q4_0 blocks are copied
+// bit-exactly; float tensors are quantized. Throws neuroctx::Error for
+// unsupported source types or shapes.
+void pack_tensor(const TensorView& src, WeightFormat format, const PackFormat& layout, uint8_t* dst);
+
+// Packs rows supplied as int8 values (already in [-8, 7] for kInt4) plus one
+// scale per block.
+void pack_quantized(const int8_t* q, const float* scales, int64_t n, int64_t k, WeightFormat format,
+                    const PackFormat& layout, uint8_t* dst);
+
+// C[m, col] = sum over blocks of a.scale * w.scale * dot(a.q, w.q) for every
+// m < a.rows and every weight row in panels [panel_begin, panel_end).
+// Columns past w.n are never written.
+using GemmFn = void (*)(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc,
+                        int64_t panel_begin, int64_t panel_end);
+
+// Rows of A processed against one weight panel before moving on; keeps the
+// activation tile L2-resident during prefill. The GEMM kernels' upper bound
+// for TuningProfile::gemm_row_tile.
+inline constexpr int64_t kRowTile = 64;
+
+// The variant's single-row GEMV specialized for `k`, in which the K loop is
+// unrolled at compile time; nullptr for shapes that were not instantiated.
+// Expects the variant's own layout.
+using FixedGemvFn = GemmFn (*)(int64_t k, WeightFormat format);
+
+// Dense f32 tiles of fused attention: q is [nq, d], k and v are [nk, d],
+// s is [nq, nk] and acc is [nq, d], all row-major without padding.
+//   AttnScoresFn:     s = q * k^T
+//   AttnAccumulateFn: acc += s * v
+using AttnScoresFn = void (*)(const float* q, int64_t nq, const float* k, int64_t nk, int64_t d, float* s);
+using AttnAccumulateFn = void (*)(const float* s, int64_t nq, const float* v, int64_t nk, int64_t d, float* acc);
+// dst[i] = f16 src[i] widened to f32.
+using WidenF16Fn = void (*)(const uint16_t* src, int64_t n, float* dst);
+
+// Row width multiple required by DotI8Fn.
+inline constexpr int64_t kDotAlign = 16;
+// out[i] = dot(q, rows + i * dim) over `dim` int8 values for i < n;
+// embedding search. dim must be a multiple of kDotAlign.
+using DotI8Fn = void (*)(const int8_t* q, const int8_t* rows, int64_t n, int64_t dim, int32_t* out);
+
+struct KernelSet {
+    KernelVariant variant = KernelVariant::kReference;
+    const char* name = "reference";
+    PackFormat layout;
+    GemmFn gemm_i8 = nullptr;
+    GemmFn gemm_i4 = nullptr;
+    GemmFn gemv_i8 = nullptr; // a.rows == 1 fast path
+    GemmFn gemv_i4 = nullptr;
+    AttnScoresFn attn_scores = nullptr;
+    AttnAccumulateFn attn_accumulate = nullptr;
+    WidenF16Fn widen_f16 = nullptr;
+    DotI8Fn dot_i8 = nullptr;
+    FixedGemvFn fixed_gemv = nullptr; // optional; matmul_panels() falls back to gemv_*
+};
+
+// Kernel variants compiled in and supported by `features`, fastest first.
+std::vector<const KernelSet*> supported_kernels(const CpuFeatures& features);
+
+// nullptr when the variant is not compiled in or the CPU lacks it.
+const KernelSet* find_kernels(KernelVariant variant);
+
+// The process-wide choice: the fastest supported variant, unless the
+// NEUROCTX_KERNELS environment variable names another supported one.
+const KernelSet& active();
+
+// Single-threaded C = A * W^T over all panels, routing one-row inputs to the
+// fixed-shape GEMV when the variant has one for w.k, else to the GEMV path.
+// Both follow tuning() (neuroctx/tuning.h): the row tile of GEMMs and
+// whether fixed-shape GEMVs are used. `w` must have been packed in
+// `ks.layout`.
+void matmul(const KernelSet& ks, const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc);
+void matmul_panels(const KernelSet& ks, const PackedWeights& w, const QuantizedRows& a, float* c,
+                   int64_t ldc, int64_t panel_begin, int64_t panel_end);
+
+} // namespace neuroctx::kernels
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "neuroctx/memory_plan.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace neuroctx {
+
+// Storage type of cached K/V rows. The 8-bit types keep one fp32 scale per
+// (position, head) row, so a row is quantized once when it is stored and a
+// page never needs requantizing while it fills.
+enum class KvDType : uint8_t {
+    kF16,
+    kInt8, // symmetric, scale = absmax / 127
+    kFp8,  // E4M3, scale = absmax / 448
+};
+
+const char* kv_dtype_name(KvDType dtype);
+// "f16", "int8" or "fp8"; throws neuroctx::Error otherwise.
+KvDType parse_kv_dtype(std::string_view name);
+
+struct KvCacheConfig {
+    int32_t n_layers = 0;
+    int32_t n_kv_heads = 0;
+    int32_t head_dim = 0;
+    int32_t page_tokens = 16;
+    KvDType dtype = KvDType::kF16;
+    size_t budget_bytes = 0; // upper bound on page memory
+};
+
+using SeqId = int32_t;
+
+class KvPageStore;
+
+struct KvCacheStats {
+    int32_t pages_total = 0;
+    int32_t pages_free = 0;   // never used or returned
+    int32_t pages_cached = 0; // unreferenced, kept for prefix reuse
+    int32_t pages_used = 0;   // referenced by at least one sequence
+    int64_t prefix_tokens_reused = 0;
+    int64_t prefix_tokens_restored = 0; // the part of those read from the store
+    int64_t pages_evicted = 0;
+    int64_t pages_copied = 0; // copy-on-write
+    int64_t pages_spilled = 0; // written to the store on eviction or detach
+};
+
+// Paged KV storage shared by every sequence of one model.
+//
+// Memory is one address range of `pages_total` fixed-size pages; a page is
+// touched only when first handed out, so resident KV grows with the tokens
+// actually stored. A page holds `page_tokens` consecutive positions of one
+// sequence for all layers, laid out [layer][K, V][kv head] head blocks, so
+// one sequence needs a single block table. A head block is
+// [page_tokens][head_dim] elements followed, for 8-bit types, by
+// float scales[page_tokens].
+//
+// Full pages are content-addressed by the hash chain of the tokens they
+// cover (plus a per-sequence salt) and shared copy-on-write: a new sequence
+// whose prompt starts with a cached prefix maps those pages instead of
+// recomputing them. Pages nobody references stay cached until the budget
+// needs them and are then evicted least recently released first. With a
+// KvPageStore attached, published pages are persisted to flash as they are
+// evicted (and when the store is detached), never from commit(), and a
+// prefix that misses in memory is read back from there.
+//
+// Not thread-safe; the scheduler owns the cache.
+class KvCache {
+public:
+    explicit KvCache(const KvCacheConfig& config);
+
+    const KvCacheConfig& config() const { return config_; }
+    size_t page_bytes() const { return page_bytes_; }
+    // Bytes of one head block, including its scales.
+    size_t head_block_bytes() const { return head_block_bytes_; }
+
+    // `salt` separates prefixes that must never be shared even when the
+    // tokens match (different adapters, system contexts, ...).
+    SeqId create(uint64_t salt = 0);
+    // New sequence sharing every page of `src` up to its current length.
+    SeqId fork(SeqId src);
+    void release(SeqId seq);
+
+    // Maps cached full pages matching the start of `tokens` into an empty
+    // sequence and returns the number of positions now present. At least
+    // the last token is always left to compute so the caller gets logits.
+    // Pages found only in the attached store are loaded into free (or
+    // evicted) pages.
+    int64_t match_prefix(SeqId seq, std::span<const int32_t> tokens);
+
+    // Persists published pages to `store` as they are evicted and restores
+    // from it in match_prefix(); nullptr detaches. Detaching, or attaching
+    // another store, first writes every published page the old one lacks.
+    // The store must have been opened for this cache's geometry and must
+    // outlive the attachment.
+    void attach_store(KvPageStore* store);
+
+    // Evicts every cached page, first writing those the attached store does
+    // not hold yet, and returns the memory of all free pages to the OS;
+    // pages in use stay. What memory pressure calls for: prefixes then come
+    // back from the store as sequences match them again. Returns the number
+    // of pages evicted.
+    int32_t trim();
+
+    // Makes room for `n` more positions, allocating pages (evicting cached
+    // ones if needed) and unsharing a shared tail page. Returns false,
+    // without changing the sequence, when the budget cannot hold them.
+    bool reserve(SeqId seq, int64_t n);
+
+    // Stores K and V rows ([n, n_kv_heads * head_dim] floats) for positions
+    // [pos, pos + n) of `layer`. The positions must have been reserved.
+    void store(SeqId seq, int32_t layer, int64_t pos, int64_t n, const float* k, const float* v);
+
+    // Appends the tokens whose K/V were stored for every layer, advancing the
+    // length and publishing pages that became full for prefix reuse.
+    void commit(SeqId seq, std::span<const int32_t> tokens);
+
+    // Drops positions from `length` on, returning the pages past the new end
+    // (speculative decoding rolls back rejected draft tokens this way). The
+    // kept tail page is unpublished when this sequence is its only user, as
+    // its later slots will be overwritten.
+    void truncate(SeqId seq, int64_t length);
+
+    // Reads positions [pos, pos + n) of `layer` back as floats.
+    void load(SeqId seq, int32_t layer, int64_t pos, int64_t n, float* k, float* v) const;
+
+    int64_t length(SeqId seq) const { return seqs_[seq].length; }
+    std::span<const int32_t> block_table(SeqId seq) const { return seqs_[seq].pages; }
+    int64_t capacity(SeqId seq) const;
+
+    // Start of the head block of `head` in `page`; kind 0 is K, 1 is V.
+    uint8_t* head_block(int32_t page, int32_t layer, int kind, int32_t head) const;
+
+    // Pages a sequence of `tokens` positions needs.
+    int64_t pages_for(int64_t tokens) const;
+
+    KvCacheStats stats() const;
+
+private:
+    struct Page {
+        int32_t refs = 0;
+        int32_t prev = -1; // LRU links while cached
+        int32_t next = -1;
+        bool published = false;
+        uint64_t hash = 0;
+    };
+
+    struct Sequence {
+        bool live = false;
+        uint64_t salt = 0;
+        uint64_t chain = 0; // hash through the last full page
+        int64_t length = 0;
+        std::vector<int32_t> pages;
+    };
+
+    Sequence& seq_ref(SeqId seq);
+    const Sequence& seq_ref(SeqId seq) const;
+    int32_t allocate_page();
+    void acquire(int32_t page);
+    void unref(int32_t page);
+    void lru_push(int32_t page);
+    void lru_remove(int32_t page);
+    void unpublish(int32_t page);
+    void spill(int32_t page); // writes a published page the store lacks
+    uint64_t page_hash(uint64_t chain, const int32_t* tokens) const;
+    int32_t* page_tokens(int32_t page) { return tokens_.data() + size_t(page) * config_.page_tokens; }
+    const int32_t* page_tokens(int32_t page) const {
+        return tokens_.data() + size_t(page) * config_.page_tokens;
+    }
+
+    void publish(int32_t page, uint64_t hash);
+
+    KvCacheConfig config_;
+    size_t head_block_bytes_ = 0;
+    size_t page_bytes_ = 0;
+    int32_t pages_total_ = 0;
+    Arena memory_;
+    std::vector<Page> pages_;
+    std::vector<int32_t> tokens_; // token ids stored in each page
+    std::vector<int32_t> free_;
+    int32_t lru_head_ = -1; // least recently released cached page
+    int32_t lru_tail_ = -1;
+    int32_t cached_ = 0;
+    std::unordered_map<uint64_t, int32_t> published_;
+    std::vector<Sequence> seqs_;
+    std::vector<SeqId> free_seqs_;
+    KvPageStore* store_ = nullptr;
+    int64_t reused_tokens_ = 0;
+    int64_t restored_tokens_ = 0;
+    int64_t evicted_ = 0;
+    int64_t copied_ = 0;
+    int64_t spilled_ = 0;
+};
+
+// Row primitives for attention over head blocks: dequantization happens in
+// registers, never into a float copy of the cache.
+//   kv_dot:  returns dot(q, row `slot`)
+//   kv_axpy: acc += w * row `slot`
+float kv_dot(KvDType dtype, const uint8_t* block, int32_t page_tokens, int32_t head_dim, int32_t slot,
+             const float* q);
+void kv_axpy(KvDType dtype, const uint8_t* block, int32_t page_tokens, int32_t head_dim, int32_t slot, float w,
+             float* acc);
+// Rows [slot, slot + n) of a head block as floats, [n, head_dim], for the
+// tiled attention path that reuses each row across many queries.
+void kv_dequantize_rows(KvDType dtype, const uint8_t* block, int32_t page_tokens, int32_t head_dim, int32_t slot,
+                        int32_t n, float* out);
+
+} // namespace neuroctx
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "neuroctx/kv_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <span>
+#include <string>
+#include <unordered_map>
+
+namespace neuroctx {
+
+struct KvStoreOptions {
+    size_t budget_bytes = size_t(1) << 30; // least recently used pages go first
+};
+
+struct KvStoreStats {
+    int64_t pages = 0;
+    int64_t bytes = 0;
+    int64_t hits = 0;     // pages read back
+    int64_t misses = 0;   // stale or corrupt files found by load()
+    int64_t writes = 0;
+    int64_t failures = 0; // writes dropped on I/O errors
+    int64_t evicted = 0;
+};
+
+// Full KV pages persisted on flash, so prefixes that recur across requests
+// and process restarts (system prompts, user profiles, recent history) are
+// read back instead of prefilled again.
+//
+// Pages are keyed by KvCache's token hash chain, which already covers every
+// token before and in the page plus the sequence salt, mixed with a model
+// key (Model::fingerprint()): one file per page, named by that key, holding
+// the page's tokens and its bytes exactly as they sit in the cache. A file
+// carries the cache geometry and a checksum; anything that does not match
+// on load is deleted and counts as a miss.
+//
+// Writes go through a temporary file and a rename but are not fsynced; the
+// checksum catches a page torn by a crash. A write that fails (disk full,
+// ...) is dropped and counted, never thrown, because KvCache makes it when
+// a step's reserve() evicts the page.
+//
+// Not thread-safe; attach it to one KvCache (KvCache::attach_store()).
+class KvPageStore {
+public:
+    static constexpr uint32_t kFormatVersion = 1;
+
+    // Store for pages of `cache`'s geometry. Creates `dir` if needed and
+    // indexes the pages in it, oldest use first by modification time.
+    // Throws neuroctx::Error when it cannot.
+    static KvPageStore open(const std::string& dir, const KvCache& cache, uint64_t model_key,
+                            const KvStoreOptions& options = {});
+
+    bool contains(uint64_t hash) const { return index_.count(file_key(hash)) != 0; }
+
+    // Reads the page published as `hash` for `tokens` (page_tokens ids) into
+    // `page` (page_bytes). False when there is no such page.
+    bool load(uint64_t hash, std::span<const int32_t> tokens, uint8_t* page);
+
+    // Persists a published page; a no-op if already stored.
+    void save(uint64_t hash, std::span<const int32_t> tokens, const uint8_t* page);
+
+    const KvCacheConfig& layout() const { return layout_; }
+    size_t page_bytes() const { return page_bytes_; }
+    const std::string& directory() const { return dir_; }
+    KvStoreStats stats() const { return stats_; }
+
+private:
+    struct Entry {
+        size_t bytes = 0;
+        std::list<uint64_t>::iterator use; // position in use_, oldest first
+    };
+
+    uint64_t file_key(uint64_t hash) const;
+    std::string path_of(uint64_t key) const;
+    void remove(uint64_t key);
+
+    std::string dir_;
+    KvCacheConfig layout_;
+    uint64_t model_key_ = 0;
+    KvStoreOptions options_;
+    size_t page_bytes_ = 0;
+    std::unordered_map<uint64_t, Entry> index_;
+    std::list<uint64_t> use_;
+    KvStoreStats stats_;
+};
+
+} // namespace neuroctx
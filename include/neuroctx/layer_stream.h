@@ -0,0 +1,84 @@
+#pragma once
+
+#include "neuroctx/mapped_file.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace neuroctx {
+
+struct ByteRange {
+    size_t offset = 0;
+    size_t length = 0;
+};
+
+struct LayerStreamOptions {
+    int32_t window = 2; // layers resident at once, the running one included
+};
+
+struct LayerStreamStats {
+    int64_t prefetched = 0; // layers read ahead
+    int64_t evicted = 0;    // layers dropped after running
+    size_t window_bytes = 0; // weight bytes of the largest window
+};
+
+// Keeps only a window of transformer layers' weights resident.
+//
+// The executor calls enter() at every layer boundary. Entering layer l
+// queues layers l + 1 .. l + window - 1 (wrapping into the next step) for a
+// prefetch thread, which starts readahead with MADV_WILLNEED and then
+// touches a byte per page so the pages are mapped before the compute thread
+// gets there; the layer just left is dropped with MADV_DONTNEED. Resident
+// weight memory is then bounded by the largest window instead of the
+// model, at the cost of re-reading every layer from flash each step: decode
+// becomes bound by storage bandwidth when the prefetch cannot keep up.
+//
+// Not thread-safe; enter() is called from the thread running the executor.
+class LayerStreamer {
+public:
+    // `layers[l]` are the byte ranges of layer l's weights in `file`, which
+    // must outlive the streamer. Drops every layer outside the first window.
+    LayerStreamer(const MappedFile& file, std::vector<std::vector<ByteRange>> layers,
+                  const LayerStreamOptions& options = {});
+    ~LayerStreamer();
+    LayerStreamer(const LayerStreamer&) = delete;
+    LayerStreamer& operator=(const LayerStreamer&) = delete;
+
+    // The executor is about to run nodes of `layer`; -1 for the embedding
+    // and the output head.
+    void enter(int32_t layer);
+
+    int32_t layers() const { return static_cast<int32_t>(layers_.size()); }
+    int32_t window() const { return window_; }
+    LayerStreamStats stats() const;
+
+private:
+    void request(int32_t layer);
+    void evict(int32_t layer);
+    void prefetch_main();
+
+    const MappedFile& file_;
+    std::vector<std::vector<ByteRange>> layers_;
+    int32_t window_ = 1;
+    int32_t current_ = -1;
+    // Requested and not dropped since. The prefetcher reads it to abandon a
+    // layer that was dropped before it got there.
+    std::vector<std::atomic<uint8_t>> wanted_;
+    size_t window_bytes_ = 0;
+    int64_t evicted_ = 0;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<int32_t> queue_;
+    bool quit_ = false;
+    std::atomic<int64_t> prefetched_{0};
+    std::thread prefetcher_;
+};
+
+} // namespace neuroctx
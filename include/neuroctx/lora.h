@@ -0,0 +1,85 @@
+#pragma once
+
+#include "neuroctx/kernels.h"
+#include "neuroctx/model_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace neuroctx {
+
+class Model;
+class ThreadPool;
+
+// Low-rank update of one weight [n, k]: W x + scale * B (A x), with A
+// [rank, k] and B [n, rank] as f32 rows.
+struct LoraDelta {
+    const float* a = nullptr;
+    const float* b = nullptr;
+    int64_t rank = 0;
+    int64_t k = 0;
+    int64_t n = 0;
+    float scale = 1.0f; // alpha / rank times the adapter's user scale
+};
+
+// A LoRA adapter bound to one loaded base model, in llama.cpp's GGUF
+// adapter format: adapter.lora.alpha, and "<weight>.lora_a" [rank, k] plus
+// "<weight>.lora_b" [n, rank] for any of the layer projections.
+//
+// The base weights are never touched or copied: the executor computes the
+// delta as a second, rank-sized GEMM pair next to each adapted matmul, for
+// the rows of the sequences that use the adapter (StepSequence::adapter),
+// so requests with different adapters, or none, share one batch. The file
+// stays mapped; f32 factors are read in place and f16/bf16 ones widened
+// once, so an adapter costs megabytes where a merged copy of the model
+// would cost gigabytes.
+class LoraAdapter {
+public:
+    // Throws neuroctx::Error when the file is not a LoRA adapter for
+    // `model`'s architecture, a factor's shape does not match its base
+    // weight or its rank exceeds ModelOptions::max_lora_rank, or it adapts a
+    // tensor that is not a layer projection. `model` must outlive the
+    // adapter.
+    static std::unique_ptr<LoraAdapter> open(const std::string& path, const Model& model, float scale = 1.0f);
+
+    LoraAdapter(const LoraAdapter&) = delete;
+    LoraAdapter& operator=(const LoraAdapter&) = delete;
+
+    // The delta for the matmul whose node weight is `base`; nullptr when
+    // this adapter leaves it alone.
+    const LoraDelta* find(const kernels::PackedWeights* base) const;
+
+    const std::string& path() const { return file_.path(); }
+    size_t tensors() const { return deltas_.size(); }
+    // Heap held for widened factors.
+    size_t widened_bytes() const;
+    // Identity of the factors and scale; use it in the KV prefix salt, since
+    // the same tokens give different K/V under another adapter.
+    uint64_t fingerprint() const { return fingerprint_; }
+
+private:
+    LoraAdapter() = default;
+
+    ModelFile file_;
+    std::vector<std::vector<float>> widened_;
+    std::vector<std::pair<const kernels::PackedWeights*, LoraDelta>> deltas_; // sorted by base
+    uint64_t fingerprint_ = 0;
+};
+
+// `salt` combined with the adapter's fingerprint, unchanged for none: the
+// KvCache::create() salt of a sequence that runs with `adapter`.
+uint64_t adapter_salt(uint64_t salt, const LoraAdapter* adapter);
+
+// Adds d.scale * B (A x) to rows [begin, end) of `c` (row stride ldc),
+// with x the Q8 rows of the base matmul's input. `t` is scratch of
+// (end - begin) * d.rank floats. Rows of A are dotted against every input
+// row at once and B is split into column tasks across `pool`.
+void lora_apply(const LoraDelta& d, const kernels::QuantizedRows& x, int64_t begin, int64_t end, float* c,
+                int64_t ldc, float* t, ThreadPool* pool);
+
+} // namespace neuroctx
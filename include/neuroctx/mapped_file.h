@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace neuroctx {
+
+// Access-pattern hints forwarded to madvise(2).
+enum class Advice {
+    kNormal,
+    kSequential, // header parsing / one linear pass
+    kRandom,     // steady-state decode touches weights layer by layer
+    kWillNeed,   // start asynchronous readahead
+    kDontNeed,   // drop clean pages; they are re-read from the page cache
+};
+
+// Read-only, shared, page-cache-backed mapping of a whole file.
+//
+// Several processes mapping the same model share one physical copy of the
+// weights. Nothing is copied on open; pages fault in on first touch unless
+// `populate` is requested.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Throws neuroctx::Error if the file cannot be opened or mapped.
+    static MappedFile open(const std::string& path, Advice advice = Advice::kNormal,
+                           bool populate = false);
+
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    const std::string& path() const { return path_; }
+    bool empty() const { return size_ == 0; }
+
+    // Identity of the underlying file, used to key derived caches.
+    uint64_t device() const { return device_; }
+    uint64_t inode() const { return inode_; }
+    int64_t mtime_ns() const { return mtime_ns_; }
+
+    // Applies `advice` to [offset, offset + length). The range is widened
+    // to page boundaries, except for kDontNeed which is narrowed so that
+    // neighbouring data is never dropped. Returns false if madvise fails.
+    bool advise(size_t offset, size_t length, Advice advice) const;
+    bool advise(Advice advice) const { return advise(0, size_, advice); }
+
+    // Pins the range in RAM (mlock). Returns false when RLIMIT_MEMLOCK
+    // does not allow it; the mapping remains usable either way.
+    bool lock(size_t offset, size_t length) const;
+
+private:
+    void reset() noexcept;
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    uint64_t device_ = 0;
+    uint64_t inode_ = 0;
+    int64_t mtime_ns_ = 0;
+    std::string path_;
+};
+
+size_t page_size();
+
+} // namespace neuroctx
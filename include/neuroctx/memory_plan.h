@@ -0,0 +1,95 @@
+#pragma once
+
+#include "neuroctx/graph.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace neuroctx {
+
+// Upper bounds for the symbolic row dimensions of a graph.
+struct RowBounds {
+    std::array<int64_t, static_cast<size_t>(RowDim::kCount)> max = {1, 1, 1};
+
+    int64_t operator[](RowDim dim) const { return max[static_cast<size_t>(dim)]; }
+    int64_t& operator[](RowDim dim) { return max[static_cast<size_t>(dim)]; }
+};
+
+// Byte offset of every graph value inside one arena. Values whose live
+// ranges (first definition .. last use, in node order) do not overlap share
+// memory.
+struct MemoryPlan {
+    static constexpr size_t kAlignment = 64;
+
+    RowBounds bounds;
+    std::vector<size_t> offsets; // per value id
+    std::vector<size_t> sizes;   // per value id, already aligned
+    size_t arena_bytes = 0;
+    size_t unshared_bytes = 0; // what one buffer per value would cost
+};
+
+// Liveness analysis plus greedy-by-size placement: values are placed
+// largest first at the lowest offset that does not collide with any
+// already placed value that is live at the same time.
+MemoryPlan plan_memory(const Graph& graph, const RowBounds& bounds);
+
+enum class ArenaMemory : uint8_t {
+    kPrivate, // anonymous memory, CPU only
+    // A file descriptor other devices can import without copying: a dma-buf
+    // from /dev/dma_heap/system when the kernel has it (what Android's
+    // AHardwareBuffer allocates from), else a memfd.
+    kShared,
+};
+
+// One preallocated, page-aligned activation buffer. Allocation happens in
+// reserve(); the inference loop only hands out pointers.
+class Arena {
+public:
+    Arena() = default;
+    explicit Arena(size_t bytes) { reserve(bytes); }
+    explicit Arena(ArenaMemory memory) : memory_(memory) {}
+    ~Arena();
+
+    Arena(Arena&& other) noexcept;
+    Arena& operator=(Arena&& other) noexcept;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Grows the buffer to at least `bytes`; contents are not preserved.
+    void reserve(size_t bytes);
+
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t capacity() const { return capacity_; }
+
+    // Returns the pages to the OS but keeps the address range. Contents
+    // read back as zero; the next step refaults them on demand. A no-op for
+    // dma-bufs, whose pages belong to the exporting heap.
+    void discard();
+    // The same for the whole OS pages inside [offset, offset + bytes).
+    void discard(size_t offset, size_t bytes);
+
+    ArenaMemory memory() const { return memory_; }
+    // Descriptor of a kShared arena (-1 before reserve() or when private);
+    // owned by the arena.
+    int fd() const { return fd_; }
+    bool dma_buf() const { return dma_buf_; }
+
+    // Bracket CPU access to a dma-buf between device work (DMA_BUF_IOCTL_SYNC)
+    // so caches are maintained; no-ops for other memory.
+    void begin_cpu_access() const;
+    void end_cpu_access() const;
+
+private:
+    void free_buffer() noexcept;
+
+    uint8_t* data_ = nullptr;
+    size_t capacity_ = 0;
+    ArenaMemory memory_ = ArenaMemory::kPrivate;
+    int fd_ = -1;
+    bool dma_buf_ = false;
+};
+
+} // namespace neuroctx
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace neuroctx {
+
+enum class MemoryPressure : uint8_t {
+    kNone,
+    kModerate, // give back caches
+    kCritical, // give back everything that can be rebuilt, or be killed
+};
+
+const char* memory_pressure_name(MemoryPressure level);
+
+// The pressure an Android ComponentCallbacks2.onTrimMemory() level asks us
+// to act on, for a daemon whose app forwards it: RUNNING_MODERATE,
+// RUNNING_LOW, UI_HIDDEN and BACKGROUND are moderate; RUNNING_CRITICAL,
+// MODERATE and COMPLETE, where the low-memory killer is next, critical.
+MemoryPressure memory_pressure_from_trim_level(int level);
+
+struct MemoryReading {
+    // Cumulative time some or all non-idle tasks stalled on memory
+    // (/proc/pressure/memory "total=", microseconds); empty without PSI.
+    std::optional<int64_t> some_stall_us;
+    std::optional<int64_t> full_stall_us;
+    std::optional<int64_t> available_bytes; // MemAvailable
+    std::optional<int64_t> total_bytes;     // MemTotal
+};
+
+// Pressure stall information and /proc/meminfo.
+class MemorySensors {
+public:
+    explicit MemorySensors(const std::string& proc = "/proc");
+
+    MemoryReading read() const;
+    bool has_psi() const { return psi_; }
+
+private:
+    std::string proc_;
+    bool psi_ = false;
+};
+
+struct MemoryPressureOptions {
+    // Share of the time since the last reading spent stalled.
+    double moderate_some_stall = 0.10;
+    double critical_full_stall = 0.10;
+    // MemAvailable as a share of MemTotal, for kernels without PSI too.
+    double moderate_available = 0.15;
+    double critical_available = 0.05;
+    std::chrono::milliseconds calm{10000}; // below a level before stepping down from it
+};
+
+// Tracks how hard the system is reclaiming, so the runtime gives memory
+// back before the low-memory killer takes the whole process.
+//
+// Each reading is classified by the stall rate since the previous one and
+// by available memory; the level rises at once and falls one step at a
+// time, after `calm` without a reading at the current level. hint() folds
+// in levels the platform reports directly (onTrimMemory()).
+//
+// Not thread-safe. Feed it a reading about once a second and hand level
+// changes to Scheduler::set_memory_pressure(), e.g. through
+// Session::between_steps().
+class MemoryPressureMonitor {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit MemoryPressureMonitor(const MemoryPressureOptions& options = {}) : options_(options) {}
+
+    // Returns the level to act on from now on.
+    MemoryPressure update(const MemoryReading& reading, Clock::time_point now = Clock::now());
+    // A level reported by the platform counts as a reading at that level.
+    MemoryPressure hint(MemoryPressure level, Clock::time_point now = Clock::now());
+
+    MemoryPressure level() const { return level_; }
+
+private:
+    MemoryPressure classify(const MemoryReading& reading, Clock::time_point now) const;
+    MemoryPressure observe(MemoryPressure seen, Clock::time_point now);
+
+    MemoryPressureOptions options_;
+    MemoryPressure level_ = MemoryPressure::kNone;
+    Clock::time_point last_seen_; // last reading at level_
+    Clock::time_point last_reading_;
+    MemoryReading last_;
+    bool started_ = false;
+};
+
+} // namespace neuroctx
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "neuroctx/backend.h"
+#include "neuroctx/executor.h"
+#include "neuroctx/graph.h"
+#include "neuroctx/kernels.h"
+#include "neuroctx/kv_cache.h"
+#include "neuroctx/layer_stream.h"
+#include "neuroctx/memory_plan.h"
+#include "neuroctx/model_file.h"
+#include "neuroctx/packed_model.h"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace neuroctx {
+
+class ThreadPool;
+struct SnapshotKey;
+
+// Hyperparameters of a llama-family decoder, read from GGUF metadata.
+struct ModelConfig {
+    std::string architecture;
+    int64_t n_vocab = 0;
+    int64_t n_embd = 0;
+    int64_t n_layer = 0;
+    int64_t n_head = 0;
+    int64_t n_head_kv = 0;
+    int64_t head_dim = 0;
+    int64_t n_ff = 0;
+    int64_t n_ctx = 0; // training context length
+    float rms_eps = 1e-5f;
+    float rope_base = 10000.0f;
+    RopeMode rope_mode = RopeMode::kNorm;
+
+    // Supports "llama", "mistral" and "qwen2"; throws neuroctx::Error for
+    // other architectures or missing keys.
+    static ModelConfig from_gguf(const ModelFile& file);
+};
+
+struct ModelOptions {
+    int64_t max_batch_tokens = 256; // token rows of one forward step
+    int64_t max_outputs = 16;       // rows that need logits in one step
+    const kernels::KernelSet* kernels = nullptr; // defaults to kernels::active()
+    std::string cache_dir;                       // packed weights; default_cache_dir() when empty
+    bool fuse = true;                            // run fuse_graph() on the step graph
+    // Restores the planned step graph from a snapshot in cache_dir, written
+    // by the first load for these options (see snapshot.h).
+    bool snapshot = true;
+    // Accelerators to offload to (non-owning, must outlive the model). The
+    // graph is partitioned by cost across the CPU and these, once for decode
+    // and once for full batches, and the arena becomes shared memory.
+    std::vector<Backend*> backends;
+    // Streams transformer layers' packed weights from flash, keeping this
+    // many layers resident (see LayerStreamer); 0 keeps the whole model.
+    int32_t stream_layers = 0;
+    // Largest LoRA rank an adapter may have; the delta scratch is sized for
+    // it at load so steps never allocate. 0 refuses adapters.
+    int32_t max_lora_rank = 64;
+};
+
+// One forward step: token rows grouped by sequence, plus the rows whose
+// logits the caller needs (indices into `tokens`).
+struct StepBatch {
+    std::span<const int32_t> tokens;
+    std::span<const StepSequence> sequences;
+    std::span<const int32_t> output_rows;
+};
+
+// A loaded decoder: mapped GGUF, packed weights, a step graph planned for
+// `max_batch_tokens` rows and the arena it runs in.
+class Model {
+public:
+    static std::unique_ptr<Model> load(const std::string& path, const ModelOptions& options = {});
+
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    const ModelConfig& config() const { return config_; }
+    const ModelOptions& options() const { return options_; }
+    const ModelFile& file() const { return file_; }
+    const Graph& graph() const { return graph_; }
+    const MemoryPlan& plan() const { return plan_; }
+    const kernels::KernelSet& kernel_set() const { return *kernels_; }
+    const Executor& executor() const { return *executor_; }
+    const PackedModel& packed() const { return packed_; }
+    // True when the graph and plan came from a snapshot rather than being
+    // built at load.
+    bool from_snapshot() const { return from_snapshot_; }
+    // Observes the nodes of every later forward() (Executor::set_observer).
+    void set_observer(NodeObserver observer) { executor_->set_observer(std::move(observer)); }
+    // Null unless options().stream_layers is set.
+    const LayerStreamer* streamer() const { return streamer_.get(); }
+
+    // KV geometry for this model; `budget_bytes` bounds the page pool.
+    KvCacheConfig kv_config(size_t budget_bytes, KvDType dtype = KvDType::kF16, int32_t page_tokens = 16) const;
+
+    // Identity of the weights (GGUF header, size, mtime and a sample of every
+    // tensor's data) and the kernel variant computing with them; keys caches
+    // of computed state such as a KvPageStore.
+    uint64_t fingerprint() const;
+
+    // Runs one step: stores K/V for every token row (the positions must be
+    // reserved in `kv`), commits them, and returns logits
+    // [output_rows.size(), n_vocab], valid until the next call.
+    const float* forward(const StepBatch& batch, KvCache& kv, ThreadPool* pool = nullptr);
+    // The output rows' final hidden states of the last forward(), before
+    // output_norm: [output_rows.size(), n_embd], valid as long as the logits.
+    const float* hidden() const { return executor_->f32(hidden_); }
+
+    // Returns the activation arena's pages to the OS (Arena::discard()); the
+    // next forward() faults them back in. The last logits are lost.
+    void release_memory() { arena_.discard(); }
+
+private:
+    Model() = default;
+
+    void build_graph();
+    SnapshotKey snapshot_key() const;
+    bool restore_snapshot(const std::string& path);
+    void save_snapshot(const std::string& path) const;
+    void offload(const RowBounds& bounds);
+    void stream(int32_t window);
+    const float* norm_weight(const std::string& name);
+
+    ModelConfig config_;
+    ModelOptions options_;
+    const kernels::KernelSet* kernels_ = nullptr;
+    ModelFile file_;
+    PackedModel packed_;
+    std::vector<std::vector<float>> converted_; // norm/bias weights stored as f16/bf16
+    std::vector<std::pair<const float*, std::string>> norm_names_; // what norm_weight() returned, for snapshots
+    Graph graph_;
+    MemoryPlan plan_;
+    Arena arena_;
+    std::unique_ptr<Executor> executor_;
+    std::unique_ptr<LayerStreamer> streamer_; // views packed_
+    int32_t tokens_ = -1;
+    int32_t positions_ = -1;
+    int32_t output_rows_ = -1;
+    int32_t hidden_ = -1;
+    int32_t logits_ = -1;
+    bool from_snapshot_ = false;
+};
+
+} // namespace neuroctx
@@ -0,0 +1,152 @@
+#pragma once
+
+#include "neuroctx/mapped_file.h"
+#include "neuroctx/tensor.h"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace neuroctx {
+
+// GGUF metadata value types.
+enum class MetaType : uint32_t {
+    kU8 = 0,
+    kI8 = 1,
+    kU16 = 2,
+    kI16 = 3,
+    kU32 = 4,
+    kI32 = 5,
+    kF32 = 6,
+    kBool = 7,
+    kString = 8,
+    kArray = 9,
+    kU64 = 10,
+    kI64 = 11,
+    kF64 = 12,
+};
+
+// Lazily decoded view of a metadata array. Elements stay in the mapping;
+// string arrays (e.g. tokenizer vocabularies) are walked on demand.
+class MetaArray {
+public:
+    MetaArray() = default;
+    MetaArray(MetaType elem_type, uint64_t count, const uint8_t* data, const uint8_t* end)
+        : elem_type_(elem_type), count_(count), data_(data), end_(end) {}
+
+    MetaType elem_type() const { return elem_type_; }
+    uint64_t size() const { return count_; }
+    const uint8_t* data() const { return data_; }
+
+    // Fixed-width element access; returns nullopt on type mismatch.
+    std::optional<int64_t> int_at(uint64_t index) const;
+    std::optional<double> float_at(uint64_t index) const;
+
+    // Sequential reader for string arrays. Each call to next() yields the
+    // following element; returns false once exhausted.
+    class StringCursor {
+    public:
+        StringCursor(const uint8_t* pos, const uint8_t* end, uint64_t remaining)
+            : pos_(pos), end_(end), remaining_(remaining) {}
+        bool next(std::string_view& out);
+
+    private:
+        const uint8_t* pos_;
+        const uint8_t* end_;
+        uint64_t remaining_;
+    };
+    StringCursor strings() const;
+
+private:
+    MetaType elem_type_ = MetaType::kU8;
+    uint64_t count_ = 0;
+    const uint8_t* data_ = nullptr;
+    const uint8_t* end_ = nullptr;
+};
+
+class MetaValue {
+public:
+    MetaValue() = default;
+    MetaValue(MetaType type, const uint8_t* data, const uint8_t* end)
+        : type_(type), data_(data), end_(end) {}
+
+    MetaType type() const { return type_; }
+    std::optional<int64_t> as_int() const;
+    std::optional<double> as_float() const; // also accepts integer values
+    std::optional<std::string_view> as_string() const;
+    std::optional<MetaArray> as_array() const;
+    // The value as encoded in the file, for copying it to another one.
+    std::span<const uint8_t> bytes() const { return {data_, end_}; }
+
+private:
+    MetaType type_ = MetaType::kU8;
+    const uint8_t* data_ = nullptr;
+    const uint8_t* end_ = nullptr;
+};
+
+struct MetaEntry {
+    std::string_view key;
+    MetaValue value;
+};
+
+// A GGUF model file mapped read-only. Parsing touches only the header;
+// tensor payloads are handed out as views into the mapping, so opening a
+// multi-gigabyte model costs a few page faults and one table allocation
+// each for tensors, the name index and metadata, whatever the tensor count.
+class ModelFile {
+public:
+    ModelFile() = default;
+    ModelFile(ModelFile&&) noexcept = default;
+    ModelFile& operator=(ModelFile&&) noexcept = default;
+
+    // Throws neuroctx::Error on malformed or truncated files. `advice`
+    // applies to the tensor data region once the header has been parsed.
+    static ModelFile open(const std::string& path, Advice advice = Advice::kRandom,
+                          bool populate = false);
+
+    const MappedFile& mapping() const { return file_; }
+    const std::string& path() const { return file_.path(); }
+    uint32_t version() const { return version_; }
+    size_t alignment() const { return alignment_; }
+    size_t data_offset() const { return data_offset_; }
+
+    std::span<const TensorView> tensors() const { return tensors_; }
+    const TensorView* find(std::string_view name) const;
+    const TensorView& require(std::string_view name) const;
+
+    std::span<const MetaEntry> metadata() const { return metadata_; }
+    const MetaValue* meta(std::string_view key) const;
+    int64_t meta_int(std::string_view key, int64_t fallback) const;
+    double meta_float(std::string_view key, double fallback) const;
+    std::string_view meta_string(std::string_view key, std::string_view fallback = {}) const;
+
+    // `general.architecture`, e.g. "llama" or "qwen2".
+    std::string_view architecture() const { return meta_string("general.architecture"); }
+
+    // Hash of the header (names, shapes, types, metadata), the file size and
+    // the first and last 4 KiB of every tensor's data: tells apart files of
+    // the same shape with different weights while reading two pages per
+    // tensor. Independent of path and mtime.
+    uint64_t content_fingerprint() const;
+
+    // Per-tensor paging hints (e.g. WILLNEED ahead of a layer).
+    bool advise(const TensorView& tensor, Advice advice) const {
+        return file_.advise(tensor.offset, tensor.nbytes, advice);
+    }
+
+private:
+    void parse();
+
+    MappedFile file_;
+    uint32_t version_ = 0;
+    size_t alignment_ = 32;
+    size_t data_offset_ = 0;
+    std::vector<TensorView> tensors_;
+    std::vector<uint32_t> by_name_; // indices into tensors_, sorted by name
+    std::vector<MetaEntry> metadata_;
+};
+
+} // namespace neuroctx
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "neuroctx/kernels.h"
+#include "neuroctx/mapped_file.h"
+#include "neuroctx/model_file.h"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace neuroctx {
+
+// One weight matrix in kernel-native panel layout, viewed in the mapping.
+struct PackedTensor {
+    std::string_view name;
+    kernels::PackedWeights weights;
+    size_t offset = 0; // byte offset within the blob
+    size_t nbytes = 0;
+};
+
+// Kernel-native weights for one model and one kernel layout, cached as a
+// memory-mapped blob next to (or apart from) the source model.
+//
+// Blob layout (little-endian):
+//   PackHeader
+//   PackEntry[tensor_count]
+//   tensor names (not NUL-terminated)
+//   panel data, each tensor aligned to `data_alignment`
+//
+// A blob is reused only if its format version, kernel variant, panel layout
+// and source-model identity (size, mtime, header fingerprint) all match;
+// anything else is rebuilt. The CPU feature bits of the machine that packed
+// it are recorded for diagnostics.
+class PackedModel {
+public:
+    static constexpr uint32_t kFormatVersion = 1;
+
+    PackedModel() = default;
+    PackedModel(PackedModel&&) noexcept = default;
+    PackedModel& operator=(PackedModel&&) noexcept = default;
+
+    // Maps `path` if it is a valid blob for `model` and `ks`; nullopt when
+    // it is missing or stale. Throws on I/O errors other than ENOENT.
+    static std::optional<PackedModel> try_open(const std::string& path, const ModelFile& model,
+                                               const kernels::KernelSet& ks);
+
+    // Packs every eligible weight of `model` for `ks.layout` and writes the
+    // blob atomically (temporary file + rename).
+    static void build(const ModelFile& model, const kernels::KernelSet& ks, const std::string& path);
+
+    // First-run path: reuse the cached blob or build it, then map it.
+    static PackedModel open_or_build(const ModelFile& model, const kernels::KernelSet& ks,
+                                     const std::string& cache_dir);
+
+    // <cache_dir>/<model basename>.<variant>-p<rows>k<interleave>.nctxpack
+    static std::string cache_path(const ModelFile& model, const kernels::KernelSet& ks,
+                                  const std::string& cache_dir);
+
+    // Whether a tensor is stored in the blob: 2-D, packable type, K a
+    // multiple of 32. Token embeddings are only packed for tied output heads.
+    static bool should_pack(const ModelFile& model, const TensorView& tensor);
+
+    std::span<const PackedTensor> tensors() const { return tensors_; }
+    const PackedTensor* find(std::string_view name) const;
+    const kernels::PackedWeights& require(std::string_view name) const;
+
+    const MappedFile& mapping() const { return file_; }
+    const std::string& path() const { return file_.path(); }
+    uint64_t packed_cpu_bits() const { return cpu_bits_; }
+    // True if this instance was produced by open_or_build() packing afresh.
+    bool rebuilt() const { return rebuilt_; }
+
+private:
+    MappedFile file_;
+    std::vector<PackedTensor> tensors_; // sorted by name
+    uint64_t cpu_bits_ = 0;
+    bool rebuilt_ = false;
+};
+
+// $NEUROCTX_CACHE_DIR, else $XDG_CACHE_HOME/neuroctx, else ~/.cache/neuroctx.
+std::string default_cache_dir();
+
+} // namespace neuroctx
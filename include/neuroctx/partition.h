@@ -0,0 +1,34 @@
+#pragma once
+
+#include "neuroctx/backend.h"
+#include "neuroctx/graph.h"
+#include "neuroctx/memory_plan.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace neuroctx {
+
+struct Placement {
+    std::vector<int32_t> device;   // per node, an index into the profiles
+    std::vector<Segment> segments; // maximal runs of one device, in order
+    double seconds = 0;            // estimated step time
+    double cpu_seconds = 0;        // the part of it spent on devices[0]
+
+    bool offloaded() const { return segments.size() > 1 || (!segments.empty() && segments[0].device != 0); }
+};
+
+// Estimated time of one node on `device` for a step of `rows`: the larger
+// of its compute time and the time to stream its weights and activations,
+// or infinity when the device does not run the op.
+double node_seconds(const Graph& graph, const Node& node, const RowBounds& rows, const DeviceProfile& device);
+
+// Assigns every node to one of `devices` so that the estimated step time
+// is minimal. devices[0] is the CPU and must run every op. Nodes execute in
+// graph order, so a placement is a sequence of segments and switching
+// devices costs the new device's launch plus both sides' sync; a dynamic
+// program over the node order finds the exact optimum of that model.
+Placement place_graph(const Graph& graph, const RowBounds& rows, std::span<const DeviceProfile> devices);
+
+} // namespace neuroctx
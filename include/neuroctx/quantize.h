@@ -0,0 +1,96 @@
+#pragma once
+
+#include "neuroctx/model_file.h"
+#include "neuroctx/tensor.h"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace neuroctx {
+
+class Model;
+class ThreadPool;
+
+// How much each input channel of every matmul weight matters: the mean
+// square of the activations it was multiplied with over calibration text.
+// A few channels carry most of the output, and rounding their weights
+// carefully is what activation-aware quantization buys.
+class ActivationStats {
+public:
+    // Runs `model` over `tokens` as independent sequences of `chunk_tokens`
+    // (split into steps the model's plan admits) and records the inputs of
+    // every matmul. Replaces the model's node observer while it runs.
+    static ActivationStats collect(Model& model, std::span<const int32_t> tokens, int64_t chunk_tokens,
+                                   ThreadPool* pool = nullptr);
+
+    // Mean squared activation per column of `weight`; empty when no
+    // calibration step ran it.
+    std::vector<float> importance(std::string_view weight) const;
+    int64_t tokens() const { return tokens_; }
+    int64_t chunks() const { return chunks_; }
+    size_t size() const { return entries_.size(); }
+
+private:
+    struct Entry {
+        std::vector<double> sum; // of squares, per column
+        int64_t rows = 0;
+    };
+
+    std::unordered_map<std::string, Entry> entries_;
+    int64_t tokens_ = 0;
+    int64_t chunks_ = 0;
+};
+
+// Encodes one row of `k` floats (a multiple of 32) as Q4_0 or Q8_0 blocks:
+// 32 values sharing an fp16 scale. The scale of each block is the
+// least-squares fit, weighted by `importance` (k values; null weighs every
+// column the same), among a small grid of candidate roundings, rather than
+// plain absmax. Throws neuroctx::Error for other types.
+void quantize_row(const float* x, int64_t k, DType type, const float* importance, uint8_t* dst);
+
+// Type override for tensors whose name contains `pattern`.
+struct TensorTypeRule {
+    std::string pattern;
+    DType type = DType::kQ8_0; // kQ4_0, kQ8_0, kF16 or kF32
+};
+
+struct QuantizeOptions {
+    DType type = DType::kQ4_0; // of 2-D weights: kQ4_0 or kQ8_0
+    // Mixed precision: the first matching rule sets a tensor's type instead.
+    // A tied token_embd.weight also matches as output.weight. The defaults
+    // keep the output head and value projections, the most sensitive to
+    // rounding, at 8 bits.
+    std::vector<TensorTypeRule> rules = {{"output.weight", DType::kQ8_0}, {"attn_v.weight", DType::kQ8_0}};
+    const ActivationStats* stats = nullptr; // importance-weighted rounding when set
+};
+
+struct QuantizedTensor {
+    std::string name;
+    DType from = DType::kF32;
+    DType to = DType::kF32;
+    // sum(w * (x - q)^2) / sum(w * x^2) with w the importance (1 without
+    // statistics); 0 for tensors copied as they are.
+    double error = 0.0;
+};
+
+struct QuantizeResult {
+    std::vector<QuantizedTensor> tensors; // in file order
+    uint64_t bytes_in = 0;                // tensor data
+    uint64_t bytes_out = 0;
+};
+
+// Writes `src` to `path` (atomically, temporary file + rename) as GGUF with
+// its 2-D weights requantized: `options.type` or a rule's type for tensors
+// whose rows are whole blocks and that dequantize_row() can read, the rest
+// copied byte for byte, as are tensors already of the target type. Metadata
+// is kept, with general.file_type and general.quantization_version updated
+// and quantize.imatrix.* recording the calibration. Rows are quantized
+// across `pool`.
+QuantizeResult quantize_model(const ModelFile& src, const std::string& path, const QuantizeOptions& options,
+                              ThreadPool* pool = nullptr);
+
+} // namespace neuroctx
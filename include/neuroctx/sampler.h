@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace neuroctx {
+
+class ThreadPool;
+
+struct SamplingParams {
+    float temperature = 0.0f; // <= 0: greedy
+    int32_t top_k = 40;       // candidates kept; 0 keeps the whole vocabulary
+    float top_p = 0.95f;      // nucleus over the top-k candidates; 1 keeps them all
+    // Recent tokens' logits are divided by this when positive and multiplied
+    // when negative (CTRL-style); 1 disables.
+    float repetition_penalty = 1.0f;
+    int32_t penalty_last_n = 64; // tokens of the context the penalty looks back over
+    uint64_t seed = 0;           // 0: derived from the request id
+};
+
+// Tokens allowed at the next position, bit t % 64 of word t / 64, at least
+// ceil(n_vocab / 64) words; empty allows every token.
+using TokenMask = std::span<const uint64_t>;
+
+// Next-token selection from one logits row.
+//
+// Never softmaxes or sorts the vocabulary: one pass keeps the top k logits
+// in a k-entry heap, skipping 16-logit blocks whose maximum (one NEON
+// reduction) cannot enter it and blocks the mask rules out as a whole.
+// Tokens under the repetition penalty are skipped in that pass and offered
+// again with their penalized logit, so the row is never written. Only the
+// k survivors are sorted, scaled by the temperature and softmaxed; top-p
+// cuts that list. Greedy decoding is the same pass with k = 1, so masks and
+// penalties apply to it too.
+//
+// Not thread-safe; keeps scratch buffers between calls.
+class Sampler {
+public:
+    // Returns the token, or -1 when the mask allows none. `recent` are the
+    // context's last tokens, of which the last penalty_last_n are
+    // penalized; `rng` is the request's generator state, advanced by one
+    // per sampled (non-greedy) token. Throws neuroctx::Error for a mask
+    // shorter than the row.
+    int32_t sample(std::span<const float> logits, const SamplingParams& params, std::span<const int32_t> recent,
+                   TokenMask allowed, uint64_t& rng);
+
+private:
+    struct Candidate {
+        float logit;
+        int32_t token;
+    };
+    void offer(float logit, int32_t token, size_t k);
+
+    std::vector<Candidate> heap_;  // min-heap of the best k so far
+    std::vector<uint64_t> penalized_; // bitset, cleared again after each call
+    std::vector<float> weights_;
+};
+
+struct SampleJob {
+    std::span<const float> logits;
+    const SamplingParams* params = nullptr; // null: skipped
+    std::span<const int32_t> recent;
+    TokenMask allowed;
+    uint64_t* rng = nullptr;
+    int32_t token = -1; // result
+};
+
+// Samples the output rows of one batched step, one job per row.
+class BatchSampler {
+public:
+    // Runs the jobs across `pool` (one Sampler's scratch per worker), or on
+    // the calling thread when it is null or there is a single job. Throws
+    // neuroctx::Error for a mask shorter than its row.
+    void sample(std::span<SampleJob> jobs, ThreadPool* pool);
+
+private:
+    std::vector<Sampler> samplers_;
+};
+
+} // namespace neuroctx
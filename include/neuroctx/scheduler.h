@@ -0,0 +1,187 @@
+#pragma once
+
+#include "neuroctx/executor.h"
+#include "neuroctx/kv_cache.h"
+#include "neuroctx/memory_pressure.h"
+#include "neuroctx/sampler.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace neuroctx {
+
+class LoraAdapter;
+class Model;
+class ThreadPool;
+
+using RequestId = int64_t;
+
+enum class RequestState : uint8_t {
+    kQueued,  // waiting for a slot (also after preemption)
+    kRunning, // has a KV sequence; prefilling or decoding
+    kFinished,
+    kCancelled,
+};
+
+enum class RequestPriority : uint8_t {
+    kInteractive, // user-facing; its decode steps come first
+    kBackground,  // bulk ingestion; prefills only in leftover budget and is
+                  // preempted first under KV pressure
+};
+
+struct GenerateRequest {
+    std::vector<int32_t> prompt;
+    // When false, more prompt tokens arrive through append_input() and are
+    // prefilled as they come; generation starts once the input is closed.
+    bool input_complete = true;
+    RequestPriority priority = RequestPriority::kInteractive;
+    int32_t max_new_tokens = 128;
+    std::vector<int32_t> stop_tokens;
+    uint64_t prefix_salt = 0; // KvCache::create() salt
+    // Runs the request with this LoRA adapter of the scheduler's model,
+    // which must outlive it; null runs the base model.
+    const LoraAdapter* adapter = nullptr;
+    // Called for every generated token; returning false ends the request.
+    std::function<bool(RequestId, int32_t)> on_token;
+    // Picks the next token from one logits row; when empty the built-in
+    // Sampler does, with `sampling` (greedy by default) and `allowed_tokens`.
+    std::function<int32_t(std::span<const float>)> sample;
+    SamplingParams sampling;
+    // The tokens allowed next, e.g. by a grammar that on_token advances;
+    // called before every pick, and the mask must stay valid until the
+    // token is delivered. An empty mask allows everything; one that allows
+    // nothing finishes the request.
+    std::function<TokenMask(RequestId)> allowed_tokens;
+};
+
+struct SchedulerOptions {
+    int64_t max_batch_tokens = 256; // clamped to the model's planned batch
+    int32_t max_running = 8;        // sequences with KV at once
+    int64_t prefill_chunk = 128;    // prompt tokens of one request per step
+    // Prompt tokens allowed in a step that also carries interactive decode
+    // tokens; bounds how much a long prefill can delay a decode step.
+    int64_t prefill_tokens_with_decode = 64;
+};
+
+struct SchedulerStats {
+    int64_t steps = 0;
+    int64_t decode_tokens = 0;
+    int64_t prefill_tokens = 0;
+    int64_t prefix_tokens_reused = 0;
+    int64_t preemptions = 0;
+    int64_t spilled = 0; // requests suspended under critical memory pressure
+    int64_t max_step_tokens = 0;
+};
+
+// Continuous batching over one model and one paged KV cache.
+//
+// Every step() builds a single forward pass from all running requests:
+// each decoding request contributes its one pending token first, then
+// prefilling requests fill the remaining token budget with prompt chunks,
+// interactive and oldest first. Requests join and leave between steps, so
+// new prompts never wait for a whole batch to finish.
+//
+// Prompts are prefilled in chunks of at most `prefill_chunk` tokens that
+// go straight into the KV cache, so activation memory is fixed by the
+// planned batch, not by prompt length. Between chunks a prefill yields to
+// decode steps, and it never takes more than `prefill_tokens_with_decode`
+// rows of a step that carries interactive decode tokens. Streaming inputs
+// (input_complete = false) are prefilled as their tokens arrive.
+//
+// The output rows of a step are sampled together, across the pool, before
+// any on_token callback runs.
+//
+// When the KV budget runs out a request is preempted: background requests
+// first, then the most recently admitted. Its pages are released and it is
+// requeued at the front to recompute; its prefix usually comes back from
+// the prefix cache.
+//
+// Not thread-safe; drive it from one thread.
+class Scheduler {
+public:
+    Scheduler(Model& model, KvCache& kv, ThreadPool* pool = nullptr, const SchedulerOptions& options = {});
+
+    RequestId submit(GenerateRequest request);
+    // Adds prompt tokens to a request submitted with input_complete = false;
+    // `last` closes its input.
+    void append_input(RequestId id, std::span<const int32_t> tokens, bool last);
+    void cancel(RequestId id);
+    // Drops a finished or cancelled request's record.
+    void release(RequestId id);
+
+    // Runs one batched forward pass. Returns false when nothing is runnable.
+    bool step();
+    // Steps until nothing is runnable: every request has finished or waits
+    // for streamed input.
+    void run();
+
+    // Token budget of the next steps, clamped to the model's planned batch;
+    // what a governor turns down to shed heat without dropping requests.
+    void set_max_batch_tokens(int64_t tokens);
+    int64_t max_batch_tokens() const { return options_.max_batch_tokens; }
+
+    // Gives memory back as the system runs short. Moderate pressure drops
+    // the prefix cache (KvCache::trim()). Critical pressure also suspends
+    // every running request, releasing its KV so its full pages spill to
+    // the attached KvPageStore, and discards the model's activation arena;
+    // nothing is admitted or stepped until the pressure drops below
+    // critical. Suspended requests then resume from the pages the store
+    // reads back as each is readmitted, recomputing at most a partial page
+    // and the pending token; without a store they prefill again.
+    void set_memory_pressure(MemoryPressure level);
+    MemoryPressure memory_pressure() const { return pressure_; }
+
+    RequestState state(RequestId id) const;
+    // Generated tokens so far.
+    std::span<const int32_t> output(RequestId id) const;
+    size_t active() const { return waiting_.size() + running_.size(); }
+    const SchedulerStats& stats() const { return stats_; }
+
+private:
+    struct Request {
+        GenerateRequest spec;
+        RequestState state = RequestState::kQueued;
+        std::vector<int32_t> tokens; // prompt followed by generated tokens
+        size_t prompt_tokens = 0;
+        int64_t computed = 0; // positions with K/V in the cache
+        SeqId seq = -1;
+        bool input_open = false;
+        uint64_t rng = 0; // sampler state
+    };
+
+    Request& get(RequestId id);
+    const Request& get(RequestId id) const;
+    void admit();
+    bool reserve_or_preempt(RequestId id, int64_t n);
+    bool in_batch(RequestId id) const;
+    void preempt(RequestId id);
+    void finish(Request& r, RequestState state);
+
+    Model& model_;
+    KvCache& kv_;
+    ThreadPool* pool_;
+    SchedulerOptions options_;
+    int64_t max_outputs_ = 0;
+    RequestId next_id_ = 1;
+    std::unordered_map<RequestId, Request> requests_;
+    std::deque<RequestId> waiting_;
+    std::vector<RequestId> running_; // admission order
+    SchedulerStats stats_;
+    MemoryPressure pressure_ = MemoryPressure::kNone;
+
+    // Per-step buffers, reused so steady-state steps do not allocate.
+    std::vector<RequestId> step_order_; // running_ at the start of the step
+    std::vector<int32_t> batch_tokens_;
+    std::vector<StepSequence> batch_seqs_;
+    std::vector<int32_t> batch_outputs_;
+    std::vector<RequestId> batch_owner_;  // per StepSequence
+    std::vector<RequestId> output_owner_; // per output row
+    std::vector<SampleJob> sample_jobs_;  // per output row
+    BatchSampler sampler_;
+};
+
+} // namespace neuroctx
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "neuroctx/event_loop.h"
+#include "neuroctx/scheduler.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace neuroctx {
+
+class KvCache;
+class Model;
+class ThreadPool;
+
+enum class GenerateStatus : uint8_t {
+    kFinished,  // max_new_tokens or a stop token
+    kCancelled, // stop token requested or on_token returned false
+    kDeadline,
+};
+
+struct GenerateResult {
+    GenerateStatus status = GenerateStatus::kFinished;
+    std::vector<int32_t> tokens;
+};
+
+struct GenerateControl {
+    // Called on the loop thread for every generated token, in order;
+    // returning false cancels the request.
+    std::function<bool(int32_t)> on_token;
+    // Cancels the request when stop is requested, from any thread.
+    std::stop_token stop;
+    // The request is cancelled at the first step boundary past it.
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+};
+
+// Non-blocking front end of a Scheduler for coroutines on an EventLoop:
+//
+//   GenerateResult r = co_await session.generate(std::move(request), control);
+//
+// One engine thread owns the model, the KV cache and the scheduler and runs
+// the batched steps; any number of requests from any number of coroutines
+// share them. Tokens and completions come back through EventLoop::post(),
+// so a client's callbacks and resumption always run on the loop thread and
+// never block on a forward pass.
+//
+// Requests must be complete (input_complete), with a prompt and
+// max_new_tokens > 0, and must not set GenerateRequest::on_token, which the
+// session uses itself; stream through GenerateControl::on_token instead.
+// GenerateRequest::sample and allowed_tokens run on the engine thread. A
+// request the scheduler still refuses fails only its own co_await.
+//
+// generate() must be awaited from a coroutine running on the loop. Destroy
+// the session only after every generate() has completed; the destructor
+// stops the engine thread after its current step.
+class Session {
+    struct Pending;
+
+public:
+    Session(Model& model, KvCache& kv, EventLoop& loop, ThreadPool* pool = nullptr,
+            const SchedulerOptions& options = {});
+    ~Session();
+    Session(const Session&) = delete;
+    Session& operator=(const Session&) = delete;
+
+    class GenerateAwaiter {
+    public:
+        bool await_ready() const noexcept { return false; }
+        void await_suspend(std::coroutine_handle<> h) { session_->start(pending_, h); }
+        // Rethrows a scheduler error or an exception from on_token.
+        GenerateResult await_resume() { return session_->collect(*pending_); }
+
+    private:
+        friend class Session;
+        GenerateAwaiter(Session* session, std::shared_ptr<Pending> pending)
+            : session_(session), pending_(std::move(pending)) {}
+
+        Session* session_;
+        std::shared_ptr<Pending> pending_;
+    };
+
+    // Throws neuroctx::Error for a request the session cannot take.
+    GenerateAwaiter generate(GenerateRequest request, GenerateControl control = {});
+
+    // Snapshot as of the last finished step. Thread-safe.
+    SchedulerStats stats() const;
+
+    // Runs `fn` on the engine thread before its next step, e.g. to change
+    // the batch budget or ThreadPool::set_active(), which must not race a
+    // step. `fn` must not throw. Thread-safe.
+    void between_steps(std::function<void(Scheduler&, ThreadPool*)> fn);
+
+private:
+    void start(const std::shared_ptr<Pending>& p, std::coroutine_handle<> h);
+    GenerateResult collect(Pending& p);
+    void cancel(Pending& p);
+    void deliver(const std::shared_ptr<Pending>& p);
+    void engine_main();
+
+    EventLoop& loop_;
+    ThreadPool* pool_;
+    Scheduler scheduler_; // engine thread only
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<std::shared_ptr<Pending>> incoming_;
+    std::vector<std::function<void(Scheduler&, ThreadPool*)>> tuning_;
+    SchedulerStats stats_;
+    bool quit_ = false;
+
+    std::vector<std::shared_ptr<Pending>> active_; // engine thread only
+    std::thread engine_;
+};
+
+} // namespace neuroctx
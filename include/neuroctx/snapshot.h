@@ -0,0 +1,51 @@
+#pragma once
+
+#include "neuroctx/graph.h"
+#include "neuroctx/memory_plan.h"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace neuroctx {
+
+// What a snapshot is valid for: the source model's identity, the kernel
+// variant and device it was planned on, and the plan's options.
+struct SnapshotKey {
+    uint64_t source_size = 0;
+    uint64_t source_mtime_ns = 0;
+    uint64_t source_fingerprint = 0; // GGUF header bytes
+    uint64_t device = 0;             // hash of tuning_device()
+    uint32_t variant = 0;            // kernels::Variant
+    uint32_t fuse = 0;
+    int64_t max_batch_tokens = 0;
+    int64_t max_outputs = 0;
+
+    bool operator==(const SnapshotKey&) const = default;
+};
+
+// The state Model::load() derives before its first step: the fused step
+// graph and its memory plan, i.e. the arena layout. Node weights are held
+// by tensor name (weights[n] = {weight, aux} of node n, empty for none) and
+// their pointers left null, to be resolved against the mapped model.
+struct StartupSnapshot {
+    static constexpr uint32_t kFormatVersion = 1;
+
+    Graph graph;
+    MemoryPlan plan;
+    std::vector<std::array<std::string, 2>> weights;
+};
+
+// Binary file layout (little-endian): a header with the key, the values,
+// the nodes, the plan, then a checksum of everything before it. Written
+// atomically (temporary file + rename); throws neuroctx::Error on I/O
+// errors.
+void write_snapshot(const std::string& path, const SnapshotKey& key, const StartupSnapshot& snapshot);
+
+// The snapshot at `path` when it was written for `key` and is intact;
+// nullopt when it is missing, stale or corrupt.
+std::optional<StartupSnapshot> read_snapshot(const std::string& path, const SnapshotKey& key);
+
+} // namespace neuroctx
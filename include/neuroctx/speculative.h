@@ -0,0 +1,104 @@
+#pragma once
+
+#include "neuroctx/kv_cache.h"
+#include "neuroctx/scheduler.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace neuroctx {
+
+class Model;
+class ThreadPool;
+
+struct SpeculativeOptions {
+    int32_t max_draft = 8; // clamped so k + 1 rows fit the target's outputs
+    int32_t initial_draft = 4;
+    // Weight of the latest round in the acceptance and timing averages.
+    float smoothing = 0.2f;
+    // While speculation does not pay off (k = 0), one round in this many
+    // still drafts a token so the acceptance estimate can recover. The
+    // interval doubles after each probe that does not re-enable drafting,
+    // up to 16x.
+    int32_t probe_interval = 16;
+};
+
+struct SpeculativeStats {
+    int64_t rounds = 0;       // target verify steps
+    int64_t drafted = 0;      // draft tokens proposed
+    int64_t accepted = 0;     // draft tokens the target agreed with
+    int64_t draft_steps = 0;  // draft forward passes
+    int64_t generated = 0;
+    float acceptance = 0.0f;  // smoothed per-token acceptance rate
+    int32_t draft_length = 0; // k of the next round
+
+    // Tokens produced per target forward pass.
+    double tokens_per_round() const { return rounds > 0 ? double(generated) / double(rounds) : 0.0; }
+};
+
+// Speculative decoding of one request with a small draft model.
+//
+// Each round the draft decodes k tokens greedily, then the target runs one
+// forward pass over the pending token and all k drafts and picks its own
+// token at every row. Drafts are accepted while they match the target's
+// pick; the first mismatch is replaced by the target's token (or, when all
+// match, the target's pick after the last draft is appended), so each round
+// yields between 1 and k + 1 tokens for a single read of the target
+// weights. Rejected positions are rolled back with KvCache::truncate().
+//
+// The output is exactly what the target alone would produce: every emitted
+// token is the target's pick (GenerateRequest::sample, or the built-in
+// Sampler) at its position, given the tokens before it. Sampling draws one
+// random number per emitted token, so a seeded request samples the same
+// tokens as without a draft.
+//
+// k adapts between rounds: with a smoothed acceptance rate a, a round of k
+// drafts yields (1 - a^(k + 1)) / (1 - a) tokens on average, and k is chosen
+// to maximize that over the measured cost of k draft steps plus a verify
+// step of k + 1 rows. k = 0 decodes with the target alone.
+//
+// Both models must share the tokenizer (same vocabulary size is checked).
+// Each model has its own KV cache; the streaming input and priority fields
+// of GenerateRequest are not used.
+class SpeculativeDecoder {
+public:
+    SpeculativeDecoder(Model& target, KvCache& target_kv, Model& draft, KvCache& draft_kv,
+                       ThreadPool* pool = nullptr, const SpeculativeOptions& options = {});
+
+    // Runs the request to completion and returns the generated tokens.
+    // Throws neuroctx::Error when a KV cache cannot hold the sequence.
+    std::vector<int32_t> generate(const GenerateRequest& request);
+
+    // Accumulated over every generate() call; acceptance and draft_length
+    // carry over between requests.
+    const SpeculativeStats& stats() const { return stats_; }
+
+private:
+    void prefill(Model& model, KvCache& kv, SeqId seq, std::span<const int32_t> tokens,
+                 const LoraAdapter* adapter = nullptr);
+    const float* step(Model& model, KvCache& kv, SeqId seq, std::span<const int32_t> tokens, int64_t outputs,
+                      const LoraAdapter* adapter = nullptr);
+    int32_t choose_draft_length() const;
+
+    Model& target_;
+    KvCache& target_kv_;
+    Model& draft_;
+    KvCache& draft_kv_;
+    ThreadPool* pool_;
+    SpeculativeOptions options_;
+    SpeculativeStats stats_;
+    RequestId next_id_ = 1;
+    int32_t max_draft_ = 0;
+    int32_t probe_interval_ = 0;
+    int32_t since_probe_ = 0;
+    // Smoothed step costs, 0 until measured: one draft step, a one-row
+    // target step, and each extra row of a verify step.
+    double draft_seconds_ = 0.0;
+    double verify_seconds_ = 0.0;
+    double verify_row_seconds_ = 0.0;
+
+    std::vector<int32_t> rows_; // output row indices, 0 .. max_draft
+    Sampler sampler_;
+};
+
+} // namespace neuroctx
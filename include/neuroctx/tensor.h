@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace neuroctx {
+
+// Element types understood by the loader. Values match the GGUF/ggml type
+// ids so tensor records can be decoded without a translation table.
+enum class DType : uint32_t {
+    kF32 = 0,
+    kF16 = 1,
+    kQ4_0 = 2,
+    kQ4_1 = 3,
+    kQ5_0 = 6,
+    kQ5_1 = 7,
+    kQ8_0 = 8,
+    kQ8_1 = 9,
+    kQ2_K = 10,
+    kQ3_K = 11,
+    kQ4_K = 12,
+    kQ5_K = 13,
+    kQ6_K = 14,
+    kQ8_K = 15,
+    kIQ2_XXS = 16,
+    kIQ2_XS = 17,
+    kIQ3_XXS = 18,
+    kIQ1_S = 19,
+    kIQ4_NL = 20,
+    kIQ3_S = 21,
+    kIQ2_S = 22,
+    kIQ4_XS = 23,
+    kI8 = 24,
+    kI16 = 25,
+    kI32 = 26,
+    kI64 = 27,
+    kF64 = 28,
+    kIQ1_M = 29,
+    kBF16 = 30,
+    // ARM interleaved Q4_0 repacks (4x4, 4x8, 8x8 rows x bytes).
+    kQ4_0_4_4 = 31,
+    kQ4_0_4_8 = 32,
+    kQ4_0_8_8 = 33,
+};
+
+struct DTypeInfo {
+    const char* name;
+    uint32_t block_elems; // elements per quantization block (1 for plain types)
+    uint32_t block_bytes; // storage bytes per block
+};
+
+// Returns nullptr for type ids this build does not know about.
+const DTypeInfo* dtype_info(DType type);
+
+const char* dtype_name(DType type);
+
+inline constexpr int kMaxDims = 4;
+
+// Non-owning view of one tensor inside a mapped model file. `name` and
+// `data` point straight into the mapping and stay valid for as long as the
+// owning ModelFile is alive.
+struct TensorView {
+    std::string_view name;
+    DType dtype = DType::kF32;
+    uint32_t n_dims = 0;
+    int64_t ne[kMaxDims] = {1, 1, 1, 1}; // ne[0] is the contiguous dimension
+    const void* data = nullptr;
+    size_t offset = 0; // byte offset of `data` within the file
+    size_t nbytes = 0;
+
+    int64_t elements() const { return ne[0] * ne[1] * ne[2] * ne[3]; }
+    int64_t rows() const { return ne[1] * ne[2] * ne[3]; }
+    int64_t cols() const { return ne[0]; }
+    size_t row_bytes() const { return nbytes / static_cast<size_t>(rows()); }
+
+    template <typename T>
+    const T* as() const {
+        return static_cast<const T*>(data);
+    }
+};
+
+// Whether dequantize_row() can decode `type`: f32, f16, bf16, q8_0, q4_0.
+bool can_dequantize(DType type);
+
+// Decodes row `row` of a 2-D tensor into cols() floats. Throws
+// neuroctx::Error for other types.
+void dequantize_row(const TensorView& tensor, int64_t row, float* out);
+
+// IEEE half <-> single conversions used for scales and fp16 weights.
+inline float fp16_to_fp32(uint16_t h) {
+    const uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    uint32_t bits;
+    if (exp == 0x1f) {
+        bits = sign | 0x7f800000u | (mant << 13);
+    } else if (exp != 0) {
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    } else if (mant == 0) {
+        bits = sign;
+    } else {
+        // Subnormal half: renormalize.
+        exp = 113;
+        while ((mant & 0x400) == 0) {
+            mant <<= 1;
+            --exp;
+        }
+        bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+    }
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+inline uint16_t fp32_to_fp16(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    const uint32_t abs = bits & 0x7fffffffu;
+    if (abs >= 0x7f800000u) {
+        return static_cast<uint16_t>(sign | 0x7c00 | (abs > 0x7f800000u ? 0x200 : 0));
+    }
+    if (abs >= 0x477ff000u) { // rounds to >= 65520: overflow to inf
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+    if (abs < 0x38800000u) { // below the smallest normal half
+        if (abs < 0x33000000u) {
+            return static_cast<uint16_t>(sign);
+        }
+        const uint32_t exp = abs >> 23;
+        const uint32_t mant = (abs & 0x7fffff) | 0x800000;
+        const uint32_t shift = 126 - exp;
+        uint32_t half = mant >> shift;
+        const uint32_t rem = mant & ((1u << shift) - 1);
+        const uint32_t mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (half & 1))) {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = ((abs - 0x38000000u) >> 13);
+    const uint32_t rem = abs & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) {
+        ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+inline float bf16_to_fp32(uint16_t h) {
+    const uint32_t bits = static_cast<uint32_t>(h) << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+// OCP FP8 E4M3 (bias 7, no infinities, 0x7f/0xff are NaN). Conversion
+// rounds to nearest even and saturates at +-448; used for KV storage.
+inline uint8_t fp32_to_fp8_e4m3(float f) {
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    const auto sign = static_cast<uint8_t>((bits >> 24) & 0x80);
+    const uint32_t abs = bits & 0x7fffffffu;
+    if (abs > 0x7f800000u) {
+        return static_cast<uint8_t>(sign | 0x7f);
+    }
+    if (abs >= 0x43e00000u) { // >= 448
+        return static_cast<uint8_t>(sign | 0x7e);
+    }
+    if (abs < 0x3c800000u) { // below the smallest normal, 2^-6
+        if (abs < 0x3a800000u) { // below half the smallest subnormal
+            return sign;
+        }
+        const uint32_t exp = abs >> 23;
+        const uint32_t mant = (abs & 0x7fffff) | 0x800000;
+        const uint32_t shift = 141 - exp;
+        uint32_t q = mant >> shift;
+        const uint32_t rem = mant & ((1u << shift) - 1);
+        const uint32_t mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (q & 1))) {
+            ++q;
+        }
+        return static_cast<uint8_t>(sign | q);
+    }
+    uint32_t q = (abs - 0x3c000000u) >> 20;
+    const uint32_t rem = abs & 0xfffff;
+    if (rem > 0x80000 || (rem == 0x80000 && (q & 1))) {
+        ++q;
+    }
+    return static_cast<uint8_t>(sign | (q > 0x7e ? 0x7e : q));
+}
+
+inline float fp8_e4m3_to_fp32(uint8_t v) {
+    const uint32_t exp = (v >> 3) & 0xf;
+    const uint32_t mant = v & 0x7;
+    float f;
+    if (exp == 0) {
+        f = static_cast<float>(mant) * (1.0f / 512.0f);
+    } else if (exp == 0xf && mant == 0x7) {
+        const uint32_t nan = 0x7fc00000u;
+        std::memcpy(&f, &nan, sizeof(f));
+    } else {
+        const uint32_t bits = ((exp + 120) << 23) | (mant << 20);
+        std::memcpy(&f, &bits, sizeof(f));
+    }
+    return (v & 0x80) ? -f : f;
+}
+
+} // namespace neuroctx
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace neuroctx {
+
+// CPUs grouped into clusters of equal capacity, fastest cluster first.
+// Capacity comes from sysfs cpu_capacity (arm64), else cpuinfo_max_freq,
+// else every CPU counts the same.
+struct CpuCluster {
+    std::vector<int> cpus;
+    uint32_t capacity = 0;
+};
+
+struct CpuTopology {
+    std::vector<CpuCluster> clusters;
+
+    int cpu_count() const;
+    std::string describe() const; // e.g. "1x3300 3x2800 4x2000"
+};
+
+// Reads the clusters of the CPUs this process may run on.
+CpuTopology read_cpu_topology(const std::string& sysfs_root = "/sys/devices/system/cpu");
+
+enum class CorePolicy : uint8_t {
+    kPerformance, // every cluster except the slowest (all when there is one)
+    kAll,
+};
+
+// "perf" or "all"; throws neuroctx::Error otherwise.
+CorePolicy parse_core_policy(std::string_view name);
+
+struct ThreadPoolOptions {
+    CorePolicy policy = CorePolicy::kPerformance;
+    int max_threads = 0; // 0: one per selected CPU
+    bool pin = true;
+
+    // NEUROCTX_CORES=perf|all and NEUROCTX_THREADS=N override the defaults.
+    static ThreadPoolOptions from_env();
+};
+
+// Fork-join pool for kernel tiles. The calling thread takes part as worker
+// 0 (unpinned, so application threads keep their affinity); the other
+// workers are pinned one per selected CPU, fastest cluster first.
+//
+// parallel_for() splits the task range across workers in proportion to
+// their cluster's measured throughput; workers that run dry steal half of
+// the remaining range of another worker, so a slow or preempted core never
+// holds up the step. Weights start from the cluster capacity and follow the
+// observed tasks-per-worker of each cluster.
+class ThreadPool {
+public:
+    using TaskFn = void (*)(void* ctx, int64_t task, int worker);
+
+    explicit ThreadPool(const ThreadPoolOptions& options = {});
+    ThreadPool(const CpuTopology& topology, const ThreadPoolOptions& options);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return static_cast<int>(workers_.size()); }
+    // Workers that take part in parallel_for(); the others stay parked.
+    int active() const { return active_count_; }
+    int cluster_of(int worker) const { return workers_[worker].cluster; }
+    int cpu_of(int worker) const { return workers_[worker].cpu; }
+    const CpuTopology& topology() const { return topology_; }
+    // Current relative throughput of one worker in `cluster` (fastest = 1).
+    double cluster_weight(int cluster) const { return cluster_weight_[cluster]; }
+
+    // Restricts jobs to the calling thread plus up to `threads` - 1 workers
+    // outside the `skip_clusters` fastest clusters (a throttled SoC runs
+    // cooler on its mid cores). Clamped so the calling thread always works;
+    // call between jobs, from the thread that calls run().
+    void set_active(int threads, int skip_clusters = 0);
+
+    // Runs fn(ctx, task, worker) for every task in [0, n) and returns when
+    // all are done. Not reentrant; one caller at a time.
+    void run(int64_t n, TaskFn fn, void* ctx);
+
+    template <typename F>
+    void parallel_for(int64_t n, F&& f) {
+        using Fn = std::remove_reference_t<F>;
+        run(
+            n,
+            [](void* ctx, int64_t task, int worker) { (*static_cast<Fn*>(ctx))(task, worker); },
+            const_cast<void*>(static_cast<const void*>(&f)));
+    }
+
+private:
+    struct alignas(64) Queue {
+        std::atomic<uint64_t> range{0}; // begin | end << 32
+        std::atomic<uint32_t> job{0};   // last generation the worker takes part in
+    };
+
+    struct Worker {
+        int cpu = -1;
+        int cluster = 0;
+        int64_t done = 0; // tasks executed in the current job
+    };
+
+    void start(const ThreadPoolOptions& options);
+    void worker_main(int index);
+    void work(int index);
+    bool steal(int thief);
+    void update_weights(int64_t n);
+
+    CpuTopology topology_;
+    std::vector<Worker> workers_;
+    std::vector<Queue> queues_;
+    std::vector<double> cluster_weight_;
+    std::vector<std::thread> threads_;
+    std::vector<uint8_t> enabled_; // per worker; caller thread only
+    int active_count_ = 0;
+
+    TaskFn fn_ = nullptr;
+    void* ctx_ = nullptr;
+    alignas(64) std::atomic<uint32_t> generation_{0};
+    alignas(64) std::atomic<int> active_{0};
+    std::atomic<bool> stop_{false};
+};
+
+} // namespace neuroctx
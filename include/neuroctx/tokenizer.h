@@ -0,0 +1,176 @@
+#pragma once
+
+#include "neuroctx/model_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace neuroctx {
+
+enum class TokenizerModel : uint8_t {
+    kBytePair,      // "gpt2": byte-level BPE by merge rank (Llama 3, Qwen2)
+    kSentencePiece, // "llama": BPE by piece score with byte fallback (Llama 2, Mistral, TinyLlama)
+};
+
+// Splitting of byte-level BPE input into words, after tokenizer.ggml.pre.
+enum class PreTokenizer : uint8_t {
+    kGpt2,   // 's|'t|..| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+
+    kLlama3, // (?i:'s|..)|[^\r\n\p{L}\p{N}]?\p{L}+|\p{N}{1,3}| ?[^\s\p{L}\p{N}]+[\r\n]*|\s*[\r\n]+|\s+(?!\S)|\s+
+    kQwen2,  // as kLlama3 with single digits
+};
+
+struct TokenizerOptions {
+    size_t cache_words = 4096; // word encodings kept in the LRU cache; 0 disables it
+};
+
+struct TokenizerStats {
+    uint64_t words = 0;       // words encoded
+    uint64_t cache_hits = 0;  // of them, answered from the cache
+    uint64_t cache_evictions = 0;
+};
+
+// Text to token ids and back for the vocabulary in a GGUF file.
+//
+// Token strings stay in the file's mapping; loading builds a hash index
+// over them, a table of merges keyed by the token pair and a trie of the
+// special tokens, so a 150k-token vocabulary loads in milliseconds. Text is
+// split into words by a hand-written scanner equivalent to the model's
+// pre-tokenizer pattern, which decodes and validates UTF-8 as it goes and
+// runs through ASCII letters 8 or 16 bytes at a time. Each word is merged
+// with a priority queue (O(n log n) also for words that are whole
+// paragraphs) unless the LRU cache of word encodings already has it; on
+// ordinary prose most words hit. Scratch buffers and cache entries are
+// reused, so once they have grown to the longest word seen, encode()
+// allocates nothing beyond the caller's output vector.
+//
+// SentencePiece vocabularies are split at word starts (U+2581) only when no
+// piece spans one, which keeps the result identical to merging the whole
+// text; characters missing from the vocabulary become byte tokens without
+// taking part in merges.
+//
+// Not thread-safe: encode() updates the cache and scratch state.
+class Tokenizer {
+public:
+    // From the tokenizer.ggml.* metadata of `file`, which must outlive the
+    // tokenizer. Throws neuroctx::Error when there is none or the model type
+    // is not supported.
+    static Tokenizer from_gguf(const ModelFile& file, const TokenizerOptions& options = {});
+
+    Tokenizer(Tokenizer&&) noexcept = default;
+    Tokenizer& operator=(Tokenizer&&) noexcept = default;
+
+    // Appends the tokens of `text` to `out`. Control tokens written out in
+    // the text (e.g. "<|im_start|>") become their ids when `parse_special`
+    // is set; user-defined tokens always do. Invalid UTF-8 is encoded
+    // byte by byte.
+    void encode(std::string_view text, std::vector<int32_t>& out, bool add_bos = false, bool parse_special = true);
+
+    // Appends the text of `tokens` to `out`; control tokens only with
+    // `special`. Unknown ids are skipped. SentencePiece word starts become
+    // spaces, including the one encode() put in front of the text, so that
+    // decoding token by token concatenates to the same string.
+    void decode(std::span<const int32_t> tokens, std::string& out, bool special = false) const;
+
+    int32_t size() const { return static_cast<int32_t>(tokens_.size()); }
+    std::string_view token(int32_t id) const { return tokens_[static_cast<size_t>(id)]; }
+    std::optional<int32_t> find(std::string_view token) const;
+    int32_t bos() const { return bos_; } // -1 when the vocabulary has none
+    int32_t eos() const { return eos_; }
+    bool adds_bos() const { return add_bos_; } // tokenizer.ggml.add_bos_token
+    TokenizerModel model() const { return model_; }
+    PreTokenizer pre_tokenizer() const { return pre_; }
+    const TokenizerStats& stats() const { return stats_; }
+
+private:
+    struct Merge {
+        uint64_t pair = ~uint64_t{0}; // left id << 32 | right id; all ones when empty
+        float priority = 0;           // higher merges first
+        int32_t result = -1;
+    };
+    struct Symbol {
+        int32_t id;   // -1: no token, emitted as byte tokens
+        int32_t prev;
+        int32_t next;
+        uint32_t offset; // bytes of the word
+        uint32_t len;    // 0 once merged into its left neighbour
+    };
+    struct Candidate {
+        float priority;
+        int32_t left;
+        int32_t left_id;
+        int32_t right_id;
+        int32_t result;
+    };
+    struct TrieNode {
+        int32_t token = -1;
+        std::vector<std::pair<uint8_t, int32_t>> children;
+    };
+    static constexpr size_t kCacheWordBytes = 22;
+    static constexpr size_t kCacheTokens = 8;
+    struct CacheEntry {
+        uint64_t hash = 0;
+        int32_t newer = -1;
+        int32_t older = -1;
+        int32_t chain = -1; // next entry in the same bucket
+        uint8_t word_len = 0;
+        uint8_t n_tokens = 0;
+        char word[kCacheWordBytes];
+        int32_t tokens[kCacheTokens];
+    };
+
+    Tokenizer() = default;
+    void index_vocabulary();
+    int32_t lookup(std::string_view token) const;
+    void add_merge(int32_t left, int32_t right, float priority, int32_t result);
+    const Merge* find_merge(int32_t left, int32_t right) const;
+    std::pair<int32_t, size_t> match_special(std::string_view text, size_t pos, bool parse_special) const;
+
+    void encode_fragment(std::string_view text, std::vector<int32_t>& out, bool space_prefix);
+    size_t next_word(std::string_view text, size_t pos) const;
+    void encode_word(std::string_view word, std::vector<int32_t>& out);
+    void merge_word(std::string_view word, std::vector<int32_t>& out);
+    void push_candidate(int32_t left, int32_t right);
+
+    int32_t cache_find(std::string_view word, uint64_t hash);
+    void cache_insert(std::string_view word, uint64_t hash, std::span<const int32_t> tokens);
+    void cache_unlink(int32_t entry);
+    void cache_push(int32_t entry);
+
+    TokenizerModel model_ = TokenizerModel::kBytePair;
+    PreTokenizer pre_ = PreTokenizer::kGpt2;
+    std::vector<std::string_view> tokens_;
+    std::vector<uint8_t> types_;
+    std::vector<int32_t> index_; // open addressing over tokens_, -1 empty
+    std::vector<Merge> merges_;
+    std::vector<TrieNode> special_trie_;
+    bool special_first_[256] = {};
+    int32_t byte_tokens_[256] = {}; // token of each byte: its mapped character, or <0xXX>
+    int32_t bos_ = -1;
+    int32_t eos_ = -1;
+    int32_t unk_ = -1;
+    bool add_bos_ = false;
+    bool add_space_prefix_ = true;
+    bool ignore_merges_ = false; // whole words found in the vocabulary skip merging (Llama 3)
+    bool split_words_ = true;    // SentencePiece: no piece spans a word start
+
+    std::vector<CacheEntry> cache_;
+    std::vector<int32_t> buckets_;
+    int32_t cache_used_ = 0;
+    int32_t newest_ = -1;
+    int32_t oldest_ = -1;
+    TokenizerStats stats_;
+
+    std::string text_; // escaped SentencePiece fragment
+    std::string word_; // byte-level word in mapped characters
+    std::vector<Symbol> symbols_;
+    std::vector<Candidate> heap_;
+    std::vector<int32_t> word_tokens_;
+};
+
+} // namespace neuroctx
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace neuroctx::trace {
+
+// Hot-path instrumentation, off until enable().
+//
+// Spans are timestamped with the cycle counter (CNTVCT_EL0 on AArch64, the
+// monotonic clock elsewhere) and appended to a per-thread ring that only
+// its thread writes, so recording is two counter reads and a 40-byte store
+// with no lock or shared cache line. Disabled, every instrumented site costs
+// one relaxed load of a flag that stays in L1.
+//
+// The executor records a span per node and one per transformer layer; the
+// thread pool one per worker per parallel_for, which shows how evenly big
+// and little cores finished. With PMU counters available (perf_event_open
+// allowed by perf_event_paranoid), each thread opens its own last-level
+// read-miss counter and reads it without a lock: layer and work spans carry
+// the bytes their thread read from memory, and on export a layer also gets
+// the traffic of other threads' work spans that began inside it.
+//
+// Export with write_chrome_trace() for ui.perfetto.dev or chrome://tracing,
+// or aggregate with profile(). Both read the rings without synchronizing
+// with their writers: call them while traced threads are idle, e.g. between
+// steps or after disable().
+
+struct TraceOptions {
+    size_t buffer_events = size_t{1} << 15; // per thread, rounded up to a power of two; oldest dropped
+    bool pmu = true;
+};
+
+enum class Kind : uint8_t {
+    kScope, // Scope
+    kOp,    // executor node; arg = layer
+    kLayer, // executor layer; arg = layer, bytes = memory read traffic
+    kWork,  // thread pool worker; arg = tasks it ran, bytes = its memory read traffic
+};
+
+struct Event {
+    const char* name; // must outlive the trace: a literal or op_name()
+    uint64_t begin;
+    uint64_t end;
+    uint64_t bytes;
+    int32_t arg;
+    Kind kind;
+};
+
+namespace detail {
+inline std::atomic<bool> g_enabled{false};
+} // namespace detail
+
+inline bool enabled() { return detail::g_enabled.load(std::memory_order_relaxed); }
+
+inline uint64_t now() {
+#if defined(__aarch64__)
+    uint64_t v;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+uint64_t ticks_per_second();
+
+// Starts recording on every thread, including ones started later; each opens
+// its PMU counter the first time it measures. Safe to call again to change
+// options; buffers keep the size they were created with.
+void enable(const TraceOptions& options = {});
+void disable();
+// Drops everything recorded so far.
+void clear();
+// Whether layer spans carry memory traffic.
+bool pmu_available();
+
+// Appends to the calling thread's ring. No-op while disabled.
+void record(Kind kind, const char* name, uint64_t begin, uint64_t end, int32_t arg = -1, uint64_t bytes = 0);
+
+// Bytes read from memory by the calling thread since its counter was opened,
+// from the PMU; 0 without it. Lock-free: one read() of the thread's counter.
+uint64_t memory_bytes();
+
+// Records the enclosing block.
+class Scope {
+public:
+    explicit Scope(const char* name) : name_(enabled() ? name : nullptr), begin_(name_ != nullptr ? now() : 0) {}
+    ~Scope() {
+        if (name_ != nullptr) {
+            record(Kind::kScope, name_, begin_, now());
+        }
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name_;
+    uint64_t begin_;
+};
+
+// Emits a kLayer span whenever the layer of consecutive nodes changes.
+class LayerMeter {
+public:
+    void enter(int32_t layer);
+    void finish() { enter(-1); }
+
+private:
+    int32_t layer_ = -1;
+    uint64_t begin_ = 0;
+    uint64_t bytes_ = 0;
+};
+
+// Writes every recorded event as Chrome trace JSON, which Perfetto opens.
+// Throws neuroctx::Error when the file cannot be written.
+void write_chrome_trace(const std::string& path);
+
+// Totals per op name (layer == -1) and per layer (name "layer"), slowest
+// first.
+struct OpProfile {
+    std::string name;
+    int32_t layer = -1;
+    uint64_t calls = 0;
+    double total_us = 0;
+    double max_us = 0;
+    uint64_t bytes = 0;
+
+    double bandwidth_gbps() const { return total_us > 0 ? double(bytes) / (total_us * 1e3) : 0.0; }
+};
+std::vector<OpProfile> profile();
+
+} // namespace neuroctx::trace
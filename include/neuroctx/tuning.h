@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace neuroctx {
+
+// Tile and unroll parameters of the kernel drivers that do not change
+// results beyond float rounding, so they can be picked per device.
+// Defaults suit a Cortex-A7x-class core; `neuroctx_bench --tune` measures
+// the current device's model shapes and writes the profile the runtime
+// loads at startup.
+struct TuningProfile {
+    int64_t gemm_row_tile = 64;        // activation rows run against each panel in turn; 64 at most
+    int32_t tasks_per_worker = 4;      // matmul panel ranges per pool worker, for stealing
+    int32_t attention_query_tile = 16; // query vectors sharing a K/V tile, up to kMaxQueryTile
+    int32_t attention_key_tile = 16;   // cache positions per K/V tile, up to kMaxKeyTile
+    bool fixed_gemv = true;            // fully specialized GEMV kernels where the shape has one
+
+    bool operator==(const TuningProfile&) const = default;
+};
+
+// What a profile is only valid for: the active kernel variant, the CPU
+// features and the cluster topology, e.g. "dotprod | neon fp16 dotprod | 4x1024 4x512".
+std::string tuning_device();
+
+// NEUROCTX_TUNING when set, else <default_cache_dir()>/tuning-<device hash>.txt.
+std::string tuning_profile_path();
+
+// "key value" lines as written by write_tuning_profile(). Missing keys keep
+// their defaults, unknown ones are ignored and values are clamped to what
+// the kernels accept. `device` receives the device line. Throws
+// neuroctx::Error when the file cannot be read or a value does not parse.
+TuningProfile read_tuning_profile(const std::string& path, std::string* device = nullptr);
+
+// Writes `profile` for tuning_device() atomically (temporary file + rename),
+// creating the directory.
+void write_tuning_profile(const TuningProfile& profile, const std::string& path);
+
+// The process-wide profile, read on first use from tuning_profile_path()
+// when it exists and was tuned on this device; the defaults otherwise.
+const TuningProfile& tuning();
+// Where tuning() came from: the profile path, or "defaults" with the reason.
+const std::string& tuning_source();
+// Replaces the profile. Not synchronized with kernel callers: only for
+// tools that switch it between runs, like the tuner.
+void set_tuning(const TuningProfile& profile);
+
+// Panels per matmul task for `panels` panels on `workers` workers, a
+// multiple of `align`.
+int64_t panels_per_task(int64_t panels, int workers, int64_t align = 1);
+
+} // namespace neuroctx
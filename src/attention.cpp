@@ -0,0 +1,121 @@
+#include "neuroctx/attention.h"
+
+#include "neuroctx/tuning.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace neuroctx {
+
+namespace {
+
+void load_rows(const kernels::KernelSet& ks, KvDType dtype, const uint8_t* block, int32_t page_tokens,
+               int32_t head_dim, int32_t slot, int32_t n, float* out) {
+    if (dtype == KvDType::kF16) {
+        ks.widen_f16(reinterpret_cast<const uint16_t*>(block) + int64_t(slot) * head_dim, int64_t(n) * head_dim,
+                     out);
+    } else {
+        kv_dequantize_rows(dtype, block, page_tokens, head_dim, slot, n, out);
+    }
+}
+
+// Query vectors [i0, i1) of rows starting at r0, where vector i is row
+// r0 + i / group and head kv_head * group + i % group.
+void attention_tile(const kernels::KernelSet& ks, const KvCache& kv, SeqId seq, int32_t layer,
+                    const AttentionShape& shape, int64_t pos0, int64_t r0, int64_t i0, int64_t i1, int32_t kv_head,
+                    const float* q, int64_t ldq, float* out, int64_t ldo) {
+    const KvCacheConfig& config = kv.config();
+    const int32_t pt = config.page_tokens;
+    const int32_t hd = shape.head_dim;
+    const int32_t group = shape.n_head / shape.n_kv_head;
+    const int64_t nq = i1 - i0;
+    const int32_t key_tile = tuning().attention_key_tile;
+    const auto table = kv.block_table(seq);
+
+    alignas(64) float qt[kMaxQueryTile * kMaxHeadDim];
+    alignas(64) float acc[kMaxQueryTile * kMaxHeadDim];
+    alignas(64) float kt[kMaxKeyTile * kMaxHeadDim];
+    alignas(64) float vt[kMaxKeyTile * kMaxHeadDim];
+    alignas(64) float s[kMaxQueryTile * kMaxKeyTile];
+    float max[kMaxQueryTile];
+    float sum[kMaxQueryTile];
+
+    // The softmax scale is folded into the copy.
+    for (int64_t i = 0; i < nq; ++i) {
+        const int64_t v = i0 + i;
+        const float* src = q + (r0 + v / group) * ldq + (int64_t(kv_head) * group + v % group) * hd;
+        for (int32_t d = 0; d < hd; ++d) {
+            qt[i * hd + d] = src[d] * shape.scale;
+        }
+        max[i] = -std::numeric_limits<float>::infinity();
+        sum[i] = 0.0f;
+    }
+    std::fill(acc, acc + nq * hd, 0.0f);
+
+    const int64_t last = pos0 + r0 + (i1 - 1) / group;
+    for (int64_t start = 0; start <= last;) {
+        const int32_t page = table[static_cast<size_t>(start / pt)];
+        const auto slot = static_cast<int32_t>(start % pt);
+        const auto nk = static_cast<int32_t>(std::min<int64_t>({key_tile, pt - slot, last - start + 1}));
+        load_rows(ks, config.dtype, kv.head_block(page, layer, 0, kv_head), pt, hd, slot, nk, kt);
+        load_rows(ks, config.dtype, kv.head_block(page, layer, 1, kv_head), pt, hd, slot, nk, vt);
+        ks.attn_scores(qt, nq, kt, nk, hd, s);
+
+        for (int64_t i = 0; i < nq; ++i) {
+            float* si = s + i * nk;
+            // Keys past the query's own position are masked out.
+            const int64_t visible = std::clamp<int64_t>(pos0 + r0 + (i0 + i) / group - start + 1, 0, nk);
+            float tile_max = -std::numeric_limits<float>::infinity();
+            for (int64_t j = 0; j < visible; ++j) {
+                tile_max = std::max(tile_max, si[j]);
+            }
+            if (tile_max > max[i]) {
+                const float correction = std::exp(max[i] - tile_max);
+                sum[i] *= correction;
+                float* ai = acc + i * hd;
+                for (int32_t d = 0; d < hd; ++d) {
+                    ai[d] *= correction;
+                }
+                max[i] = tile_max;
+            }
+            float tile_sum = 0.0f;
+            for (int64_t j = 0; j < visible; ++j) {
+                si[j] = std::exp(si[j] - max[i]);
+                tile_sum += si[j];
+            }
+            std::fill(si + visible, si + nk, 0.0f);
+            sum[i] += tile_sum;
+        }
+        ks.attn_accumulate(s, nq, vt, nk, hd, acc);
+        start += nk;
+    }
+
+    for (int64_t i = 0; i < nq; ++i) {
+        const int64_t v = i0 + i;
+        float* o = out + (r0 + v / group) * ldo + (int64_t(kv_head) * group + v % group) * hd;
+        const float inv = 1.0f / sum[i];
+        for (int32_t d = 0; d < hd; ++d) {
+            o[d] = acc[i * hd + d] * inv;
+        }
+    }
+}
+
+} // namespace
+
+int64_t attention_row_tile(const AttentionShape& shape) {
+    return std::max<int64_t>(1, tuning().attention_query_tile / (shape.n_head / shape.n_kv_head));
+}
+
+void paged_attention(const kernels::KernelSet& ks, const KvCache& kv, SeqId seq, int32_t layer,
+                     const AttentionShape& shape, int64_t pos0, int64_t row_begin, int64_t row_end,
+                     int32_t kv_head, const float* q, int64_t ldq, float* out, int64_t ldo) {
+    const int64_t total = (row_end - row_begin) * (shape.n_head / shape.n_kv_head);
+    const int64_t query_tile = tuning().attention_query_tile;
+    for (int64_t i = 0; i < total; i += query_tile) {
+        attention_tile(ks, kv, seq, layer, shape, pos0, row_begin, i, std::min(total, i + query_tile), kv_head, q,
+                       ldq, out, ldo);
+    }
+}
+
+} // namespace neuroctx
@@ -0,0 +1,64 @@
+#include "neuroctx/backend.h"
+
+#include <algorithm>
+#include <unistd.h>
+
+namespace neuroctx {
+
+const char* device_kind_name(DeviceKind kind) {
+    switch (kind) {
+    case DeviceKind::kCpu: return "cpu";
+    case DeviceKind::kGpu: return "gpu";
+    case DeviceKind::kNpu: return "npu";
+    }
+    return "unknown";
+}
+
+DeviceProfile cpu_profile(const kernels::KernelSet& kernels, int threads) {
+    constexpr double kHz = 2.0e9;
+    double int8_per_cycle = 2.0; // scalar multiply-add
+    switch (kernels.variant) {
+    case kernels::KernelVariant::kReference: break;
+    case kernels::KernelVariant::kNeon: int8_per_cycle = 16.0; break;
+    case kernels::KernelVariant::kDotprod: int8_per_cycle = 64.0; break;
+    case kernels::KernelVariant::kI8mm: int8_per_cycle = 128.0; break;
+    case kernels::KernelVariant::kSve:
+        int8_per_cycle = 64.0 * std::max<uint32_t>(cpu_features().sve_vector_bytes, 16) / 16.0;
+        break;
+    }
+    const double cores = std::max(threads, 1);
+    DeviceProfile p;
+    p.name = std::string("cpu-") + kernels.name;
+    p.kind = DeviceKind::kCpu;
+    p.int8_ops_per_s = cores * int8_per_cycle * kHz;
+    p.f32_ops_per_s = cores * 8.0 * kHz;
+    // A couple of big cores already saturate the memory controller.
+    p.bytes_per_s = std::min(cores, 4.0) * 5.0e9;
+    p.ops = kAllOps;
+    return p;
+}
+
+std::vector<AcceleratorInfo> probe_accelerators(const std::string& dev_root) {
+    struct Known {
+        const char* node;
+        DeviceKind kind;
+        const char* name;
+    };
+    static constexpr Known kKnown[] = {
+        {"mali0", DeviceKind::kGpu, "mali"},       // Arm kbase driver
+        {"kgsl-3d0", DeviceKind::kGpu, "adreno"},  // Qualcomm
+        {"ethosn0", DeviceKind::kNpu, "ethos-n"},  // Ethos-N78 and kin
+        {"ethosu0", DeviceKind::kNpu, "ethos-u"},  // Ethos-U65/U85 (Linux driver)
+        {"ethos-u0", DeviceKind::kNpu, "ethos-u"}, // older out-of-tree naming
+    };
+    std::vector<AcceleratorInfo> found;
+    for (const Known& k : kKnown) {
+        const std::string path = dev_root + "/" + k.node;
+        if (::access(path.c_str(), F_OK) == 0) {
+            found.push_back({k.kind, k.name, path});
+        }
+    }
+    return found;
+}
+
+} // namespace neuroctx
@@ -0,0 +1,14 @@
+#include "neuroctx/common.h"
+
+#include <cerrno>
+#include <cstring>
+
+namespace neuroctx {
+
+void throw_error(const std::string& what) { throw Error(what); }
+
+void throw_errno(const std::string& what) {
+    throw Error(what + ": " + std::strerror(errno));
+}
+
+} // namespace neuroctx
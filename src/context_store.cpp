@@ -0,0 +1,764 @@
+#include "neuroctx/context_store.h"
+
+#include "fd_io.h"
+#include "neuroctx/common.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace neuroctx {
+
+namespace {
+
+constexpr char kLogMagic[8] = {'N', 'C', 'T', 'X', 'L', 'O', 'G', '\0'};
+constexpr char kIvfMagic[8] = {'N', 'C', 'T', 'X', 'I', 'V', 'F', '\0'};
+
+struct LogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t stride;
+    uint32_t reserved;
+};
+
+struct RecordHeader {
+    uint64_t id;
+    float scale;
+    uint32_t reserved;
+};
+
+struct IvfHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dim;
+    uint32_t stride;
+    uint32_t nlist;
+    uint32_t first_seq;
+    uint32_t last_seq;
+    uint64_t count;
+    uint64_t centroid_offset;       // int8[nlist][stride]
+    uint64_t centroid_scale_offset; // float[nlist]
+    uint64_t list_offset;           // uint64[nlist + 1], record index of each list
+    uint64_t id_offset;             // uint64[count]
+    uint64_t scale_offset;          // float[count]
+    uint64_t vector_offset;         // int8[count][stride]
+    uint64_t file_size;
+};
+
+static_assert(sizeof(LogHeader) == 24);
+static_assert(sizeof(RecordHeader) == 16);
+static_assert(sizeof(IvfHeader) == 96);
+
+constexpr size_t kSectionAlign = kCacheLine;
+// Rows scored per dot_i8 call; bounds the score buffer.
+constexpr int64_t kScanChunk = 256;
+constexpr int kKmeansIters = 8;
+// Training sample per list; k-means cost is linear in it.
+constexpr int64_t kSamplePerList = 32;
+constexpr int32_t kMaxLists = 4096;
+
+// One record to be written into a sealed segment; `v` points into the open
+// segment or a mapped source segment.
+struct Row {
+    uint64_t id;
+    float scale;
+    const int8_t* v;
+};
+
+std::string segment_name(uint32_t seq, const char* ext) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%08u.%s", seq, ext);
+    return name;
+}
+
+// Parses "NNNNNNNN.<ext>"; false for anything else.
+bool parse_segment_name(const std::string& name, const char* ext, uint32_t* seq) {
+    const size_t ext_len = std::strlen(ext);
+    if (name.size() != 9 + ext_len || name[8] != '.' || name.compare(9, ext_len, ext) != 0) {
+        return false;
+    }
+    uint32_t v = 0;
+    for (int i = 0; i < 8; ++i) {
+        if (name[i] < '0' || name[i] > '9') {
+            return false;
+        }
+        v = v * 10 + uint32_t(name[i] - '0');
+    }
+    *seq = v;
+    return true;
+}
+
+void sync_directory(const std::string& dir) {
+    FdGuard fd(::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (fd.get() < 0 || fsync(fd.get()) != 0) {
+        throw_errno("fsync " + dir);
+    }
+}
+
+// Normalizes `x` and quantizes it symmetrically into out[0, stride), zero
+// padded. Returns the scale, or 0 for a zero (or non-finite) vector.
+float quantize(const float* x, int64_t dim, int64_t stride, int8_t* out) {
+    double norm2 = 0.0;
+    float amax = 0.0f;
+    for (int64_t t = 0; t < dim; ++t) {
+        norm2 += double(x[t]) * double(x[t]);
+        amax = std::max(amax, std::fabs(x[t]));
+    }
+    std::memset(out, 0, size_t(stride));
+    if (!(norm2 > 0.0) || !std::isfinite(norm2)) {
+        return 0.0f;
+    }
+    const float inv_norm = float(1.0 / std::sqrt(norm2));
+    const float scale = amax * inv_norm / 127.0f;
+    const float inv = inv_norm / scale;
+    for (int64_t t = 0; t < dim; ++t) {
+        out[t] = static_cast<int8_t>(std::lrintf(std::clamp(x[t] * inv, -127.0f, 127.0f)));
+    }
+    return scale;
+}
+
+int32_t list_count(int64_t records) {
+    const auto n = static_cast<int32_t>(std::lround(std::sqrt(double(records))));
+    return std::clamp<int32_t>(n, 1, kMaxLists);
+}
+
+// Index of the centroid most similar to `v`.
+int32_t nearest(const kernels::KernelSet& ks, const int8_t* v, const int8_t* centroids,
+                const float* centroid_scales, int32_t nlist, int64_t stride, int32_t* dots) {
+    ks.dot_i8(v, centroids, nlist, stride, dots);
+    int32_t best = 0;
+    float best_score = -INFINITY;
+    for (int32_t c = 0; c < nlist; ++c) {
+        const float s = float(dots[c]) * centroid_scales[c];
+        if (s > best_score) {
+            best_score = s;
+            best = c;
+        }
+    }
+    return best;
+}
+
+// Spherical k-means on an evenly spaced sample of `rows`. Assignment runs on
+// the int8 forms with the store's own dot kernel; means are taken in float.
+void train_lists(const kernels::KernelSet& ks, const std::vector<Row>& rows, int32_t nlist, int64_t dim,
+                 int64_t stride, std::vector<int8_t>& centroids, std::vector<float>& centroid_scales) {
+    const auto n = static_cast<int64_t>(rows.size());
+    const int64_t samples = std::min<int64_t>(n, int64_t(nlist) * kSamplePerList);
+    std::vector<const Row*> sample(static_cast<size_t>(samples));
+    for (int64_t i = 0; i < samples; ++i) {
+        sample[size_t(i)] = &rows[size_t(i * n / samples)];
+    }
+    centroids.assign(size_t(nlist) * size_t(stride), 0);
+    centroid_scales.assign(size_t(nlist), 0.0f);
+    for (int32_t c = 0; c < nlist; ++c) {
+        const Row& r = *sample[size_t(int64_t(c) * samples / nlist)];
+        std::memcpy(&centroids[size_t(c) * size_t(stride)], r.v, size_t(stride));
+        centroid_scales[size_t(c)] = r.scale;
+    }
+
+    std::vector<double> sums(static_cast<size_t>(nlist) * size_t(dim));
+    std::vector<int64_t> counts(static_cast<size_t>(nlist));
+    std::vector<int32_t> dots(static_cast<size_t>(nlist));
+    std::vector<float> fit(static_cast<size_t>(samples));
+    std::vector<float> mean(static_cast<size_t>(dim));
+    std::vector<int64_t> worst;
+    for (int iter = 0; iter < kKmeansIters; ++iter) {
+        std::fill(sums.begin(), sums.end(), 0.0);
+        std::fill(counts.begin(), counts.end(), 0);
+        for (int64_t i = 0; i < samples; ++i) {
+            const Row& r = *sample[size_t(i)];
+            const int32_t c = nearest(ks, r.v, centroids.data(), centroid_scales.data(), nlist, stride, dots.data());
+            fit[size_t(i)] = float(dots[size_t(c)]) * centroid_scales[size_t(c)] * r.scale;
+            ++counts[size_t(c)];
+            double* sum = &sums[size_t(c) * size_t(dim)];
+            for (int64_t t = 0; t < dim; ++t) {
+                sum[t] += double(r.v[t]) * double(r.scale);
+            }
+        }
+        // Empty lists restart at the samples their centroids fit worst.
+        worst.clear();
+        for (int32_t c = 0; c < nlist; ++c) {
+            int8_t* out = &centroids[size_t(c) * size_t(stride)];
+            if (counts[size_t(c)] > 0) {
+                const double* sum = &sums[size_t(c) * size_t(dim)];
+                for (int64_t t = 0; t < dim; ++t) {
+                    mean[size_t(t)] = float(sum[t]);
+                }
+                centroid_scales[size_t(c)] = quantize(mean.data(), dim, stride, out);
+                continue;
+            }
+            if (worst.empty()) {
+                worst.resize(size_t(samples));
+                for (int64_t i = 0; i < samples; ++i) {
+                    worst[size_t(i)] = i;
+                }
+                std::sort(worst.begin(), worst.end(),
+                          [&](int64_t a, int64_t b) { return fit[size_t(a)] > fit[size_t(b)]; });
+            }
+            const Row& r = *sample[size_t(worst.back())];
+            worst.pop_back();
+            std::memcpy(out, r.v, size_t(stride));
+            centroid_scales[size_t(c)] = r.scale;
+        }
+    }
+}
+
+// Writes `rows` as sealed segment <last_seq>.ivf, atomically replacing any
+// file of that name. Returns its path.
+std::string write_segment(const kernels::KernelSet& ks, const std::string& dir, const std::vector<Row>& rows,
+                          int64_t dim, int64_t stride, uint32_t first_seq, uint32_t last_seq) {
+    const auto count = static_cast<int64_t>(rows.size());
+    const int32_t nlist = std::min<int32_t>(list_count(count), static_cast<int32_t>(count));
+    std::vector<int8_t> centroids;
+    std::vector<float> centroid_scales;
+    train_lists(ks, rows, nlist, dim, stride, centroids, centroid_scales);
+
+    // Counting sort of the records into their lists.
+    std::vector<int32_t> assign(static_cast<size_t>(count));
+    std::vector<uint64_t> lists(size_t(nlist) + 1, 0);
+    std::vector<int32_t> dots(static_cast<size_t>(nlist));
+    for (int64_t i = 0; i < count; ++i) {
+        assign[size_t(i)] =
+            nearest(ks, rows[size_t(i)].v, centroids.data(), centroid_scales.data(), nlist, stride, dots.data());
+        ++lists[size_t(assign[size_t(i)]) + 1];
+    }
+    for (int32_t c = 0; c < nlist; ++c) {
+        lists[size_t(c) + 1] += lists[size_t(c)];
+    }
+
+    IvfHeader h{};
+    std::memcpy(h.magic, kIvfMagic, sizeof(kIvfMagic));
+    h.version = ContextStore::kFormatVersion;
+    h.dim = static_cast<uint32_t>(dim);
+    h.stride = static_cast<uint32_t>(stride);
+    h.nlist = static_cast<uint32_t>(nlist);
+    h.first_seq = first_seq;
+    h.last_seq = last_seq;
+    h.count = static_cast<uint64_t>(count);
+    h.centroid_offset = align_up(sizeof(IvfHeader), kSectionAlign);
+    h.centroid_scale_offset = align_up(h.centroid_offset + centroids.size(), kSectionAlign);
+    h.list_offset = align_up(h.centroid_scale_offset + size_t(nlist) * sizeof(float), kSectionAlign);
+    h.id_offset = align_up(h.list_offset + lists.size() * sizeof(uint64_t), kSectionAlign);
+    h.scale_offset = align_up(h.id_offset + size_t(count) * sizeof(uint64_t), kSectionAlign);
+    h.vector_offset = align_up(h.scale_offset + size_t(count) * sizeof(float), kSectionAlign);
+    h.file_size = h.vector_offset + uint64_t(count) * uint64_t(stride);
+
+    const std::string path = dir + "/" + segment_name(last_seq, "ivf");
+    const std::string tmp = path + ".tmp";
+    FdGuard fd(::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+    if (fd.get() < 0) {
+        throw_errno("create " + tmp);
+    }
+    if (ftruncate(fd.get(), static_cast<off_t>(h.file_size)) != 0) {
+        const int saved = errno;
+        ::unlink(tmp.c_str());
+        errno = saved;
+        throw_errno("ftruncate " + tmp);
+    }
+    void* addr = mmap(nullptr, h.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (addr == MAP_FAILED) {
+        const int saved = errno;
+        ::unlink(tmp.c_str());
+        errno = saved;
+        throw_errno("mmap " + tmp);
+    }
+    auto* out = static_cast<uint8_t*>(addr);
+    std::memcpy(out, &h, sizeof(h));
+    std::memcpy(out + h.centroid_offset, centroids.data(), centroids.size());
+    std::memcpy(out + h.centroid_scale_offset, centroid_scales.data(), centroid_scales.size() * sizeof(float));
+    std::memcpy(out + h.list_offset, lists.data(), lists.size() * sizeof(uint64_t));
+    auto* ids = reinterpret_cast<uint64_t*>(out + h.id_offset);
+    auto* scales = reinterpret_cast<float*>(out + h.scale_offset);
+    auto* vectors = reinterpret_cast<int8_t*>(out + h.vector_offset);
+    std::vector<uint64_t> cursor(lists.begin(), lists.end() - 1);
+    for (int64_t i = 0; i < count; ++i) {
+        const Row& r = rows[size_t(i)];
+        const uint64_t slot = cursor[size_t(assign[size_t(i)])]++;
+        ids[slot] = r.id;
+        scales[slot] = r.scale;
+        std::memcpy(vectors + slot * uint64_t(stride), r.v, size_t(stride));
+    }
+    const bool synced = msync(addr, h.file_size, MS_SYNC) == 0;
+    munmap(addr, h.file_size);
+    if (!synced || fsync(fd.get()) != 0 || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        const int saved = errno;
+        ::unlink(tmp.c_str());
+        errno = saved;
+        throw_errno("write " + path);
+    }
+    sync_directory(dir);
+    return path;
+}
+
+} // namespace
+
+struct ContextStore::Segment {
+    MappedFile file;
+    uint32_t first_seq = 0;
+    uint32_t last_seq = 0;
+    int32_t nlist = 0;
+    int64_t count = 0;
+    const int8_t* centroids = nullptr;
+    const float* centroid_scales = nullptr;
+    const uint64_t* lists = nullptr;
+    const uint64_t* ids = nullptr;
+    const float* scales = nullptr;
+    const int8_t* vectors = nullptr;
+    uint64_t vector_offset = 0;
+};
+
+ContextStore::ContextStore() = default;
+
+ContextStore::~ContextStore() { close_log(); }
+
+ContextStore::ContextStore(ContextStore&& other) noexcept
+    : dir_(std::move(other.dir_)),
+      options_(other.options_),
+      kernels_(other.kernels_),
+      stride_(other.stride_),
+      segments_(std::move(other.segments_)),
+      log_fd_(std::exchange(other.log_fd_, -1)),
+      log_seq_(other.log_seq_),
+      ids_(std::move(other.ids_)),
+      scales_(std::move(other.scales_)),
+      vectors_(std::move(other.vectors_)) {}
+
+ContextStore& ContextStore::operator=(ContextStore&& other) noexcept {
+    if (this != &other) {
+        close_log();
+        dir_ = std::move(other.dir_);
+        options_ = other.options_;
+        kernels_ = other.kernels_;
+        stride_ = other.stride_;
+        segments_ = std::move(other.segments_);
+        log_fd_ = std::exchange(other.log_fd_, -1);
+        log_seq_ = other.log_seq_;
+        ids_ = std::move(other.ids_);
+        scales_ = std::move(other.scales_);
+        vectors_ = std::move(other.vectors_);
+    }
+    return *this;
+}
+
+ContextStore ContextStore::open(const std::string& dir, const ContextStoreOptions& options,
+                                const kernels::KernelSet& kernels) {
+    if (options.dim <= 0 || options.seal_records <= 0 || options.max_segment_records <= 0) {
+        throw_error("context store: dim, seal_records and max_segment_records must be positive");
+    }
+    if (kernels.dot_i8 == nullptr) {
+        throw_error(std::string("context store: kernel set '") + kernels.name + "' has no int8 dot");
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        throw_error("create " + dir + ": " + ec.message());
+    }
+
+    ContextStore store;
+    store.dir_ = dir;
+    store.options_ = options;
+    store.kernels_ = &kernels;
+    store.stride_ = int64_t(align_up(size_t(options.dim), size_t(kernels::kDotAlign)));
+
+    std::vector<uint32_t> logs;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        const std::string name = entry.path().filename().string();
+        const std::string path = entry.path().string();
+        uint32_t seq = 0;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+            ::unlink(path.c_str()); // an interrupted seal or compaction
+        } else if (parse_segment_name(name, "ivf", &seq)) {
+            store.segments_.push_back(load_segment(path, options.dim, store.stride_));
+        } else if (parse_segment_name(name, "log", &seq)) {
+            logs.push_back(seq);
+        }
+    }
+    if (ec) {
+        throw_error("list " + dir + ": " + ec.message());
+    }
+
+    // A compaction interrupted after its rename leaves the segments it
+    // merged behind; the merged one covers their sequence range.
+    auto& segments = store.segments_;
+    std::sort(segments.begin(), segments.end(), [](const auto& a, const auto& b) { return a->last_seq < b->last_seq; });
+    auto covered = [&](uint32_t first, uint32_t last, const Segment* self) {
+        return std::any_of(segments.begin(), segments.end(), [&](const auto& s) {
+            return s.get() != self && s->first_seq <= first && last <= s->last_seq;
+        });
+    };
+    for (size_t i = 0; i < segments.size();) {
+        if (covered(segments[i]->first_seq, segments[i]->last_seq, segments[i].get())) {
+            ::unlink(segments[i]->file.path().c_str());
+            segments.erase(segments.begin() + std::ptrdiff_t(i));
+        } else {
+            ++i;
+        }
+    }
+    for (size_t i = 1; i < segments.size(); ++i) {
+        if (segments[i]->first_seq <= segments[i - 1]->last_seq) {
+            throw_error(dir + ": overlapping segments " + segments[i - 1]->file.path() + " and " +
+                        segments[i]->file.path());
+        }
+    }
+
+    // Likewise a seal interrupted before it removed its log.
+    const uint32_t sealed = segments.empty() ? 0 : segments.back()->last_seq;
+    uint32_t open_seq = 0;
+    std::sort(logs.begin(), logs.end());
+    for (uint32_t seq : logs) {
+        if (seq <= sealed) {
+            ::unlink((dir + "/" + segment_name(seq, "log")).c_str());
+        } else if (open_seq != 0) {
+            throw_error(dir + ": more than one open log");
+        } else {
+            open_seq = seq;
+        }
+    }
+    store.open_log(open_seq != 0 ? open_seq : sealed + 1);
+    return store;
+}
+
+void ContextStore::open_log(uint32_t seq) {
+    const std::string path = dir_ + "/" + segment_name(seq, "log");
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw_errno("open " + path);
+    }
+    log_fd_ = fd;
+    log_seq_ = seq;
+    ids_.clear();
+    scales_.clear();
+    vectors_.clear();
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        throw_errno("stat " + path);
+    }
+    const auto size = static_cast<size_t>(st.st_size);
+    if (size < sizeof(LogHeader)) {
+        // New, or torn while writing the header: start it over.
+        LogHeader h{};
+        std::memcpy(h.magic, kLogMagic, sizeof(kLogMagic));
+        h.version = kFormatVersion;
+        h.dim = static_cast<uint32_t>(options_.dim);
+        h.stride = static_cast<uint32_t>(stride_);
+        if (ftruncate(fd, 0) != 0) {
+            throw_errno("ftruncate " + path);
+        }
+        if (!write_all(fd, &h, sizeof(h))) {
+            throw_errno("write " + path);
+        }
+        if (fsync(fd) != 0) {
+            throw_errno("fsync " + path);
+        }
+        sync_directory(dir_);
+        return;
+    }
+
+    MappedFile log = MappedFile::open(path, Advice::kSequential);
+    LogHeader h;
+    std::memcpy(&h, log.data(), sizeof(h));
+    if (std::memcmp(h.magic, kLogMagic, sizeof(kLogMagic)) != 0 || h.version != kFormatVersion) {
+        throw_error(path + ": not a context store log");
+    }
+    if (h.dim != uint32_t(options_.dim) || h.stride != uint32_t(stride_)) {
+        throw_error(path + ": dimension " + std::to_string(h.dim) + ", store opened with " +
+                    std::to_string(options_.dim));
+    }
+    const size_t record = sizeof(RecordHeader) + size_t(stride_);
+    const size_t count = (size - sizeof(LogHeader)) / record;
+    ids_.resize(count);
+    scales_.resize(count);
+    vectors_.resize(count * size_t(stride_));
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* p = log.data() + sizeof(LogHeader) + i * record;
+        RecordHeader r;
+        std::memcpy(&r, p, sizeof(r));
+        ids_[i] = r.id;
+        scales_[i] = r.scale;
+        std::memcpy(&vectors_[i * size_t(stride_)], p + sizeof(r), size_t(stride_));
+    }
+    const size_t valid = sizeof(LogHeader) + count * record;
+    if (valid != size && ftruncate(fd, static_cast<off_t>(valid)) != 0) {
+        throw_errno("ftruncate " + path);
+    }
+}
+
+void ContextStore::close_log() {
+    if (log_fd_ >= 0) {
+        ::close(log_fd_);
+        log_fd_ = -1;
+    }
+}
+
+void ContextStore::add(uint64_t id, std::span<const float> embedding) {
+    add(std::span<const uint64_t>(&id, 1), embedding);
+}
+
+void ContextStore::add(std::span<const uint64_t> ids, std::span<const float> embeddings) {
+    if (embeddings.size() != ids.size() * size_t(options_.dim)) {
+        throw_error("context store: " + std::to_string(ids.size()) + " ids with " +
+                    std::to_string(embeddings.size()) + " embedding values, expected " +
+                    std::to_string(options_.dim) + " each");
+    }
+    if (ids.empty()) {
+        return;
+    }
+    const size_t record = sizeof(RecordHeader) + size_t(stride_);
+    std::vector<uint8_t> buf(record * ids.size());
+    for (size_t i = 0; i < ids.size(); ++i) {
+        uint8_t* rec = buf.data() + i * record;
+        RecordHeader r{};
+        r.id = ids[i];
+        r.scale = quantize(embeddings.data() + i * size_t(options_.dim), options_.dim, stride_,
+                           reinterpret_cast<int8_t*>(rec + sizeof(RecordHeader)));
+        std::memcpy(rec, &r, sizeof(r));
+    }
+
+    const std::string path = dir_ + "/" + segment_name(log_seq_, "log");
+    try {
+        if (!write_all(log_fd_, buf.data(), buf.size())) {
+            throw_errno("write " + path);
+        }
+    } catch (...) {
+        // Do not leave a torn record for the next append to land behind;
+        // should that fail as well, open() drops it.
+        const off_t valid = static_cast<off_t>(sizeof(LogHeader) + ids_.size() * record);
+        const bool trimmed = ftruncate(log_fd_, valid) == 0;
+        static_cast<void>(trimmed);
+        throw;
+    }
+    if (options_.sync && fdatasync(log_fd_) != 0) {
+        throw_errno("fdatasync " + path);
+    }
+    for (size_t i = 0; i < ids.size(); ++i) {
+        const uint8_t* rec = buf.data() + i * record;
+        RecordHeader r;
+        std::memcpy(&r, rec, sizeof(r));
+        ids_.push_back(r.id);
+        scales_.push_back(r.scale);
+        const auto* v = reinterpret_cast<const int8_t*>(rec + sizeof(RecordHeader));
+        vectors_.insert(vectors_.end(), v, v + stride_);
+    }
+    if (static_cast<int64_t>(ids_.size()) >= options_.seal_records) {
+        seal();
+    }
+}
+
+void ContextStore::flush() {
+    if (log_fd_ >= 0 && fdatasync(log_fd_) != 0) {
+        throw_errno("fdatasync " + dir_ + "/" + segment_name(log_seq_, "log"));
+    }
+}
+
+void ContextStore::seal() {
+    if (ids_.empty()) {
+        return;
+    }
+    std::vector<Row> rows(ids_.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        rows[i] = {ids_[i], scales_[i], &vectors_[i * size_t(stride_)]};
+    }
+    const std::string path = write_segment(*kernels_, dir_, rows, options_.dim, stride_, log_seq_, log_seq_);
+    segments_.push_back(load_segment(path, options_.dim, stride_));
+    close_log();
+    const std::string log = dir_ + "/" + segment_name(log_seq_, "log");
+    if (::unlink(log.c_str()) != 0) {
+        throw_errno("unlink " + log);
+    }
+    open_log(log_seq_ + 1);
+}
+
+void ContextStore::compact() {
+    size_t begin = 0;
+    while (begin < segments_.size()) {
+        size_t end = begin + 1;
+        int64_t records = segments_[begin]->count;
+        while (end < segments_.size() && records + segments_[end]->count <= options_.max_segment_records) {
+            records += segments_[end++]->count;
+        }
+        if (end - begin < 2) {
+            begin = end;
+            continue;
+        }
+        std::vector<Row> rows;
+        rows.reserve(size_t(records));
+        for (size_t s = begin; s < end; ++s) {
+            const Segment& seg = *segments_[s];
+            seg.file.advise(seg.vector_offset, size_t(seg.count * stride_), Advice::kSequential);
+            for (int64_t i = 0; i < seg.count; ++i) {
+                rows.push_back({seg.ids[i], seg.scales[i], seg.vectors + i * stride_});
+            }
+        }
+        // Named after the last segment it replaces, which the rename does
+        // atomically; the others are removed once it is in place.
+        const std::string path = write_segment(*kernels_, dir_, rows, options_.dim, stride_,
+                                               segments_[begin]->first_seq, segments_[end - 1]->last_seq);
+        rows.clear();
+        auto merged = load_segment(path, options_.dim, stride_);
+        for (size_t s = begin; s + 1 < end; ++s) {
+            ::unlink(segments_[s]->file.path().c_str());
+        }
+        segments_.erase(segments_.begin() + std::ptrdiff_t(begin) + 1, segments_.begin() + std::ptrdiff_t(end));
+        segments_[begin] = std::move(merged);
+        ++begin;
+    }
+}
+
+int64_t ContextStore::size() const {
+    auto n = static_cast<int64_t>(ids_.size());
+    for (const auto& s : segments_) {
+        n += s->count;
+    }
+    return n;
+}
+
+namespace {
+
+// Keeps the k best hits as a min-heap on score.
+void offer(std::vector<ContextHit>& heap, size_t k, uint64_t id, float score) {
+    constexpr auto worse = [](const ContextHit& a, const ContextHit& b) { return a.score > b.score; };
+    if (heap.size() < k) {
+        heap.push_back({id, score});
+        std::push_heap(heap.begin(), heap.end(), worse);
+    } else if (score > heap.front().score) {
+        std::pop_heap(heap.begin(), heap.end(), worse);
+        heap.back() = {id, score};
+        std::push_heap(heap.begin(), heap.end(), worse);
+    }
+}
+
+void scan(const kernels::KernelSet& ks, const int8_t* query, float query_scale, const uint64_t* ids,
+          const float* scales, const int8_t* vectors, int64_t count, int64_t stride, std::vector<ContextHit>& heap,
+          size_t k) {
+    int32_t dots[kScanChunk];
+    for (int64_t i = 0; i < count; i += kScanChunk) {
+        const int64_t n = std::min(kScanChunk, count - i);
+        ks.dot_i8(query, vectors + i * stride, n, stride, dots);
+        for (int64_t j = 0; j < n; ++j) {
+            // Scale 0 marks a zero vector, which has no direction to match.
+            if (scales[i + j] != 0.0f) {
+                offer(heap, k, ids[i + j], float(dots[j]) * query_scale * scales[i + j]);
+            }
+        }
+    }
+}
+
+} // namespace
+
+std::unique_ptr<ContextStore::Segment> ContextStore::load_segment(const std::string& path, int64_t dim,
+                                                                  int64_t stride) {
+    MappedFile file = MappedFile::open(path, Advice::kRandom);
+    IvfHeader h;
+    if (file.size() < sizeof(h)) {
+        throw_error(path + ": truncated segment");
+    }
+    std::memcpy(&h, file.data(), sizeof(h));
+    if (std::memcmp(h.magic, kIvfMagic, sizeof(kIvfMagic)) != 0 || h.version != kFormatVersion) {
+        throw_error(path + ": not a context store segment");
+    }
+    if (h.dim != uint32_t(dim) || h.stride != uint32_t(stride)) {
+        throw_error(path + ": dimension " + std::to_string(h.dim) + ", store opened with " + std::to_string(dim));
+    }
+    const uint64_t n = h.count;
+    if (h.file_size != file.size() || h.nlist == 0 || h.nlist > n || h.first_seq > h.last_seq ||
+        h.centroid_offset + uint64_t(h.nlist) * h.stride > h.centroid_scale_offset ||
+        h.centroid_scale_offset + uint64_t(h.nlist) * sizeof(float) > h.list_offset ||
+        h.list_offset + (uint64_t(h.nlist) + 1) * sizeof(uint64_t) > h.id_offset ||
+        h.id_offset + n * sizeof(uint64_t) > h.scale_offset || h.scale_offset + n * sizeof(float) > h.vector_offset ||
+        h.vector_offset + n * h.stride != h.file_size || h.centroid_offset % kSectionAlign != 0 ||
+        h.list_offset % kSectionAlign != 0 || h.id_offset % kSectionAlign != 0 ||
+        h.scale_offset % kSectionAlign != 0 || h.centroid_scale_offset % kSectionAlign != 0) {
+        throw_error(path + ": corrupt segment header");
+    }
+    auto s = std::make_unique<Segment>();
+    const uint8_t* base = file.data();
+    s->first_seq = h.first_seq;
+    s->last_seq = h.last_seq;
+    s->nlist = static_cast<int32_t>(h.nlist);
+    s->count = static_cast<int64_t>(n);
+    s->centroids = reinterpret_cast<const int8_t*>(base + h.centroid_offset);
+    s->centroid_scales = reinterpret_cast<const float*>(base + h.centroid_scale_offset);
+    s->lists = reinterpret_cast<const uint64_t*>(base + h.list_offset);
+    s->ids = reinterpret_cast<const uint64_t*>(base + h.id_offset);
+    s->scales = reinterpret_cast<const float*>(base + h.scale_offset);
+    s->vectors = reinterpret_cast<const int8_t*>(base + h.vector_offset);
+    s->vector_offset = h.vector_offset;
+    if (s->lists[0] != 0 || s->lists[h.nlist] != n ||
+        !std::is_sorted(s->lists, s->lists + h.nlist + 1)) {
+        throw_error(path + ": corrupt list table");
+    }
+    s->file = std::move(file);
+    return s;
+}
+
+void ContextStore::search_segment(const Segment& segment, const int8_t* query, float query_scale, int32_t nprobe,
+                                  std::vector<ContextHit>& heap, size_t k) const {
+    const int32_t nlist = segment.nlist;
+    std::vector<int32_t> dots(static_cast<size_t>(nlist));
+    kernels_->dot_i8(query, segment.centroids, nlist, stride_, dots.data());
+    std::vector<int32_t> order(static_cast<size_t>(nlist));
+    for (int32_t c = 0; c < nlist; ++c) {
+        order[size_t(c)] = c;
+    }
+    const auto probe = static_cast<size_t>(std::min(nprobe, nlist));
+    auto score = [&](int32_t c) { return float(dots[size_t(c)]) * segment.centroid_scales[c]; };
+    auto closer = [&](int32_t a, int32_t b) { return score(a) > score(b); };
+    std::partial_sort(order.begin(), order.begin() + std::ptrdiff_t(probe), order.end(), closer);
+
+    // Start reading every probed list before scanning the first one.
+    for (size_t p = 0; p < probe; ++p) {
+        const int32_t c = order[p];
+        const uint64_t begin = segment.lists[c];
+        const uint64_t count = segment.lists[c + 1] - begin;
+        if (count > 0) {
+            segment.file.advise(segment.vector_offset + begin * uint64_t(stride_), count * uint64_t(stride_),
+                                Advice::kWillNeed);
+        }
+    }
+    for (size_t p = 0; p < probe; ++p) {
+        const int32_t c = order[p];
+        const uint64_t begin = segment.lists[c];
+        scan(*kernels_, query, query_scale, segment.ids + begin, segment.scales + begin,
+             segment.vectors + begin * uint64_t(stride_), int64_t(segment.lists[c + 1] - begin), stride_, heap, k);
+    }
+}
+
+std::vector<ContextHit> ContextStore::search(std::span<const float> query, int32_t k, int32_t nprobe) const {
+    if (static_cast<int64_t>(query.size()) != options_.dim) {
+        throw_error("context store: query has " + std::to_string(query.size()) + " values, expected " +
+                    std::to_string(options_.dim));
+    }
+    std::vector<ContextHit> heap;
+    if (k <= 0 || kernels_ == nullptr) {
+        return heap;
+    }
+    std::vector<int8_t> q(static_cast<size_t>(stride_));
+    const float query_scale = quantize(query.data(), options_.dim, stride_, q.data());
+    if (query_scale == 0.0f) {
+        return heap;
+    }
+    if (nprobe <= 0) {
+        nprobe = options_.nprobe;
+    }
+    heap.reserve(size_t(k) + 1);
+    for (const auto& segment : segments_) {
+        search_segment(*segment, q.data(), query_scale, nprobe, heap, size_t(k));
+    }
+    scan(*kernels_, q.data(), query_scale, ids_.data(), scales_.data(), vectors_.data(),
+         static_cast<int64_t>(ids_.size()), stride_, heap, size_t(k));
+    std::sort_heap(heap.begin(), heap.end(),
+                   [](const ContextHit& a, const ContextHit& b) { return a.score > b.score; });
+    return heap;
+}
+
+} // namespace neuroctx
@@ -0,0 +1,100 @@
+#include "neuroctx/cpu_features.h"
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <sys/prctl.h>
+#endif
+
+namespace neuroctx {
+
+namespace {
+
+#if defined(__aarch64__) && defined(__linux__)
+// Bit positions from the kernel's uapi <asm/hwcap.h>; older libc headers
+// do not define all of them.
+constexpr unsigned long kHwcapAsimd = 1ul << 1;
+constexpr unsigned long kHwcapAsimdHp = 1ul << 10;
+constexpr unsigned long kHwcapAsimdDp = 1ul << 20;
+constexpr unsigned long kHwcapSve = 1ul << 22;
+constexpr unsigned long kHwcap2Sve2 = 1ul << 1;
+constexpr unsigned long kHwcap2SveI8mm = 1ul << 9;
+constexpr unsigned long kHwcap2I8mm = 1ul << 13;
+constexpr unsigned long kHwcap2Bf16 = 1ul << 14;
+constexpr int kPrSveGetVl = 51;
+constexpr int kPrSveVlLenMask = 0xffff;
+#endif
+
+} // namespace
+
+CpuFeatures detect_cpu_features() {
+    CpuFeatures f;
+#if defined(__aarch64__) && defined(__linux__)
+    const unsigned long hwcap = getauxval(AT_HWCAP);
+    const unsigned long hwcap2 = getauxval(AT_HWCAP2);
+    f.neon = (hwcap & kHwcapAsimd) != 0;
+    f.fp16 = (hwcap & kHwcapAsimdHp) != 0;
+    f.dotprod = (hwcap & kHwcapAsimdDp) != 0;
+    f.sve = (hwcap & kHwcapSve) != 0;
+    f.sve2 = (hwcap2 & kHwcap2Sve2) != 0;
+    f.sve_i8mm = (hwcap2 & kHwcap2SveI8mm) != 0;
+    f.i8mm = (hwcap2 & kHwcap2I8mm) != 0;
+    f.bf16 = (hwcap2 & kHwcap2Bf16) != 0;
+    if (f.sve) {
+        const int vl = prctl(kPrSveGetVl);
+        f.sve_vector_bytes = vl > 0 ? static_cast<uint32_t>(vl & kPrSveVlLenMask) : 0;
+        if (f.sve_vector_bytes == 0) {
+            f.sve = f.sve2 = f.sve_i8mm = false;
+        }
+    }
+#elif defined(__aarch64__)
+    // Non-Linux AArch64 (e.g. macOS): ASIMD is architectural, the rest is
+    // left to explicit overrides.
+    f.neon = true;
+#endif
+    return f;
+}
+
+const CpuFeatures& cpu_features() {
+    static const CpuFeatures features = detect_cpu_features();
+    return features;
+}
+
+uint64_t CpuFeatures::bits() const {
+    uint64_t b = 0;
+    b |= uint64_t{neon} << 0;
+    b |= uint64_t{fp16} << 1;
+    b |= uint64_t{dotprod} << 2;
+    b |= uint64_t{i8mm} << 3;
+    b |= uint64_t{bf16} << 4;
+    b |= uint64_t{sve} << 5;
+    b |= uint64_t{sve2} << 6;
+    b |= uint64_t{sve_i8mm} << 7;
+    b |= uint64_t{sve_vector_bytes} << 32;
+    return b;
+}
+
+std::string CpuFeatures::describe() const {
+    std::string s;
+    auto add = [&s](bool on, const char* name) {
+        if (on) {
+            if (!s.empty()) {
+                s += ' ';
+            }
+            s += name;
+        }
+    };
+    add(neon, "neon");
+    add(fp16, "fp16");
+    add(dotprod, "dotprod");
+    add(i8mm, "i8mm");
+    add(bf16, "bf16");
+    add(sve, "sve");
+    add(sve2, "sve2");
+    add(sve_i8mm, "sve-i8mm");
+    if (sve) {
+        s += " vl=" + std::to_string(sve_vector_bytes * 8);
+    }
+    return s.empty() ? "generic" : s;
+}
+
+} // namespace neuroctx
@@ -0,0 +1,206 @@
+#include "neuroctx/embedding.h"
+
+#include "neuroctx/common.h"
+#include "neuroctx/context_store.h"
+#include "neuroctx/model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace neuroctx {
+
+namespace {
+
+constexpr int32_t kPageTokens = 16;
+
+// Bytes for `pages` KV pages of `model`, an upper bound for every KvDType.
+size_t kv_budget(const Model& model, int64_t pages) {
+    const ModelConfig& c = model.config();
+    const size_t head_block = size_t(kPageTokens) * c.head_dim * 2 + kPageTokens * sizeof(float) + kCacheLine;
+    return size_t(pages) * size_t(c.n_layer) * 2 * size_t(c.n_head_kv) * head_block;
+}
+
+} // namespace
+
+Embedder::Embedder(Model& model, ThreadPool* pool, const EmbedderOptions& options)
+    : model_(model), pool_(pool), options_(options),
+      kv_([&] {
+          options_.max_tokens = std::max<int64_t>(options_.max_tokens, 1);
+          // One full step, or the longest item, with as much again left to
+          // keep shared prefixes cached.
+          const int64_t step = model.options().max_batch_tokens / kPageTokens + model.options().max_outputs;
+          const int64_t item = (options_.max_tokens + kPageTokens - 1) / kPageTokens + 1;
+          return model.kv_config(kv_budget(model, 2 * std::max(step, item)), options_.kv_dtype, kPageTokens);
+      }()) {
+    if (model.options().max_outputs <= 0) {
+        throw_error("embedder: the model was planned without output rows");
+    }
+    const TensorView& norm = model.file().require("output_norm.weight");
+    if (norm.elements() != model.config().n_embd || !can_dequantize(norm.dtype)) {
+        throw_error("embedder: cannot read output_norm.weight");
+    }
+    norm_.resize(static_cast<size_t>(model.config().n_embd));
+    dequantize_row(norm, 0, norm_.data());
+    const auto rows = static_cast<size_t>(model.options().max_batch_tokens);
+    const auto outputs = static_cast<size_t>(model.options().max_outputs);
+    tokens_.reserve(rows);
+    seqs_.reserve(outputs);
+    outputs_.reserve(outputs);
+    owners_.reserve(outputs);
+}
+
+int64_t Embedder::dim() const { return model_.config().n_embd; }
+
+// output_norm's RMS factor cancels in the L2 normalization; only its
+// weights are left.
+void Embedder::pool_rows(const float* hidden, float* out) const {
+    const int64_t n = dim();
+    double norm2 = 0.0;
+    for (int64_t i = 0; i < n; ++i) {
+        out[i] = hidden[i] * norm_[static_cast<size_t>(i)];
+        norm2 += double(out[i]) * double(out[i]);
+    }
+    const float inv = norm2 > 0.0 ? float(1.0 / std::sqrt(norm2)) : 0.0f;
+    for (int64_t i = 0; i < n; ++i) {
+        out[i] *= inv;
+    }
+}
+
+void Embedder::embed_long(std::span<const std::span<const int32_t>> items, int32_t item, float* out) {
+    const std::span<const int32_t> all = items[static_cast<size_t>(item)];
+    const std::span<const int32_t> tokens = all.first(std::min(all.size(), static_cast<size_t>(options_.max_tokens)));
+    const int64_t chunk = model_.options().max_batch_tokens;
+    const SeqId seq = kv_.create();
+    const int64_t matched = kv_.match_prefix(seq, tokens);
+    stats_.prefix_tokens_reused += matched;
+    const auto end = static_cast<int64_t>(tokens.size());
+    const int32_t zero = 0;
+    try {
+        for (int64_t pos = matched; pos < end;) {
+            const int64_t n = std::min(chunk, end - pos);
+            if (!kv_.reserve(seq, n)) {
+                throw_error("embedder: KV budget cannot hold an item");
+            }
+            const int32_t last = static_cast<int32_t>(n - 1);
+            const StepSequence s{seq, pos, 0, n};
+            const StepBatch batch{tokens.subspan(static_cast<size_t>(pos), static_cast<size_t>(n)),
+                                  std::span<const StepSequence>(&s, 1),
+                                  pos + n == end ? std::span<const int32_t>(&last, 1)
+                                                 : std::span<const int32_t>(&zero, 0)};
+            model_.forward(batch, kv_, pool_);
+            stats_.tokens += n;
+            ++stats_.steps;
+            pos += n;
+        }
+    } catch (...) {
+        kv_.release(seq);
+        throw;
+    }
+    kv_.release(seq);
+    pool_rows(model_.hidden(), out + item * dim());
+}
+
+void Embedder::embed(std::span<const std::span<const int32_t>> items, std::span<float> out) {
+    const int64_t d = dim();
+    if (out.size() != items.size() * static_cast<size_t>(d)) {
+        throw_error("embedder: output holds " + std::to_string(out.size()) + " values, expected " +
+                    std::to_string(items.size() * static_cast<size_t>(d)));
+    }
+    const auto length = [&](int32_t i) {
+        return std::min(static_cast<int64_t>(items[static_cast<size_t>(i)].size()), options_.max_tokens);
+    };
+    std::vector<int32_t> order(items.size());
+    std::iota(order.begin(), order.end(), 0);
+    for (const int32_t i : order) {
+        if (items[static_cast<size_t>(i)].empty()) {
+            throw_error("embedder: item " + std::to_string(i) + " is empty");
+        }
+        stats_.truncated += static_cast<int64_t>(items[static_cast<size_t>(i)].size()) > options_.max_tokens;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](int32_t a, int32_t b) { return length(a) > length(b); });
+    stats_.items += static_cast<int64_t>(items.size());
+
+    const int64_t max_rows = model_.options().max_batch_tokens;
+    const auto max_outputs = static_cast<size_t>(model_.options().max_outputs);
+    size_t lo = 0;
+    size_t hi = order.size();
+    while (lo < hi && length(order[lo]) > max_rows) {
+        embed_long(items, order[lo++], out.data());
+    }
+
+    int64_t rows = 0;
+    // Adds an item's uncached tokens to the step when they fit.
+    const auto try_add = [&](int32_t item) {
+        if (outputs_.size() >= max_outputs) {
+            return false;
+        }
+        const std::span<const int32_t> tokens = items[static_cast<size_t>(item)].first(static_cast<size_t>(length(item)));
+        const SeqId seq = kv_.create();
+        const int64_t matched = kv_.match_prefix(seq, tokens);
+        const int64_t n = static_cast<int64_t>(tokens.size()) - matched;
+        if (rows + n > max_rows || !kv_.reserve(seq, n)) {
+            kv_.release(seq);
+            return false;
+        }
+        seqs_.push_back({seq, matched, rows, n});
+        tokens_.insert(tokens_.end(), tokens.begin() + matched, tokens.end());
+        outputs_.push_back(static_cast<int32_t>(rows + n - 1));
+        owners_.push_back(item);
+        rows += n;
+        stats_.prefix_tokens_reused += matched;
+        return true;
+    };
+    const auto release = [&] {
+        for (const StepSequence& s : seqs_) {
+            kv_.release(s.seq);
+        }
+    };
+    while (lo < hi) {
+        tokens_.clear();
+        seqs_.clear();
+        outputs_.clear();
+        owners_.clear();
+        rows = 0;
+        // The longest items left, then the shortest into what remains.
+        while (lo < hi && try_add(order[lo])) {
+            ++lo;
+        }
+        while (lo < hi && try_add(order[hi - 1])) {
+            --hi;
+        }
+        if (seqs_.empty()) {
+            throw_error("embedder: KV budget cannot hold an item");
+        }
+        try {
+            model_.forward(StepBatch{tokens_, seqs_, outputs_}, kv_, pool_);
+        } catch (...) {
+            release();
+            throw;
+        }
+        release();
+        const float* hidden = model_.hidden();
+        for (size_t o = 0; o < owners_.size(); ++o) {
+            pool_rows(hidden + static_cast<int64_t>(o) * d, out.data() + owners_[o] * d);
+        }
+        stats_.tokens += rows;
+        ++stats_.steps;
+    }
+}
+
+void Embedder::embed_into(ContextStore& store, std::span<const uint64_t> ids,
+                          std::span<const std::span<const int32_t>> items) {
+    if (ids.size() != items.size()) {
+        throw_error("embedder: " + std::to_string(ids.size()) + " ids for " + std::to_string(items.size()) +
+                    " items");
+    }
+    if (store.dim() != dim()) {
+        throw_error("embedder: store has dimension " + std::to_string(store.dim()) + ", model " +
+                    std::to_string(dim()));
+    }
+    scratch_.resize(items.size() * static_cast<size_t>(dim()));
+    embed(items, scratch_);
+    store.add(ids, scratch_);
+}
+
+} // namespace neuroctx
@@ -0,0 +1,161 @@
+#include "neuroctx/event_loop.h"
+
+#include "neuroctx/common.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace neuroctx {
+
+// Owner of a spawned task: started eagerly, frees itself at the end.
+struct SpawnedTask {
+    struct promise_type {
+        SpawnedTask get_return_object() const noexcept { return {}; }
+        std::suspend_never initial_suspend() const noexcept { return {}; }
+        std::suspend_never final_suspend() const noexcept { return {}; }
+        void return_void() const noexcept {}
+        void unhandled_exception() const noexcept { std::terminate(); }
+    };
+
+    static SpawnedTask drive(EventLoop* loop, Task<void> task) {
+        co_await task;
+        loop->task_done();
+    }
+};
+
+EventLoop::EventLoop() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        throw_errno("epoll_create1");
+    }
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd_ < 0) {
+        const int saved = errno;
+        ::close(epoll_fd_);
+        errno = saved;
+        throw_errno("eventfd");
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = wake_fd_;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev) != 0) {
+        const int saved = errno;
+        ::close(wake_fd_);
+        ::close(epoll_fd_);
+        errno = saved;
+        throw_errno("epoll_ctl eventfd");
+    }
+}
+
+EventLoop::~EventLoop() {
+    ::close(wake_fd_);
+    ::close(epoll_fd_);
+}
+
+void EventLoop::spawn(Task<void> task) {
+    ++spawned_;
+    SpawnedTask::drive(this, std::move(task));
+}
+
+void EventLoop::post(std::function<void()> fn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        posted_.push_back(std::move(fn));
+    }
+    wake();
+}
+
+void EventLoop::stop() {
+    stop_.store(true, std::memory_order_relaxed);
+    wake();
+}
+
+void EventLoop::wake() {
+    const uint64_t one = 1;
+    // A full counter (EAGAIN) means a wakeup is already pending.
+    const ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+    static_cast<void>(n);
+}
+
+void EventLoop::watch(int fd, bool write, std::coroutine_handle<> h) {
+    epoll_event ev{};
+    ev.events = (write ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        throw_errno("epoll_ctl fd " + std::to_string(fd));
+    }
+    watchers_[fd] = h;
+}
+
+void EventLoop::add_timer(Clock::time_point when, std::coroutine_handle<> h) {
+    timers_.push({when, timer_order_++, h});
+}
+
+void EventLoop::run_posted() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_.swap(posted_);
+    }
+    for (auto& fn : running_) {
+        fn();
+    }
+    running_.clear();
+}
+
+void EventLoop::run_timers() {
+    const Clock::time_point now = Clock::now();
+    while (!timers_.empty() && timers_.top().when <= now) {
+        const std::coroutine_handle<> h = timers_.top().h;
+        timers_.pop();
+        h.resume();
+    }
+}
+
+void EventLoop::run() {
+    constexpr int kMaxEvents = 64;
+    epoll_event events[kMaxEvents];
+    stop_.store(false, std::memory_order_relaxed);
+    for (;;) {
+        run_posted();
+        run_timers();
+        if (stop_.load(std::memory_order_relaxed) || spawned_ == 0) {
+            return;
+        }
+        int timeout_ms = -1;
+        if (!timers_.empty()) {
+            const auto wait = timers_.top().when - Clock::now();
+            // Round up so a timer is never polled for just before it is due.
+            const auto ms = std::chrono::ceil<std::chrono::milliseconds>(wait).count();
+            timeout_ms = static_cast<int>(std::clamp<int64_t>(ms, 0, INT32_MAX));
+        }
+        const int n = epoll_wait(epoll_fd_, events, kMaxEvents, timeout_ms);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw_errno("epoll_wait");
+        }
+        for (int i = 0; i < n; ++i) {
+            const int fd = events[i].data.fd;
+            if (fd == wake_fd_) {
+                uint64_t count = 0;
+                const ssize_t r = ::read(wake_fd_, &count, sizeof(count));
+                static_cast<void>(r);
+                continue;
+            }
+            auto it = watchers_.find(fd);
+            if (it == watchers_.end()) {
+                continue;
+            }
+            const std::coroutine_handle<> h = it->second;
+            watchers_.erase(it);
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+            h.resume();
+        }
+    }
+}
+
+} // namespace neuroctx
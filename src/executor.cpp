@@ -0,0 +1,678 @@
+#include "neuroctx/executor.h"
+
+#include "neuroctx/attention.h"
+#include "neuroctx/backend.h"
+#include "neuroctx/common.h"
+#include "neuroctx/layer_stream.h"
+#include "neuroctx/lora.h"
+#include "neuroctx/partition.h"
+#include "neuroctx/tensor.h"
+#include "neuroctx/thread_pool.h"
+#include "neuroctx/trace.h"
+#include "neuroctx/tuning.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace neuroctx {
+
+namespace {
+
+void check(bool ok, const Node& node, const char* what) {
+    if (!ok) {
+        throw_error("executor: node '" + node.label + "': " + what);
+    }
+}
+
+void binary(OpType op, const float* a, const float* b, float* out, int64_t rows, int64_t cols, bool broadcast) {
+    for (int64_t r = 0; r < rows; ++r) {
+        const float* x = a + r * cols;
+        const float* y = broadcast ? b : b + r * cols;
+        float* o = out + r * cols;
+        if (op == OpType::kAdd) {
+            for (int64_t c = 0; c < cols; ++c) {
+                o[c] = x[c] + y[c];
+            }
+        } else {
+            for (int64_t c = 0; c < cols; ++c) {
+                o[c] = x[c] * y[c];
+            }
+        }
+    }
+}
+
+void silu(const float* x, float* out, int64_t n) {
+    for (int64_t i = 0; i < n; ++i) {
+        out[i] = x[i] / (1.0f + std::exp(-x[i]));
+    }
+}
+
+float rms_scale(const float* x, int64_t cols, float eps) {
+    double sum = 0.0;
+    for (int64_t c = 0; c < cols; ++c) {
+        sum += static_cast<double>(x[c]) * x[c];
+    }
+    return 1.0f / std::sqrt(static_cast<float>(sum / static_cast<double>(cols)) + eps);
+}
+
+void rms_norm(const float* x, const float* weight, float eps, float* out, int64_t rows, int64_t cols) {
+    for (int64_t r = 0; r < rows; ++r) {
+        const float* xr = x + r * cols;
+        float* o = out + r * cols;
+        const float scale = rms_scale(xr, cols, eps);
+        for (int64_t c = 0; c < cols; ++c) {
+            o[c] = xr[c] * scale * (weight != nullptr ? weight[c] : 1.0f);
+        }
+    }
+}
+
+// rms_norm straight into Q8 rows, one 32-element block at a time, so the
+// normalized floats only ever exist in registers and a stack block.
+void rms_norm_q8(const float* x, const float* weight, float eps, const kernels::QuantizedRows& out) {
+    const int64_t cols = out.k;
+    const int64_t blocks = cols / kernels::kBlock;
+    float block[kernels::kBlock];
+    for (int64_t r = 0; r < out.rows; ++r) {
+        const float* xr = x + r * cols;
+        const float scale = rms_scale(xr, cols, eps);
+        for (int64_t b = 0; b < blocks; ++b) {
+            for (int64_t i = 0; i < kernels::kBlock; ++i) {
+                const int64_t c = b * kernels::kBlock + i;
+                block[i] = xr[c] * scale * (weight != nullptr ? weight[c] : 1.0f);
+            }
+            int8_t* q = const_cast<int8_t*>(out.q) + r * cols + b * kernels::kBlock;
+            kernels::quantize_rows(block, 1, kernels::kBlock, q, const_cast<float*>(out.scales) + r * blocks + b);
+        }
+    }
+}
+
+// Inverse frequencies of the head_dim/2 rotation pairs, computed once per
+// op so the row loops only pay for cos/sin.
+void rope_freqs(int64_t head_dim, float base, float* inv_freq) {
+    for (int64_t i = 0; i < head_dim / 2; ++i) {
+        inv_freq[i] = std::pow(base, -2.0f * static_cast<float>(i) / static_cast<float>(head_dim));
+    }
+}
+
+// Rotates heads [head_begin, head_end) of one row at `pos`.
+void rope_row(const float* x, int32_t pos, float* out, int64_t head_begin, int64_t head_end, int64_t head_dim,
+              RopeMode mode, const float* inv_freq) {
+    const int64_t half = head_dim / 2;
+    float cos_t[kMaxHeadDim / 2];
+    float sin_t[kMaxHeadDim / 2];
+    for (int64_t i = 0; i < half; ++i) {
+        const float theta = static_cast<float>(pos) * inv_freq[i];
+        cos_t[i] = std::cos(theta);
+        sin_t[i] = std::sin(theta);
+    }
+    for (int64_t h = head_begin; h < head_end; ++h) {
+        const float* xh = x + h * head_dim;
+        float* oh = out + h * head_dim;
+        for (int64_t i = 0; i < half; ++i) {
+            const int64_t a = mode == RopeMode::kNorm ? 2 * i : i;
+            const int64_t b = mode == RopeMode::kNorm ? 2 * i + 1 : i + half;
+            const float x0 = xh[a];
+            const float x1 = xh[b];
+            oh[a] = x0 * cos_t[i] - x1 * sin_t[i];
+            oh[b] = x0 * sin_t[i] + x1 * cos_t[i];
+        }
+    }
+}
+
+void rope(const float* x, const int32_t* positions, float* out, int64_t rows, int64_t cols, int64_t head_dim,
+          RopeMode mode, const float* inv_freq) {
+    for (int64_t r = 0; r < rows; ++r) {
+        rope_row(x + r * cols, positions[r], out + r * cols, 0, cols / head_dim, head_dim, mode, inv_freq);
+    }
+}
+
+// Element-wise tail of a fused matmul, applied per task to the columns it
+// has just written.
+struct Epilogue {
+    const float* bias = nullptr;
+    const float* gate = nullptr;         // Activation::kSiluGate, [rows, ldc]
+    const int32_t* positions = nullptr;  // kMatMulRope
+    int64_t head_dim = 0;
+    RopeMode mode = RopeMode::kNorm;
+    const float* inv_freq = nullptr;  // rope_freqs() of head_dim
+};
+
+void apply_epilogue(const Epilogue& e, float* c, int64_t ldc, int64_t rows, int64_t col_begin, int64_t col_end,
+                    bool with_rope) {
+    for (int64_t r = 0; r < rows; ++r) {
+        float* row = c + r * ldc;
+        if (e.bias != nullptr) {
+            for (int64_t i = col_begin; i < col_end; ++i) {
+                row[i] += e.bias[i];
+            }
+        }
+        if (e.gate != nullptr) {
+            const float* g = e.gate + r * ldc;
+            for (int64_t i = col_begin; i < col_end; ++i) {
+                row[i] *= g[i] / (1.0f + std::exp(-g[i]));
+            }
+        }
+        if (e.positions != nullptr && with_rope) {
+            rope_row(row, e.positions[r], row, col_begin / e.head_dim, col_end / e.head_dim, e.head_dim, e.mode,
+                     e.inv_freq);
+        }
+    }
+}
+
+// Splits the weight panels into a few tasks per worker (tuning()
+// .tasks_per_worker) so stealing can even out big and little cores. Each
+// task runs the epilogue on its own columns right after computing them.
+void parallel_matmul(ThreadPool* pool, const kernels::KernelSet& ks, const kernels::PackedWeights& w,
+                     const kernels::QuantizedRows& a, float* c, int64_t ldc, const Epilogue& e = {}) {
+    const int64_t panels = w.panels();
+    const int64_t panel_rows = w.layout.panel_rows;
+    // Rope pairs columns within a head, so its tasks must cover whole heads;
+    // when heads and panels do not line up it runs after the last task.
+    int64_t align = 1;
+    const bool rope_after = e.positions != nullptr && e.head_dim % panel_rows != 0;
+    if (e.positions != nullptr && !rope_after) {
+        align = e.head_dim / panel_rows;
+    }
+    const auto run = [&](int64_t begin, int64_t end) {
+        kernels::matmul_panels(ks, w, a, c, ldc, begin, end);
+        if (e.bias != nullptr || e.gate != nullptr || e.positions != nullptr) {
+            apply_epilogue(e, c, ldc, a.rows, begin * panel_rows, std::min(w.n, end * panel_rows), !rope_after);
+        }
+    };
+    if (pool == nullptr || pool->size() == 1 || panels < 2) {
+        run(0, panels);
+    } else {
+        const int64_t per_task = panels_per_task(panels, pool->size(), align);
+        pool->parallel_for((panels + per_task - 1) / per_task, [&](int64_t task, int) {
+            const int64_t begin = task * per_task;
+            run(begin, std::min(panels, begin + per_task));
+        });
+    }
+    if (rope_after) {
+        rope(c, e.positions, c, a.rows, w.n, e.head_dim, e.mode, e.inv_freq);
+    }
+}
+
+void bias(const float* x, const float* b, float* out, int64_t rows, int64_t cols) {
+    for (int64_t r = 0; r < rows; ++r) {
+        for (int64_t c = 0; c < cols; ++c) {
+            out[r * cols + c] = x[r * cols + c] + b[c];
+        }
+    }
+}
+
+} // namespace
+
+Executor::Executor(const Graph& graph, const MemoryPlan& plan, Arena& arena)
+    : graph_(graph), plan_(plan), arena_(&arena) {
+    graph_.validate();
+    const auto& values = graph_.values();
+    if (plan_.offsets.size() != values.size()) {
+        throw_error("executor: memory plan does not match the graph");
+    }
+    arena.reserve(plan_.arena_bytes);
+    base_ = arena.data();
+
+    for (const Node& node : graph_.nodes()) {
+        check(node.inputs() >= 1 && node.outputs() == (node.op == OpType::kAddRmsNorm ? 2 : 1), node,
+              "wrong number of outputs or no input");
+        const Value& out = values[node.out[0]];
+        const Value& in = values[node.in[0]];
+        switch (node.op) {
+        case OpType::kAdd:
+        case OpType::kMul: {
+            check(node.inputs() == 2, node, "binary op needs two inputs");
+            const Value& rhs = values[node.in[1]];
+            check(in.type == ValueType::kF32 && rhs.type == ValueType::kF32 &&
+                      out.type == ValueType::kF32 && in.cols == out.cols && rhs.cols == out.cols &&
+                      (rhs.rows == in.rows || rhs.rows == RowDim::kOne) && in.rows == out.rows,
+                  node, "binary op operands do not match");
+            break;
+        }
+        case OpType::kSilu:
+        case OpType::kRmsNorm:
+            check(in.type == ValueType::kF32 &&
+                      (out.type == ValueType::kF32 || (node.op == OpType::kRmsNorm && out.type == ValueType::kQ8)) &&
+                      in.cols == out.cols && in.rows == out.rows,
+                  node, "unary op operands do not match");
+            break;
+        case OpType::kQuantize:
+            check(in.type == ValueType::kF32 && out.type == ValueType::kQ8 && in.cols == out.cols &&
+                      in.rows == out.rows,
+                  node, "quantize needs F32 -> Q8 of equal shape");
+            break;
+        case OpType::kMatMul:
+        case OpType::kMatMulRope: {
+            const auto* w = static_cast<const kernels::PackedWeights*>(node.weight);
+            check(w != nullptr, node, "matmul without weights");
+            check(in.type == ValueType::kQ8 && out.type == ValueType::kF32 && w->k == in.cols && w->n == out.cols &&
+                      in.rows == out.rows,
+                  node, "matmul shapes do not match the packed weights");
+            if (node.op == OpType::kMatMulRope) {
+                check(node.inputs() == 2, node, "rope needs positions");
+                const Value& pos = values[node.in[1]];
+                check(node.i0 > 0 && node.i0 % 2 == 0 && node.i0 <= kMaxHeadDim && out.cols % node.i0 == 0, node,
+                      "rope head size unsupported");
+                check(pos.type == ValueType::kI32 && pos.cols == 1 && pos.rows == in.rows, node,
+                      "rope positions do not match");
+            } else if (static_cast<Activation>(node.i0) == Activation::kSiluGate) {
+                check(node.inputs() == 2, node, "gated matmul needs a gate");
+                const Value& gate = values[node.in[1]];
+                check(gate.type == ValueType::kF32 && gate.cols == out.cols && gate.rows == out.rows, node,
+                      "gate does not match the matmul output");
+            } else {
+                check(node.i0 == 0 && node.inputs() == 1, node, "unknown matmul activation");
+            }
+            break;
+        }
+        case OpType::kCopy:
+            check(in.type == out.type && in.cols == out.cols && node.i0 >= 0, node, "copy operands do not match");
+            break;
+        case OpType::kBias:
+            check(node.weight != nullptr && in.type == ValueType::kF32 && out.type == ValueType::kF32 &&
+                      in.cols == out.cols && in.rows == out.rows,
+                  node, "bias operands do not match");
+            break;
+        case OpType::kEmbed: {
+            const auto* table = static_cast<const TensorView*>(node.weight);
+            check(table != nullptr && can_dequantize(table->dtype) && table->cols() == out.cols, node,
+                  "embedding table missing or of unsupported type");
+            check(in.type == ValueType::kI32 && in.cols == 1 && out.type == ValueType::kF32 && in.rows == out.rows,
+                  node, "embed needs I32 ids -> F32 rows");
+            break;
+        }
+        case OpType::kGather: {
+            check(node.inputs() == 2, node, "gather needs rows and indices");
+            const Value& index = values[node.in[1]];
+            check(in.type == out.type && in.cols == out.cols && index.type == ValueType::kI32 && index.cols == 1 &&
+                      index.rows == out.rows,
+                  node, "gather operands do not match");
+            break;
+        }
+        case OpType::kRope: {
+            check(node.inputs() == 2, node, "rope needs positions");
+            const Value& pos = values[node.in[1]];
+            check(node.i0 > 0 && node.i0 % 2 == 0 && node.i0 <= kMaxHeadDim && in.cols % node.i0 == 0, node,
+                  "rope head size unsupported");
+            check(in.type == ValueType::kF32 && out.type == ValueType::kF32 && in.cols == out.cols &&
+                      in.rows == out.rows && pos.type == ValueType::kI32 && pos.cols == 1 && pos.rows == in.rows,
+                  node, "rope operands do not match");
+            break;
+        }
+        case OpType::kAttention: {
+            check(node.inputs() == 3 && node.layer >= 0, node, "attention needs q, k, v and a layer");
+            const Value& k = values[node.in[1]];
+            const Value& v = values[node.in[2]];
+            const int64_t hd = node.i0;
+            check(hd > 0 && hd <= kMaxHeadDim && in.cols % hd == 0 && k.cols % hd == 0 && k.cols == v.cols &&
+                      (in.cols / hd) % (k.cols / hd) == 0,
+                  node, "attention head layout unsupported");
+            check(in.type == ValueType::kF32 && k.type == ValueType::kF32 && v.type == ValueType::kF32 &&
+                      out.type == ValueType::kF32 && out.cols == in.cols && out.rows == in.rows &&
+                      k.rows == in.rows && v.rows == in.rows,
+                  node, "attention operands do not match");
+            break;
+        }
+        case OpType::kAddRmsNorm: {
+            check(node.inputs() == 2, node, "add_rms_norm needs two inputs");
+            const Value& rhs = values[node.in[1]];
+            const Value& norm = values[node.out[1]];
+            check(in.type == ValueType::kF32 && rhs.type == ValueType::kF32 && out.type == ValueType::kF32 &&
+                      in.cols == out.cols && rhs.cols == out.cols && in.rows == out.rows && rhs.rows == out.rows,
+                  node, "add operands do not match");
+            check((norm.type == ValueType::kF32 || norm.type == ValueType::kQ8) && norm.cols == out.cols &&
+                      norm.rows == out.rows,
+                  node, "norm output does not match the sum");
+            break;
+        }
+        case OpType::kCount: check(false, node, "invalid op"); break;
+        }
+    }
+}
+
+kernels::QuantizedRows Executor::q8(int32_t value, int64_t rows) const {
+    const Value& v = graph_.values()[value];
+    const int64_t bound = plan_.bounds[v.rows];
+    kernels::QuantizedRows q;
+    q.q = reinterpret_cast<const int8_t*>(data(value));
+    q.scales = reinterpret_cast<const float*>(data(value) + bound * v.cols);
+    q.rows = rows;
+    q.k = v.cols;
+    return q;
+}
+
+int64_t Executor::rows_of(int32_t value, const ExecContext& ctx) const {
+    return ctx.rows[graph_.values()[value].rows];
+}
+
+void Executor::run(const ExecContext& ctx) {
+    for (size_t d = 0; d < ctx.rows.max.size(); ++d) {
+        if (ctx.rows.max[d] < 0 || ctx.rows.max[d] > plan_.bounds.max[d]) {
+            throw_error("executor: step rows exceed the planned bound");
+        }
+    }
+    if (!backends_.empty()) {
+        for (const StepSequence& s : ctx.sequences) {
+            if (s.adapter != nullptr) {
+                throw_error("executor: LoRA adapters are not supported with offload");
+            }
+        }
+    }
+    const kernels::KernelSet& ks = ctx.kernels != nullptr ? *ctx.kernels : kernels::active();
+    if (trace::enabled() || streamer_ != nullptr || observer_) {
+        run_layered(ctx, ks);
+        return;
+    }
+    const auto& nodes = graph_.nodes();
+    if (backends_.empty()) {
+        for (const Node& node : nodes) {
+            run_node(node, ctx, ks);
+        }
+        return;
+    }
+    for (const Segment& segment : segments(ctx.rows[RowDim::kTokens])) {
+        if (segment.device == 0) {
+            for (int32_t n = segment.begin; n < segment.end; ++n) {
+                run_node(nodes[static_cast<size_t>(n)], ctx, ks);
+            }
+            continue;
+        }
+        arena_->end_cpu_access();
+        backends_[static_cast<size_t>(segment.device) - 1]->run(graph_, segment, ctx);
+        arena_->begin_cpu_access();
+    }
+}
+
+// run() with layer boundaries observed: a trace span per node and per layer,
+// the streamer told which layer comes next and the observer called. Kept
+// apart so the plain loop carries no per-node checks.
+void Executor::run_layered(const ExecContext& ctx, const kernels::KernelSet& ks) {
+    const auto& nodes = graph_.nodes();
+    const bool traced = trace::enabled();
+    trace::LayerMeter meter;
+    int32_t layer = -1;
+    const auto node_range = [&](int32_t begin, int32_t end) {
+        for (int32_t n = begin; n < end; ++n) {
+            const Node& node = nodes[static_cast<size_t>(n)];
+            if (node.layer != layer) {
+                layer = node.layer;
+                if (streamer_ != nullptr) {
+                    streamer_->enter(layer);
+                }
+                if (traced) {
+                    meter.enter(layer);
+                }
+            }
+            const uint64_t t0 = traced ? trace::now() : 0;
+            run_node(node, ctx, ks);
+            if (traced) {
+                trace::record(trace::Kind::kOp, op_name(node.op), t0, trace::now(), node.layer);
+            }
+            if (observer_) {
+                observer_(node, *this, ctx);
+            }
+        }
+    };
+    if (backends_.empty()) {
+        node_range(0, static_cast<int32_t>(nodes.size()));
+    } else {
+        for (const Segment& segment : segments(ctx.rows[RowDim::kTokens])) {
+            if (segment.device == 0) {
+                node_range(segment.begin, segment.end);
+                continue;
+            }
+            if (traced) {
+                meter.finish();
+            }
+            layer = -2; // re-enter the layer if the CPU resumes it
+            const uint64_t t0 = traced ? trace::now() : 0;
+            arena_->end_cpu_access();
+            backends_[static_cast<size_t>(segment.device) - 1]->run(graph_, segment, ctx);
+            arena_->begin_cpu_access();
+            if (traced) {
+                trace::record(trace::Kind::kScope, "offload", t0, trace::now());
+            }
+        }
+    }
+    if (traced) {
+        meter.finish();
+    }
+}
+
+void Executor::set_offload(std::vector<Backend*> backends, const Placement& decode, const Placement& prefill) {
+    const auto nodes = static_cast<int32_t>(graph_.nodes().size());
+    for (const Placement* p : {&decode, &prefill}) {
+        int32_t next = 0;
+        for (const Segment& s : p->segments) {
+            if (s.begin != next || s.end <= s.begin || s.device < 0 ||
+                static_cast<size_t>(s.device) > backends.size()) {
+                throw_error("executor: placement does not match the graph and backends");
+            }
+            next = s.end;
+        }
+        if (next != nodes) {
+            throw_error("executor: placement does not cover the graph");
+        }
+    }
+    if (!backends.empty() && arena_->memory() != ArenaMemory::kShared) {
+        throw_error("executor: offload needs a shared arena");
+    }
+    backends_ = std::move(backends);
+    if (!backends_.empty()) {
+        arena_->begin_cpu_access(); // the CPU owns the arena between device segments
+    }
+    decode_segments_ = decode.segments;
+    prefill_segments_ = prefill.segments;
+}
+
+std::span<const Segment> Executor::segments(int64_t tokens) const {
+    return tokens == 1 ? decode_segments_ : prefill_segments_;
+}
+
+void Executor::run_node(const Node& node, const ExecContext& ctx, const kernels::KernelSet& ks) {
+    const Value& out = graph_.values()[node.out[0]];
+    const int64_t rows = rows_of(node.out[0], ctx);
+    const int64_t cols = out.cols;
+    switch (node.op) {
+    case OpType::kAdd:
+    case OpType::kMul:
+        binary(node.op, f32(node.in[0]), f32(node.in[1]), f32(node.out[0]), rows, cols,
+               graph_.values()[node.in[1]].rows != graph_.values()[node.in[0]].rows);
+        break;
+    case OpType::kSilu: silu(f32(node.in[0]), f32(node.out[0]), rows * cols); break;
+    case OpType::kRmsNorm:
+        if (out.type == ValueType::kQ8) {
+            rms_norm_q8(f32(node.in[0]), static_cast<const float*>(node.weight), node.f0, q8(node.out[0], rows));
+        } else {
+            rms_norm(f32(node.in[0]), static_cast<const float*>(node.weight), node.f0, f32(node.out[0]), rows,
+                     cols);
+        }
+        break;
+    case OpType::kQuantize: {
+        const kernels::QuantizedRows q = q8(node.out[0], rows);
+        kernels::quantize_rows(f32(node.in[0]), rows, cols, const_cast<int8_t*>(q.q), const_cast<float*>(q.scales));
+        break;
+    }
+    case OpType::kMatMul:
+    case OpType::kMatMulRope: run_matmul(node, ctx, ks, rows); break;
+    case OpType::kCopy:
+        if (node.i0 + rows > rows_of(node.in[0], ctx)) {
+            throw_error("executor: node '" + node.label + "' copies past the end of its input");
+        }
+        if (out.type == ValueType::kQ8) {
+            const kernels::QuantizedRows src = q8(node.in[0], node.i0 + rows);
+            const kernels::QuantizedRows dst = q8(node.out[0], rows);
+            std::memcpy(const_cast<int8_t*>(dst.q), src.q + node.i0 * cols, static_cast<size_t>(rows * cols));
+            std::memcpy(const_cast<float*>(dst.scales), src.scales + node.i0 * (cols / kernels::kBlock),
+                        static_cast<size_t>(rows * (cols / kernels::kBlock)) * sizeof(float));
+        } else {
+            const size_t row_bytes = value_row_bytes(out);
+            std::memcpy(data(node.out[0]), data(node.in[0]) + node.i0 * row_bytes, rows * row_bytes);
+        }
+        break;
+    case OpType::kBias:
+        bias(f32(node.in[0]), static_cast<const float*>(node.weight), f32(node.out[0]), rows, cols);
+        break;
+    case OpType::kEmbed: {
+        const auto& table = *static_cast<const TensorView*>(node.weight);
+        const int32_t* ids = i32(node.in[0]);
+        for (int64_t r = 0; r < rows; ++r) {
+            if (ids[r] < 0 || ids[r] >= table.rows()) {
+                throw_error("executor: token id " + std::to_string(ids[r]) + " out of range");
+            }
+            dequantize_row(table, ids[r], f32(node.out[0]) + r * cols);
+        }
+        break;
+    }
+    case OpType::kGather: {
+        const int32_t* index = i32(node.in[1]);
+        const int64_t limit = rows_of(node.in[0], ctx);
+        const size_t row_bytes = value_row_bytes(out);
+        for (int64_t r = 0; r < rows; ++r) {
+            if (index[r] < 0 || index[r] >= limit) {
+                throw_error("executor: node '" + node.label + "' gathers a row out of range");
+            }
+            std::memcpy(data(node.out[0]) + r * row_bytes, data(node.in[0]) + index[r] * row_bytes, row_bytes);
+        }
+        break;
+    }
+    case OpType::kRope: {
+        float inv_freq[kMaxHeadDim / 2];
+        rope_freqs(node.i0, node.f0, inv_freq);
+        rope(f32(node.in[0]), i32(node.in[1]), f32(node.out[0]), rows, cols, node.i0,
+             static_cast<RopeMode>(node.i1), inv_freq);
+        break;
+    }
+    case OpType::kAttention: run_attention(node, ctx); break;
+    case OpType::kAddRmsNorm: {
+        // The norm reads each sum row while it is still in L1.
+        const auto* weight = static_cast<const float*>(node.weight);
+        const bool quantized = graph_.values()[node.out[1]].type == ValueType::kQ8;
+        const kernels::QuantizedRows q = quantized ? q8(node.out[1], rows) : kernels::QuantizedRows{};
+        for (int64_t r = 0; r < rows; ++r) {
+            float* sum = f32(node.out[0]) + r * cols;
+            binary(OpType::kAdd, f32(node.in[0]) + r * cols, f32(node.in[1]) + r * cols, sum, 1, cols, false);
+            if (quantized) {
+                const int64_t blocks = cols / kernels::kBlock;
+                rms_norm_q8(sum, weight, node.f0, {q.q + r * cols, q.scales + r * blocks, 1, cols});
+            } else {
+                rms_norm(sum, weight, node.f0, f32(node.out[1]) + r * cols, 1, cols);
+            }
+        }
+        break;
+    }
+    case OpType::kCount: break;
+    }
+}
+
+void Executor::run_matmul(const Node& node, const ExecContext& ctx, const kernels::KernelSet& ks, int64_t rows) {
+    const auto& w = *static_cast<const kernels::PackedWeights*>(node.weight);
+    const kernels::QuantizedRows a = q8(node.in[0], rows);
+    float* c = f32(node.out[0]);
+    const int64_t cols = graph_.values()[node.out[0]].cols;
+    Epilogue e;
+    e.bias = static_cast<const float*>(node.aux);
+    float inv_freq[kMaxHeadDim / 2];
+    if (node.op == OpType::kMatMulRope) {
+        rope_freqs(node.i0, node.f0, inv_freq);
+        e.positions = i32(node.in[1]);
+        e.head_dim = node.i0;
+        e.mode = static_cast<RopeMode>(node.i1);
+        e.inv_freq = inv_freq;
+    } else if (static_cast<Activation>(node.i0) == Activation::kSiluGate) {
+        e.gate = f32(node.in[1]);
+    }
+    bool adapted = false;
+    if (graph_.values()[node.in[0]].rows == RowDim::kTokens) {
+        for (const StepSequence& s : ctx.sequences) {
+            adapted |= s.adapter != nullptr && s.adapter->find(&w) != nullptr;
+        }
+    }
+    if (!adapted) {
+        parallel_matmul(ctx.pool, ks, w, a, c, cols, e);
+        return;
+    }
+    // The low-rank deltas go in before the epilogue, which then runs over
+    // the whole output.
+    parallel_matmul(ctx.pool, ks, w, a, c, cols);
+    for (const StepSequence& s : ctx.sequences) {
+        const LoraDelta* d = s.adapter != nullptr ? s.adapter->find(&w) : nullptr;
+        if (d == nullptr) {
+            continue;
+        }
+        if (lora_scratch_.size() < static_cast<size_t>(s.rows * d->rank)) {
+            throw_error("executor: node '" + node.label + "': LoRA rank exceeds the reserved scratch");
+        }
+        lora_apply(*d, a, s.first_row, s.first_row + s.rows, c, cols, lora_scratch_.data(), ctx.pool);
+    }
+    if (e.bias != nullptr || e.gate != nullptr || e.positions != nullptr) {
+        apply_epilogue(e, c, cols, rows, 0, w.n, true);
+    }
+}
+
+void Executor::reserve_lora(int64_t rows, int64_t rank) {
+    lora_scratch_.resize(static_cast<size_t>(std::max<int64_t>(rows * rank, 0)));
+}
+
+void Executor::run_attention(const Node& node, const ExecContext& ctx) {
+    if (ctx.kv == nullptr) {
+        throw_error("executor: attention without a KV cache");
+    }
+    const auto& values = graph_.values();
+    const int64_t hd = node.i0;
+    const int64_t ldq = values[node.in[0]].cols;
+    const int64_t ldk = values[node.in[1]].cols;
+    AttentionShape shape;
+    shape.head_dim = static_cast<int32_t>(hd);
+    shape.n_head = static_cast<int32_t>(ldq / hd);
+    shape.n_kv_head = static_cast<int32_t>(ldk / hd);
+    shape.scale = node.f0;
+    const float* q = f32(node.in[0]);
+    const float* k = f32(node.in[1]);
+    const float* v = f32(node.in[2]);
+    float* out = f32(node.out[0]);
+
+    int64_t total = 0;
+    for (const StepSequence& s : ctx.sequences) {
+        if (s.first_row != total) {
+            throw_error("executor: step sequences must cover the token rows in order");
+        }
+        ctx.kv->store(s.seq, node.layer, s.pos, s.rows, k + s.first_row * ldk, v + s.first_row * ldk);
+        total += s.rows;
+    }
+    if (total != rows_of(node.in[0], ctx)) {
+        throw_error("executor: step sequences do not cover the token rows");
+    }
+    // One task per (row tile, KV head) of every sequence, so each K/V tile
+    // read from the cache serves a whole query tile. Tasks are located by a
+    // scan over the few sequences of the step.
+    const kernels::KernelSet& ks = ctx.kernels != nullptr ? *ctx.kernels : kernels::active();
+    const int64_t row_tile = attention_row_tile(shape);
+    const auto tasks_of = [&](const StepSequence& s) { return (s.rows + row_tile - 1) / row_tile * shape.n_kv_head; };
+    int64_t tasks = 0;
+    for (const StepSequence& s : ctx.sequences) {
+        tasks += tasks_of(s);
+    }
+    const auto run_task = [&](int64_t task, int) {
+        size_t i = 0;
+        while (task >= tasks_of(ctx.sequences[i])) {
+            task -= tasks_of(ctx.sequences[i]);
+            ++i;
+        }
+        const StepSequence& s = ctx.sequences[i];
+        const int64_t r = task / shape.n_kv_head * row_tile;
+        paged_attention(ks, *ctx.kv, s.seq, node.layer, shape, s.pos, r, std::min(s.rows, r + row_tile),
+                        static_cast<int32_t>(task % shape.n_kv_head), q + s.first_row * ldq, ldq,
+                        out + s.first_row * ldq, ldq);
+    };
+    if (ctx.pool != nullptr) {
+        ctx.pool->parallel_for(tasks, run_task);
+    } else {
+        for (int64_t t = 0; t < tasks; ++t) {
+            run_task(t, 0);
+        }
+    }
+}
+
+} // namespace neuroctx
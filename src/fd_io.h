@@ -0,0 +1,68 @@
+#pragma once
+
+// File-descriptor helpers shared by the modules that write their own cache
+// files (packed weights, context store, KV pages, quantized models,
+// snapshots). Internal; not part of the installed headers.
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace neuroctx {
+
+// Closes the descriptor, if valid, on scope exit.
+class FdGuard {
+public:
+    explicit FdGuard(int fd) : fd_(fd) {}
+    ~FdGuard() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+        }
+    }
+    FdGuard(const FdGuard&) = delete;
+    FdGuard& operator=(const FdGuard&) = delete;
+    int get() const { return fd_; }
+
+private:
+    int fd_;
+};
+
+// Writes all `len` bytes, retrying short writes and EINTR. False on any
+// other failure, with errno set.
+inline bool write_all(int fd, const void* data, size_t len) {
+    const auto* p = static_cast<const uint8_t*>(data);
+    while (len > 0) {
+        const ssize_t n = ::write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= size_t(n);
+    }
+    return true;
+}
+
+// Reads exactly `len` bytes at `offset`; false on error or end of file.
+inline bool read_all(int fd, void* data, size_t len, off_t offset) {
+    auto* p = static_cast<uint8_t*>(data);
+    while (len > 0) {
+        const ssize_t n = ::pread(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        len -= size_t(n);
+        offset += n;
+    }
+    return true;
+}
+
+} // namespace neuroctx
@@ -0,0 +1,200 @@
+#include "neuroctx/fusion.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace neuroctx {
+
+namespace {
+
+// Producer and consumer counts of every value, rebuilt between rules.
+struct Uses {
+    std::vector<int32_t> producer;
+    std::vector<int32_t> consumers;
+    std::vector<int32_t> consumer; // the last consumer seen
+
+    explicit Uses(const Graph& graph)
+        : producer(graph.values().size(), -1), consumers(graph.values().size(), 0),
+          consumer(graph.values().size(), -1) {
+        const auto& nodes = graph.nodes();
+        for (size_t n = 0; n < nodes.size(); ++n) {
+            for (int i = 0; i < nodes[n].outputs(); ++i) {
+                producer[nodes[n].out[i]] = static_cast<int32_t>(n);
+            }
+            for (int i = 0; i < nodes[n].inputs(); ++i) {
+                ++consumers[nodes[n].in[i]];
+                consumer[nodes[n].in[i]] = static_cast<int32_t>(n);
+            }
+        }
+    }
+};
+
+// The single node reading `value`, or -1 when it has other readers or must
+// stay visible to the caller.
+int32_t sole_consumer(const Graph& graph, const Uses& uses, int32_t value) {
+    if (uses.consumers[value] != 1 || graph.values()[value].role != ValueRole::kIntermediate) {
+        return -1;
+    }
+    return uses.consumer[value];
+}
+
+bool plain_matmul(const Node& node) {
+    return node.op == OpType::kMatMul && static_cast<Activation>(node.i0) == Activation::kNone;
+}
+
+void append_label(Node& node, const Node& fused) {
+    node.label += "+";
+    node.label += op_name(fused.op);
+}
+
+// Applies `rule(n, uses, dead)` to every live node, then drops the nodes it
+// marked dead. Returns the number of fusions.
+template <typename Rule>
+int32_t apply(Graph& graph, Rule&& rule) {
+    auto& nodes = graph.nodes();
+    const Uses uses(graph);
+    std::vector<bool> dead(nodes.size(), false);
+    int32_t fused = 0;
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        if (!dead[n] && rule(static_cast<int32_t>(n), uses, dead)) {
+            ++fused;
+        }
+    }
+    size_t kept = 0;
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        if (dead[n]) {
+            continue;
+        }
+        if (kept != n) {
+            nodes[kept] = std::move(nodes[n]);
+        }
+        ++kept;
+    }
+    nodes.resize(kept);
+    return fused;
+}
+
+} // namespace
+
+FusionStats fuse_graph(Graph& graph) {
+    auto& nodes = graph.nodes();
+    const auto& values = graph.values();
+    FusionStats stats;
+
+    stats.bias = apply(graph, [&](int32_t n, const Uses& uses, std::vector<bool>& dead) {
+        Node& m = nodes[n];
+        if (!plain_matmul(m) || m.aux != nullptr) {
+            return false;
+        }
+        const int32_t b = sole_consumer(graph, uses, m.out[0]);
+        if (b < 0 || nodes[b].op != OpType::kBias) {
+            return false;
+        }
+        m.aux = nodes[b].weight;
+        m.out[0] = nodes[b].out[0];
+        append_label(m, nodes[b]);
+        dead[b] = true;
+        return true;
+    });
+
+    stats.rope = apply(graph, [&](int32_t n, const Uses& uses, std::vector<bool>& dead) {
+        Node& m = nodes[n];
+        if (!plain_matmul(m)) {
+            return false;
+        }
+        const int32_t r = sole_consumer(graph, uses, m.out[0]);
+        if (r < 0 || nodes[r].op != OpType::kRope || nodes[r].in[0] != m.out[0]) {
+            return false;
+        }
+        const Node& rope = nodes[r];
+        m.op = OpType::kMatMulRope;
+        m.in[1] = rope.in[1];
+        m.i0 = rope.i0;
+        m.i1 = rope.i1;
+        m.f0 = rope.f0;
+        m.out[0] = rope.out[0];
+        append_label(m, rope);
+        dead[r] = true;
+        return true;
+    });
+
+    // silu(gate) * up, where the gate projection runs first: the up
+    // projection multiplies its own tile by silu(gate) as it is written.
+    stats.swiglu = apply(graph, [&](int32_t n, const Uses& uses, std::vector<bool>& dead) {
+        const Node& mul = nodes[n];
+        if (mul.op != OpType::kMul || values[mul.in[0]].rows != values[mul.in[1]].rows) {
+            return false;
+        }
+        for (int side = 0; side < 2; ++side) {
+            const int32_t s = uses.producer[mul.in[side]];
+            const int32_t u = uses.producer[mul.in[1 - side]];
+            if (s < 0 || u < 0 || dead[s] || dead[u] || nodes[s].op != OpType::kSilu || !plain_matmul(nodes[u]) ||
+                sole_consumer(graph, uses, nodes[s].out[0]) != n || sole_consumer(graph, uses, nodes[u].out[0]) != n) {
+                continue;
+            }
+            const int32_t gate = nodes[s].in[0];
+            const int32_t gate_producer = uses.producer[gate];
+            // The gate must exist before the up projection runs.
+            if (values[gate].cols != values[nodes[u].out[0]].cols || values[gate].rows != values[mul.out[0]].rows ||
+                (gate_producer >= u && values[gate].role != ValueRole::kInput)) {
+                continue;
+            }
+            Node& up = nodes[u];
+            up.i0 = static_cast<int64_t>(Activation::kSiluGate);
+            up.in[1] = gate;
+            up.out[0] = mul.out[0];
+            append_label(up, nodes[s]);
+            append_label(up, mul);
+            dead[s] = true;
+            dead[n] = true;
+            return true;
+        }
+        return false;
+    });
+
+    stats.norm_quantize = apply(graph, [&](int32_t n, const Uses& uses, std::vector<bool>& dead) {
+        Node& norm = nodes[n];
+        if (norm.op != OpType::kRmsNorm || values[norm.out[0]].type != ValueType::kF32) {
+            return false;
+        }
+        const int32_t q = sole_consumer(graph, uses, norm.out[0]);
+        if (q < 0 || nodes[q].op != OpType::kQuantize) {
+            return false;
+        }
+        norm.out[0] = nodes[q].out[0];
+        append_label(norm, nodes[q]);
+        dead[q] = true;
+        return true;
+    });
+
+    // The sum stays a value (it is the residual stream); only the norm moves
+    // into the add, which still has the sum row in cache.
+    stats.add_norm = apply(graph, [&](int32_t n, const Uses&, std::vector<bool>& dead) {
+        Node& add = nodes[n];
+        if (add.op != OpType::kAdd || values[add.in[0]].rows != values[add.in[1]].rows) {
+            return false;
+        }
+        int32_t norm = -1;
+        for (size_t c = static_cast<size_t>(n) + 1; c < nodes.size() && norm < 0; ++c) {
+            if (!dead[c] && nodes[c].op == OpType::kRmsNorm && nodes[c].in[0] == add.out[0]) {
+                norm = static_cast<int32_t>(c);
+            }
+        }
+        if (norm < 0) {
+            return false;
+        }
+        add.op = OpType::kAddRmsNorm;
+        add.out[1] = nodes[norm].out[0];
+        add.weight = nodes[norm].weight;
+        add.f0 = nodes[norm].f0;
+        append_label(add, nodes[norm]);
+        dead[norm] = true;
+        return true;
+    });
+
+    graph.compact();
+    graph.validate();
+    return stats;
+}
+
+} // namespace neuroctx
@@ -0,0 +1,238 @@
+#include "neuroctx/governor.h"
+
+#include "neuroctx/common.h"
+#include "neuroctx/scheduler.h"
+#include "neuroctx/thread_pool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+
+namespace neuroctx {
+
+namespace {
+
+std::optional<std::string> read_line(const std::filesystem::path& path) {
+    std::ifstream f(path);
+    std::string line;
+    if (!std::getline(f, line)) {
+        return std::nullopt;
+    }
+    return line;
+}
+
+std::optional<double> read_number(const std::filesystem::path& path) {
+    std::ifstream f(path);
+    double v = 0;
+    if (!(f >> v)) {
+        return std::nullopt;
+    }
+    return v;
+}
+
+std::string lower(std::string s) {
+    for (char& c : s) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return s;
+}
+
+bool is_soc_zone(const std::string& type) {
+    for (const char* key : {"cpu", "gpu", "soc", "tsens", "x86_pkg"}) {
+        if (type.find(key) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+ThermalSensors::ThermalSensors(const std::string& sysfs_class) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    std::vector<std::string> matched;
+    std::vector<std::string> others;
+    for (const auto& entry : fs::directory_iterator(fs::path(sysfs_class) / "thermal", ec)) {
+        if (entry.path().filename().string().rfind("thermal_zone", 0) != 0 || !fs::exists(entry.path() / "temp")) {
+            continue;
+        }
+        const std::string type = lower(read_line(entry.path() / "type").value_or(""));
+        if (type.find("batt") != std::string::npos) {
+            continue; // read from the gauge instead
+        }
+        (is_soc_zone(type) ? matched : others).push_back((entry.path() / "temp").string());
+    }
+    zones_ = matched.empty() ? std::move(others) : std::move(matched);
+    std::sort(zones_.begin(), zones_.end());
+    for (const auto& entry : fs::directory_iterator(fs::path(sysfs_class) / "power_supply", ec)) {
+        if (lower(read_line(entry.path() / "type").value_or("")) == "battery") {
+            battery_ = entry.path().string();
+            break;
+        }
+    }
+}
+
+ThermalReading ThermalSensors::read() const {
+    namespace fs = std::filesystem;
+    ThermalReading r;
+    for (const std::string& zone : zones_) {
+        // Disabled or unsupported sensors read as errors or absurd values.
+        if (const auto v = read_number(zone); v && *v > -40000 && *v < 200000) {
+            r.soc_celsius = std::max(r.soc_celsius.value_or(-1e9), *v / 1000.0);
+        }
+    }
+    if (!battery_.empty()) {
+        if (const auto t = read_number(fs::path(battery_) / "temp")) {
+            r.battery_celsius = *t / 10.0;
+        }
+        if (const auto c = read_number(fs::path(battery_) / "capacity")) {
+            r.battery_percent = static_cast<int>(*c);
+        }
+        const std::string status = lower(read_line(fs::path(battery_) / "status").value_or(""));
+        r.charging = status == "charging" || status == "full";
+    }
+    return r;
+}
+
+std::string ThermalSensors::describe() const {
+    std::string s = std::to_string(zones_.size()) + " zones";
+    if (!battery_.empty()) {
+        s += ", battery:" + std::filesystem::path(battery_).filename().string();
+    }
+    return s;
+}
+
+std::vector<OperatingPoint> default_operating_points(const ThreadPool& pool, int64_t batch_tokens, int variants) {
+    const int n = pool.size();
+    const int64_t b = std::max<int64_t>(batch_tokens, 1);
+    const int last_variant = std::max(variants, 1) - 1;
+    int off_prime = 0; // workers outside the fastest cluster
+    for (int i = 1; i < n; ++i) {
+        off_prime += pool.cluster_of(i) > 0 ? 1 : 0;
+    }
+    std::vector<OperatingPoint> points;
+    const auto add = [&](int threads, int skip, int64_t batch, int variant) {
+        const OperatingPoint p{std::max(threads, 1), skip, std::max<int64_t>(batch, 1), variant};
+        if (points.empty() || !(points.back() == p)) {
+            points.push_back(p);
+        }
+    };
+    add(n, 0, b, 0);
+    add(n, 0, b / 2, 0);
+    add(n * 3 / 4, 0, b / 2, 0);
+    // Leave the prime cluster only when there are cores to move to.
+    const int threads = off_prime > 0 ? off_prime + 1 : n / 2;
+    const int skip = off_prime > 0 ? 1 : 0;
+    add(threads, skip, b / 4, 0);
+    if (last_variant > 0) {
+        add(threads, skip, b / 4, 1);
+        add(threads / 2, skip, b / 4, last_variant);
+    } else {
+        add(threads / 2, skip, b / 8, 0);
+    }
+    return points;
+}
+
+std::vector<std::string> list_model_variants(const std::string& dir) {
+    namespace fs = std::filesystem;
+    std::error_code ec;
+    std::vector<std::pair<uintmax_t, std::string>> found;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (entry.path().extension() == ".gguf") {
+            found.emplace_back(entry.file_size(ec), entry.path().string());
+        }
+    }
+    if (ec) {
+        throw_error("governor: cannot list " + dir + ": " + ec.message());
+    }
+    std::sort(found.begin(), found.end(), [](const auto& a, const auto& b) {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    });
+    std::vector<std::string> out;
+    for (auto& [size, path] : found) {
+        out.push_back(std::move(path));
+    }
+    return out;
+}
+
+Governor::Governor(std::vector<OperatingPoint> points, const GovernorOptions& options)
+    : points_(std::move(points)), options_(options), up_dwell_(options.up_dwell) {
+    if (points_.empty()) {
+        throw_error("governor: no operating points");
+    }
+}
+
+void Governor::step_to(size_t level, Clock::time_point now) {
+    if (level != level_) {
+        level_ = level;
+        last_change_ = now;
+    }
+}
+
+const OperatingPoint& Governor::update(const ThermalReading& reading, Clock::time_point now) {
+    using Seconds = std::chrono::duration<double>;
+    if (reading.soc_celsius) {
+        const double t = *reading.soc_celsius;
+        if (!started_) {
+            average_ = t;
+            started_ = true;
+        } else {
+            const double previous = average_;
+            average_ += options_.smoothing * (t - average_);
+            const double dt = Seconds(now - last_reading_).count();
+            if (dt > 0) {
+                trend_ += options_.smoothing * ((average_ - previous) / dt - trend_);
+            }
+        }
+        last_reading_ = now;
+    }
+
+    const size_t last = points_.size() - 1;
+    const bool saving = reading.battery_percent && !reading.charging &&
+                        *reading.battery_percent <= options_.low_battery_percent;
+    const size_t floor = saving ? std::min(points_.size() / 2, last) : 0;
+    bool hot = reading.battery_celsius && *reading.battery_celsius > options_.battery_max_celsius;
+    bool cool = !hot;
+    if (started_) {
+        if (average_ >= options_.critical_celsius) {
+            step_to(last, now);
+            return current();
+        }
+        const double ahead = Seconds(options_.lookahead).count();
+        const double low = options_.target_celsius - options_.hysteresis_celsius;
+        hot = hot || average_ + std::max(trend_, 0.0) * ahead > options_.target_celsius;
+        cool = cool && average_ < low && average_ + trend_ * ahead < low;
+    }
+
+    const auto since = now - last_change_;
+    if (since >= options_.max_up_dwell) {
+        up_dwell_ = options_.up_dwell; // held a point long enough to trust the ladder again
+    }
+    if (hot && level_ < last && since >= options_.down_dwell) {
+        if (now - last_up_ < up_dwell_) {
+            // The last step up did not hold: wait longer before the next.
+            up_dwell_ = std::min(up_dwell_ * 2, options_.max_up_dwell);
+        }
+        step_to(level_ + 1, now);
+    } else if (cool && level_ > floor && since >= up_dwell_) {
+        step_to(level_ - 1, now);
+        last_up_ = now;
+    }
+    if (level_ < floor) {
+        step_to(floor, now);
+    }
+    return current();
+}
+
+void Governor::apply(const OperatingPoint& point, ThreadPool* pool, Scheduler* scheduler) {
+    if (pool != nullptr) {
+        pool->set_active(point.threads, point.skip_clusters);
+    }
+    if (scheduler != nullptr) {
+        scheduler->set_max_batch_tokens(point.batch_tokens);
+    }
+}
+
+} // namespace neuroctx
@@ -0,0 +1,155 @@
+#include "neuroctx/graph.h"
+
+#include "neuroctx/common.h"
+
+namespace neuroctx {
+
+size_t value_row_bytes(const Value& value) {
+    const auto cols = static_cast<size_t>(value.cols);
+    switch (value.type) {
+    case ValueType::kF32:
+    case ValueType::kI32: return cols * 4;
+    case ValueType::kQ8: return cols + cols / 32 * sizeof(float);
+    }
+    return 0;
+}
+
+const char* op_name(OpType op) {
+    switch (op) {
+    case OpType::kAdd: return "add";
+    case OpType::kMul: return "mul";
+    case OpType::kSilu: return "silu";
+    case OpType::kRmsNorm: return "rms_norm";
+    case OpType::kQuantize: return "quantize";
+    case OpType::kMatMul: return "matmul";
+    case OpType::kCopy: return "copy";
+    case OpType::kBias: return "bias";
+    case OpType::kEmbed: return "embed";
+    case OpType::kGather: return "gather";
+    case OpType::kRope: return "rope";
+    case OpType::kAttention: return "attention";
+    case OpType::kMatMulRope: return "matmul_rope";
+    case OpType::kAddRmsNorm: return "add_rms_norm";
+    case OpType::kCount: break;
+    }
+    return "unknown";
+}
+
+int Node::inputs() const {
+    int n = 0;
+    while (n < kMaxNodeInputs && in[n] >= 0) {
+        ++n;
+    }
+    return n;
+}
+
+int Node::outputs() const {
+    int n = 0;
+    while (n < kMaxNodeOutputs && out[n] >= 0) {
+        ++n;
+    }
+    return n;
+}
+
+int32_t Graph::add_value(std::string name, ValueType type, int64_t cols, RowDim rows, ValueRole role) {
+    if (cols <= 0 || (type == ValueType::kQ8 && cols % 32 != 0)) {
+        throw_error("graph: value '" + name + "' has invalid width " + std::to_string(cols));
+    }
+    values_.push_back({std::move(name), type, rows, role, cols});
+    return static_cast<int32_t>(values_.size() - 1);
+}
+
+Node& Graph::add_node(OpType op, std::initializer_list<int32_t> in, std::initializer_list<int32_t> out,
+                      std::string label) {
+    if (in.size() > kMaxNodeInputs || out.size() > kMaxNodeOutputs) {
+        throw_error("graph: too many operands for " + std::string(op_name(op)));
+    }
+    Node node;
+    node.op = op;
+    int i = 0;
+    for (int32_t v : in) {
+        node.in[i++] = v;
+    }
+    i = 0;
+    for (int32_t v : out) {
+        node.out[i++] = v;
+    }
+    node.label = label.empty() ? op_name(op) : std::move(label);
+    nodes_.push_back(std::move(node));
+    return nodes_.back();
+}
+
+void Graph::validate() const {
+    std::vector<int32_t> producer(values_.size(), -1);
+    for (size_t v = 0; v < values_.size(); ++v) {
+        if (values_[v].role == ValueRole::kInput) {
+            producer[v] = -2; // defined before the first node
+        }
+    }
+    for (size_t n = 0; n < nodes_.size(); ++n) {
+        const Node& node = nodes_[n];
+        for (int i = 0; i < node.inputs(); ++i) {
+            const int32_t v = node.in[i];
+            if (v < 0 || static_cast<size_t>(v) >= values_.size() || producer[v] == -1) {
+                throw_error("graph: node " + std::to_string(n) + " (" + node.label + ") reads undefined value");
+            }
+        }
+        for (int i = 0; i < node.outputs(); ++i) {
+            const int32_t v = node.out[i];
+            if (v < 0 || static_cast<size_t>(v) >= values_.size() || producer[v] != -1) {
+                throw_error("graph: node " + std::to_string(n) + " (" + node.label +
+                            ") writes an input or an already defined value");
+            }
+            producer[v] = static_cast<int32_t>(n);
+        }
+    }
+    for (size_t v = 0; v < values_.size(); ++v) {
+        if (values_[v].role == ValueRole::kOutput && producer[v] < 0) {
+            throw_error("graph: output '" + values_[v].name + "' is never produced");
+        }
+    }
+}
+
+void Graph::compact() {
+    std::vector<bool> used(values_.size(), false);
+    for (size_t v = 0; v < values_.size(); ++v) {
+        used[v] = values_[v].role != ValueRole::kIntermediate;
+    }
+    for (const Node& node : nodes_) {
+        for (int i = 0; i < node.inputs(); ++i) {
+            used[node.in[i]] = true;
+        }
+        for (int i = 0; i < node.outputs(); ++i) {
+            used[node.out[i]] = true;
+        }
+    }
+    std::vector<int32_t> remap(values_.size(), -1);
+    std::vector<Value> kept;
+    kept.reserve(values_.size());
+    for (size_t v = 0; v < values_.size(); ++v) {
+        if (used[v]) {
+            remap[v] = static_cast<int32_t>(kept.size());
+            kept.push_back(std::move(values_[v]));
+        }
+    }
+    values_ = std::move(kept);
+    for (Node& node : nodes_) {
+        for (int i = 0; i < node.inputs(); ++i) {
+            node.in[i] = remap[node.in[i]];
+        }
+        for (int i = 0; i < node.outputs(); ++i) {
+            node.out[i] = remap[node.out[i]];
+        }
+    }
+}
+
+int32_t Graph::find_value(const std::string& name) const {
+    for (size_t v = 0; v < values_.size(); ++v) {
+        if (values_[v].name == name) {
+            return static_cast<int32_t>(v);
+        }
+    }
+    return -1;
+}
+
+} // namespace neuroctx
@@ -0,0 +1,498 @@
+#include "neuroctx/ipc.h"
+
+#include "neuroctx/common.h"
+#include "neuroctx/mapped_file.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+namespace neuroctx {
+
+namespace {
+
+constexpr char kMagic[8] = {'N', 'C', 'T', 'X', 'I', 'P', 'C', '\0'};
+constexpr uint32_t kVersion = 1;
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "shared-memory atomics must be address-free");
+
+struct ChannelHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t ring_slots;
+    uint32_t block_bytes;
+    uint32_t heap_blocks;
+    uint64_t size;
+    uint64_t ring_offset[2]; // request, response
+    uint64_t bitmap_offset;
+    uint64_t heap_offset;
+};
+
+// The shared part of one ring, followed by its slots. The consumer's index
+// and, for the runtime, the producer's never live here.
+struct SharedRing {
+    alignas(kCacheLine) std::atomic<uint64_t> tail; // app producers of the request ring
+    alignas(kCacheLine) std::atomic<uint32_t> items; // futex word, bumped on every push
+    std::atomic<uint32_t> item_waiters;
+    alignas(kCacheLine) std::atomic<uint32_t> space; // futex word, bumped on every pop
+    std::atomic<uint32_t> space_waiters;
+};
+
+inline void cpu_relax() {
+#if defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#elif defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Process-shared futex (no FUTEX_PRIVATE_FLAG): the word is in the memfd.
+void futex_wait(std::atomic<uint32_t>& word, uint32_t seen, std::chrono::nanoseconds timeout) {
+    timespec ts;
+    ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+    ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, seen, &ts, nullptr, 0);
+}
+
+void futex_wake(std::atomic<uint32_t>& word, int count) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, count, nullptr, nullptr, 0);
+}
+
+uint64_t word_mask(uint32_t first, uint32_t count) {
+    return (count == 64 ? ~uint64_t{0} : ((uint64_t{1} << count) - 1)) << first;
+}
+
+} // namespace
+
+struct IpcChannel::Slot {
+    std::atomic<uint64_t> seq;
+    IpcMessage message;
+};
+
+struct IpcChannel::Ring {
+    SharedRing* shared = nullptr;
+    Slot* slots = nullptr;
+    uint64_t mask = 0;
+    std::atomic<uint64_t>* tail = nullptr; // &shared->tail or &local_tail
+    std::atomic<uint64_t> local_tail{0};
+    uint64_t head = 0;
+};
+
+bool IpcMessage::set_inline(std::span<const uint8_t> bytes) {
+    if (bytes.size() > kInlineBytes) {
+        return false;
+    }
+    std::memcpy(data, bytes.data(), bytes.size());
+    inline_bytes = static_cast<uint32_t>(bytes.size());
+    return true;
+}
+
+std::span<const uint8_t> IpcMessage::inline_data() const {
+    return {data, std::min<size_t>(inline_bytes, kInlineBytes)};
+}
+
+IpcChannel::IpcChannel() = default;
+
+IpcChannel::~IpcChannel() { reset(); }
+
+IpcChannel::IpcChannel(IpcChannel&& other) noexcept { *this = std::move(other); }
+
+IpcChannel& IpcChannel::operator=(IpcChannel&& other) noexcept {
+    if (this != &other) {
+        reset();
+        fd_ = std::exchange(other.fd_, -1);
+        runtime_ = other.runtime_;
+        base_ = std::exchange(other.base_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        spin_ = other.spin_;
+        block_bytes_ = other.block_bytes_;
+        heap_blocks_ = other.heap_blocks_;
+        bitmap_ = std::exchange(other.bitmap_, nullptr);
+        heap_ = std::exchange(other.heap_, nullptr);
+        tx_ = std::move(other.tx_);
+        rx_ = std::move(other.rx_);
+    }
+    return *this;
+}
+
+void IpcChannel::reset() noexcept {
+    if (base_ != nullptr) {
+        munmap(base_, size_);
+        base_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    tx_.reset();
+    rx_.reset();
+}
+
+IpcChannel IpcChannel::create(const IpcOptions& options) {
+    static_assert(sizeof(Slot) == 2 * kCacheLine);
+    const uint64_t slots = std::bit_ceil(std::max<uint32_t>(options.ring_slots, 2));
+    if (options.block_bytes == 0 || options.heap_blocks == 0 ||
+        uint64_t(options.block_bytes) * options.heap_blocks > UINT32_MAX || slots > (uint64_t{1} << 24)) {
+        throw_error("ipc: ring or heap geometry out of range");
+    }
+    ChannelHeader h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.ring_slots = static_cast<uint32_t>(slots);
+    h.block_bytes = options.block_bytes;
+    h.heap_blocks = options.heap_blocks;
+    const size_t ring_bytes = sizeof(SharedRing) + slots * sizeof(Slot);
+    h.ring_offset[0] = align_up(sizeof(ChannelHeader), kCacheLine);
+    h.ring_offset[1] = align_up(h.ring_offset[0] + ring_bytes, kCacheLine);
+    h.bitmap_offset = align_up(h.ring_offset[1] + ring_bytes, kCacheLine);
+    const size_t words = (options.heap_blocks + 63) / 64;
+    h.heap_offset = align_up(h.bitmap_offset + words * sizeof(uint64_t), page_size());
+    h.size = h.heap_offset + uint64_t(options.block_bytes) * options.heap_blocks;
+
+    const int fd = memfd_create("neuroctx-ipc", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        throw_errno("memfd_create");
+    }
+    // Sealed so the app can never shrink the file under the runtime's
+    // mapping (which would turn its reads into SIGBUS).
+    if (ftruncate(fd, static_cast<off_t>(h.size)) != 0 ||
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+        const int saved = errno;
+        ::close(fd);
+        errno = saved;
+        throw_errno("ipc: size and seal memfd");
+    }
+    void* addr = mmap(nullptr, h.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        const int saved = errno;
+        ::close(fd);
+        errno = saved;
+        throw_errno("ipc: mmap channel");
+    }
+    auto* base = static_cast<uint8_t*>(addr);
+    for (const uint64_t offset : h.ring_offset) {
+        auto* ring = new (base + offset) SharedRing();
+        ring->tail.store(0, std::memory_order_relaxed);
+        auto* slot = reinterpret_cast<Slot*>(ring + 1);
+        for (uint64_t i = 0; i < slots; ++i) {
+            new (&slot[i].seq) std::atomic<uint64_t>(i);
+        }
+    }
+    auto* bitmap = reinterpret_cast<std::atomic<uint64_t>*>(base + h.bitmap_offset);
+    for (size_t w = 0; w < words; ++w) {
+        new (&bitmap[w]) std::atomic<uint64_t>(0);
+    }
+    // Blocks past the end of the heap are permanently taken.
+    if (const uint32_t tail = options.heap_blocks % 64; tail != 0) {
+        bitmap[words - 1].store(~word_mask(0, tail), std::memory_order_relaxed);
+    }
+    std::memcpy(base, &h, sizeof(h));
+    munmap(addr, h.size);
+    return map(fd, true, options.spin);
+}
+
+IpcChannel IpcChannel::attach(int fd, std::chrono::microseconds spin) { return map(fd, false, spin); }
+
+IpcChannel IpcChannel::map(int fd, bool runtime, std::chrono::microseconds spin) {
+    IpcChannel ch;
+    ch.fd_ = fd;
+    ch.runtime_ = runtime;
+    // With one core, polling only delays the peer it is waiting for.
+    ch.spin_ = std::thread::hardware_concurrency() > 1 ? spin : std::chrono::microseconds(0);
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        throw_errno("ipc: stat channel");
+    }
+    ChannelHeader h;
+    if (size_t(st.st_size) < sizeof(h) || ::pread(fd, &h, sizeof(h), 0) != ssize_t(sizeof(h))) {
+        throw_error("ipc: channel too small");
+    }
+    const uint64_t slots = h.ring_slots;
+    const size_t ring_bytes = sizeof(SharedRing) + slots * sizeof(Slot);
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion || h.size != uint64_t(st.st_size) ||
+        !std::has_single_bit(slots) || h.block_bytes == 0 ||
+        h.ring_offset[0] % kCacheLine != 0 || h.ring_offset[1] % kCacheLine != 0 ||
+        h.ring_offset[0] + ring_bytes > h.ring_offset[1] || h.ring_offset[1] + ring_bytes > h.bitmap_offset ||
+        h.bitmap_offset % kCacheLine != 0 || h.bitmap_offset + (h.heap_blocks + 63) / 64 * 8 > h.heap_offset ||
+        h.heap_offset + uint64_t(h.block_bytes) * h.heap_blocks != h.size) {
+        throw_error("ipc: not a channel, or a different version");
+    }
+    void* addr = mmap(nullptr, h.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        throw_errno("ipc: mmap channel");
+    }
+    ch.base_ = static_cast<uint8_t*>(addr);
+    ch.size_ = h.size;
+    ch.block_bytes_ = h.block_bytes;
+    ch.heap_blocks_ = h.heap_blocks;
+    ch.bitmap_ = reinterpret_cast<std::atomic<uint64_t>*>(ch.base_ + h.bitmap_offset);
+    ch.heap_ = ch.base_ + h.heap_offset;
+
+    auto view = [&](uint64_t offset, bool producer) {
+        auto ring = std::make_unique<Ring>();
+        ring->shared = reinterpret_cast<SharedRing*>(ch.base_ + offset);
+        ring->slots = reinterpret_cast<Slot*>(ring->shared + 1);
+        ring->mask = slots - 1;
+        // Only app threads share a producer index through the mapping.
+        ring->tail = producer && runtime ? &ring->local_tail : &ring->shared->tail;
+        return ring;
+    };
+    ch.tx_ = view(h.ring_offset[runtime ? 1 : 0], true);
+    ch.rx_ = view(h.ring_offset[runtime ? 0 : 1], false);
+    return ch;
+}
+
+bool IpcChannel::push(Ring& ring, const IpcMessage& message) {
+    uint64_t pos = ring.tail->load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &ring.slots[pos & ring.mask];
+        const uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        const auto dif = static_cast<int64_t>(seq - pos);
+        if (dif == 0) {
+            if (ring.tail->compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            return false; // full: the slot still holds the previous lap
+        } else {
+            // Another sender claimed the slot. With a private tail that
+            // sender has moved it on; if not, the app wrote the slot's seq
+            // and the ring is corrupt.
+            const uint64_t tail = ring.tail->load(std::memory_order_relaxed);
+            if (tail == pos && ring.tail == &ring.local_tail) {
+                return false;
+            }
+            pos = tail;
+        }
+    }
+    std::memcpy(&slot->message, &message, sizeof(message));
+    slot->seq.store(pos + 1, std::memory_order_release);
+    ring.shared->items.fetch_add(1, std::memory_order_seq_cst);
+    if (ring.shared->item_waiters.load(std::memory_order_seq_cst) != 0) {
+        futex_wake(ring.shared->items, 1);
+    }
+    return true;
+}
+
+bool IpcChannel::pop(Ring& ring, IpcMessage& message) {
+    Slot& slot = ring.slots[ring.head & ring.mask];
+    if (slot.seq.load(std::memory_order_acquire) != ring.head + 1) {
+        return false;
+    }
+    std::memcpy(&message, &slot.message, sizeof(message));
+    slot.seq.store(ring.head + ring.mask + 1, std::memory_order_release);
+    ++ring.head;
+    ring.shared->space.fetch_add(1, std::memory_order_seq_cst);
+    if (ring.shared->space_waiters.load(std::memory_order_seq_cst) != 0) {
+        futex_wake(ring.shared->space, INT_MAX);
+    }
+    return true;
+}
+
+bool IpcChannel::try_send(const IpcMessage& message) { return push(*tx_, message); }
+
+bool IpcChannel::try_receive(IpcMessage& message) { return pop(*rx_, message); }
+
+namespace {
+
+// Polls `attempt` for `spin`, then sleeps on `word` between attempts with
+// `waiters` raised, until it succeeds or `timeout` passes.
+template <typename Attempt>
+bool wait_until_done(Attempt&& attempt, std::atomic<uint32_t>& word, std::atomic<uint32_t>& waiters,
+                     std::chrono::microseconds spin, std::chrono::nanoseconds timeout) {
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    const auto deadline = start + timeout;
+    const auto spin_end = start + std::min<std::chrono::nanoseconds>(spin, timeout);
+    do {
+        for (int i = 0; i < 64; ++i) {
+            if (attempt()) {
+                return true;
+            }
+            cpu_relax();
+        }
+    } while (Clock::now() < spin_end);
+    for (;;) {
+        const auto now = Clock::now();
+        if (now >= deadline) {
+            return attempt();
+        }
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        const uint32_t seen = word.load(std::memory_order_seq_cst);
+        if (attempt()) {
+            waiters.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        futex_wait(word, seen, deadline - now);
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        if (attempt()) {
+            return true;
+        }
+    }
+}
+
+} // namespace
+
+bool IpcChannel::send(const IpcMessage& message, std::chrono::nanoseconds timeout) {
+    SharedRing& shared = *tx_->shared;
+    return wait_until_done([&] { return push(*tx_, message); }, shared.space, shared.space_waiters, spin_, timeout);
+}
+
+bool IpcChannel::receive(IpcMessage& message, std::chrono::nanoseconds timeout) {
+    SharedRing& shared = *rx_->shared;
+    return wait_until_done([&] { return pop(*rx_, message); }, shared.items, shared.item_waiters, spin_, timeout);
+}
+
+std::optional<IpcBuffer> IpcChannel::allocate(size_t bytes) {
+    // A zero-byte descriptor reads as invalid, so free() could not return it.
+    const uint64_t n = (uint64_t(bytes) + block_bytes_ - 1) / block_bytes_;
+    if (n == 0 || n > heap_blocks_) {
+        return std::nullopt;
+    }
+    const uint32_t words = (heap_blocks_ + 63) / 64;
+    // Find a run of n clear bits, then claim it word by word; losing a race
+    // for any word releases the words already taken and rescans.
+    for (int attempt = 0; attempt < 8; ++attempt) {
+        uint64_t run = 0;
+        uint64_t start = 0;
+        bool found = false;
+        for (uint32_t w = 0; w < words && !found; ++w) {
+            const uint64_t bits = bitmap_[w].load(std::memory_order_relaxed);
+            if (bits == ~uint64_t{0}) {
+                run = 0;
+                continue;
+            }
+            for (uint32_t b = 0; b < 64; ++b) {
+                if ((bits >> b & 1) != 0) {
+                    run = 0;
+                    continue;
+                }
+                if (run++ == 0) {
+                    start = uint64_t(w) * 64 + b;
+                }
+                if (run == n) {
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (!found) {
+            return std::nullopt;
+        }
+        uint64_t claimed = 0; // blocks taken so far, from `start`
+        while (claimed < n) {
+            const uint64_t block = start + claimed;
+            const auto first = static_cast<uint32_t>(block % 64);
+            const auto count = static_cast<uint32_t>(std::min<uint64_t>(64 - first, n - claimed));
+            const uint64_t mask = word_mask(first, count);
+            std::atomic<uint64_t>& word = bitmap_[block / 64];
+            uint64_t bits = word.load(std::memory_order_relaxed);
+            bool taken = false;
+            while ((bits & mask) == 0) {
+                if (word.compare_exchange_weak(bits, bits | mask, std::memory_order_acquire)) {
+                    taken = true;
+                    break;
+                }
+            }
+            if (!taken) {
+                break;
+            }
+            claimed += count;
+        }
+        if (claimed == n) {
+            return IpcBuffer{static_cast<uint32_t>(start * block_bytes_), static_cast<uint32_t>(bytes)};
+        }
+        if (claimed > 0) {
+            free(IpcBuffer{static_cast<uint32_t>(start * block_bytes_), static_cast<uint32_t>(claimed * block_bytes_)});
+        }
+    }
+    return std::nullopt;
+}
+
+void IpcChannel::free(IpcBuffer buffer) {
+    if (buffer.offset % block_bytes_ != 0 || data(buffer).empty()) {
+        return;
+    }
+    const uint64_t first_block = buffer.offset / block_bytes_;
+    const uint64_t n = std::max<uint64_t>((uint64_t(buffer.bytes) + block_bytes_ - 1) / block_bytes_, 1);
+    for (uint64_t done = 0; done < n;) {
+        const uint64_t block = first_block + done;
+        const auto first = static_cast<uint32_t>(block % 64);
+        const auto count = static_cast<uint32_t>(std::min<uint64_t>(64 - first, n - done));
+        bitmap_[block / 64].fetch_and(~word_mask(first, count), std::memory_order_release);
+        done += count;
+    }
+}
+
+std::span<uint8_t> IpcChannel::data(IpcBuffer buffer) const {
+    const uint64_t heap = uint64_t(heap_blocks_) * block_bytes_;
+    if (buffer.bytes == 0 || buffer.offset >= heap || buffer.bytes > heap - buffer.offset) {
+        return {};
+    }
+    return {heap_ + buffer.offset, buffer.bytes};
+}
+
+void send_fd(int socket, int fd) {
+    char byte = 0;
+    iovec iov{&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    ssize_t n;
+    do {
+        n = sendmsg(socket, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    if (n != 1) {
+        throw_errno("ipc: send fd");
+    }
+}
+
+int receive_fd(int socket) {
+    char byte = 0;
+    iovec iov{&byte, 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n;
+    do {
+        n = recvmsg(socket, &msg, MSG_CMSG_CLOEXEC);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        throw_errno("ipc: receive fd");
+    }
+    const cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (n == 0 || cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+        cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+        throw_error("ipc: peer sent no file descriptor");
+    }
+    int fd;
+    std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+    return fd;
+}
+
+} // namespace neuroctx
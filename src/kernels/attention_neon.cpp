@@ -0,0 +1,118 @@
+// NEON f32 attention tiles. Scores take four keys per pass so every query
+// load feeds four FMAs; accumulation keeps a 16-wide slice of the output
+// row in registers across all keys of the tile.
+
+#include "variants.h"
+
+#include <arm_neon.h>
+
+namespace neuroctx::kernels::neon {
+
+void attn_scores(const float* q, int64_t nq, const float* k, int64_t nk, int64_t d, float* s) {
+    const int64_t d4 = d & ~int64_t(3);
+    for (int64_t i = 0; i < nq; ++i) {
+        const float* qi = q + i * d;
+        int64_t j = 0;
+        for (; j + 4 <= nk; j += 4) {
+            const float* k0 = k + j * d;
+            const float* k1 = k0 + d;
+            const float* k2 = k1 + d;
+            const float* k3 = k2 + d;
+            float32x4_t a0 = vdupq_n_f32(0.0f);
+            float32x4_t a1 = vdupq_n_f32(0.0f);
+            float32x4_t a2 = vdupq_n_f32(0.0f);
+            float32x4_t a3 = vdupq_n_f32(0.0f);
+            for (int64_t t = 0; t < d4; t += 4) {
+                const float32x4_t x = vld1q_f32(qi + t);
+                a0 = vfmaq_f32(a0, x, vld1q_f32(k0 + t));
+                a1 = vfmaq_f32(a1, x, vld1q_f32(k1 + t));
+                a2 = vfmaq_f32(a2, x, vld1q_f32(k2 + t));
+                a3 = vfmaq_f32(a3, x, vld1q_f32(k3 + t));
+            }
+            float r0 = vaddvq_f32(a0);
+            float r1 = vaddvq_f32(a1);
+            float r2 = vaddvq_f32(a2);
+            float r3 = vaddvq_f32(a3);
+            for (int64_t t = d4; t < d; ++t) {
+                r0 += qi[t] * k0[t];
+                r1 += qi[t] * k1[t];
+                r2 += qi[t] * k2[t];
+                r3 += qi[t] * k3[t];
+            }
+            s[i * nk + j] = r0;
+            s[i * nk + j + 1] = r1;
+            s[i * nk + j + 2] = r2;
+            s[i * nk + j + 3] = r3;
+        }
+        for (; j < nk; ++j) {
+            const float* kj = k + j * d;
+            float32x4_t a = vdupq_n_f32(0.0f);
+            for (int64_t t = 0; t < d4; t += 4) {
+                a = vfmaq_f32(a, vld1q_f32(qi + t), vld1q_f32(kj + t));
+            }
+            float r = vaddvq_f32(a);
+            for (int64_t t = d4; t < d; ++t) {
+                r += qi[t] * kj[t];
+            }
+            s[i * nk + j] = r;
+        }
+    }
+}
+
+void attn_accumulate(const float* s, int64_t nq, const float* v, int64_t nk, int64_t d, float* acc) {
+    for (int64_t i = 0; i < nq; ++i) {
+        const float* si = s + i * nk;
+        float* ai = acc + i * d;
+        int64_t t = 0;
+        for (; t + 16 <= d; t += 16) {
+            float32x4_t a0 = vld1q_f32(ai + t);
+            float32x4_t a1 = vld1q_f32(ai + t + 4);
+            float32x4_t a2 = vld1q_f32(ai + t + 8);
+            float32x4_t a3 = vld1q_f32(ai + t + 12);
+            for (int64_t j = 0; j < nk; ++j) {
+                const float* vj = v + j * d + t;
+                const float32x4_t w = vdupq_n_f32(si[j]);
+                a0 = vfmaq_f32(a0, vld1q_f32(vj), w);
+                a1 = vfmaq_f32(a1, vld1q_f32(vj + 4), w);
+                a2 = vfmaq_f32(a2, vld1q_f32(vj + 8), w);
+                a3 = vfmaq_f32(a3, vld1q_f32(vj + 12), w);
+            }
+            vst1q_f32(ai + t, a0);
+            vst1q_f32(ai + t + 4, a1);
+            vst1q_f32(ai + t + 8, a2);
+            vst1q_f32(ai + t + 12, a3);
+        }
+        for (; t + 4 <= d; t += 4) {
+            float32x4_t a = vld1q_f32(ai + t);
+            for (int64_t j = 0; j < nk; ++j) {
+                a = vfmaq_f32(a, vld1q_f32(v + j * d + t), vdupq_n_f32(si[j]));
+            }
+            vst1q_f32(ai + t, a);
+        }
+        for (; t < d; ++t) {
+            for (int64_t j = 0; j < nk; ++j) {
+                ai[t] += si[j] * v[j * d + t];
+            }
+        }
+    }
+}
+
+void widen_f16(const uint16_t* src, int64_t n, float* dst) {
+    int64_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const float16x8_t h = vreinterpretq_f16_u16(vld1q_u16(src + i));
+        vst1q_f32(dst + i, vcvt_f32_f16(vget_low_f16(h)));
+        vst1q_f32(dst + i + 4, vcvt_high_f32_f16(h));
+    }
+    if (i < n) {
+        uint16_t tail[8] = {};
+        float out[8];
+        __builtin_memcpy(tail, src + i, size_t(n - i) * sizeof(uint16_t));
+        const float16x8_t h = vreinterpretq_f16_u16(vld1q_u16(tail));
+        vst1q_f32(out, vcvt_f32_f16(vget_low_f16(h)));
+        vst1q_f32(out + 4, vcvt_high_f32_f16(h));
+        __builtin_memcpy(dst + i, out, size_t(n - i) * sizeof(float));
+    }
+}
+
+} // namespace neuroctx::kernels::neon
@@ -0,0 +1,36 @@
+// Portable f32 attention tiles; the oracle for the SIMD versions.
+
+#include "variants.h"
+
+namespace neuroctx::kernels::ref {
+
+void attn_scores(const float* q, int64_t nq, const float* k, int64_t nk, int64_t d, float* s) {
+    for (int64_t i = 0; i < nq; ++i) {
+        for (int64_t j = 0; j < nk; ++j) {
+            float sum = 0.0f;
+            for (int64_t t = 0; t < d; ++t) {
+                sum += q[i * d + t] * k[j * d + t];
+            }
+            s[i * nk + j] = sum;
+        }
+    }
+}
+
+void attn_accumulate(const float* s, int64_t nq, const float* v, int64_t nk, int64_t d, float* acc) {
+    for (int64_t i = 0; i < nq; ++i) {
+        for (int64_t j = 0; j < nk; ++j) {
+            const float w = s[i * nk + j];
+            for (int64_t t = 0; t < d; ++t) {
+                acc[i * d + t] += w * v[j * d + t];
+            }
+        }
+    }
+}
+
+void widen_f16(const uint16_t* src, int64_t n, float* dst) {
+    for (int64_t i = 0; i < n; ++i) {
+        dst[i] = fp16_to_fp32(src[i]);
+    }
+}
+
+} // namespace neuroctx::kernels::ref
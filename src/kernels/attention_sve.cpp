@@ -0,0 +1,74 @@
+// SVE f32 attention tiles, vector-length agnostic. Head dimensions that are
+// not a multiple of the vector length run their last chunk predicated.
+
+#include "variants.h"
+
+#include <arm_sve.h>
+
+namespace neuroctx::kernels::sve {
+
+void attn_scores(const float* q, int64_t nq, const float* k, int64_t nk, int64_t d, float* s) {
+    const int64_t vl = static_cast<int64_t>(svcntw());
+    const svbool_t all = svptrue_b32();
+    for (int64_t i = 0; i < nq; ++i) {
+        const float* qi = q + i * d;
+        int64_t j = 0;
+        for (; j + 4 <= nk; j += 4) {
+            const float* k0 = k + j * d;
+            svfloat32_t a0 = svdup_n_f32(0.0f);
+            svfloat32_t a1 = svdup_n_f32(0.0f);
+            svfloat32_t a2 = svdup_n_f32(0.0f);
+            svfloat32_t a3 = svdup_n_f32(0.0f);
+            for (int64_t t = 0; t < d; t += vl) {
+                const svbool_t pg = svwhilelt_b32_s64(t, d);
+                const svfloat32_t x = svld1_f32(pg, qi + t);
+                a0 = svmla_f32_m(pg, a0, x, svld1_f32(pg, k0 + t));
+                a1 = svmla_f32_m(pg, a1, x, svld1_f32(pg, k0 + d + t));
+                a2 = svmla_f32_m(pg, a2, x, svld1_f32(pg, k0 + 2 * d + t));
+                a3 = svmla_f32_m(pg, a3, x, svld1_f32(pg, k0 + 3 * d + t));
+            }
+            s[i * nk + j] = svaddv_f32(all, a0);
+            s[i * nk + j + 1] = svaddv_f32(all, a1);
+            s[i * nk + j + 2] = svaddv_f32(all, a2);
+            s[i * nk + j + 3] = svaddv_f32(all, a3);
+        }
+        for (; j < nk; ++j) {
+            const float* kj = k + j * d;
+            svfloat32_t a = svdup_n_f32(0.0f);
+            for (int64_t t = 0; t < d; t += vl) {
+                const svbool_t pg = svwhilelt_b32_s64(t, d);
+                a = svmla_f32_m(pg, a, svld1_f32(pg, qi + t), svld1_f32(pg, kj + t));
+            }
+            s[i * nk + j] = svaddv_f32(all, a);
+        }
+    }
+}
+
+void attn_accumulate(const float* s, int64_t nq, const float* v, int64_t nk, int64_t d, float* acc) {
+    const int64_t vl = static_cast<int64_t>(svcntw());
+    for (int64_t i = 0; i < nq; ++i) {
+        const float* si = s + i * nk;
+        float* ai = acc + i * d;
+        for (int64_t t = 0; t < d; t += vl) {
+            const svbool_t pg = svwhilelt_b32_s64(t, d);
+            svfloat32_t a = svld1_f32(pg, ai + t);
+            for (int64_t j = 0; j < nk; ++j) {
+                a = svmla_n_f32_m(pg, a, svld1_f32(pg, v + j * d + t), si[j]);
+            }
+            svst1_f32(pg, ai + t, a);
+        }
+    }
+}
+
+void widen_f16(const uint16_t* src, int64_t n, float* dst) {
+    const int64_t vl = static_cast<int64_t>(svcntw());
+    for (int64_t i = 0; i < n; i += vl) {
+        const svbool_t pg = svwhilelt_b32_s64(i, n);
+        // Each 16-bit value lands in the low half of a 32-bit lane, which is
+        // the half FCVT widens.
+        const svuint32_t h = svld1uh_u32(pg, src + i);
+        svst1_f32(pg, dst + i, svcvt_f32_f16_x(pg, svreinterpret_f16_u32(h)));
+    }
+}
+
+} // namespace neuroctx::kernels::sve
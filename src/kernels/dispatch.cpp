@@ -0,0 +1,133 @@
+#include "variants.h"
+
+#include "neuroctx/common.h"
+#include "neuroctx/tuning.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace neuroctx::kernels {
+
+namespace {
+
+constexpr KernelSet kReferenceSet = {
+    KernelVariant::kReference, "reference", {4, 4}, ref::gemm_i8, ref::gemm_i4, ref::gemv_i8, ref::gemv_i4,
+    ref::attn_scores, ref::attn_accumulate, ref::widen_f16, ref::dot_i8, ref::fixed_gemv,
+};
+
+#if defined(NEUROCTX_ARM_KERNELS)
+constexpr KernelSet kNeonSet = {
+    KernelVariant::kNeon, "neon", {4, 4}, neon::gemm_i8, neon::gemm_i4, neon::gemv_i8, neon::gemv_i4,
+    neon::attn_scores, neon::attn_accumulate, neon::widen_f16, neon::dot_i8, neon::fixed_gemv,
+};
+
+constexpr KernelSet kDotprodSet = {
+    KernelVariant::kDotprod, "dotprod", {4, 4},
+    dotprod::gemm_i8, dotprod::gemm_i4, dotprod::gemv_i8, dotprod::gemv_i4,
+    neon::attn_scores, neon::attn_accumulate, neon::widen_f16, dotprod::dot_i8, dotprod::fixed_gemv,
+};
+
+constexpr KernelSet kI8mmSet = {
+    KernelVariant::kI8mm, "i8mm", {4, 8}, i8mm::gemm_i8, i8mm::gemm_i4, i8mm::gemv_i8, i8mm::gemv_i4,
+    neon::attn_scores, neon::attn_accumulate, neon::widen_f16, dotprod::dot_i8,
+};
+
+// The SVE panel height is the vector length, which is only known (and only
+// safe to query) on an SVE machine.
+const KernelSet& sve_set() {
+    static const KernelSet set = {
+        KernelVariant::kSve, "sve", {sve::panel_rows(), 4}, sve::gemm_i8, sve::gemm_i4, sve::gemv_i8, sve::gemv_i4,
+        sve::attn_scores, sve::attn_accumulate, sve::widen_f16, sve::dot_i8,
+    };
+    return set;
+}
+#endif
+
+const KernelSet& choose() {
+    const auto candidates = supported_kernels(cpu_features());
+    if (const char* forced = std::getenv("NEUROCTX_KERNELS"); forced != nullptr && *forced != '\0') {
+        for (const KernelSet* ks : candidates) {
+            if (std::strcmp(ks->name, forced) == 0) {
+                return *ks;
+            }
+        }
+    }
+    return *candidates.front();
+}
+
+} // namespace
+
+std::vector<const KernelSet*> supported_kernels(const CpuFeatures& features) {
+    std::vector<const KernelSet*> sets;
+#if defined(NEUROCTX_ARM_KERNELS)
+    // Wide SVE beats fixed 128-bit NEON; at 128 bits SMMLA and SDOT win.
+    const bool sve = features.sve && features.sve_vector_bytes >= 16;
+    if (sve && features.sve_vector_bytes > 16) {
+        sets.push_back(&sve_set());
+    }
+    if (features.i8mm && features.dotprod) {
+        sets.push_back(&kI8mmSet);
+    }
+    if (features.dotprod) {
+        sets.push_back(&kDotprodSet);
+    }
+    if (sve && features.sve_vector_bytes == 16) {
+        sets.push_back(&sve_set());
+    }
+    if (features.neon) {
+        sets.push_back(&kNeonSet);
+    }
+#else
+    (void)features;
+#endif
+    sets.push_back(&kReferenceSet);
+    return sets;
+}
+
+const KernelSet* find_kernels(KernelVariant variant) {
+    for (const KernelSet* ks : supported_kernels(cpu_features())) {
+        if (ks->variant == variant) {
+            return ks;
+        }
+    }
+    return nullptr;
+}
+
+const KernelSet& active() {
+    static const KernelSet& chosen = choose();
+    return chosen;
+}
+
+void matmul_panels(const KernelSet& ks, const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc,
+                   int64_t panel_begin, int64_t panel_end) {
+    const TuningProfile& tuned = tuning();
+    const bool int4 = w.format == WeightFormat::kInt4;
+    if (a.rows == 1) {
+        GemmFn fn = nullptr;
+        if (tuned.fixed_gemv && ks.fixed_gemv != nullptr && w.layout == ks.layout) {
+            fn = ks.fixed_gemv(w.k, w.format);
+        }
+        if (fn == nullptr) {
+            fn = int4 ? ks.gemv_i4 : ks.gemv_i8;
+        }
+        fn(w, a, c, ldc, panel_begin, panel_end);
+        return;
+    }
+    // The kernels tile rows by kRowTile themselves; a smaller tile is
+    // applied by handing them one row range at a time.
+    const GemmFn fn = int4 ? ks.gemm_i4 : ks.gemm_i8;
+    const int64_t tile = std::clamp<int64_t>(tuned.gemm_row_tile, 1, kRowTile);
+    const int64_t blocks = a.k / kBlock;
+    for (int64_t m = 0; m < a.rows; m += tile) {
+        const QuantizedRows part{a.q + m * a.k, a.scales + m * blocks, std::min(tile, a.rows - m), a.k};
+        fn(w, part, c + m * ldc, ldc, panel_begin, panel_end);
+    }
+}
+
+void matmul(const KernelSet& ks, const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc) {
+    matmul_panels(ks, w, a, c, ldc, 0, w.panels());
+}
+
+} // namespace neuroctx::kernels
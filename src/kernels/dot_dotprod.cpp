@@ -0,0 +1,40 @@
+// ARMv8.2 int8 row dots: one SDOT per 16 values and row. Four rows share
+// every query load.
+
+#include "variants.h"
+
+#include <arm_neon.h>
+
+namespace neuroctx::kernels::dotprod {
+
+void dot_i8(const int8_t* q, const int8_t* rows, int64_t n, int64_t dim, int32_t* out) {
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const int8_t* r = rows + i * dim;
+        int32x4_t a0 = vdupq_n_s32(0);
+        int32x4_t a1 = vdupq_n_s32(0);
+        int32x4_t a2 = vdupq_n_s32(0);
+        int32x4_t a3 = vdupq_n_s32(0);
+        for (int64_t t = 0; t < dim; t += 16) {
+            const int8x16_t x = vld1q_s8(q + t);
+            a0 = vdotq_s32(a0, x, vld1q_s8(r + t));
+            a1 = vdotq_s32(a1, x, vld1q_s8(r + dim + t));
+            a2 = vdotq_s32(a2, x, vld1q_s8(r + 2 * dim + t));
+            a3 = vdotq_s32(a3, x, vld1q_s8(r + 3 * dim + t));
+        }
+        out[i] = vaddvq_s32(a0);
+        out[i + 1] = vaddvq_s32(a1);
+        out[i + 2] = vaddvq_s32(a2);
+        out[i + 3] = vaddvq_s32(a3);
+    }
+    for (; i < n; ++i) {
+        const int8_t* r = rows + i * dim;
+        int32x4_t a = vdupq_n_s32(0);
+        for (int64_t t = 0; t < dim; t += 16) {
+            a = vdotq_s32(a, vld1q_s8(q + t), vld1q_s8(r + t));
+        }
+        out[i] = vaddvq_s32(a);
+    }
+}
+
+} // namespace neuroctx::kernels::dotprod
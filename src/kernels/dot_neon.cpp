@@ -0,0 +1,49 @@
+// ARMv8.0 int8 row dots: SMULL/SMULL2 into int16, SADALP into int32. Four
+// rows share every query load.
+
+#include "variants.h"
+
+#include <arm_neon.h>
+
+namespace neuroctx::kernels::neon {
+
+namespace {
+
+inline int32x4_t mla16(int32x4_t acc, int8x16_t a, int8x16_t b) {
+    acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(a), vget_low_s8(b)));
+    return vpadalq_s16(acc, vmull_high_s8(a, b));
+}
+
+} // namespace
+
+void dot_i8(const int8_t* q, const int8_t* rows, int64_t n, int64_t dim, int32_t* out) {
+    int64_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const int8_t* r = rows + i * dim;
+        int32x4_t a0 = vdupq_n_s32(0);
+        int32x4_t a1 = vdupq_n_s32(0);
+        int32x4_t a2 = vdupq_n_s32(0);
+        int32x4_t a3 = vdupq_n_s32(0);
+        for (int64_t t = 0; t < dim; t += 16) {
+            const int8x16_t x = vld1q_s8(q + t);
+            a0 = mla16(a0, x, vld1q_s8(r + t));
+            a1 = mla16(a1, x, vld1q_s8(r + dim + t));
+            a2 = mla16(a2, x, vld1q_s8(r + 2 * dim + t));
+            a3 = mla16(a3, x, vld1q_s8(r + 3 * dim + t));
+        }
+        out[i] = vaddvq_s32(a0);
+        out[i + 1] = vaddvq_s32(a1);
+        out[i + 2] = vaddvq_s32(a2);
+        out[i + 3] = vaddvq_s32(a3);
+    }
+    for (; i < n; ++i) {
+        const int8_t* r = rows + i * dim;
+        int32x4_t a = vdupq_n_s32(0);
+        for (int64_t t = 0; t < dim; t += 16) {
+            a = mla16(a, vld1q_s8(q + t), vld1q_s8(r + t));
+        }
+        out[i] = vaddvq_s32(a);
+    }
+}
+
+} // namespace neuroctx::kernels::neon
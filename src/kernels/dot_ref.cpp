@@ -0,0 +1,18 @@
+// Portable int8 row dots; the oracle for the SIMD versions.
+
+#include "variants.h"
+
+namespace neuroctx::kernels::ref {
+
+void dot_i8(const int8_t* q, const int8_t* rows, int64_t n, int64_t dim, int32_t* out) {
+    for (int64_t i = 0; i < n; ++i) {
+        const int8_t* r = rows + i * dim;
+        int32_t sum = 0;
+        for (int64_t t = 0; t < dim; ++t) {
+            sum += int32_t(q[t]) * int32_t(r[t]);
+        }
+        out[i] = sum;
+    }
+}
+
+} // namespace neuroctx::kernels::ref
@@ -0,0 +1,39 @@
+// SVE int8 row dots, vector-length agnostic: SDOT over one predicated
+// vector of the row at a time, two rows per query load.
+
+#include "variants.h"
+
+#include <arm_sve.h>
+
+namespace neuroctx::kernels::sve {
+
+void dot_i8(const int8_t* q, const int8_t* rows, int64_t n, int64_t dim, int32_t* out) {
+    const auto vl = static_cast<int64_t>(svcntb());
+    const svbool_t all = svptrue_b32();
+    int64_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        const int8_t* r0 = rows + i * dim;
+        const int8_t* r1 = r0 + dim;
+        svint32_t a0 = svdup_n_s32(0);
+        svint32_t a1 = svdup_n_s32(0);
+        for (int64_t t = 0; t < dim; t += vl) {
+            const svbool_t pg = svwhilelt_b8_s64(t, dim);
+            const svint8_t x = svld1_s8(pg, q + t);
+            a0 = svdot_s32(a0, x, svld1_s8(pg, r0 + t));
+            a1 = svdot_s32(a1, x, svld1_s8(pg, r1 + t));
+        }
+        out[i] = static_cast<int32_t>(svaddv_s32(all, a0));
+        out[i + 1] = static_cast<int32_t>(svaddv_s32(all, a1));
+    }
+    for (; i < n; ++i) {
+        const int8_t* r = rows + i * dim;
+        svint32_t a = svdup_n_s32(0);
+        for (int64_t t = 0; t < dim; t += vl) {
+            const svbool_t pg = svwhilelt_b8_s64(t, dim);
+            a = svdot_s32(a, svld1_s8(pg, q + t), svld1_s8(pg, r + t));
+        }
+        out[i] = static_cast<int32_t>(svaddv_s32(all, a));
+    }
+}
+
+} // namespace neuroctx::kernels::sve
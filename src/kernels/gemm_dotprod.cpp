@@ -0,0 +1,61 @@
+// ARMv8.2 SDOT kernels. Each indexed SDOT multiplies a 4x4 row/K chunk of
+// the panel by one broadcast activation quad.
+
+#include "neon_4x4.h"
+
+namespace neuroctx::kernels::dotprod {
+
+namespace {
+
+struct Dot {
+    static inline int32x4_t block(const int8x16_t w[8], const int8_t* a) {
+        const int8x16_t a0 = vld1q_s8(a);
+        const int8x16_t a1 = vld1q_s8(a + 16);
+        // Two chains so consecutive SDOTs do not serialize on one register.
+        int32x4_t s0 = vdupq_n_s32(0);
+        int32x4_t s1 = vdupq_n_s32(0);
+        s0 = vdotq_laneq_s32(s0, w[0], a0, 0);
+        s1 = vdotq_laneq_s32(s1, w[1], a0, 1);
+        s0 = vdotq_laneq_s32(s0, w[2], a0, 2);
+        s1 = vdotq_laneq_s32(s1, w[3], a0, 3);
+        s0 = vdotq_laneq_s32(s0, w[4], a1, 0);
+        s1 = vdotq_laneq_s32(s1, w[5], a1, 1);
+        s0 = vdotq_laneq_s32(s0, w[6], a1, 2);
+        s1 = vdotq_laneq_s32(s1, w[7], a1, 3);
+        return vaddq_s32(s0, s1);
+    }
+};
+
+template <bool kInt4, int64_t K>
+void fixed_gemv_kernel(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t, int64_t panel_begin,
+                       int64_t panel_end) {
+    run_fixed_gemv<kInt4, K, Dot>(w, a, c, panel_begin, panel_end);
+}
+
+} // namespace
+
+void gemm_i8(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run_4x4<false, 4, Dot>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemm_i4(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run_4x4<true, 4, Dot>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemv_i8(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run_4x4<false, 1, Dot>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemv_i4(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run_4x4<true, 1, Dot>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+GemmFn fixed_gemv(int64_t k, WeightFormat format) {
+    NEUROCTX_FIXED_GEMV_SWITCH(k, format);
+}
+
+} // namespace neuroctx::kernels::dotprod
@@ -0,0 +1,115 @@
+// ARMv8.6 SMMLA kernels on the 4x8 panel layout. One SMMLA multiplies a
+// 2x8 tile of two activation rows by a 2x8 tile of two weight rows, so a
+// K block of a 4-row panel costs eight SMMLAs per pair of activation rows.
+// A single-row input is paired with itself; SMMLA still retires as many
+// MACs per cycle as SDOT on the cores that have it.
+
+#include "neon_4x4.h"
+
+namespace neuroctx::kernels::i8mm {
+
+namespace {
+
+// Per-row dot products of one K block for activation rows a0 and a1.
+inline void block_pair(const int8x16_t w[8], const int8_t* a0, const int8_t* a1, int32x4_t& row0,
+                       int32x4_t& row1) {
+    int32x4_t s01 = vdupq_n_s32(0); // [a0.r0, a0.r1, a1.r0, a1.r1]
+    int32x4_t s23 = vdupq_n_s32(0); // [a0.r2, a0.r3, a1.r2, a1.r3]
+    for (int c = 0; c < 4; ++c) {
+        const int8x16_t av = vcombine_s8(vld1_s8(a0 + 8 * c), vld1_s8(a1 + 8 * c));
+        s01 = vmmlaq_s32(s01, av, w[2 * c]);
+        s23 = vmmlaq_s32(s23, av, w[2 * c + 1]);
+    }
+    const int64x2_t lo = vreinterpretq_s64_s32(s01);
+    const int64x2_t hi = vreinterpretq_s64_s32(s23);
+    row0 = vreinterpretq_s32_s64(vzip1q_s64(lo, hi));
+    row1 = vreinterpretq_s32_s64(vzip2q_s64(lo, hi));
+}
+
+// MB activation row pairs against one panel. The second row of the last
+// pair may alias the first when the row count is odd.
+template <bool kInt4, int MB>
+inline void panel_4x8(const uint8_t* panel, int64_t blocks, const int8_t* const* rows, const float* const* scales,
+                      float32x4_t acc[2 * MB]) {
+    constexpr int64_t kBlockBytes = kNeonPanelRows * (4 + (kInt4 ? kBlock / 2 : kBlock));
+    for (int i = 0; i < 2 * MB; ++i) {
+        acc[i] = vdupq_n_f32(0.0f);
+    }
+    for (int64_t b = 0; b < blocks; ++b) {
+        const uint8_t* blk = panel + b * kBlockBytes;
+        const float32x4_t ws = vld1q_f32(reinterpret_cast<const float*>(blk));
+        int8x16_t w[8];
+        load_block_weights<kInt4>(blk + kNeonPanelRows * 4, w);
+        for (int pi = 0; pi < MB; ++pi) {
+            int32x4_t r0;
+            int32x4_t r1;
+            block_pair(w, rows[2 * pi] + b * kBlock, rows[2 * pi + 1] + b * kBlock, r0, r1);
+            acc[2 * pi] = vfmaq_f32(acc[2 * pi], vcvtq_f32_s32(r0), vmulq_n_f32(ws, scales[2 * pi][b]));
+            acc[2 * pi + 1] = vfmaq_f32(acc[2 * pi + 1], vcvtq_f32_s32(r1), vmulq_n_f32(ws, scales[2 * pi + 1][b]));
+        }
+    }
+}
+
+template <bool kInt4, int MB>
+void run_4x8(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    const int64_t blocks = w.k / kBlock;
+    const int64_t panel_bytes = blocks * kNeonPanelRows * (4 + (kInt4 ? kBlock / 2 : kBlock));
+    for (int64_t m0 = 0; m0 < a.rows; m0 += kRowTile) {
+        const int64_t m1 = min64(a.rows, m0 + kRowTile);
+        for (int64_t p = panel_begin; p < panel_end; ++p) {
+            const uint8_t* panel = w.data + p * panel_bytes;
+            const int64_t valid = min64(kNeonPanelRows, w.n - p * kNeonPanelRows);
+            float* out = c + p * kNeonPanelRows;
+            int64_t m = m0;
+            for (; m + 2 * MB <= m1; m += 2 * MB) {
+                const int8_t* rows[2 * MB];
+                const float* scales[2 * MB];
+                for (int i = 0; i < 2 * MB; ++i) {
+                    rows[i] = a.q + (m + i) * a.k;
+                    scales[i] = a.scales + (m + i) * blocks;
+                }
+                float32x4_t acc[2 * MB];
+                panel_4x8<kInt4, MB>(panel, blocks, rows, scales, acc);
+                for (int i = 0; i < 2 * MB; ++i) {
+                    store_panel(acc[i], out + (m + i) * ldc, valid);
+                }
+            }
+            for (; m < m1; m += 2) {
+                const int64_t second = min64(m + 1, m1 - 1);
+                const int8_t* rows[2] = {a.q + m * a.k, a.q + second * a.k};
+                const float* scales[2] = {a.scales + m * blocks, a.scales + second * blocks};
+                float32x4_t acc[2];
+                panel_4x8<kInt4, 1>(panel, blocks, rows, scales, acc);
+                store_panel(acc[0], out + m * ldc, valid);
+                if (second != m) {
+                    store_panel(acc[1], out + second * ldc, valid);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+void gemm_i8(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run_4x8<false, 2>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemm_i4(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run_4x8<true, 2>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemv_i8(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run_4x8<false, 1>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemv_i4(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run_4x8<true, 1>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+} // namespace neuroctx::kernels::i8mm
@@ -0,0 +1,57 @@
+// ARMv8.0 ASIMD kernels for cores without SDOT (Cortex-A53/A55 r0 class):
+// widening SMULL plus pairwise SADALP accumulation.
+
+#include "neon_4x4.h"
+
+namespace neuroctx::kernels::neon {
+
+namespace {
+
+struct Dot {
+    static inline int32x4_t block(const int8x16_t w[8], const int8_t* a) {
+        int32x4_t lo = vdupq_n_s32(0); // rows 0-1, two partial sums each
+        int32x4_t hi = vdupq_n_s32(0); // rows 2-3
+        for (int j = 0; j < 8; ++j) {
+            int32_t quad;
+            __builtin_memcpy(&quad, a + 4 * j, sizeof(quad));
+            const int8x16_t aq = vreinterpretq_s8_s32(vdupq_n_s32(quad));
+            lo = vpadalq_s16(lo, vmull_s8(vget_low_s8(w[j]), vget_low_s8(aq)));
+            hi = vpadalq_s16(hi, vmull_high_s8(w[j], aq));
+        }
+        return vpaddq_s32(lo, hi);
+    }
+};
+
+template <bool kInt4, int64_t K>
+void fixed_gemv_kernel(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t, int64_t panel_begin,
+                       int64_t panel_end) {
+    run_fixed_gemv<kInt4, K, Dot>(w, a, c, panel_begin, panel_end);
+}
+
+} // namespace
+
+void gemm_i8(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run_4x4<false, 4, Dot>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemm_i4(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run_4x4<true, 4, Dot>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemv_i8(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run_4x4<false, 1, Dot>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemv_i4(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run_4x4<true, 1, Dot>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+GemmFn fixed_gemv(int64_t k, WeightFormat format) {
+    NEUROCTX_FIXED_GEMV_SWITCH(k, format);
+}
+
+} // namespace neuroctx::kernels::neon
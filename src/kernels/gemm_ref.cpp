@@ -0,0 +1,137 @@
+// Portable scalar kernels. They read any PackFormat, which also makes them
+// the oracle for the SIMD variants' layouts.
+
+#include "variants.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace neuroctx::kernels::ref {
+
+namespace {
+
+template <WeightFormat F>
+int32_t weight_at(const uint8_t* values, int64_t panel_rows, int64_t ki, int64_t r, int64_t kk) {
+    const int64_t t = ((kk / ki) * panel_rows + r) * ki + kk % ki;
+    if constexpr (F == WeightFormat::kInt8) {
+        return static_cast<int8_t>(values[t]);
+    } else {
+        const int64_t half = kBlock * panel_rows / 2;
+        const uint8_t byte = t < half ? (values[t] & 0x0f) : (values[t - half] >> 4);
+        return static_cast<int32_t>(byte) - 8;
+    }
+}
+
+template <WeightFormat F>
+void gemm(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+          int64_t panel_end) {
+    const int64_t rows = w.layout.panel_rows;
+    const int64_t ki = w.layout.k_interleave;
+    const int64_t blocks = w.k / kBlock;
+    const size_t block_bytes = packed_block_bytes(F, w.layout);
+    const size_t panel_bytes = packed_panel_bytes(w.k, F, w.layout);
+
+    for (int64_t m0 = 0; m0 < a.rows; m0 += kRowTile) {
+        const int64_t m1 = std::min(a.rows, m0 + kRowTile);
+        for (int64_t p = panel_begin; p < panel_end; ++p) {
+            const uint8_t* panel = w.data + p * panel_bytes;
+            const int64_t valid = std::min(rows, w.n - p * rows);
+            for (int64_t m = m0; m < m1; ++m) {
+                const int8_t* aq = a.q + m * a.k;
+                const float* as = a.scales + m * blocks;
+                for (int64_t r = 0; r < valid; ++r) {
+                    float acc = 0.0f;
+                    for (int64_t b = 0; b < blocks; ++b) {
+                        const uint8_t* blk = panel + b * block_bytes;
+                        float ws;
+                        std::memcpy(&ws, blk + r * sizeof(float), sizeof(float));
+                        const uint8_t* values = blk + rows * sizeof(float);
+                        int32_t isum = 0;
+                        for (int64_t kk = 0; kk < kBlock; ++kk) {
+                            isum += weight_at<F>(values, rows, ki, r, kk) * aq[b * kBlock + kk];
+                        }
+                        acc += static_cast<float>(isum) * (ws * as[b]);
+                    }
+                    c[m * ldc + p * rows + r] = acc;
+                }
+            }
+        }
+    }
+}
+
+// Single-row GEMV on the reference set's 4x4 layout with K fixed, so every
+// index below is a constant and the compiler is free to unroll and
+// vectorize. Sums in the same order as gemm(), so results match bit for bit.
+template <bool kInt4, int64_t K>
+void fixed_gemv_kernel(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t, int64_t panel_begin,
+                       int64_t panel_end) {
+    constexpr int64_t kRows = 4;
+    constexpr int64_t kBlocks = K / kBlock;
+    constexpr int64_t kValueBytes = kRows * (kInt4 ? kBlock / 2 : kBlock);
+    constexpr int64_t kBlockBytes = kRows * int64_t(sizeof(float)) + kValueBytes;
+    static_assert(K % kBlock == 0);
+
+    for (int64_t p = panel_begin; p < panel_end; ++p) {
+        const uint8_t* panel = w.data + p * kBlocks * kBlockBytes;
+        float acc[kRows] = {};
+        for (int64_t b = 0; b < kBlocks; ++b) {
+            const uint8_t* blk = panel + b * kBlockBytes;
+            const int8_t* aq = a.q + b * kBlock;
+            float ws[kRows];
+            std::memcpy(ws, blk, sizeof(ws));
+            int8_t v[kRows * kBlock];
+            if constexpr (kInt4) {
+                for (int64_t t = 0; t < kValueBytes; ++t) {
+                    const uint8_t byte = blk[kRows * sizeof(float) + t];
+                    v[t] = static_cast<int8_t>((byte & 0x0f) - 8);
+                    v[t + kValueBytes] = static_cast<int8_t>((byte >> 4) - 8);
+                }
+            } else {
+                std::memcpy(v, blk + kRows * sizeof(float), sizeof(v));
+            }
+            int32_t isum[kRows] = {};
+            for (int64_t chunk = 0; chunk < kBlock / 4; ++chunk) {
+                for (int64_t r = 0; r < kRows; ++r) {
+                    for (int64_t j = 0; j < 4; ++j) {
+                        isum[r] += int32_t(v[(chunk * kRows + r) * 4 + j]) * aq[chunk * 4 + j];
+                    }
+                }
+            }
+            for (int64_t r = 0; r < kRows; ++r) {
+                acc[r] += static_cast<float>(isum[r]) * (ws[r] * a.scales[b]);
+            }
+        }
+        const int64_t valid = std::min(kRows, w.n - p * kRows);
+        for (int64_t r = 0; r < valid; ++r) {
+            c[p * kRows + r] = acc[r];
+        }
+    }
+}
+
+} // namespace
+
+void gemm_i8(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    gemm<WeightFormat::kInt8>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemm_i4(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    gemm<WeightFormat::kInt4>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemv_i8(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    gemm<WeightFormat::kInt8>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemv_i4(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    gemm<WeightFormat::kInt4>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+GemmFn fixed_gemv(int64_t k, WeightFormat format) {
+    NEUROCTX_FIXED_GEMV_SWITCH(k, format);
+}
+
+} // namespace neuroctx::kernels::ref
@@ -0,0 +1,146 @@
+// SVE kernels, vector-length agnostic. A panel holds one weight row per
+// 32-bit lane (svcntw() rows), laid out like the 4x4 NEON panel repeated
+// once per 128-bit segment, so the indexed SDOT of every segment pairs its
+// four rows with the same broadcast activation quad. SVE2 adds no int8 dot
+// product beyond SVE's, so SVE2 parts run this variant as well.
+
+#include "variants.h"
+
+#include <arm_sve.h>
+
+namespace neuroctx::kernels::sve {
+
+namespace {
+
+inline int64_t min64(int64_t a, int64_t b) { return a < b ? a : b; }
+
+inline svint32_t dot_block(svint8_t w0, svint8_t w1, svint8_t w2, svint8_t w3, svint8_t w4, svint8_t w5,
+                           svint8_t w6, svint8_t w7, const int8_t* a) {
+    const svbool_t all = svptrue_b8();
+    const svint8_t a0 = svld1rq_s8(all, a);
+    const svint8_t a1 = svld1rq_s8(all, a + 16);
+    svint32_t s0 = svdup_n_s32(0);
+    svint32_t s1 = svdup_n_s32(0);
+    s0 = svdot_lane_s32(s0, w0, a0, 0);
+    s1 = svdot_lane_s32(s1, w1, a0, 1);
+    s0 = svdot_lane_s32(s0, w2, a0, 2);
+    s1 = svdot_lane_s32(s1, w3, a0, 3);
+    s0 = svdot_lane_s32(s0, w4, a1, 0);
+    s1 = svdot_lane_s32(s1, w5, a1, 1);
+    s0 = svdot_lane_s32(s0, w6, a1, 2);
+    s1 = svdot_lane_s32(s1, w7, a1, 3);
+    return svadd_s32_x(svptrue_b32(), s0, s1);
+}
+
+inline svint8_t low_nibbles(svuint8_t x) {
+    const svbool_t all = svptrue_b8();
+    return svsub_n_s8_x(all, svreinterpret_s8_u8(svand_n_u8_x(all, x, 0x0f)), 8);
+}
+
+inline svint8_t high_nibbles(svuint8_t x) {
+    const svbool_t all = svptrue_b8();
+    return svsub_n_s8_x(all, svreinterpret_s8_u8(svlsr_n_u8_x(all, x, 4)), 8);
+}
+
+// MB (1 or 2) activation rows against one panel.
+template <bool kInt4, int MB>
+inline void panel_rows_sve(const uint8_t* panel, int64_t blocks, int64_t vl, const int8_t* aq, const float* as,
+                           int64_t a_k, float* out0, float* out1, svbool_t store) {
+    const svbool_t all8 = svptrue_b8();
+    const svbool_t all32 = svptrue_b32();
+    const int64_t block_bytes = vl + (kInt4 ? 4 * vl : 8 * vl);
+    svfloat32_t acc0 = svdup_n_f32(0.0f);
+    svfloat32_t acc1 = svdup_n_f32(0.0f);
+    for (int64_t b = 0; b < blocks; ++b) {
+        const uint8_t* blk = panel + b * block_bytes;
+        const svfloat32_t ws = svld1_f32(all32, reinterpret_cast<const float*>(blk));
+        const uint8_t* v = blk + vl;
+        svint8_t w0, w1, w2, w3, w4, w5, w6, w7;
+        if constexpr (kInt4) {
+            const svuint8_t x0 = svld1_u8(all8, v);
+            const svuint8_t x1 = svld1_u8(all8, v + vl);
+            const svuint8_t x2 = svld1_u8(all8, v + 2 * vl);
+            const svuint8_t x3 = svld1_u8(all8, v + 3 * vl);
+            w0 = low_nibbles(x0);
+            w1 = low_nibbles(x1);
+            w2 = low_nibbles(x2);
+            w3 = low_nibbles(x3);
+            w4 = high_nibbles(x0);
+            w5 = high_nibbles(x1);
+            w6 = high_nibbles(x2);
+            w7 = high_nibbles(x3);
+        } else {
+            const auto* q = reinterpret_cast<const int8_t*>(v);
+            w0 = svld1_s8(all8, q);
+            w1 = svld1_s8(all8, q + vl);
+            w2 = svld1_s8(all8, q + 2 * vl);
+            w3 = svld1_s8(all8, q + 3 * vl);
+            w4 = svld1_s8(all8, q + 4 * vl);
+            w5 = svld1_s8(all8, q + 5 * vl);
+            w6 = svld1_s8(all8, q + 6 * vl);
+            w7 = svld1_s8(all8, q + 7 * vl);
+        }
+        const svint32_t s0 = dot_block(w0, w1, w2, w3, w4, w5, w6, w7, aq + b * kBlock);
+        acc0 = svmla_f32_x(all32, acc0, svcvt_f32_s32_x(all32, s0), svmul_n_f32_x(all32, ws, as[b]));
+        if constexpr (MB == 2) {
+            const svint32_t s1 = dot_block(w0, w1, w2, w3, w4, w5, w6, w7, aq + a_k + b * kBlock);
+            acc1 = svmla_f32_x(all32, acc1, svcvt_f32_s32_x(all32, s1), svmul_n_f32_x(all32, ws, as[blocks + b]));
+        }
+    }
+    svst1_f32(store, out0, acc0);
+    if constexpr (MB == 2) {
+        svst1_f32(store, out1, acc1);
+    }
+}
+
+template <bool kInt4, int MB>
+void run(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+         int64_t panel_end) {
+    const int64_t vl = static_cast<int64_t>(svcntb());
+    const int64_t rows = static_cast<int64_t>(svcntw());
+    const int64_t blocks = w.k / kBlock;
+    const int64_t panel_bytes = blocks * (vl + (kInt4 ? 4 * vl : 8 * vl));
+    for (int64_t m0 = 0; m0 < a.rows; m0 += kRowTile) {
+        const int64_t m1 = min64(a.rows, m0 + kRowTile);
+        for (int64_t p = panel_begin; p < panel_end; ++p) {
+            const uint8_t* panel = w.data + p * panel_bytes;
+            const svbool_t store = svwhilelt_b32_s64(p * rows, w.n);
+            float* out = c + p * rows;
+            int64_t m = m0;
+            for (; m + MB <= m1; m += MB) {
+                panel_rows_sve<kInt4, MB>(panel, blocks, vl, a.q + m * a.k, a.scales + m * blocks, a.k,
+                                          out + m * ldc, out + (m + 1) * ldc, store);
+            }
+            for (; m < m1; ++m) {
+                panel_rows_sve<kInt4, 1>(panel, blocks, vl, a.q + m * a.k, a.scales + m * blocks, a.k,
+                                         out + m * ldc, nullptr, store);
+            }
+        }
+    }
+}
+
+} // namespace
+
+uint32_t panel_rows() { return static_cast<uint32_t>(svcntw()); }
+
+void gemm_i8(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run<false, 2>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemm_i4(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run<true, 2>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemv_i8(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run<false, 1>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+void gemv_i4(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    run<true, 1>(w, a, c, ldc, panel_begin, panel_end);
+}
+
+} // namespace neuroctx::kernels::sve
@@ -0,0 +1,167 @@
+#pragma once
+
+// Shared driver for the NEON kernels that consume the 4x4 panel layout
+// (4 weight rows, 4 K values interleaved). Included only by the per-ISA
+// translation units: everything here has internal linkage, so each of them
+// keeps its own copy compiled for its own -march.
+
+#include "variants.h"
+
+#include <arm_neon.h>
+
+namespace neuroctx::kernels {
+namespace {
+
+constexpr int64_t kNeonPanelRows = 4;
+
+inline int64_t min64(int64_t a, int64_t b) { return a < b ? a : b; }
+
+// Expands one K block into eight 16-byte vectors; vector j holds the
+// interleaved-layout bytes [16 j, 16 j + 16). The same mapping serves the
+// 4x8 layout, where vectors 2c and 2c + 1 are the row pairs of chunk c.
+template <bool kInt4>
+inline void load_block_weights(const uint8_t* values, int8x16_t w[8]) {
+    if constexpr (kInt4) {
+        const uint8x16_t mask = vdupq_n_u8(0x0f);
+        const int8x16_t eight = vdupq_n_s8(8);
+        for (int j = 0; j < 4; ++j) {
+            const uint8x16_t v = vld1q_u8(values + 16 * j);
+            w[j] = vsubq_s8(vreinterpretq_s8_u8(vandq_u8(v, mask)), eight);
+            w[j + 4] = vsubq_s8(vreinterpretq_s8_u8(vshrq_n_u8(v, 4)), eight);
+        }
+    } else {
+        const auto* q = reinterpret_cast<const int8_t*>(values);
+        for (int j = 0; j < 8; ++j) {
+            w[j] = vld1q_s8(q + 16 * j);
+        }
+    }
+}
+
+inline void store_panel(float32x4_t v, float* dst, int64_t valid) {
+    if (valid == kNeonPanelRows) {
+        vst1q_f32(dst, v);
+        return;
+    }
+    float tmp[4];
+    vst1q_f32(tmp, v);
+    for (int64_t i = 0; i < valid; ++i) {
+        dst[i] = tmp[i];
+    }
+}
+
+// `Dot::block(w, a)` returns the four per-row int32 dot products of one K
+// block against 32 activation bytes.
+template <bool kInt4, int MB, typename Dot>
+inline void panel_4x4(const uint8_t* panel, int64_t blocks, const int8_t* aq, const float* as, int64_t a_k,
+                      float32x4_t acc[MB]) {
+    constexpr int64_t kBlockBytes = kNeonPanelRows * (4 + (kInt4 ? kBlock / 2 : kBlock));
+    for (int mi = 0; mi < MB; ++mi) {
+        acc[mi] = vdupq_n_f32(0.0f);
+    }
+    for (int64_t b = 0; b < blocks; ++b) {
+        const uint8_t* blk = panel + b * kBlockBytes;
+        const float32x4_t ws = vld1q_f32(reinterpret_cast<const float*>(blk));
+        int8x16_t w[8];
+        load_block_weights<kInt4>(blk + kNeonPanelRows * 4, w);
+        for (int mi = 0; mi < MB; ++mi) {
+            const int32x4_t isum = Dot::block(w, aq + mi * a_k + b * kBlock);
+            acc[mi] = vfmaq_f32(acc[mi], vcvtq_f32_s32(isum), vmulq_n_f32(ws, as[mi * blocks + b]));
+        }
+    }
+}
+
+template <bool kInt4, int MB, typename Dot>
+void run_4x4(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc, int64_t panel_begin,
+             int64_t panel_end) {
+    const int64_t blocks = w.k / kBlock;
+    const int64_t panel_bytes = blocks * kNeonPanelRows * (4 + (kInt4 ? kBlock / 2 : kBlock));
+    for (int64_t m0 = 0; m0 < a.rows; m0 += kRowTile) {
+        const int64_t m1 = min64(a.rows, m0 + kRowTile);
+        for (int64_t p = panel_begin; p < panel_end; ++p) {
+            const uint8_t* panel = w.data + p * panel_bytes;
+            const int64_t valid = min64(kNeonPanelRows, w.n - p * kNeonPanelRows);
+            float* out = c + p * kNeonPanelRows;
+            int64_t m = m0;
+            for (; m + MB <= m1; m += MB) {
+                float32x4_t acc[MB];
+                panel_4x4<kInt4, MB, Dot>(panel, blocks, a.q + m * a.k, a.scales + m * blocks, a.k, acc);
+                for (int mi = 0; mi < MB; ++mi) {
+                    store_panel(acc[mi], out + (m + mi) * ldc, valid);
+                }
+            }
+            for (; m < m1; ++m) {
+                float32x4_t acc[1];
+                panel_4x4<kInt4, 1, Dot>(panel, blocks, a.q + m * a.k, a.scales + m * blocks, a.k, acc);
+                store_panel(acc[0], out + m * ldc, valid);
+            }
+        }
+    }
+}
+
+// Blocking of the fixed-K GEMV. The block loop is unrolled by the largest
+// of 8, 4, 2 that divides it and alternates two accumulators per panel, so
+// the FMA chain does not serialize consecutive blocks. Short rows run two
+// panels side by side to amortize the per-panel scale loads and stores and
+// give the core a second weight stream; long rows already expose enough
+// independent work and keep the register pressure of one.
+template <int64_t K>
+struct FixedGemvShape {
+    static constexpr int64_t kBlocks = K / kBlock;
+    static constexpr int kUnroll = kBlocks % 8 == 0 ? 8 : kBlocks % 4 == 0 ? 4 : 2;
+    static constexpr int kPanels = kBlocks >= 128 ? 1 : 2;
+    static_assert(K % (2 * kBlock) == 0, "fixed GEMV shapes must be an even number of K blocks");
+};
+
+template <bool kInt4, int64_t K, int P, typename Dot>
+inline void fixed_panels(const uint8_t* panel, const int8_t* aq, const float* as, float32x4_t out[P]) {
+    using Shape = FixedGemvShape<K>;
+    constexpr int64_t kBlockBytes = kNeonPanelRows * (4 + (kInt4 ? kBlock / 2 : kBlock));
+    constexpr int64_t kPanelBytes = Shape::kBlocks * kBlockBytes;
+    float32x4_t acc[P][2];
+    for (int pi = 0; pi < P; ++pi) {
+        acc[pi][0] = vdupq_n_f32(0.0f);
+        acc[pi][1] = vdupq_n_f32(0.0f);
+    }
+    for (int64_t b0 = 0; b0 < Shape::kBlocks; b0 += Shape::kUnroll) {
+#pragma GCC unroll 8
+        for (int u = 0; u < Shape::kUnroll; ++u) {
+            const int64_t b = b0 + u;
+            for (int pi = 0; pi < P; ++pi) {
+                const uint8_t* blk = panel + pi * kPanelBytes + b * kBlockBytes;
+                const float32x4_t ws = vld1q_f32(reinterpret_cast<const float*>(blk));
+                int8x16_t w[8];
+                load_block_weights<kInt4>(blk + kNeonPanelRows * 4, w);
+                const int32x4_t isum = Dot::block(w, aq + b * kBlock);
+                acc[pi][u & 1] = vfmaq_f32(acc[pi][u & 1], vcvtq_f32_s32(isum), vmulq_n_f32(ws, as[b]));
+            }
+        }
+    }
+    for (int pi = 0; pi < P; ++pi) {
+        out[pi] = vaddq_f32(acc[pi][0], acc[pi][1]);
+    }
+}
+
+template <bool kInt4, int64_t K, typename Dot>
+void run_fixed_gemv(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t panel_begin,
+                    int64_t panel_end) {
+    constexpr int P = FixedGemvShape<K>::kPanels;
+    constexpr int64_t kBlockBytes = kNeonPanelRows * (4 + (kInt4 ? kBlock / 2 : kBlock));
+    constexpr int64_t kPanelBytes = FixedGemvShape<K>::kBlocks * kBlockBytes;
+    int64_t p = panel_begin;
+    for (; p + P <= panel_end; p += P) {
+        float32x4_t acc[P];
+        fixed_panels<kInt4, K, P, Dot>(w.data + p * kPanelBytes, a.q, a.scales, acc);
+        for (int pi = 0; pi < P; ++pi) {
+            const int64_t row = (p + pi) * kNeonPanelRows;
+            store_panel(acc[pi], c + row, min64(kNeonPanelRows, w.n - row));
+        }
+    }
+    for (; p < panel_end; ++p) {
+        float32x4_t acc[1];
+        fixed_panels<kInt4, K, 1, Dot>(w.data + p * kPanelBytes, a.q, a.scales, acc);
+        store_panel(acc[0], c + p * kNeonPanelRows, min64(kNeonPanelRows, w.n - p * kNeonPanelRows));
+    }
+}
+
+} // namespace
+} // namespace neuroctx::kernels
@@ -0,0 +1,247 @@
+#include "neuroctx/common.h"
+#include "neuroctx/kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace neuroctx::kernels {
+
+namespace {
+
+void check_layout(int64_t k, const PackFormat& layout) {
+    if (k <= 0 || k % kBlock != 0) {
+        throw_error("kernels: K=" + std::to_string(k) + " is not a multiple of 32");
+    }
+    if (layout.panel_rows == 0 || layout.k_interleave == 0 || kBlock % layout.k_interleave != 0) {
+        throw_error("kernels: invalid pack layout");
+    }
+}
+
+// Writes one panel. `q`/`scales` hold `valid` source rows; the remaining
+// panel rows are zero-filled with a zero scale.
+void pack_panel(const int8_t* q, const float* scales, int64_t valid, int64_t k, WeightFormat format,
+                const PackFormat& layout, uint8_t* dst, std::vector<int8_t>& tmp) {
+    const int64_t rows = layout.panel_rows;
+    const int64_t ki = layout.k_interleave;
+    const int64_t blocks = k / kBlock;
+    const size_t block_bytes = packed_block_bytes(format, layout);
+    tmp.assign(static_cast<size_t>(kBlock * rows), 0);
+
+    for (int64_t b = 0; b < blocks; ++b) {
+        uint8_t* blk = dst + b * block_bytes;
+        for (int64_t r = 0; r < rows; ++r) {
+            const float s = r < valid ? scales[r * blocks + b] : 0.0f;
+            std::memcpy(blk + r * sizeof(float), &s, sizeof(float));
+        }
+        for (int64_t chunk = 0; chunk < kBlock / ki; ++chunk) {
+            for (int64_t r = 0; r < rows; ++r) {
+                int8_t* out = tmp.data() + (chunk * rows + r) * ki;
+                if (r < valid) {
+                    std::memcpy(out, q + r * k + b * kBlock + chunk * ki, static_cast<size_t>(ki));
+                } else {
+                    std::memset(out, 0, static_cast<size_t>(ki));
+                }
+            }
+        }
+        uint8_t* values = blk + rows * sizeof(float);
+        if (format == WeightFormat::kInt8) {
+            std::memcpy(values, tmp.data(), tmp.size());
+        } else {
+            const size_t half = tmp.size() / 2;
+            for (size_t t = 0; t < half; ++t) {
+                const auto lo = static_cast<uint8_t>(tmp[t] + 8);
+                const auto hi = static_cast<uint8_t>(tmp[t + half] + 8);
+                values[t] = static_cast<uint8_t>((lo & 0x0f) | (hi << 4));
+            }
+        }
+    }
+}
+
+void quantize_block(const float* x, WeightFormat format, int8_t* q, float* scale) {
+    float amax = 0.0f;
+    for (int64_t i = 0; i < kBlock; ++i) {
+        amax = std::max(amax, std::fabs(x[i]));
+    }
+    const float qmax = format == WeightFormat::kInt8 ? 127.0f : 7.0f;
+    const float qmin = format == WeightFormat::kInt8 ? -127.0f : -8.0f;
+    const float d = amax / qmax;
+    const float id = d != 0.0f ? 1.0f / d : 0.0f;
+    for (int64_t i = 0; i < kBlock; ++i) {
+        q[i] = static_cast<int8_t>(std::clamp(std::nearbyint(x[i] * id), qmin, qmax));
+    }
+    *scale = d;
+}
+
+// Decodes one source row into int8 values and per-block scales in the
+// requested format.
+void fetch_row(const TensorView& src, int64_t row, WeightFormat format, int8_t* q, float* scales,
+               float* tmp) {
+    const int64_t k = src.cols();
+    const int64_t blocks = k / kBlock;
+    const auto* base = static_cast<const uint8_t*>(src.data) + static_cast<size_t>(row) * src.row_bytes();
+
+    switch (src.dtype) {
+    case DType::kQ8_0:
+        if (format == WeightFormat::kInt8) {
+            for (int64_t b = 0; b < blocks; ++b) {
+                const uint8_t* blk = base + b * 34;
+                uint16_t d;
+                std::memcpy(&d, blk, sizeof(d));
+                scales[b] = fp16_to_fp32(d);
+                std::memcpy(q + b * kBlock, blk + 2, kBlock);
+            }
+            return;
+        }
+        for (int64_t b = 0; b < blocks; ++b) {
+            const uint8_t* blk = base + b * 34;
+            uint16_t d;
+            std::memcpy(&d, blk, sizeof(d));
+            const float scale = fp16_to_fp32(d);
+            for (int64_t i = 0; i < kBlock; ++i) {
+                tmp[b * kBlock + i] = scale * static_cast<int8_t>(blk[2 + i]);
+            }
+        }
+        break;
+    case DType::kQ4_0:
+        // Both target formats hold Q4_0 exactly: value = nibble - 8.
+        for (int64_t b = 0; b < blocks; ++b) {
+            const uint8_t* blk = base + b * 18;
+            uint16_t d;
+            std::memcpy(&d, blk, sizeof(d));
+            scales[b] = fp16_to_fp32(d);
+            for (int64_t i = 0; i < kBlock / 2; ++i) {
+                q[b * kBlock + i] = static_cast<int8_t>((blk[2 + i] & 0x0f) - 8);
+                q[b * kBlock + i + kBlock / 2] = static_cast<int8_t>((blk[2 + i] >> 4) - 8);
+            }
+        }
+        return;
+    case DType::kF32:
+        std::memcpy(tmp, base, static_cast<size_t>(k) * sizeof(float));
+        break;
+    case DType::kF16:
+        for (int64_t i = 0; i < k; ++i) {
+            uint16_t h;
+            std::memcpy(&h, base + 2 * i, sizeof(h));
+            tmp[i] = fp16_to_fp32(h);
+        }
+        break;
+    case DType::kBF16:
+        for (int64_t i = 0; i < k; ++i) {
+            uint16_t h;
+            std::memcpy(&h, base + 2 * i, sizeof(h));
+            tmp[i] = bf16_to_fp32(h);
+        }
+        break;
+    default:
+        throw_error(std::string("kernels: cannot pack ") + dtype_name(src.dtype) + " tensor '" +
+                    std::string(src.name) + "'");
+    }
+    for (int64_t b = 0; b < blocks; ++b) {
+        quantize_block(tmp + b * kBlock, format, q + b * kBlock, scales + b);
+    }
+}
+
+} // namespace
+
+const char* variant_name(KernelVariant variant) {
+    switch (variant) {
+    case KernelVariant::kReference: return "reference";
+    case KernelVariant::kNeon: return "neon";
+    case KernelVariant::kDotprod: return "dotprod";
+    case KernelVariant::kI8mm: return "i8mm";
+    case KernelVariant::kSve: return "sve";
+    }
+    return "unknown";
+}
+
+size_t packed_block_bytes(WeightFormat format, const PackFormat& layout) {
+    const size_t value_bytes = format == WeightFormat::kInt8 ? kBlock : kBlock / 2;
+    return layout.panel_rows * (sizeof(float) + value_bytes);
+}
+
+size_t packed_panel_bytes(int64_t k, WeightFormat format, const PackFormat& layout) {
+    return static_cast<size_t>(k / kBlock) * packed_block_bytes(format, layout);
+}
+
+size_t packed_bytes(int64_t n, int64_t k, WeightFormat format, const PackFormat& layout) {
+    const int64_t panels = (n + layout.panel_rows - 1) / layout.panel_rows;
+    return static_cast<size_t>(panels) * packed_panel_bytes(k, format, layout);
+}
+
+void quantize_rows(const float* x, int64_t rows, int64_t k, int8_t* q, float* scales) {
+    const int64_t blocks = k / kBlock;
+    for (int64_t r = 0; r < rows; ++r) {
+        for (int64_t b = 0; b < blocks; ++b) {
+            const float* src = x + r * k + b * kBlock;
+            float amax = 0.0f;
+            for (int64_t i = 0; i < kBlock; ++i) {
+                amax = std::max(amax, std::fabs(src[i]));
+            }
+            const float d = amax / 127.0f;
+            const float id = d != 0.0f ? 1.0f / d : 0.0f;
+            int8_t* dst = q + r * k + b * kBlock;
+            for (int64_t i = 0; i < kBlock; ++i) {
+                dst[i] = static_cast<int8_t>(std::nearbyint(src[i] * id));
+            }
+            scales[r * blocks + b] = d;
+        }
+    }
+}
+
+WeightFormat native_format(DType type) {
+    return type == DType::kQ4_0 ? WeightFormat::kInt4 : WeightFormat::kInt8;
+}
+
+bool can_pack(DType type) {
+    switch (type) {
+    case DType::kQ8_0:
+    case DType::kQ4_0:
+    case DType::kF32:
+    case DType::kF16:
+    case DType::kBF16: return true;
+    default: return false;
+    }
+}
+
+void pack_tensor(const TensorView& src, WeightFormat format, const PackFormat& layout, uint8_t* dst) {
+    const int64_t k = src.cols();
+    const int64_t n = src.rows();
+    check_layout(k, layout);
+    if (!can_pack(src.dtype)) {
+        throw_error(std::string("kernels: cannot pack ") + dtype_name(src.dtype) + " tensor '" +
+                    std::string(src.name) + "'");
+    }
+    const int64_t rows = layout.panel_rows;
+    const int64_t blocks = k / kBlock;
+    std::vector<int8_t> q(static_cast<size_t>(rows * k));
+    std::vector<float> scales(static_cast<size_t>(rows * blocks));
+    std::vector<float> tmp(static_cast<size_t>(k));
+    std::vector<int8_t> interleave;
+    const size_t panel_bytes = packed_panel_bytes(k, format, layout);
+
+    for (int64_t p = 0; p * rows < n; ++p) {
+        const int64_t valid = std::min(rows, n - p * rows);
+        for (int64_t r = 0; r < valid; ++r) {
+            fetch_row(src, p * rows + r, format, q.data() + r * k, scales.data() + r * blocks, tmp.data());
+        }
+        pack_panel(q.data(), scales.data(), valid, k, format, layout, dst + p * panel_bytes, interleave);
+    }
+}
+
+void pack_quantized(const int8_t* q, const float* scales, int64_t n, int64_t k, WeightFormat format,
+                    const PackFormat& layout, uint8_t* dst) {
+    check_layout(k, layout);
+    const int64_t rows = layout.panel_rows;
+    const int64_t blocks = k / kBlock;
+    const size_t panel_bytes = packed_panel_bytes(k, format, layout);
+    std::vector<int8_t> interleave;
+    for (int64_t p = 0; p * rows < n; ++p) {
+        const int64_t valid = std::min(rows, n - p * rows);
+        pack_panel(q + p * rows * k, scales + p * rows * blocks, valid, k, format, layout,
+                   dst + p * panel_bytes, interleave);
+    }
+}
+
+} // namespace neuroctx::kernels
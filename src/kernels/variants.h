@@ -0,0 +1,99 @@
+#pragma once
+
+// Entry points of the per-ISA kernel translation units. Each of those files
+// is compiled with its own -march flags and must only be called once the
+// dispatcher has confirmed CPU support. They deliberately avoid inline and
+// template code from shared headers: an out-of-line copy of such a function
+// emitted with SVE or i8mm instructions could be picked by the linker for
+// every other caller.
+
+#include "neuroctx/kernels.h"
+
+#include <cstdint>
+
+#define NEUROCTX_DECLARE_GEMM_VARIANT(ns)                                                         \
+    namespace ns {                                                                                \
+    void gemm_i8(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc,       \
+                 int64_t panel_begin, int64_t panel_end);                                     \
+    void gemm_i4(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc,       \
+                 int64_t panel_begin, int64_t panel_end);                                     \
+    void gemv_i8(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc,       \
+                 int64_t panel_begin, int64_t panel_end);                                     \
+    void gemv_i4(const PackedWeights& w, const QuantizedRows& a, float* c, int64_t ldc,       \
+                 int64_t panel_begin, int64_t panel_end);                                     \
+    }
+
+// Returns the fixed-shape GEMV for K = `k` in `format`, or nullptr.
+#define NEUROCTX_DECLARE_FIXED_GEMV_VARIANT(ns)                                                   \
+    namespace ns {                                                                                \
+    GemmFn fixed_gemv(int64_t k, WeightFormat format);                                            \
+    }
+
+#define NEUROCTX_DECLARE_ATTENTION_VARIANT(ns)                                                    \
+    namespace ns {                                                                                \
+    void attn_scores(const float* q, int64_t nq, const float* k, int64_t nk, int64_t d, float* s); \
+    void attn_accumulate(const float* s, int64_t nq, const float* v, int64_t nk, int64_t d,       \
+                         float* acc);                                                             \
+    void widen_f16(const uint16_t* src, int64_t n, float* dst);                                   \
+    }
+
+#define NEUROCTX_DECLARE_DOT_VARIANT(ns)                                                          \
+    namespace ns {                                                                                \
+    void dot_i8(const int8_t* q, const int8_t* rows, int64_t n, int64_t dim, int32_t* out);       \
+    }
+
+// K extents that get single-row kernels with K fixed at compile time: the
+// hidden and FFN sizes of the model families we ship (Qwen2.5 0.5B-3B,
+// Llama 3.2 1B/3B, TinyLlama, SmolLM2) plus 512 for draft models. Every
+// entry must be an even number of K blocks so the unrolled block loops
+// need no remainder.
+#define NEUROCTX_FIXED_GEMV_SHAPES(X)                                                             \
+    X(512) X(576) X(896) X(960) X(1536) X(2048) X(2560) X(3072) X(4864) X(5632) X(8192) X(8960) X(11008)
+
+// Body of a fixed_gemv() over the including file's function template
+// `fixed_gemv_kernel<bool kInt4, int64_t K>`.
+#define NEUROCTX_FIXED_GEMV_CASE(K)                                                               \
+    case K:                                                                                       \
+        return int4 ? fixed_gemv_kernel<true, K> : fixed_gemv_kernel<false, K>;
+#define NEUROCTX_FIXED_GEMV_SWITCH(k, format)                                                     \
+    do {                                                                                          \
+        const bool int4 = (format) == WeightFormat::kInt4;                                        \
+        switch (k) {                                                                              \
+            NEUROCTX_FIXED_GEMV_SHAPES(NEUROCTX_FIXED_GEMV_CASE)                                  \
+        default:                                                                                  \
+            return nullptr;                                                                       \
+        }                                                                                         \
+    } while (false)
+
+namespace neuroctx::kernels {
+
+NEUROCTX_DECLARE_GEMM_VARIANT(ref)
+NEUROCTX_DECLARE_FIXED_GEMV_VARIANT(ref)
+NEUROCTX_DECLARE_ATTENTION_VARIANT(ref)
+NEUROCTX_DECLARE_DOT_VARIANT(ref)
+
+#if defined(NEUROCTX_ARM_KERNELS)
+NEUROCTX_DECLARE_GEMM_VARIANT(neon)
+NEUROCTX_DECLARE_GEMM_VARIANT(dotprod)
+NEUROCTX_DECLARE_GEMM_VARIANT(i8mm)
+NEUROCTX_DECLARE_GEMM_VARIANT(sve)
+// SMMLA and SVE keep the generic GEMV: the former pairs the single row with
+// itself, the latter's panel height is only known at run time.
+NEUROCTX_DECLARE_FIXED_GEMV_VARIANT(neon)
+NEUROCTX_DECLARE_FIXED_GEMV_VARIANT(dotprod)
+// SDOT/SMMLA cores share the NEON attention tiles: they are plain f32 FMA.
+NEUROCTX_DECLARE_ATTENTION_VARIANT(neon)
+NEUROCTX_DECLARE_ATTENTION_VARIANT(sve)
+// SMMLA cores use the SDOT dot: one query against many rows has no second
+// matrix operand.
+NEUROCTX_DECLARE_DOT_VARIANT(neon)
+NEUROCTX_DECLARE_DOT_VARIANT(dotprod)
+NEUROCTX_DECLARE_DOT_VARIANT(sve)
+
+namespace sve {
+// Panel height of the SVE layout: one 32-bit lane per weight row.
+uint32_t panel_rows();
+} // namespace sve
+#endif
+
+} // namespace neuroctx::kernels
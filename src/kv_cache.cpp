@@ -0,0 +1,564 @@
+#include "neuroctx/kv_cache.h"
+
+#include "neuroctx/common.h"
+#include "neuroctx/hash.h"
+#include "neuroctx/kv_store.h"
+#include "neuroctx/tensor.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace neuroctx {
+
+namespace {
+
+size_t element_bytes(KvDType dtype) { return dtype == KvDType::kF16 ? 2 : 1; }
+
+bool has_scales(KvDType dtype) { return dtype != KvDType::kF16; }
+
+size_t values_bytes(KvDType dtype, int32_t page_tokens, int32_t head_dim) {
+    return align_up(size_t(page_tokens) * head_dim * element_bytes(dtype), alignof(float));
+}
+
+const float* row_scales(KvDType dtype, const uint8_t* block, int32_t page_tokens, int32_t head_dim) {
+    return reinterpret_cast<const float*>(block + values_bytes(dtype, page_tokens, head_dim));
+}
+
+const std::array<float, 256> kFp8Table = [] {
+    std::array<float, 256> table{};
+    for (int i = 0; i < 256; ++i) {
+        table[i] = fp8_e4m3_to_fp32(static_cast<uint8_t>(i));
+    }
+    return table;
+}();
+
+void store_row(KvDType dtype, uint8_t* block, int32_t page_tokens, int32_t head_dim, int64_t slot,
+               const float* src) {
+    if (dtype == KvDType::kF16) {
+        auto* dst = reinterpret_cast<uint16_t*>(block) + slot * head_dim;
+        for (int32_t d = 0; d < head_dim; ++d) {
+            dst[d] = fp32_to_fp16(src[d]);
+        }
+        return;
+    }
+    float amax = 0.0f;
+    for (int32_t d = 0; d < head_dim; ++d) {
+        amax = std::max(amax, std::fabs(src[d]));
+    }
+    const float limit = dtype == KvDType::kInt8 ? 127.0f : 448.0f;
+    const float scale = amax / limit;
+    const float inv = scale > 0.0f ? 1.0f / scale : 0.0f;
+    uint8_t* dst = block + slot * head_dim;
+    if (dtype == KvDType::kInt8) {
+        for (int32_t d = 0; d < head_dim; ++d) {
+            dst[d] = static_cast<uint8_t>(static_cast<int8_t>(std::lround(src[d] * inv)));
+        }
+    } else {
+        for (int32_t d = 0; d < head_dim; ++d) {
+            dst[d] = fp32_to_fp8_e4m3(src[d] * inv);
+        }
+    }
+    const_cast<float*>(row_scales(dtype, block, page_tokens, head_dim))[slot] = scale;
+}
+
+} // namespace
+
+const char* kv_dtype_name(KvDType dtype) {
+    switch (dtype) {
+    case KvDType::kF16: return "f16";
+    case KvDType::kInt8: return "int8";
+    case KvDType::kFp8: return "fp8";
+    }
+    return "unknown";
+}
+
+KvDType parse_kv_dtype(std::string_view name) {
+    for (const KvDType dtype : {KvDType::kF16, KvDType::kInt8, KvDType::kFp8}) {
+        if (name == kv_dtype_name(dtype)) {
+            return dtype;
+        }
+    }
+    throw_error("unknown KV cache type '" + std::string(name) + "' (expected f16, int8 or fp8)");
+}
+
+float kv_dot(KvDType dtype, const uint8_t* block, int32_t page_tokens, int32_t head_dim, int32_t slot,
+             const float* q) {
+    float sum = 0.0f;
+    switch (dtype) {
+    case KvDType::kF16: {
+        const auto* row = reinterpret_cast<const uint16_t*>(block) + int64_t(slot) * head_dim;
+        for (int32_t d = 0; d < head_dim; ++d) {
+            sum += q[d] * fp16_to_fp32(row[d]);
+        }
+        return sum;
+    }
+    case KvDType::kInt8: {
+        const auto* row = reinterpret_cast<const int8_t*>(block) + int64_t(slot) * head_dim;
+        for (int32_t d = 0; d < head_dim; ++d) {
+            sum += q[d] * static_cast<float>(row[d]);
+        }
+        break;
+    }
+    case KvDType::kFp8: {
+        const uint8_t* row = block + int64_t(slot) * head_dim;
+        for (int32_t d = 0; d < head_dim; ++d) {
+            sum += q[d] * kFp8Table[row[d]];
+        }
+        break;
+    }
+    }
+    return sum * row_scales(dtype, block, page_tokens, head_dim)[slot];
+}
+
+void kv_axpy(KvDType dtype, const uint8_t* block, int32_t page_tokens, int32_t head_dim, int32_t slot, float w,
+             float* acc) {
+    switch (dtype) {
+    case KvDType::kF16: {
+        const auto* row = reinterpret_cast<const uint16_t*>(block) + int64_t(slot) * head_dim;
+        for (int32_t d = 0; d < head_dim; ++d) {
+            acc[d] += w * fp16_to_fp32(row[d]);
+        }
+        return;
+    }
+    case KvDType::kInt8: {
+        const float ws = w * row_scales(dtype, block, page_tokens, head_dim)[slot];
+        const auto* row = reinterpret_cast<const int8_t*>(block) + int64_t(slot) * head_dim;
+        for (int32_t d = 0; d < head_dim; ++d) {
+            acc[d] += ws * static_cast<float>(row[d]);
+        }
+        return;
+    }
+    case KvDType::kFp8: {
+        const float ws = w * row_scales(dtype, block, page_tokens, head_dim)[slot];
+        const uint8_t* row = block + int64_t(slot) * head_dim;
+        for (int32_t d = 0; d < head_dim; ++d) {
+            acc[d] += ws * kFp8Table[row[d]];
+        }
+        return;
+    }
+    }
+}
+
+void kv_dequantize_rows(KvDType dtype, const uint8_t* block, int32_t page_tokens, int32_t head_dim, int32_t slot,
+                        int32_t n, float* out) {
+    const int64_t count = int64_t(n) * head_dim;
+    if (dtype == KvDType::kF16) {
+        const auto* src = reinterpret_cast<const uint16_t*>(block) + int64_t(slot) * head_dim;
+        for (int64_t i = 0; i < count; ++i) {
+            out[i] = fp16_to_fp32(src[i]);
+        }
+        return;
+    }
+    const float* scales = row_scales(dtype, block, page_tokens, head_dim) + slot;
+    const uint8_t* src = block + int64_t(slot) * head_dim;
+    for (int32_t r = 0; r < n; ++r) {
+        const float scale = scales[r];
+        const uint8_t* row = src + int64_t(r) * head_dim;
+        float* dst = out + int64_t(r) * head_dim;
+        if (dtype == KvDType::kInt8) {
+            for (int32_t d = 0; d < head_dim; ++d) {
+                dst[d] = scale * static_cast<float>(static_cast<int8_t>(row[d]));
+            }
+        } else {
+            for (int32_t d = 0; d < head_dim; ++d) {
+                dst[d] = scale * kFp8Table[row[d]];
+            }
+        }
+    }
+}
+
+KvCache::KvCache(const KvCacheConfig& config) : config_(config) {
+    if (config_.n_layers <= 0 || config_.n_kv_heads <= 0 || config_.head_dim <= 0 || config_.page_tokens <= 0) {
+        throw_error("kv cache: invalid geometry");
+    }
+    const size_t scales = has_scales(config_.dtype) ? size_t(config_.page_tokens) * sizeof(float) : 0;
+    head_block_bytes_ =
+        align_up(values_bytes(config_.dtype, config_.page_tokens, config_.head_dim) + scales, kCacheLine);
+    page_bytes_ = head_block_bytes_ * 2 * size_t(config_.n_kv_heads) * config_.n_layers;
+    const size_t pages = config_.budget_bytes / page_bytes_;
+    if (pages == 0 || pages > size_t(INT32_MAX)) {
+        throw_error("kv cache: budget of " + std::to_string(config_.budget_bytes) +
+                    " bytes does not fit whole pages of " + std::to_string(page_bytes_));
+    }
+    pages_total_ = static_cast<int32_t>(pages);
+    memory_.reserve(pages * page_bytes_);
+    pages_.resize(pages);
+    tokens_.resize(pages * size_t(config_.page_tokens));
+    free_.reserve(pages);
+    // Hand out low addresses first so the touched part stays compact.
+    for (int32_t p = pages_total_ - 1; p >= 0; --p) {
+        free_.push_back(p);
+    }
+    published_.reserve(pages);
+}
+
+KvCache::Sequence& KvCache::seq_ref(SeqId seq) {
+    if (seq < 0 || static_cast<size_t>(seq) >= seqs_.size() || !seqs_[seq].live) {
+        throw_error("kv cache: unknown sequence " + std::to_string(seq));
+    }
+    return seqs_[seq];
+}
+
+const KvCache::Sequence& KvCache::seq_ref(SeqId seq) const {
+    return const_cast<KvCache*>(this)->seq_ref(seq);
+}
+
+SeqId KvCache::create(uint64_t salt) {
+    SeqId id;
+    if (!free_seqs_.empty()) {
+        id = free_seqs_.back();
+        free_seqs_.pop_back();
+    } else {
+        id = static_cast<SeqId>(seqs_.size());
+        seqs_.emplace_back();
+    }
+    Sequence& s = seqs_[id];
+    s.live = true;
+    s.salt = salt;
+    s.chain = hash_mix(kFnvOffset, salt);
+    s.length = 0;
+    s.pages.clear();
+    return id;
+}
+
+SeqId KvCache::fork(SeqId src) {
+    const SeqId id = create(seq_ref(src).salt);
+    Sequence& from = seqs_[src];
+    Sequence& s = seqs_[id];
+    s.chain = from.chain;
+    s.length = from.length;
+    // Pages the source reserved past its length stay its own.
+    s.pages.assign(from.pages.begin(), from.pages.begin() + pages_for(from.length));
+    for (const int32_t page : s.pages) {
+        acquire(page);
+    }
+    return id;
+}
+
+void KvCache::release(SeqId seq) {
+    Sequence& s = seq_ref(seq);
+    for (const int32_t page : s.pages) {
+        unref(page);
+    }
+    s.pages.clear();
+    s.length = 0;
+    s.live = false;
+    free_seqs_.push_back(seq);
+}
+
+int64_t KvCache::pages_for(int64_t tokens) const { return (tokens + config_.page_tokens - 1) / config_.page_tokens; }
+
+int64_t KvCache::capacity(SeqId seq) const {
+    return static_cast<int64_t>(seq_ref(seq).pages.size()) * config_.page_tokens;
+}
+
+uint64_t KvCache::page_hash(uint64_t chain, const int32_t* tokens) const {
+    return hash_mix(chain, fnv1a64(tokens, size_t(config_.page_tokens) * sizeof(int32_t)));
+}
+
+int64_t KvCache::match_prefix(SeqId seq, std::span<const int32_t> tokens) {
+    Sequence& s = seq_ref(seq);
+    if (s.length != 0) {
+        throw_error("kv cache: prefix matching needs an empty sequence");
+    }
+    const size_t pt = config_.page_tokens;
+    const size_t max_pages = tokens.empty() ? 0 : (tokens.size() - 1) / pt;
+    for (size_t i = 0; i < max_pages; ++i) {
+        const int32_t* chunk = tokens.data() + i * pt;
+        const uint64_t h = page_hash(s.chain, chunk);
+        auto it = published_.find(h);
+        if (it != published_.end() && std::memcmp(page_tokens(it->second), chunk, pt * sizeof(int32_t)) == 0) {
+            acquire(it->second);
+            s.pages.push_back(it->second);
+        } else if (it == published_.end() && store_ != nullptr && store_->contains(h) &&
+                   !(free_.empty() && cached_ == 0)) {
+            const int32_t page = allocate_page();
+            if (!store_->load(h, {chunk, pt}, memory_.data() + size_t(page) * page_bytes_)) {
+                unref(page);
+                break;
+            }
+            std::memcpy(page_tokens(page), chunk, pt * sizeof(int32_t));
+            publish(page, h);
+            s.pages.push_back(page);
+            restored_tokens_ += static_cast<int64_t>(pt);
+        } else {
+            break;
+        }
+        s.chain = h;
+        s.length += static_cast<int64_t>(pt);
+    }
+    reused_tokens_ += s.length;
+    return s.length;
+}
+
+void KvCache::attach_store(KvPageStore* store) {
+    if (store != nullptr) {
+        const KvCacheConfig& l = store->layout();
+        if (l.n_layers != config_.n_layers || l.n_kv_heads != config_.n_kv_heads || l.head_dim != config_.head_dim ||
+            l.page_tokens != config_.page_tokens || l.dtype != config_.dtype || store->page_bytes() != page_bytes_) {
+            throw_error("kv cache: page store " + store->directory() + " has a different geometry");
+        }
+    }
+    if (store_ != nullptr && store != store_) {
+        for (int32_t page = 0; page < static_cast<int32_t>(pages_.size()); ++page) {
+            spill(page);
+        }
+    }
+    store_ = store;
+}
+
+void KvCache::spill(int32_t page) {
+    const Page& p = pages_[page];
+    if (store_ != nullptr && p.published && !store_->contains(p.hash)) {
+        store_->save(p.hash, {page_tokens(page), size_t(config_.page_tokens)},
+                     memory_.data() + size_t(page) * page_bytes_);
+        ++spilled_;
+    }
+}
+
+bool KvCache::reserve(SeqId seq, int64_t n) {
+    Sequence& s = seq_ref(seq);
+    const int64_t have = static_cast<int64_t>(s.pages.size());
+    const int64_t grow = std::max<int64_t>(0, pages_for(s.length + n) - have);
+    // Every page the next writes land in must be this sequence's alone: the
+    // partial last page, and pages past it that a fork still shares.
+    const int64_t first = s.length / config_.page_tokens;
+    int64_t unshare = 0;
+    for (int64_t i = first; n > 0 && i < have; ++i) {
+        unshare += pages_[s.pages[size_t(i)]].refs > 1 ? 1 : 0;
+    }
+    if (grow + unshare > static_cast<int64_t>(free_.size()) + cached_) {
+        return false;
+    }
+    for (int64_t i = first; unshare > 0 && i < have; ++i) {
+        const int32_t old = s.pages[size_t(i)];
+        if (pages_[old].refs <= 1) {
+            continue;
+        }
+        const int32_t copy = allocate_page();
+        if (i * config_.page_tokens < s.length) {
+            std::memcpy(memory_.data() + size_t(copy) * page_bytes_, memory_.data() + size_t(old) * page_bytes_,
+                        page_bytes_);
+            std::memcpy(page_tokens(copy), page_tokens(old), size_t(config_.page_tokens) * sizeof(int32_t));
+            ++copied_;
+        }
+        unref(old);
+        s.pages[size_t(i)] = copy;
+        --unshare;
+    }
+    for (int64_t i = 0; i < grow; ++i) {
+        s.pages.push_back(allocate_page());
+    }
+    return true;
+}
+
+int32_t KvCache::trim() {
+    const int32_t evicted = cached_;
+    while (lru_head_ >= 0) {
+        const int32_t page = lru_head_;
+        spill(page);
+        lru_remove(page);
+        unpublish(page);
+        free_.push_back(page);
+    }
+    evicted_ += evicted;
+    // Discard runs of adjacent free pages, then keep handing out low
+    // addresses first.
+    std::sort(free_.begin(), free_.end());
+    for (size_t i = 0; i < free_.size();) {
+        size_t j = i + 1;
+        while (j < free_.size() && free_[j] == free_[j - 1] + 1) {
+            ++j;
+        }
+        memory_.discard(size_t(free_[i]) * page_bytes_, (j - i) * page_bytes_);
+        i = j;
+    }
+    std::reverse(free_.begin(), free_.end());
+    return evicted;
+}
+
+uint8_t* KvCache::head_block(int32_t page, int32_t layer, int kind, int32_t head) const {
+    const size_t index = (size_t(layer) * 2 + kind) * config_.n_kv_heads + head;
+    return const_cast<uint8_t*>(memory_.data()) + size_t(page) * page_bytes_ + index * head_block_bytes_;
+}
+
+void KvCache::store(SeqId seq, int32_t layer, int64_t pos, int64_t n, const float* k, const float* v) {
+    const Sequence& s = seq_ref(seq);
+    if (pos < s.length || pos + n > static_cast<int64_t>(s.pages.size()) * config_.page_tokens) {
+        throw_error("kv cache: store outside the reserved range");
+    }
+    const int64_t width = int64_t(config_.n_kv_heads) * config_.head_dim;
+    for (int64_t t = 0; t < n; ++t) {
+        const int32_t page = s.pages[(pos + t) / config_.page_tokens];
+        const int64_t slot = (pos + t) % config_.page_tokens;
+        for (int kind = 0; kind < 2; ++kind) {
+            const float* src = (kind == 0 ? k : v) + t * width;
+            for (int32_t h = 0; h < config_.n_kv_heads; ++h) {
+                store_row(config_.dtype, head_block(page, layer, kind, h), config_.page_tokens, config_.head_dim,
+                          slot, src + h * config_.head_dim);
+            }
+        }
+    }
+}
+
+void KvCache::load(SeqId seq, int32_t layer, int64_t pos, int64_t n, float* k, float* v) const {
+    const Sequence& s = seq_ref(seq);
+    if (pos < 0 || pos + n > static_cast<int64_t>(s.pages.size()) * config_.page_tokens) {
+        throw_error("kv cache: load outside the sequence");
+    }
+    const int64_t width = int64_t(config_.n_kv_heads) * config_.head_dim;
+    for (int64_t t = 0; t < n; ++t) {
+        const int32_t page = s.pages[(pos + t) / config_.page_tokens];
+        const int64_t slot = (pos + t) % config_.page_tokens;
+        for (int kind = 0; kind < 2; ++kind) {
+            float* dst = (kind == 0 ? k : v) + t * width;
+            for (int32_t h = 0; h < config_.n_kv_heads; ++h) {
+                float* row = dst + h * config_.head_dim;
+                std::fill(row, row + config_.head_dim, 0.0f);
+                kv_axpy(config_.dtype, head_block(page, layer, kind, h), config_.page_tokens, config_.head_dim,
+                        static_cast<int32_t>(slot), 1.0f, row);
+            }
+        }
+    }
+}
+
+void KvCache::commit(SeqId seq, std::span<const int32_t> tokens) {
+    Sequence& s = seq_ref(seq);
+    if (s.length + static_cast<int64_t>(tokens.size()) > capacity(seq)) {
+        throw_error("kv cache: commit past the reserved range");
+    }
+    const int32_t pt = config_.page_tokens;
+    for (const int32_t token : tokens) {
+        const size_t index = static_cast<size_t>(s.length / pt);
+        const int32_t page = s.pages[index];
+        const int32_t slot = static_cast<int32_t>(s.length % pt);
+        page_tokens(page)[slot] = token;
+        ++s.length;
+        if (slot != pt - 1) {
+            continue;
+        }
+        const uint64_t h = page_hash(s.chain, page_tokens(page));
+        s.chain = h;
+        auto it = published_.find(h);
+        if (it == published_.end()) {
+            publish(page, h);
+        } else if (it->second != page && pages_[page].refs == 1 &&
+                   std::memcmp(page_tokens(it->second), page_tokens(page), size_t(pt) * sizeof(int32_t)) == 0) {
+            // Another sequence already published this prefix: share its copy.
+            const int32_t shared = it->second;
+            acquire(shared);
+            unref(page);
+            s.pages[index] = shared;
+        }
+    }
+}
+
+void KvCache::truncate(SeqId seq, int64_t length) {
+    Sequence& s = seq_ref(seq);
+    if (length < 0 || length > s.length) {
+        throw_error("kv cache: truncate past the end of the sequence");
+    }
+    const int32_t pt = config_.page_tokens;
+    const auto keep = static_cast<size_t>(pages_for(length));
+    while (s.pages.size() > keep) {
+        unref(s.pages.back());
+        s.pages.pop_back();
+    }
+    if (length % pt != 0 && pages_[s.pages.back()].refs == 1) {
+        unpublish(s.pages.back());
+    }
+    s.length = length;
+    s.chain = hash_mix(kFnvOffset, s.salt);
+    for (int64_t i = 0; i < length / pt; ++i) {
+        s.chain = page_hash(s.chain, page_tokens(s.pages[static_cast<size_t>(i)]));
+    }
+}
+
+int32_t KvCache::allocate_page() {
+    int32_t page;
+    if (!free_.empty()) {
+        page = free_.back();
+        free_.pop_back();
+    } else {
+        page = lru_head_;
+        spill(page);
+        lru_remove(page);
+        unpublish(page);
+        ++evicted_;
+    }
+    pages_[page].refs = 1;
+    return page;
+}
+
+void KvCache::acquire(int32_t page) {
+    if (pages_[page].refs++ == 0) {
+        lru_remove(page);
+    }
+}
+
+void KvCache::unref(int32_t page) {
+    if (--pages_[page].refs > 0) {
+        return;
+    }
+    if (pages_[page].published) {
+        lru_push(page);
+    } else {
+        free_.push_back(page);
+    }
+}
+
+void KvCache::lru_push(int32_t page) {
+    Page& p = pages_[page];
+    p.prev = lru_tail_;
+    p.next = -1;
+    if (lru_tail_ >= 0) {
+        pages_[lru_tail_].next = page;
+    } else {
+        lru_head_ = page;
+    }
+    lru_tail_ = page;
+    ++cached_;
+}
+
+void KvCache::lru_remove(int32_t page) {
+    Page& p = pages_[page];
+    (p.prev >= 0 ? pages_[p.prev].next : lru_head_) = p.next;
+    (p.next >= 0 ? pages_[p.next].prev : lru_tail_) = p.prev;
+    p.prev = p.next = -1;
+    --cached_;
+}
+
+void KvCache::publish(int32_t page, uint64_t hash) {
+    published_.emplace(hash, page);
+    pages_[page].published = true;
+    pages_[page].hash = hash;
+}
+
+void KvCache::unpublish(int32_t page) {
+    Page& p = pages_[page];
+    if (p.published) {
+        auto it = published_.find(p.hash);
+        if (it != published_.end() && it->second == page) {
+            published_.erase(it);
+        }
+        p.published = false;
+    }
+}
+
+KvCacheStats KvCache::stats() const {
+    KvCacheStats st;
+    st.pages_total = pages_total_;
+    st.pages_free = static_cast<int32_t>(free_.size());
+    st.pages_cached = cached_;
+    st.pages_used = pages_total_ - st.pages_free - cached_;
+    st.prefix_tokens_reused = reused_tokens_;
+    st.prefix_tokens_restored = restored_tokens_;
+    st.pages_evicted = evicted_;
+    st.pages_copied = copied_;
+    st.pages_spilled = spilled_;
+    return st;
+}
+
+} // namespace neuroctx
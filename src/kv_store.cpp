@@ -0,0 +1,209 @@
+#include "neuroctx/kv_store.h"
+
+#include "fd_io.h"
+#include "neuroctx/common.h"
+#include "neuroctx/hash.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace neuroctx {
+
+namespace {
+
+constexpr char kMagic[8] = {'N', 'C', 'T', 'X', 'K', 'V', 'P', '\0'};
+constexpr const char* kExtension = ".kvpage";
+
+struct PageHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;
+    int32_t n_layers;
+    int32_t n_kv_heads;
+    int32_t head_dim;
+    int32_t page_tokens;
+    uint64_t page_bytes;
+    uint64_t model_key;
+    uint64_t hash;
+    uint64_t checksum; // fnv1a64 over the tokens, then the page
+};
+
+static_assert(sizeof(PageHeader) == 64);
+
+uint64_t checksum(std::span<const int32_t> tokens, const uint8_t* page, size_t page_bytes) {
+    return fnv1a64(page, page_bytes, fnv1a64(tokens.data(), tokens.size_bytes()));
+}
+
+// "<16 hex digits>.kvpage"; false for anything else.
+bool parse_name(const std::string& name, uint64_t* key) {
+    const size_t ext = std::strlen(kExtension);
+    if (name.size() != 16 + ext || name.compare(16, ext, kExtension) != 0) {
+        return false;
+    }
+    uint64_t v = 0;
+    for (int i = 0; i < 16; ++i) {
+        const char c = name[size_t(i)];
+        const int digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (digit < 0) {
+            return false;
+        }
+        v = v << 4 | uint64_t(digit);
+    }
+    *key = v;
+    return true;
+}
+
+} // namespace
+
+KvPageStore KvPageStore::open(const std::string& dir, const KvCache& cache, uint64_t model_key,
+                              const KvStoreOptions& options) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        throw_error("create " + dir + ": " + ec.message());
+    }
+    KvPageStore store;
+    store.dir_ = dir;
+    store.layout_ = cache.config();
+    store.model_key_ = model_key;
+    store.options_ = options;
+    store.page_bytes_ = cache.page_bytes();
+
+    struct Found {
+        int64_t mtime_ns;
+        uint64_t key;
+        size_t bytes;
+    };
+    std::vector<Found> found;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+        const std::string name = entry.path().filename().string();
+        const std::string path = entry.path().string();
+        uint64_t key = 0;
+        struct stat st;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0) {
+            ::unlink(path.c_str()); // a write interrupted before its rename
+        } else if (parse_name(name, &key) && ::stat(path.c_str(), &st) == 0) {
+            found.push_back({int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec, key, size_t(st.st_size)});
+        }
+    }
+    if (ec) {
+        throw_error("list " + dir + ": " + ec.message());
+    }
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) { return a.mtime_ns < b.mtime_ns; });
+    for (const Found& f : found) {
+        Entry& e = store.index_[f.key];
+        e.bytes = f.bytes;
+        e.use = store.use_.insert(store.use_.end(), f.key);
+        store.stats_.bytes += int64_t(f.bytes);
+    }
+    store.stats_.pages = static_cast<int64_t>(store.index_.size());
+    while (store.stats_.bytes > int64_t(options.budget_bytes) && !store.use_.empty()) {
+        store.remove(store.use_.front());
+        ++store.stats_.evicted;
+    }
+    return store;
+}
+
+uint64_t KvPageStore::file_key(uint64_t hash) const { return hash_mix(model_key_, hash); }
+
+std::string KvPageStore::path_of(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx%s", static_cast<unsigned long long>(key), kExtension);
+    return dir_ + "/" + name;
+}
+
+void KvPageStore::remove(uint64_t key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return;
+    }
+    ::unlink(path_of(key).c_str());
+    stats_.bytes -= int64_t(it->second.bytes);
+    use_.erase(it->second.use);
+    index_.erase(it);
+    stats_.pages = static_cast<int64_t>(index_.size());
+}
+
+bool KvPageStore::load(uint64_t hash, std::span<const int32_t> tokens, uint8_t* page) {
+    const uint64_t key = file_key(hash);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return false;
+    }
+    FdGuard fd(::open(path_of(key).c_str(), O_RDONLY | O_CLOEXEC));
+    PageHeader h;
+    std::vector<int32_t> stored(tokens.size());
+    const bool ok =
+        fd.get() >= 0 && read_all(fd.get(), &h, sizeof(h), 0) && std::memcmp(h.magic, kMagic, sizeof(kMagic)) == 0 &&
+        h.version == kFormatVersion && h.dtype == static_cast<uint32_t>(layout_.dtype) &&
+        h.n_layers == layout_.n_layers && h.n_kv_heads == layout_.n_kv_heads && h.head_dim == layout_.head_dim &&
+        h.page_tokens == layout_.page_tokens && h.page_bytes == page_bytes_ && h.model_key == model_key_ &&
+        h.hash == hash && size_t(layout_.page_tokens) == tokens.size() &&
+        read_all(fd.get(), stored.data(), tokens.size_bytes(), sizeof(h)) &&
+        std::equal(stored.begin(), stored.end(), tokens.begin()) &&
+        read_all(fd.get(), page, page_bytes_, off_t(sizeof(h) + tokens.size_bytes())) &&
+        checksum(tokens, page, page_bytes_) == h.checksum;
+    if (!ok) {
+        remove(key);
+        ++stats_.misses;
+        return false;
+    }
+    // The modification time is the use order the next open() starts from.
+    futimens(fd.get(), nullptr);
+    use_.splice(use_.end(), use_, it->second.use);
+    ++stats_.hits;
+    return true;
+}
+
+void KvPageStore::save(uint64_t hash, std::span<const int32_t> tokens, const uint8_t* page) {
+    const uint64_t key = file_key(hash);
+    if (index_.count(key) != 0) {
+        return;
+    }
+    PageHeader h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kFormatVersion;
+    h.dtype = static_cast<uint32_t>(layout_.dtype);
+    h.n_layers = layout_.n_layers;
+    h.n_kv_heads = layout_.n_kv_heads;
+    h.head_dim = layout_.head_dim;
+    h.page_tokens = layout_.page_tokens;
+    h.page_bytes = page_bytes_;
+    h.model_key = model_key_;
+    h.hash = hash;
+    h.checksum = checksum(tokens, page, page_bytes_);
+
+    const std::string path = path_of(key);
+    const std::string tmp = path + ".tmp";
+    bool ok = false;
+    {
+        FdGuard fd(::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+        ok = fd.get() >= 0 && write_all(fd.get(), &h, sizeof(h)) &&
+             write_all(fd.get(), tokens.data(), tokens.size_bytes()) && write_all(fd.get(), page, page_bytes_);
+    }
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        ::unlink(tmp.c_str());
+        ++stats_.failures;
+        return;
+    }
+    const size_t bytes = sizeof(h) + tokens.size_bytes() + page_bytes_;
+    Entry& e = index_[key];
+    e.bytes = bytes;
+    e.use = use_.insert(use_.end(), key);
+    stats_.bytes += int64_t(bytes);
+    stats_.pages = static_cast<int64_t>(index_.size());
+    ++stats_.writes;
+    while (stats_.bytes > int64_t(options_.budget_bytes) && use_.size() > 1) {
+        remove(use_.front());
+        ++stats_.evicted;
+    }
+}
+
+} // namespace neuroctx
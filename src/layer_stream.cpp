@@ -0,0 +1,131 @@
+#include "neuroctx/layer_stream.h"
+
+#include "neuroctx/common.h"
+
+#include <algorithm>
+
+namespace neuroctx {
+
+namespace {
+
+// Pages touched between checks that the layer is still wanted.
+constexpr size_t kTouchBatch = 256;
+
+} // namespace
+
+LayerStreamer::LayerStreamer(const MappedFile& file, std::vector<std::vector<ByteRange>> layers,
+                             const LayerStreamOptions& options)
+    : file_(file), layers_(std::move(layers)), wanted_(layers_.size()) {
+    const auto n = static_cast<int32_t>(layers_.size());
+    window_ = std::clamp(options.window, 1, std::max(n, 1));
+    std::vector<size_t> bytes(layers_.size());
+    for (size_t l = 0; l < layers_.size(); ++l) {
+        for (const ByteRange& r : layers_[l]) {
+            bytes[l] += r.length;
+        }
+    }
+    for (int32_t l = 0; l < n; ++l) {
+        size_t sum = 0;
+        for (int32_t i = 0; i < window_; ++i) {
+            sum += bytes[static_cast<size_t>((l + i) % n)];
+        }
+        window_bytes_ = std::max(window_bytes_, sum);
+    }
+    for (int32_t l = 0; l < n; ++l) {
+        for (const ByteRange& r : layers_[static_cast<size_t>(l)]) {
+            file_.advise(r.offset, r.length, Advice::kDontNeed);
+        }
+    }
+    prefetcher_ = std::thread([this] { prefetch_main(); });
+}
+
+LayerStreamer::~LayerStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    wake_.notify_one();
+    prefetcher_.join();
+}
+
+void LayerStreamer::enter(int32_t layer) {
+    const auto n = static_cast<int32_t>(layers_.size());
+    if (layer == current_ || layer >= n || n == 0) {
+        return;
+    }
+    const int32_t previous = current_;
+    current_ = layer;
+    // The head and the embedding sit between the last layer and layer 0 of
+    // the next step.
+    const int32_t start = layer < 0 ? 0 : layer;
+    const int32_t span = layer < 0 ? window_ - 1 : window_;
+    if (previous >= 0 && (previous - start + n) % n >= span) {
+        evict(previous);
+    }
+    for (int32_t i = 0; i < span; ++i) {
+        request((start + i) % n);
+    }
+}
+
+void LayerStreamer::request(int32_t layer) {
+    if (wanted_[static_cast<size_t>(layer)].exchange(1, std::memory_order_relaxed) != 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(layer);
+    }
+    wake_.notify_one();
+}
+
+void LayerStreamer::evict(int32_t layer) {
+    wanted_[static_cast<size_t>(layer)].store(0, std::memory_order_relaxed);
+    for (const ByteRange& r : layers_[static_cast<size_t>(layer)]) {
+        file_.advise(r.offset, r.length, Advice::kDontNeed);
+    }
+    ++evicted_;
+}
+
+LayerStreamStats LayerStreamer::stats() const {
+    LayerStreamStats s;
+    s.prefetched = prefetched_.load(std::memory_order_relaxed);
+    s.evicted = evicted_;
+    s.window_bytes = window_bytes_;
+    return s;
+}
+
+void LayerStreamer::prefetch_main() {
+    const size_t page = page_size();
+    for (;;) {
+        int32_t layer;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&] { return quit_ || !queue_.empty(); });
+            if (quit_) {
+                return;
+            }
+            layer = queue_.front();
+            queue_.pop_front();
+        }
+        const std::atomic<uint8_t>& wanted = wanted_[static_cast<size_t>(layer)];
+        for (const ByteRange& r : layers_[static_cast<size_t>(layer)]) {
+            file_.advise(r.offset, r.length, Advice::kWillNeed);
+        }
+        // Readahead only queues the I/O; faulting the pages in here keeps
+        // both the wait and the page-table work off the compute thread.
+        uint8_t sink = 0;
+        for (const ByteRange& r : layers_[static_cast<size_t>(layer)]) {
+            size_t touched = 0;
+            for (size_t off = align_down(r.offset, page); off < r.offset + r.length; off += page, ++touched) {
+                if (touched % kTouchBatch == 0 && wanted.load(std::memory_order_relaxed) == 0) {
+                    break;
+                }
+                sink ^= *static_cast<const volatile uint8_t*>(file_.data() + off);
+            }
+        }
+        static_cast<void>(sink);
+        prefetched_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace neuroctx
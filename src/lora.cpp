@@ -0,0 +1,182 @@
+#include "neuroctx/lora.h"
+
+#include "neuroctx/common.h"
+#include "neuroctx/hash.h"
+#include "neuroctx/model.h"
+#include "neuroctx/thread_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+namespace neuroctx {
+
+namespace {
+
+constexpr std::string_view kSuffixA = ".lora_a";
+constexpr std::string_view kSuffixB = ".lora_b";
+constexpr int64_t kColumnsPerTask = 64;
+// Below this many multiply-adds a step's delta runs on the calling thread.
+constexpr int64_t kParallelWork = int64_t{1} << 16;
+
+bool by_base(const std::pair<const kernels::PackedWeights*, LoraDelta>& a, const kernels::PackedWeights* b) {
+    return std::less<const kernels::PackedWeights*>()(a.first, b);
+}
+
+} // namespace
+
+std::unique_ptr<LoraAdapter> LoraAdapter::open(const std::string& path, const Model& model, float scale) {
+    std::unique_ptr<LoraAdapter> adapter(new LoraAdapter());
+    adapter->file_ = ModelFile::open(path);
+    const ModelFile& f = adapter->file_;
+    if (f.meta_string("general.type", "adapter") != "adapter" || f.meta_string("adapter.type", "lora") != "lora") {
+        throw_error(path + ": not a LoRA adapter");
+    }
+    if (!f.architecture().empty() && f.architecture() != model.config().architecture) {
+        throw_error(path + ": adapter for '" + std::string(f.architecture()) + "', model is '" +
+                    model.config().architecture + "'");
+    }
+    const double alpha = f.meta_float("adapter.lora.alpha", 0.0);
+
+    // Factors in f32 are used where they are mapped; others are widened.
+    const auto factor = [&](const TensorView& t) -> const float* {
+        if (t.dtype == DType::kF32) {
+            return t.as<float>();
+        }
+        if (!can_dequantize(t.dtype)) {
+            throw_error(path + ": LoRA factor '" + std::string(t.name) + "' has unsupported type " +
+                        dtype_name(t.dtype));
+        }
+        std::vector<float>& out = adapter->widened_.emplace_back(static_cast<size_t>(t.elements()));
+        for (int64_t r = 0; r < t.rows(); ++r) {
+            dequantize_row(t, r, out.data() + r * t.cols());
+        }
+        return out.data();
+    };
+
+    for (const TensorView& a : f.tensors()) {
+        if (a.name.ends_with(kSuffixB)) {
+            const std::string_view base = a.name.substr(0, a.name.size() - kSuffixB.size());
+            if (f.find(std::string(base) + std::string(kSuffixA)) == nullptr) {
+                throw_error(path + ": '" + std::string(a.name) + "' has no matching lora_a");
+            }
+            continue;
+        }
+        if (!a.name.ends_with(kSuffixA)) {
+            continue;
+        }
+        const std::string base(a.name.substr(0, a.name.size() - kSuffixA.size()));
+        const TensorView& b = f.require(base + std::string(kSuffixB));
+        // Layer projections only: embeddings are not matmuls, and the
+        // output head runs on output rows the sequences do not map.
+        const PackedTensor* w = base.starts_with("blk.") ? model.packed().find(base) : nullptr;
+        if (w == nullptr) {
+            throw_error(path + ": cannot adapt '" + base + "'");
+        }
+        const int64_t rank = a.rows();
+        if (rank > model.options().max_lora_rank) {
+            throw_error(path + ": LoRA rank " + std::to_string(rank) + " of '" + base +
+                        "' exceeds the model's max_lora_rank (" + std::to_string(model.options().max_lora_rank) +
+                        ")");
+        }
+        if (a.n_dims != 2 || b.n_dims != 2 || a.cols() != w->weights.k || b.cols() != rank ||
+            b.rows() != w->weights.n) {
+            throw_error(path + ": LoRA factors of '" + base + "' do not match its shape");
+        }
+        LoraDelta d;
+        d.a = factor(a);
+        d.b = factor(b);
+        d.rank = rank;
+        d.k = w->weights.k;
+        d.n = w->weights.n;
+        d.scale = static_cast<float>(alpha > 0.0 ? alpha / static_cast<double>(rank) : 1.0) * scale;
+        adapter->deltas_.emplace_back(&w->weights, d);
+    }
+    if (adapter->deltas_.empty()) {
+        throw_error(path + ": adapter has no LoRA tensors");
+    }
+    std::sort(adapter->deltas_.begin(), adapter->deltas_.end(),
+              [](const auto& x, const auto& y) { return by_base(x, y.first); });
+
+    // Two trainings of the same rank and targets differ only in the factor
+    // data, which the content fingerprint samples. No mtime: a copied or
+    // re-downloaded adapter keeps its cached KV.
+    uint32_t scale_bits;
+    std::memcpy(&scale_bits, &scale, sizeof(scale_bits));
+    adapter->fingerprint_ = hash_mix(f.content_fingerprint(), scale_bits);
+    return adapter;
+}
+
+const LoraDelta* LoraAdapter::find(const kernels::PackedWeights* base) const {
+    const auto it = std::lower_bound(deltas_.begin(), deltas_.end(), base, by_base);
+    return it != deltas_.end() && it->first == base ? &it->second : nullptr;
+}
+
+size_t LoraAdapter::widened_bytes() const {
+    size_t bytes = 0;
+    for (const std::vector<float>& w : widened_) {
+        bytes += w.size() * sizeof(float);
+    }
+    return bytes;
+}
+
+uint64_t adapter_salt(uint64_t salt, const LoraAdapter* adapter) {
+    return adapter != nullptr ? hash_mix(salt, adapter->fingerprint()) : salt;
+}
+
+void lora_apply(const LoraDelta& d, const kernels::QuantizedRows& x, int64_t begin, int64_t end, float* c,
+                int64_t ldc, float* t, ThreadPool* pool) {
+    const int64_t rows = end - begin;
+    const int64_t rank = d.rank;
+    const int64_t blocks = x.k / kernels::kBlock;
+    const bool parallel = pool != nullptr && pool->size() > 1 && rows * rank * (x.k + d.n) >= kParallelWork;
+
+    // t = scale * x A^T: each row of A is read once for every input row.
+    const auto down = [&](int64_t j, int) {
+        const float* a = d.a + j * x.k;
+        for (int64_t r = begin; r < end; ++r) {
+            const int8_t* q = x.q + r * x.k;
+            const float* s = x.scales + r * blocks;
+            float acc = 0.0f;
+            for (int64_t b = 0; b < blocks; ++b) {
+                float part = 0.0f;
+                for (int64_t i = b * kernels::kBlock; i < (b + 1) * kernels::kBlock; ++i) {
+                    part += a[i] * static_cast<float>(q[i]);
+                }
+                acc += part * s[b];
+            }
+            t[(r - begin) * rank + j] = acc * d.scale;
+        }
+    };
+    // c += t B^T over one run of output columns.
+    const auto up = [&](int64_t task, int) {
+        const int64_t col_end = std::min(d.n, (task + 1) * kColumnsPerTask);
+        for (int64_t r = begin; r < end; ++r) {
+            const float* tr = t + (r - begin) * rank;
+            float* cr = c + r * ldc;
+            for (int64_t col = task * kColumnsPerTask; col < col_end; ++col) {
+                const float* b = d.b + col * rank;
+                float acc = 0.0f;
+                for (int64_t j = 0; j < rank; ++j) {
+                    acc += b[j] * tr[j];
+                }
+                cr[col] += acc;
+            }
+        }
+    };
+    const int64_t col_tasks = (d.n + kColumnsPerTask - 1) / kColumnsPerTask;
+    if (parallel) {
+        pool->parallel_for(rank, down);
+        pool->parallel_for(col_tasks, up);
+        return;
+    }
+    for (int64_t j = 0; j < rank; ++j) {
+        down(j, 0);
+    }
+    for (int64_t task = 0; task < col_tasks; ++task) {
+        up(task, 0);
+    }
+}
+
+} // namespace neuroctx
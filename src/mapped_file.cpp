@@ -0,0 +1,142 @@
+#include "neuroctx/mapped_file.h"
+
+#include "neuroctx/common.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace neuroctx {
+
+size_t page_size() {
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+namespace {
+
+int to_madvise(Advice advice) {
+    switch (advice) {
+    case Advice::kNormal: return MADV_NORMAL;
+    case Advice::kSequential: return MADV_SEQUENTIAL;
+    case Advice::kRandom: return MADV_RANDOM;
+    case Advice::kWillNeed: return MADV_WILLNEED;
+    case Advice::kDontNeed: return MADV_DONTNEED;
+    }
+    return MADV_NORMAL;
+}
+
+} // namespace
+
+MappedFile::~MappedFile() { reset(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        reset();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        device_ = other.device_;
+        inode_ = other.inode_;
+        mtime_ns_ = other.mtime_ns_;
+        path_ = std::move(other.path_);
+    }
+    return *this;
+}
+
+void MappedFile::reset() noexcept {
+    if (data_ != nullptr) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+MappedFile MappedFile::open(const std::string& path, Advice advice, bool populate) {
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw_errno("open " + path);
+    }
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        const int saved = errno;
+        ::close(fd);
+        errno = saved;
+        throw_errno("fstat " + path);
+    }
+
+    MappedFile file;
+    file.path_ = path;
+    file.size_ = static_cast<size_t>(st.st_size);
+    file.device_ = static_cast<uint64_t>(st.st_dev);
+    file.inode_ = static_cast<uint64_t>(st.st_ino);
+    file.mtime_ns_ = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+
+    if (file.size_ > 0) {
+        int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+        if (populate) {
+            flags |= MAP_POPULATE;
+        }
+#endif
+        void* addr = mmap(nullptr, file.size_, PROT_READ, flags, fd, 0);
+        if (addr == MAP_FAILED) {
+            const int saved = errno;
+            ::close(fd);
+            errno = saved;
+            throw_errno("mmap " + path);
+        }
+        file.data_ = static_cast<const uint8_t*>(addr);
+    }
+    // The mapping keeps the file referenced; the descriptor is not needed.
+    ::close(fd);
+
+    if (advice != Advice::kNormal) {
+        file.advise(advice);
+    }
+    return file;
+}
+
+bool MappedFile::advise(size_t offset, size_t length, Advice advice) const {
+    if (data_ == nullptr || offset >= size_ || length == 0) {
+        return true;
+    }
+    length = std::min(length, size_ - offset);
+    const size_t page = page_size();
+    size_t begin;
+    size_t end;
+    if (advice == Advice::kDontNeed) {
+        begin = align_up(offset, page);
+        end = align_down(offset + length, page);
+        // The final partial page of the file belongs to this range alone.
+        if (offset + length == size_) {
+            end = align_up(size_, page);
+        }
+        if (begin >= end) {
+            return true;
+        }
+    } else {
+        begin = align_down(offset, page);
+        end = align_up(offset + length, page);
+    }
+    auto* addr = const_cast<uint8_t*>(data_) + begin;
+    return madvise(addr, end - begin, to_madvise(advice)) == 0;
+}
+
+bool MappedFile::lock(size_t offset, size_t length) const {
+    if (data_ == nullptr || offset >= size_) {
+        return true;
+    }
+    length = std::min(length, size_ - offset);
+    const size_t page = page_size();
+    const size_t begin = align_down(offset, page);
+    const size_t end = align_up(offset + length, page);
+    return mlock(data_ + begin, end - begin) == 0;
+}
+
+} // namespace neuroctx
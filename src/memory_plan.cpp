@@ -0,0 +1,216 @@
+#include "neuroctx/memory_plan.h"
+
+#include "neuroctx/common.h"
+#include "neuroctx/mapped_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <linux/dma-heap.h>
+#include <numeric>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+namespace neuroctx {
+
+namespace {
+
+struct LiveRange {
+    int32_t first = -1; // node index of definition (-1: before the first node)
+    int32_t last = -1;  // node index of last use
+};
+
+std::vector<LiveRange> live_ranges(const Graph& graph) {
+    const auto& values = graph.values();
+    const auto& nodes = graph.nodes();
+    const auto end = static_cast<int32_t>(nodes.size());
+    std::vector<LiveRange> ranges(values.size());
+    for (size_t v = 0; v < values.size(); ++v) {
+        if (values[v].role == ValueRole::kInput) {
+            ranges[v] = {-1, -1};
+        }
+    }
+    for (int32_t n = 0; n < end; ++n) {
+        const Node& node = nodes[n];
+        for (int i = 0; i < node.outputs(); ++i) {
+            ranges[node.out[i]] = {n, n};
+        }
+        for (int i = 0; i < node.inputs(); ++i) {
+            ranges[node.in[i]].last = std::max(ranges[node.in[i]].last, n);
+        }
+    }
+    for (size_t v = 0; v < values.size(); ++v) {
+        if (values[v].role == ValueRole::kOutput) {
+            ranges[v].last = end;
+        }
+    }
+    return ranges;
+}
+
+bool overlaps(const LiveRange& a, const LiveRange& b) { return a.first <= b.last && b.first <= a.last; }
+
+// A dma-buf of `size` bytes from the system heap, or -1 when the kernel
+// has no dma-buf heaps (or denies access to them).
+int open_dma_heap(size_t size) {
+    const int heap = open("/dev/dma_heap/system", O_RDONLY | O_CLOEXEC);
+    if (heap < 0) {
+        return -1;
+    }
+    dma_heap_allocation_data alloc{};
+    alloc.len = size;
+    alloc.fd_flags = O_RDWR | O_CLOEXEC;
+    const int rc = ioctl(heap, DMA_HEAP_IOCTL_ALLOC, &alloc);
+    close(heap);
+    return rc == 0 ? static_cast<int>(alloc.fd) : -1;
+}
+
+void sync_dma_buf(int fd, bool dma_buf, uint64_t phase) {
+    if (!dma_buf) {
+        return;
+    }
+    struct dma_buf_sync sync{};
+    sync.flags = phase | DMA_BUF_SYNC_RW;
+    while (ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync) != 0 && errno == EINTR) {
+    }
+}
+
+} // namespace
+
+MemoryPlan plan_memory(const Graph& graph, const RowBounds& bounds) {
+    graph.validate();
+    const auto& values = graph.values();
+    MemoryPlan plan;
+    plan.bounds = bounds;
+    plan.offsets.assign(values.size(), 0);
+    plan.sizes.resize(values.size());
+    for (size_t v = 0; v < values.size(); ++v) {
+        const auto rows = static_cast<size_t>(bounds[values[v].rows]);
+        plan.sizes[v] = align_up(rows * value_row_bytes(values[v]), MemoryPlan::kAlignment);
+        plan.unshared_bytes += plan.sizes[v];
+    }
+
+    const std::vector<LiveRange> ranges = live_ranges(graph);
+    std::vector<size_t> order(values.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return plan.sizes[a] > plan.sizes[b]; });
+
+    std::vector<size_t> placed;
+    placed.reserve(values.size());
+    std::vector<std::pair<size_t, size_t>> busy; // [offset, end) of overlapping placed values
+    for (const size_t v : order) {
+        busy.clear();
+        for (const size_t p : placed) {
+            if (overlaps(ranges[v], ranges[p])) {
+                busy.emplace_back(plan.offsets[p], plan.offsets[p] + plan.sizes[p]);
+            }
+        }
+        std::sort(busy.begin(), busy.end());
+        // Best fit: the smallest gap between busy intervals that holds v.
+        size_t best = SIZE_MAX;
+        size_t best_gap = SIZE_MAX;
+        size_t cursor = 0;
+        for (const auto& [begin, end] : busy) {
+            if (begin > cursor && begin - cursor >= plan.sizes[v] && begin - cursor < best_gap) {
+                best = cursor;
+                best_gap = begin - cursor;
+            }
+            cursor = std::max(cursor, end);
+        }
+        plan.offsets[v] = best != SIZE_MAX ? best : cursor;
+        plan.arena_bytes = std::max(plan.arena_bytes, plan.offsets[v] + plan.sizes[v]);
+        placed.push_back(v);
+    }
+    return plan;
+}
+
+Arena::~Arena() { free_buffer(); }
+
+Arena::Arena(Arena&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)), capacity_(std::exchange(other.capacity_, 0)),
+      memory_(other.memory_), fd_(std::exchange(other.fd_, -1)), dma_buf_(std::exchange(other.dma_buf_, false)) {}
+
+Arena& Arena::operator=(Arena&& other) noexcept {
+    if (this != &other) {
+        free_buffer();
+        data_ = std::exchange(other.data_, nullptr);
+        capacity_ = std::exchange(other.capacity_, 0);
+        memory_ = other.memory_;
+        fd_ = std::exchange(other.fd_, -1);
+        dma_buf_ = std::exchange(other.dma_buf_, false);
+    }
+    return *this;
+}
+
+void Arena::reserve(size_t bytes) {
+    if (bytes <= capacity_) {
+        return;
+    }
+    free_buffer();
+    const size_t size = align_up(bytes, page_size());
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (memory_ == ArenaMemory::kShared) {
+        fd_ = open_dma_heap(size);
+        dma_buf_ = fd_ >= 0;
+        if (fd_ < 0) {
+            fd_ = static_cast<int>(memfd_create("neuroctx-arena", MFD_CLOEXEC));
+            if (fd_ < 0 || ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+                const int err = errno;
+                free_buffer();
+                errno = err;
+                throw_errno("arena: shared buffer of " + std::to_string(size) + " bytes");
+            }
+        }
+        flags = MAP_SHARED;
+    }
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, fd_, 0);
+    if (addr == MAP_FAILED) {
+        const int err = errno;
+        free_buffer();
+        errno = err;
+        throw_errno("arena: mmap " + std::to_string(size) + " bytes");
+    }
+    data_ = static_cast<uint8_t*>(addr);
+    capacity_ = size;
+}
+
+void Arena::discard() {
+    if (data_ == nullptr || dma_buf_) {
+        return;
+    }
+    // Shared memfd pages live in the page cache; only MADV_REMOVE frees them.
+    madvise(data_, capacity_, fd_ >= 0 ? MADV_REMOVE : MADV_DONTNEED);
+}
+
+void Arena::discard(size_t offset, size_t bytes) {
+    if (data_ == nullptr || dma_buf_ || offset >= capacity_) {
+        return;
+    }
+    const size_t page = page_size();
+    const size_t begin = align_up(offset, page);
+    const size_t end = std::min(offset + bytes, capacity_) / page * page;
+    if (begin < end) {
+        madvise(data_ + begin, end - begin, fd_ >= 0 ? MADV_REMOVE : MADV_DONTNEED);
+    }
+}
+
+void Arena::begin_cpu_access() const { sync_dma_buf(fd_, dma_buf_, DMA_BUF_SYNC_START); }
+
+void Arena::end_cpu_access() const { sync_dma_buf(fd_, dma_buf_, DMA_BUF_SYNC_END); }
+
+void Arena::free_buffer() noexcept {
+    if (data_ != nullptr) {
+        munmap(data_, capacity_);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    data_ = nullptr;
+    capacity_ = 0;
+    fd_ = -1;
+    dma_buf_ = false;
+}
+
+} // namespace neuroctx
@@ -0,0 +1,132 @@
+#include "neuroctx/memory_pressure.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace neuroctx {
+
+namespace {
+
+// onTrimMemory() levels (android.content.ComponentCallbacks2).
+constexpr int kTrimRunningModerate = 5;
+constexpr int kTrimRunningCritical = 15;
+constexpr int kTrimModerate = 60;
+
+// The "total=" field of the "some" or "full" line of a PSI file.
+std::optional<int64_t> psi_total(const std::string& path, const std::string& kind) {
+    std::ifstream f(path);
+    std::string line;
+    while (std::getline(f, line)) {
+        std::istringstream in(line);
+        std::string word;
+        in >> word;
+        if (word != kind) {
+            continue;
+        }
+        while (in >> word) {
+            if (word.rfind("total=", 0) == 0) {
+                return std::strtoll(word.c_str() + 6, nullptr, 10);
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+double stall_share(const std::optional<int64_t>& now, const std::optional<int64_t>& before, double seconds) {
+    if (!now || !before || seconds <= 0.0) {
+        return 0.0;
+    }
+    return static_cast<double>(std::max<int64_t>(*now - *before, 0)) / (seconds * 1e6);
+}
+
+} // namespace
+
+const char* memory_pressure_name(MemoryPressure level) {
+    switch (level) {
+    case MemoryPressure::kNone: return "none";
+    case MemoryPressure::kModerate: return "moderate";
+    case MemoryPressure::kCritical: return "critical";
+    }
+    return "unknown";
+}
+
+MemoryPressure memory_pressure_from_trim_level(int level) {
+    if (level >= kTrimModerate || level == kTrimRunningCritical) {
+        return MemoryPressure::kCritical;
+    }
+    return level >= kTrimRunningModerate ? MemoryPressure::kModerate : MemoryPressure::kNone;
+}
+
+MemorySensors::MemorySensors(const std::string& proc) : proc_(proc) {
+    psi_ = psi_total(proc_ + "/pressure/memory", "some").has_value();
+}
+
+MemoryReading MemorySensors::read() const {
+    MemoryReading r;
+    if (psi_) {
+        const std::string path = proc_ + "/pressure/memory";
+        r.some_stall_us = psi_total(path, "some");
+        r.full_stall_us = psi_total(path, "full");
+    }
+    std::ifstream f(proc_ + "/meminfo");
+    std::string key;
+    int64_t kib = 0;
+    std::string unit;
+    while (f >> key >> kib) {
+        std::getline(f, unit);
+        if (key == "MemTotal:") {
+            r.total_bytes = kib * 1024;
+        } else if (key == "MemAvailable:") {
+            r.available_bytes = kib * 1024;
+        }
+    }
+    return r;
+}
+
+MemoryPressure MemoryPressureMonitor::classify(const MemoryReading& reading, Clock::time_point now) const {
+    MemoryPressure level = MemoryPressure::kNone;
+    if (reading.available_bytes && reading.total_bytes && *reading.total_bytes > 0) {
+        const double share = static_cast<double>(*reading.available_bytes) / static_cast<double>(*reading.total_bytes);
+        if (share < options_.critical_available) {
+            level = MemoryPressure::kCritical;
+        } else if (share < options_.moderate_available) {
+            level = MemoryPressure::kModerate;
+        }
+    }
+    if (started_) {
+        const double seconds = std::chrono::duration<double>(now - last_reading_).count();
+        if (stall_share(reading.full_stall_us, last_.full_stall_us, seconds) >= options_.critical_full_stall) {
+            level = MemoryPressure::kCritical;
+        } else if (stall_share(reading.some_stall_us, last_.some_stall_us, seconds) >= options_.moderate_some_stall) {
+            level = std::max(level, MemoryPressure::kModerate);
+        }
+    }
+    return level;
+}
+
+MemoryPressure MemoryPressureMonitor::observe(MemoryPressure seen, Clock::time_point now) {
+    if (seen >= level_) {
+        level_ = seen;
+        last_seen_ = now;
+    } else if (now - last_seen_ >= options_.calm) {
+        level_ = static_cast<MemoryPressure>(static_cast<uint8_t>(level_) - 1);
+        last_seen_ = now;
+    }
+    return level_;
+}
+
+MemoryPressure MemoryPressureMonitor::update(const MemoryReading& reading, Clock::time_point now) {
+    const MemoryPressure seen = classify(reading, now);
+    last_ = reading;
+    last_reading_ = now;
+    started_ = true;
+    return observe(seen, now);
+}
+
+MemoryPressure MemoryPressureMonitor::hint(MemoryPressure level, Clock::time_point now) {
+    return level >= level_ ? observe(level, now) : level_;
+}
+
+} // namespace neuroctx
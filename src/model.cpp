@@ -0,0 +1,453 @@
+#include "neuroctx/model.h"
+
+#include "neuroctx/attention.h"
+#include "neuroctx/common.h"
+#include "neuroctx/fusion.h"
+#include "neuroctx/hash.h"
+#include "neuroctx/partition.h"
+#include "neuroctx/snapshot.h"
+#include "neuroctx/thread_pool.h"
+#include "neuroctx/tuning.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <unordered_map>
+
+namespace neuroctx {
+
+namespace {
+
+int64_t require_int(const ModelFile& file, const std::string& key) {
+    const int64_t value = file.meta_int(key, -1);
+    if (value <= 0) {
+        throw_error(file.path() + ": missing or invalid metadata '" + key + "'");
+    }
+    return value;
+}
+
+// One snapshot per model, kernel set and plan options, so processes
+// loading the same model differently do not overwrite each other's.
+std::string snapshot_path(const ModelFile& model, const kernels::KernelSet& ks, const ModelOptions& options,
+                          const std::string& cache_dir) {
+    return (std::filesystem::path(cache_dir) /
+            (std::filesystem::path(model.path()).filename().string() + "." + ks.name + "-t" +
+             std::to_string(options.max_batch_tokens) + "o" + std::to_string(options.max_outputs) +
+             (options.fuse ? "" : "-unfused") + ".nctxsnap"))
+        .string();
+}
+
+} // namespace
+
+ModelConfig ModelConfig::from_gguf(const ModelFile& file) {
+    ModelConfig c;
+    c.architecture = std::string(file.architecture());
+    if (c.architecture == "llama" || c.architecture == "mistral") {
+        c.rope_mode = RopeMode::kNorm;
+    } else if (c.architecture == "qwen2") {
+        c.rope_mode = RopeMode::kNeox;
+    } else {
+        throw_error(file.path() + ": unsupported architecture '" + c.architecture + "'");
+    }
+    const std::string& a = c.architecture;
+    c.n_embd = require_int(file, a + ".embedding_length");
+    c.n_layer = require_int(file, a + ".block_count");
+    c.n_head = require_int(file, a + ".attention.head_count");
+    c.n_head_kv = file.meta_int(a + ".attention.head_count_kv", c.n_head);
+    c.head_dim = file.meta_int(a + ".attention.key_length", c.n_embd / c.n_head);
+    c.n_ff = require_int(file, a + ".feed_forward_length");
+    c.n_ctx = file.meta_int(a + ".context_length", 2048);
+    c.rms_eps = static_cast<float>(file.meta_float(a + ".attention.layer_norm_rms_epsilon", 1e-5));
+    c.rope_base = static_cast<float>(file.meta_float(a + ".rope.freq_base", 10000.0));
+    c.n_vocab = file.require("token_embd.weight").rows();
+    if (c.n_head_kv <= 0 || c.n_head % c.n_head_kv != 0 || c.head_dim <= 0 || c.head_dim > kMaxHeadDim) {
+        throw_error(file.path() + ": unsupported attention layout");
+    }
+    return c;
+}
+
+std::unique_ptr<Model> Model::load(const std::string& path, const ModelOptions& options) {
+    std::unique_ptr<Model> model(new Model());
+    model->options_ = options;
+    model->kernels_ = options.kernels != nullptr ? options.kernels : &kernels::active();
+    model->file_ = ModelFile::open(path);
+    model->config_ = ModelConfig::from_gguf(model->file_);
+    const std::string cache_dir = options.cache_dir.empty() ? default_cache_dir() : options.cache_dir;
+    model->packed_ = PackedModel::open_or_build(model->file_, *model->kernels_, cache_dir);
+    RowBounds bounds;
+    bounds[RowDim::kTokens] = options.max_batch_tokens;
+    bounds[RowDim::kOutputs] = options.max_outputs;
+    const std::string snapshot =
+        options.snapshot ? snapshot_path(model->file_, *model->kernels_, options, cache_dir) : std::string();
+    if (snapshot.empty() || !model->restore_snapshot(snapshot)) {
+        model->build_graph();
+        if (options.fuse) {
+            fuse_graph(model->graph_);
+            model->tokens_ = model->graph_.find_value("tokens");
+            model->positions_ = model->graph_.find_value("positions");
+            model->output_rows_ = model->graph_.find_value("output_rows");
+            model->hidden_ = model->graph_.find_value("last");
+            model->logits_ = model->graph_.find_value("logits");
+        }
+        model->plan_ = plan_memory(model->graph_, bounds);
+        if (!snapshot.empty()) {
+            model->save_snapshot(snapshot);
+        }
+    }
+    if (!options.backends.empty()) {
+        model->arena_ = Arena(ArenaMemory::kShared);
+    }
+    model->executor_ = std::make_unique<Executor>(model->graph_, model->plan_, model->arena_);
+    model->executor_->reserve_lora(options.max_batch_tokens, options.max_lora_rank);
+    if (!options.backends.empty()) {
+        model->offload(bounds);
+    }
+    if (options.stream_layers > 0) {
+        model->stream(options.stream_layers);
+    }
+    return model;
+}
+
+const float* Model::norm_weight(const std::string& name) {
+    const TensorView& t = file_.require(name);
+    if (t.dtype == DType::kF32) {
+        norm_names_.emplace_back(t.as<float>(), name);
+        return t.as<float>();
+    }
+    std::vector<float>& out = converted_.emplace_back(static_cast<size_t>(t.elements()));
+    dequantize_row(t, 0, out.data());
+    norm_names_.emplace_back(out.data(), name);
+    return out.data();
+}
+
+SnapshotKey Model::snapshot_key() const {
+    const MappedFile& m = file_.mapping();
+    const std::string device = tuning_device();
+    SnapshotKey key;
+    key.source_size = m.size();
+    key.source_mtime_ns = static_cast<uint64_t>(m.mtime_ns());
+    key.source_fingerprint = fnv1a64(m.data(), std::min(file_.data_offset(), m.size()));
+    key.device = fnv1a64(device.data(), device.size());
+    key.variant = static_cast<uint32_t>(kernels_->variant);
+    key.fuse = options_.fuse ? 1 : 0;
+    key.max_batch_tokens = options_.max_batch_tokens;
+    key.max_outputs = options_.max_outputs;
+    return key;
+}
+
+// Node weights are stored as tensor names and looked up again here: packed
+// weights for matmuls, the GGUF tensor for embeddings, norm_weight() for
+// float vectors. Any mismatch falls back to building the graph.
+bool Model::restore_snapshot(const std::string& path) {
+    std::optional<StartupSnapshot> s;
+    try {
+        s = read_snapshot(path, snapshot_key());
+    } catch (const Error&) {
+        return false;
+    }
+    if (!s) {
+        return false;
+    }
+    try {
+        std::vector<Node>& nodes = s->graph.nodes();
+        for (size_t n = 0; n < nodes.size(); ++n) {
+            Node& node = nodes[n];
+            const std::string& weight = s->weights[n][0];
+            const std::string& aux = s->weights[n][1];
+            switch (node.op) {
+            case OpType::kMatMul:
+            case OpType::kMatMulRope:
+                node.weight = &packed_.require(weight);
+                node.aux = aux.empty() ? nullptr : norm_weight(aux);
+                continue;
+            case OpType::kEmbed: node.weight = &file_.require(weight); break;
+            case OpType::kRmsNorm:
+            case OpType::kAddRmsNorm:
+            case OpType::kBias: node.weight = weight.empty() ? nullptr : norm_weight(weight); break;
+            default:
+                if (!weight.empty()) {
+                    throw_error("snapshot: unexpected weight for " + node.label);
+                }
+                break;
+            }
+            if (!aux.empty()) {
+                throw_error("snapshot: unexpected aux weight for " + node.label);
+            }
+        }
+    } catch (const Error&) {
+        converted_.clear();
+        norm_names_.clear();
+        return false;
+    }
+    const Graph& g = s->graph;
+    const std::array<int32_t, 5> ids = {g.find_value("tokens"), g.find_value("positions"),
+                                        g.find_value("output_rows"), g.find_value("last"), g.find_value("logits")};
+    if (*std::min_element(ids.begin(), ids.end()) < 0) {
+        converted_.clear();
+        norm_names_.clear();
+        return false;
+    }
+    tokens_ = ids[0];
+    positions_ = ids[1];
+    output_rows_ = ids[2];
+    hidden_ = ids[3];
+    logits_ = ids[4];
+    graph_ = std::move(s->graph);
+    plan_ = std::move(s->plan);
+    from_snapshot_ = true;
+    return true;
+}
+
+// Best effort: a cache directory that cannot be written only costs the
+// next load the planning time.
+void Model::save_snapshot(const std::string& path) const {
+    std::unordered_map<const void*, std::string_view> names;
+    for (const PackedTensor& t : packed_.tensors()) {
+        names.emplace(&t.weights, t.name);
+    }
+    for (const TensorView& t : file_.tensors()) {
+        names.emplace(&t, t.name);
+    }
+    for (const auto& [data, name] : norm_names_) {
+        names.emplace(data, name);
+    }
+    StartupSnapshot s;
+    s.weights.reserve(graph_.nodes().size());
+    for (const Node& node : graph_.nodes()) {
+        std::array<std::string, 2>& w = s.weights.emplace_back();
+        for (int i = 0; i < 2; ++i) {
+            const void* p = i == 0 ? node.weight : node.aux;
+            if (p == nullptr) {
+                continue;
+            }
+            const auto it = names.find(p);
+            if (it == names.end()) {
+                return;
+            }
+            w[static_cast<size_t>(i)] = std::string(it->second);
+        }
+    }
+    s.graph = graph_;
+    s.plan = plan_;
+    try {
+        write_snapshot(path, snapshot_key(), s);
+    } catch (const Error&) {
+    }
+}
+
+void Model::offload(const RowBounds& bounds) {
+    std::vector<DeviceProfile> devices = {cpu_profile(*kernels_, read_cpu_topology().cpu_count())};
+    for (Backend* backend : options_.backends) {
+        devices.push_back(backend->profile());
+    }
+    RowBounds decode;
+    decode[RowDim::kTokens] = 1;
+    decode[RowDim::kOutputs] = 1;
+    const Placement decode_placement = place_graph(graph_, decode, devices);
+    const Placement prefill_placement = place_graph(graph_, bounds, devices);
+    for (size_t b = 0; b < options_.backends.size(); ++b) {
+        std::vector<int32_t> nodes;
+        for (size_t n = 0; n < graph_.nodes().size(); ++n) {
+            if (static_cast<size_t>(decode_placement.device[n]) == b + 1 ||
+                static_cast<size_t>(prefill_placement.device[n]) == b + 1) {
+                nodes.push_back(static_cast<int32_t>(n));
+            }
+        }
+        options_.backends[b]->prepare(graph_, plan_, arena_, nodes);
+    }
+    executor_->set_offload(options_.backends, decode_placement, prefill_placement);
+}
+
+void Model::stream(int32_t window) {
+    // Packed weights of blk.<l>.*, merged into runs of adjacent bytes.
+    std::vector<std::vector<ByteRange>> layers(static_cast<size_t>(config_.n_layer));
+    for (const PackedTensor& t : packed_.tensors()) {
+        if (!t.name.starts_with("blk.")) {
+            continue;
+        }
+        const std::string_view rest = t.name.substr(4);
+        int64_t layer = -1;
+        const auto [end, ec] = std::from_chars(rest.data(), rest.data() + rest.size(), layer);
+        if (ec != std::errc() || end == rest.data() + rest.size() || *end != '.' || layer < 0 ||
+            layer >= config_.n_layer) {
+            continue;
+        }
+        layers[static_cast<size_t>(layer)].push_back({t.offset, t.nbytes});
+    }
+    for (std::vector<ByteRange>& ranges : layers) {
+        std::sort(ranges.begin(), ranges.end(),
+                  [](const ByteRange& a, const ByteRange& b) { return a.offset < b.offset; });
+        std::vector<ByteRange> merged;
+        for (const ByteRange& r : ranges) {
+            if (!merged.empty() && r.offset - (merged.back().offset + merged.back().length) < page_size()) {
+                merged.back().length = r.offset + r.length - merged.back().offset;
+            } else {
+                merged.push_back(r);
+            }
+        }
+        ranges = std::move(merged);
+    }
+    LayerStreamOptions o;
+    o.window = window;
+    streamer_ = std::make_unique<LayerStreamer>(packed_.mapping(), std::move(layers), o);
+    executor_->set_layer_streamer(streamer_.get());
+}
+
+void Model::build_graph() {
+    const ModelConfig& c = config_;
+    Graph& g = graph_;
+    const int64_t q_cols = c.n_head * c.head_dim;
+    const int64_t kv_cols = c.n_head_kv * c.head_dim;
+
+    const auto matmul = [&](int32_t in, const std::string& weight, int64_t cols, const std::string& label,
+                            int32_t layer) {
+        const kernels::PackedWeights& w = packed_.require(weight);
+        const int32_t out = g.add_value(label, ValueType::kF32, cols);
+        Node& n = g.add_node(OpType::kMatMul, {in}, {out}, label);
+        n.weight = &w;
+        n.layer = layer;
+        if (const std::string bias = weight.substr(0, weight.size() - 6) + "bias"; file_.find(bias) != nullptr) {
+            const int32_t biased = g.add_value(label + ".b", ValueType::kF32, cols);
+            Node& b = g.add_node(OpType::kBias, {out}, {biased}, label + "_bias");
+            b.weight = norm_weight(bias);
+            b.layer = layer;
+            return biased;
+        }
+        return out;
+    };
+    const auto norm = [&](int32_t in, const std::string& weight, RowDim rows, const std::string& label,
+                          int32_t layer) {
+        const int32_t out = g.add_value(label, ValueType::kF32, c.n_embd, rows);
+        Node& n = g.add_node(OpType::kRmsNorm, {in}, {out}, label);
+        n.weight = norm_weight(weight);
+        n.f0 = c.rms_eps;
+        n.layer = layer;
+        return out;
+    };
+    const auto quantize = [&](int32_t in, RowDim rows, const std::string& label, int32_t layer) {
+        const int32_t out = g.add_value(label, ValueType::kQ8, g.values()[in].cols, rows);
+        g.add_node(OpType::kQuantize, {in}, {out}, label).layer = layer;
+        return out;
+    };
+    const auto binary = [&](OpType op, int32_t a, int32_t b, const std::string& label, int32_t layer) {
+        const int32_t out = g.add_value(label, ValueType::kF32, g.values()[a].cols, g.values()[a].rows);
+        g.add_node(op, {a, b}, {out}, label).layer = layer;
+        return out;
+    };
+    const auto rope = [&](int32_t in, const std::string& label, int32_t layer) {
+        const int32_t out = g.add_value(label, ValueType::kF32, g.values()[in].cols);
+        Node& n = g.add_node(OpType::kRope, {in, positions_}, {out}, label);
+        n.i0 = c.head_dim;
+        n.i1 = static_cast<int64_t>(c.rope_mode);
+        n.f0 = c.rope_base;
+        n.layer = layer;
+        return out;
+    };
+
+    tokens_ = g.add_value("tokens", ValueType::kI32, 1, RowDim::kTokens, ValueRole::kInput);
+    positions_ = g.add_value("positions", ValueType::kI32, 1, RowDim::kTokens, ValueRole::kInput);
+    output_rows_ = g.add_value("output_rows", ValueType::kI32, 1, RowDim::kOutputs, ValueRole::kInput);
+
+    int32_t x = g.add_value("embd", ValueType::kF32, c.n_embd);
+    g.add_node(OpType::kEmbed, {tokens_}, {x}).weight = &file_.require("token_embd.weight");
+
+    for (int32_t l = 0; l < c.n_layer; ++l) {
+        const std::string p = "blk." + std::to_string(l) + ".";
+        const int32_t h = quantize(norm(x, p + "attn_norm.weight", RowDim::kTokens, p + "attn_norm", l),
+                                   RowDim::kTokens, p + "attn_in", l);
+        const int32_t q = rope(matmul(h, p + "attn_q.weight", q_cols, p + "q", l), p + "q_rope", l);
+        const int32_t k = rope(matmul(h, p + "attn_k.weight", kv_cols, p + "k", l), p + "k_rope", l);
+        const int32_t v = matmul(h, p + "attn_v.weight", kv_cols, p + "v", l);
+        const int32_t attn = g.add_value(p + "attn", ValueType::kF32, q_cols);
+        Node& a = g.add_node(OpType::kAttention, {q, k, v}, {attn}, p + "attn");
+        a.i0 = c.head_dim;
+        a.f0 = 1.0f / std::sqrt(static_cast<float>(c.head_dim));
+        a.layer = l;
+        const int32_t o =
+            matmul(quantize(attn, RowDim::kTokens, p + "attn_q8", l), p + "attn_output.weight", c.n_embd,
+                   p + "attn_out", l);
+        x = binary(OpType::kAdd, x, o, p + "attn_res", l);
+
+        const int32_t f = quantize(norm(x, p + "ffn_norm.weight", RowDim::kTokens, p + "ffn_norm", l),
+                                   RowDim::kTokens, p + "ffn_in", l);
+        const int32_t gate = matmul(f, p + "ffn_gate.weight", c.n_ff, p + "gate", l);
+        const int32_t up = matmul(f, p + "ffn_up.weight", c.n_ff, p + "up", l);
+        const int32_t act = g.add_value(p + "gate_act", ValueType::kF32, c.n_ff);
+        g.add_node(OpType::kSilu, {gate}, {act}, p + "gate_act").layer = l;
+        const int32_t m = binary(OpType::kMul, act, up, p + "ffn_mul", l);
+        const int32_t d = matmul(quantize(m, RowDim::kTokens, p + "ffn_q8", l), p + "ffn_down.weight", c.n_embd,
+                                 p + "ffn_out", l);
+        x = binary(OpType::kAdd, x, d, p + "ffn_res", l);
+    }
+
+    hidden_ = g.add_value("last", ValueType::kF32, c.n_embd, RowDim::kOutputs, ValueRole::kOutput);
+    g.add_node(OpType::kGather, {x, output_rows_}, {hidden_});
+    const int32_t head = quantize(norm(hidden_, "output_norm.weight", RowDim::kOutputs, "output_norm", -1),
+                                  RowDim::kOutputs, "output_in", -1);
+    const char* head_weight = packed_.find("output.weight") != nullptr ? "output.weight" : "token_embd.weight";
+    logits_ = g.add_value("logits", ValueType::kF32, c.n_vocab, RowDim::kOutputs, ValueRole::kOutput);
+    g.add_node(OpType::kMatMul, {head}, {logits_}, "logits").weight = &packed_.require(head_weight);
+}
+
+KvCacheConfig Model::kv_config(size_t budget_bytes, KvDType dtype, int32_t page_tokens) const {
+    KvCacheConfig kv;
+    kv.n_layers = static_cast<int32_t>(config_.n_layer);
+    kv.n_kv_heads = static_cast<int32_t>(config_.n_head_kv);
+    kv.head_dim = static_cast<int32_t>(config_.head_dim);
+    kv.page_tokens = page_tokens;
+    kv.dtype = dtype;
+    kv.budget_bytes = budget_bytes;
+    return kv;
+}
+
+uint64_t Model::fingerprint() const {
+    // The file's content fingerprint tells apart a model re-quantized to the
+    // same shape (neuroctx_quantize --calibrate); the mtime catches a rewrite
+    // that the sampled tensor bytes miss.
+    const uint64_t h = hash_mix(file_.content_fingerprint(), static_cast<uint64_t>(file_.mapping().mtime_ns()));
+    return hash_mix(h, static_cast<uint64_t>(kernels_->variant));
+}
+
+const float* Model::forward(const StepBatch& batch, KvCache& kv, ThreadPool* pool) {
+    const auto rows = static_cast<int64_t>(batch.tokens.size());
+    const auto outputs = static_cast<int64_t>(batch.output_rows.size());
+    if (rows == 0 || rows > options_.max_batch_tokens || outputs > options_.max_outputs) {
+        throw_error("model: step of " + std::to_string(rows) + " tokens / " + std::to_string(outputs) +
+                    " outputs exceeds the planned batch");
+    }
+    int32_t* positions = executor_->i32(positions_);
+    int64_t covered = 0;
+    for (const StepSequence& s : batch.sequences) {
+        if (s.first_row != covered || s.rows <= 0 || s.pos != kv.length(s.seq)) {
+            throw_error("model: step sequences must cover the rows in order and continue their KV");
+        }
+        for (int64_t r = 0; r < s.rows; ++r) {
+            positions[s.first_row + r] = static_cast<int32_t>(s.pos + r);
+        }
+        covered += s.rows;
+    }
+    if (covered != rows) {
+        throw_error("model: step sequences do not cover the token rows");
+    }
+    std::memcpy(executor_->i32(tokens_), batch.tokens.data(), batch.tokens.size_bytes());
+    std::memcpy(executor_->i32(output_rows_), batch.output_rows.data(), batch.output_rows.size_bytes());
+
+    ExecContext ctx;
+    ctx.kernels = kernels_;
+    ctx.pool = pool;
+    ctx.kv = &kv;
+    ctx.sequences = batch.sequences;
+    ctx.rows[RowDim::kTokens] = rows;
+    ctx.rows[RowDim::kOutputs] = outputs;
+    executor_->run(ctx);
+
+    for (const StepSequence& s : batch.sequences) {
+        kv.commit(s.seq, batch.tokens.subspan(static_cast<size_t>(s.first_row), static_cast<size_t>(s.rows)));
+    }
+    return executor_->f32(logits_);
+}
+
+} // namespace neuroctx
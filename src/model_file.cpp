@@ -0,0 +1,383 @@
+#include "neuroctx/model_file.h"
+
+#include "neuroctx/common.h"
+#include "neuroctx/hash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace neuroctx {
+
+namespace {
+
+constexpr uint32_t kGgufMagic = 0x46554747; // "GGUF" little-endian
+constexpr size_t kMaxStringBytes = size_t{1} << 30;
+
+size_t scalar_size(MetaType type) {
+    switch (type) {
+    case MetaType::kU8:
+    case MetaType::kI8:
+    case MetaType::kBool: return 1;
+    case MetaType::kU16:
+    case MetaType::kI16: return 2;
+    case MetaType::kU32:
+    case MetaType::kI32:
+    case MetaType::kF32: return 4;
+    case MetaType::kU64:
+    case MetaType::kI64:
+    case MetaType::kF64: return 8;
+    case MetaType::kString:
+    case MetaType::kArray: return 0;
+    }
+    return 0;
+}
+
+template <typename T>
+T load(const uint8_t* p) {
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+std::optional<int64_t> decode_int(MetaType type, const uint8_t* p) {
+    switch (type) {
+    case MetaType::kU8: return load<uint8_t>(p);
+    case MetaType::kI8: return load<int8_t>(p);
+    case MetaType::kBool: return load<uint8_t>(p) != 0;
+    case MetaType::kU16: return load<uint16_t>(p);
+    case MetaType::kI16: return load<int16_t>(p);
+    case MetaType::kU32: return load<uint32_t>(p);
+    case MetaType::kI32: return load<int32_t>(p);
+    case MetaType::kU64: return static_cast<int64_t>(load<uint64_t>(p));
+    case MetaType::kI64: return load<int64_t>(p);
+    default: return std::nullopt;
+    }
+}
+
+std::optional<double> decode_float(MetaType type, const uint8_t* p) {
+    if (type == MetaType::kF32) {
+        return load<float>(p);
+    }
+    if (type == MetaType::kF64) {
+        return load<double>(p);
+    }
+    if (auto v = decode_int(type, p)) {
+        return static_cast<double>(*v);
+    }
+    return std::nullopt;
+}
+
+// Bounds-checked reader over the header region.
+class Cursor {
+public:
+    Cursor(const uint8_t* begin, const uint8_t* end, const std::string& path)
+        : pos_(begin), begin_(begin), end_(end), path_(path) {}
+
+    const uint8_t* pos() const { return pos_; }
+    size_t offset() const { return static_cast<size_t>(pos_ - begin_); }
+
+    void need(size_t bytes) const {
+        if (static_cast<size_t>(end_ - pos_) < bytes) {
+            throw_error(path_ + ": truncated GGUF header at offset " + std::to_string(offset()));
+        }
+    }
+
+    template <typename T>
+    T read() {
+        need(sizeof(T));
+        T value = load<T>(pos_);
+        pos_ += sizeof(T);
+        return value;
+    }
+
+    std::string_view read_string() {
+        const uint64_t len = read<uint64_t>();
+        if (len > kMaxStringBytes) {
+            throw_error(path_ + ": implausible string length in GGUF header");
+        }
+        need(len);
+        std::string_view s(reinterpret_cast<const char*>(pos_), len);
+        pos_ += len;
+        return s;
+    }
+
+    void skip(size_t bytes) {
+        need(bytes);
+        pos_ += bytes;
+    }
+
+    // Advances over one value of `type`, recursing into arrays.
+    void skip_value(MetaType type) {
+        if (type == MetaType::kString) {
+            read_string();
+            return;
+        }
+        if (type == MetaType::kArray) {
+            const auto elem = static_cast<MetaType>(read<uint32_t>());
+            const uint64_t count = read<uint64_t>();
+            const size_t width = scalar_size(elem);
+            if (width != 0) {
+                if (count > (std::numeric_limits<size_t>::max)() / width) {
+                    throw_error(path_ + ": GGUF array too large");
+                }
+                skip(count * width);
+            } else {
+                for (uint64_t i = 0; i < count; ++i) {
+                    skip_value(elem);
+                }
+            }
+            return;
+        }
+        const size_t width = scalar_size(type);
+        if (width == 0) {
+            throw_error(path_ + ": unknown GGUF metadata type " +
+                        std::to_string(static_cast<uint32_t>(type)));
+        }
+        skip(width);
+    }
+
+private:
+    const uint8_t* pos_;
+    const uint8_t* begin_;
+    const uint8_t* end_;
+    const std::string& path_;
+};
+
+} // namespace
+
+std::optional<int64_t> MetaArray::int_at(uint64_t index) const {
+    const size_t width = scalar_size(elem_type_);
+    if (width == 0 || index >= count_) {
+        return std::nullopt;
+    }
+    return decode_int(elem_type_, data_ + index * width);
+}
+
+std::optional<double> MetaArray::float_at(uint64_t index) const {
+    const size_t width = scalar_size(elem_type_);
+    if (width == 0 || index >= count_) {
+        return std::nullopt;
+    }
+    return decode_float(elem_type_, data_ + index * width);
+}
+
+MetaArray::StringCursor MetaArray::strings() const {
+    return StringCursor(data_, end_, elem_type_ == MetaType::kString ? count_ : 0);
+}
+
+bool MetaArray::StringCursor::next(std::string_view& out) {
+    // Lengths were validated when the header was parsed.
+    if (remaining_ == 0 || static_cast<size_t>(end_ - pos_) < sizeof(uint64_t)) {
+        return false;
+    }
+    const uint64_t len = load<uint64_t>(pos_);
+    out = std::string_view(reinterpret_cast<const char*>(pos_ + sizeof(uint64_t)), len);
+    pos_ += sizeof(uint64_t) + len;
+    --remaining_;
+    return true;
+}
+
+std::optional<int64_t> MetaValue::as_int() const { return decode_int(type_, data_); }
+
+std::optional<double> MetaValue::as_float() const { return decode_float(type_, data_); }
+
+std::optional<std::string_view> MetaValue::as_string() const {
+    if (type_ != MetaType::kString) {
+        return std::nullopt;
+    }
+    const uint64_t len = load<uint64_t>(data_);
+    return std::string_view(reinterpret_cast<const char*>(data_ + sizeof(uint64_t)), len);
+}
+
+std::optional<MetaArray> MetaValue::as_array() const {
+    if (type_ != MetaType::kArray) {
+        return std::nullopt;
+    }
+    const auto elem = static_cast<MetaType>(load<uint32_t>(data_));
+    const uint64_t count = load<uint64_t>(data_ + 4);
+    return MetaArray(elem, count, data_ + 12, end_);
+}
+
+ModelFile ModelFile::open(const std::string& path, Advice advice, bool populate) {
+    ModelFile model;
+    // The header is read front to back exactly once.
+    model.file_ = MappedFile::open(path, Advice::kSequential, populate);
+    model.parse();
+    const size_t size = model.file_.size();
+    const size_t header = std::min(model.data_offset_, size);
+    model.file_.advise(0, header, Advice::kNormal);
+    model.file_.advise(header, size - header, advice);
+    return model;
+}
+
+void ModelFile::parse() {
+    const std::string& path = file_.path();
+    const uint8_t* begin = file_.data();
+    const uint8_t* end = begin + file_.size();
+    Cursor cur(begin, end, path);
+
+    if (cur.read<uint32_t>() != kGgufMagic) {
+        throw_error(path + ": not a GGUF file");
+    }
+    version_ = cur.read<uint32_t>();
+    if (version_ < 2 || version_ > 3) {
+        throw_error(path + ": unsupported GGUF version " + std::to_string(version_));
+    }
+    const uint64_t n_tensors = cur.read<uint64_t>();
+    const uint64_t n_kv = cur.read<uint64_t>();
+    // Every record occupies at least a few bytes; reject counts the file
+    // could not possibly hold before reserving memory for them.
+    if (n_tensors > file_.size() / 16 || n_kv > file_.size() / 12) {
+        throw_error(path + ": implausible GGUF tensor/metadata count");
+    }
+
+    metadata_.reserve(n_kv);
+    for (uint64_t i = 0; i < n_kv; ++i) {
+        const std::string_view key = cur.read_string();
+        const auto type = static_cast<MetaType>(cur.read<uint32_t>());
+        const uint8_t* value_begin = cur.pos();
+        cur.skip_value(type);
+        metadata_.push_back({key, MetaValue(type, value_begin, cur.pos())});
+        if (key == "general.alignment") {
+            const auto align = metadata_.back().value.as_int();
+            if (!align || *align <= 0 || (*align & (*align - 1)) != 0) {
+                throw_error(path + ": general.alignment must be a power of two");
+            }
+            alignment_ = static_cast<size_t>(*align);
+        }
+    }
+
+    tensors_.reserve(n_tensors);
+    for (uint64_t i = 0; i < n_tensors; ++i) {
+        TensorView t;
+        t.name = cur.read_string();
+        t.n_dims = cur.read<uint32_t>();
+        if (t.n_dims == 0 || t.n_dims > static_cast<uint32_t>(kMaxDims)) {
+            throw_error(path + ": tensor '" + std::string(t.name) + "' has " +
+                        std::to_string(t.n_dims) + " dimensions");
+        }
+        for (uint32_t d = 0; d < t.n_dims; ++d) {
+            const uint64_t extent = cur.read<uint64_t>();
+            if (extent == 0 || extent > (uint64_t{1} << 40)) {
+                throw_error(path + ": tensor '" + std::string(t.name) + "' has invalid shape");
+            }
+            t.ne[d] = static_cast<int64_t>(extent);
+        }
+        t.dtype = static_cast<DType>(cur.read<uint32_t>());
+        t.offset = cur.read<uint64_t>(); // relative until the data section is known
+
+        const DTypeInfo* info = dtype_info(t.dtype);
+        if (info == nullptr) {
+            throw_error(path + ": tensor '" + std::string(t.name) + "' has unknown type " +
+                        std::to_string(static_cast<uint32_t>(t.dtype)));
+        }
+        if (t.ne[0] % info->block_elems != 0) {
+            throw_error(path + ": tensor '" + std::string(t.name) +
+                        "' row length is not a multiple of the " + info->name + " block size");
+        }
+        uint64_t blocks = static_cast<uint64_t>(t.ne[0]) / info->block_elems;
+        bool overflow = false;
+        for (int d = 1; d < kMaxDims; ++d) {
+            overflow |= __builtin_mul_overflow(blocks, static_cast<uint64_t>(t.ne[d]), &blocks);
+        }
+        uint64_t bytes = 0;
+        overflow |= __builtin_mul_overflow(blocks, uint64_t{info->block_bytes}, &bytes);
+        if (overflow || bytes > file_.size()) {
+            throw_error(path + ": tensor '" + std::string(t.name) + "' exceeds file size");
+        }
+        t.nbytes = static_cast<size_t>(bytes);
+        tensors_.push_back(t);
+    }
+
+    data_offset_ = align_up(cur.offset(), alignment_);
+    for (TensorView& t : tensors_) {
+        if (t.offset % alignment_ != 0) {
+            throw_error(path + ": tensor '" + std::string(t.name) + "' is misaligned");
+        }
+        const size_t absolute = data_offset_ + t.offset;
+        if (absolute < t.offset || absolute > file_.size() || t.nbytes > file_.size() - absolute) {
+            throw_error(path + ": tensor '" + std::string(t.name) + "' data out of bounds");
+        }
+        t.offset = absolute;
+        t.data = begin + absolute;
+    }
+
+    by_name_.resize(tensors_.size());
+    for (uint32_t i = 0; i < by_name_.size(); ++i) {
+        by_name_[i] = i;
+    }
+    std::sort(by_name_.begin(), by_name_.end(),
+              [this](uint32_t a, uint32_t b) { return tensors_[a].name < tensors_[b].name; });
+    for (size_t i = 1; i < by_name_.size(); ++i) {
+        if (tensors_[by_name_[i]].name == tensors_[by_name_[i - 1]].name) {
+            throw_error(path + ": duplicate tensor '" + std::string(tensors_[by_name_[i]].name) + "'");
+        }
+    }
+}
+
+uint64_t ModelFile::content_fingerprint() const {
+    constexpr size_t kSample = 4096;
+    uint64_t h = hash_mix(fnv1a64(file_.data(), std::min(data_offset_, file_.size())), file_.size());
+    for (const TensorView& t : tensors_) {
+        const auto* bytes = static_cast<const uint8_t*>(t.data);
+        const size_t n = std::min(t.nbytes, kSample);
+        h = hash_mix(h, fnv1a64(bytes, n));
+        if (t.nbytes > kSample) {
+            h = hash_mix(h, fnv1a64(bytes + t.nbytes - n, n));
+        }
+    }
+    return h;
+}
+
+const TensorView* ModelFile::find(std::string_view name) const {
+    auto it = std::lower_bound(by_name_.begin(), by_name_.end(), name,
+                               [this](uint32_t idx, std::string_view n) { return tensors_[idx].name < n; });
+    if (it == by_name_.end() || tensors_[*it].name != name) {
+        return nullptr;
+    }
+    return &tensors_[*it];
+}
+
+const TensorView& ModelFile::require(std::string_view name) const {
+    const TensorView* t = find(name);
+    if (t == nullptr) {
+        throw_error(path() + ": missing tensor '" + std::string(name) + "'");
+    }
+    return *t;
+}
+
+const MetaValue* ModelFile::meta(std::string_view key) const {
+    for (const MetaEntry& entry : metadata_) {
+        if (entry.key == key) {
+            return &entry.value;
+        }
+    }
+    return nullptr;
+}
+
+int64_t ModelFile::meta_int(std::string_view key, int64_t fallback) const {
+    const MetaValue* v = meta(key);
+    if (v == nullptr) {
+        return fallback;
+    }
+    return v->as_int().value_or(fallback);
+}
+
+double ModelFile::meta_float(std::string_view key, double fallback) const {
+    const MetaValue* v = meta(key);
+    if (v == nullptr) {
+        return fallback;
+    }
+    return v->as_float().value_or(fallback);
+}
+
+std::string_view ModelFile::meta_string(std::string_view key, std::string_view fallback) const {
+    const MetaValue* v = meta(key);
+    if (v == nullptr) {
+        return fallback;
+    }
+    return v->as_string().value_or(fallback);
+}
+
+} // namespace neuroctx
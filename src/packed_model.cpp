@@ -0,0 +1,290 @@
+#include "neuroctx/packed_model.h"
+
+#include "fd_io.h"
+#include "neuroctx/common.h"
+#include "neuroctx/hash.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace neuroctx {
+
+namespace {
+
+constexpr char kMagic[8] = {'N', 'C', 'T', 'X', 'P', 'A', 'K', '\0'};
+
+struct PackHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_bytes;
+    uint32_t variant;
+    uint32_t panel_rows;
+    uint32_t k_interleave;
+    uint32_t tensor_count;
+    uint64_t cpu_bits;
+    uint64_t source_size;
+    int64_t source_mtime_ns;
+    uint64_t source_fingerprint;
+    uint64_t directory_offset;
+    uint64_t strings_offset;
+    uint64_t data_offset;
+    uint64_t data_alignment;
+    uint64_t file_size;
+};
+
+struct PackEntry {
+    uint64_t name_offset;
+    uint32_t name_len;
+    uint32_t format;
+    int64_t n;
+    int64_t k;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+static_assert(sizeof(PackHeader) == 104);
+static_assert(sizeof(PackEntry) == 48);
+
+// The GGUF header covers names, shapes, types and metadata; hashing it
+// plus size and mtime identifies the source without reading the weights.
+uint64_t source_fingerprint(const ModelFile& model) {
+    const size_t header = std::min(model.data_offset(), model.mapping().size());
+    return fnv1a64(model.mapping().data(), header);
+}
+
+std::string basename_of(const std::string& path) {
+    return std::filesystem::path(path).filename().string();
+}
+
+} // namespace
+
+bool PackedModel::should_pack(const ModelFile& model, const TensorView& tensor) {
+    if (tensor.n_dims != 2 || !kernels::can_pack(tensor.dtype) || tensor.cols() % kernels::kBlock != 0) {
+        return false;
+    }
+    if (tensor.name == "token_embd.weight") {
+        return model.find("output.weight") == nullptr;
+    }
+    return true;
+}
+
+std::string PackedModel::cache_path(const ModelFile& model, const kernels::KernelSet& ks,
+                                    const std::string& cache_dir) {
+    return (std::filesystem::path(cache_dir) /
+            (basename_of(model.path()) + "." + ks.name + "-p" + std::to_string(ks.layout.panel_rows) + "k" +
+             std::to_string(ks.layout.k_interleave) + ".nctxpack"))
+        .string();
+}
+
+std::optional<PackedModel> PackedModel::try_open(const std::string& path, const ModelFile& model,
+                                                 const kernels::KernelSet& ks) {
+    if (::access(path.c_str(), F_OK) != 0 && errno == ENOENT) {
+        return std::nullopt;
+    }
+    MappedFile file = MappedFile::open(path, Advice::kRandom);
+    if (file.size() < sizeof(PackHeader)) {
+        return std::nullopt;
+    }
+    PackHeader h;
+    std::memcpy(&h, file.data(), sizeof(h));
+    const MappedFile& src = model.mapping();
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kFormatVersion ||
+        h.header_bytes != sizeof(PackHeader) || h.variant != static_cast<uint32_t>(ks.variant) ||
+        h.panel_rows != ks.layout.panel_rows || h.k_interleave != ks.layout.k_interleave ||
+        h.file_size != file.size() || h.source_size != src.size() || h.source_mtime_ns != src.mtime_ns() ||
+        h.source_fingerprint != source_fingerprint(model)) {
+        return std::nullopt;
+    }
+    if (h.directory_offset + uint64_t{h.tensor_count} * sizeof(PackEntry) > file.size() ||
+        h.strings_offset > file.size()) {
+        throw_error(path + ": corrupt pack directory");
+    }
+
+    PackedModel packed;
+    packed.cpu_bits_ = h.cpu_bits;
+    packed.tensors_.reserve(h.tensor_count);
+    for (uint32_t i = 0; i < h.tensor_count; ++i) {
+        PackEntry e;
+        std::memcpy(&e, file.data() + h.directory_offset + i * sizeof(PackEntry), sizeof(e));
+        if (e.name_offset + e.name_len > file.size() || e.offset > file.size() || e.bytes > file.size() - e.offset ||
+            e.format > static_cast<uint32_t>(kernels::WeightFormat::kInt4) || e.n <= 0 || e.k <= 0 ||
+            e.k % kernels::kBlock != 0) {
+            throw_error(path + ": corrupt pack entry " + std::to_string(i));
+        }
+        PackedTensor t;
+        t.name = std::string_view(reinterpret_cast<const char*>(file.data() + e.name_offset), e.name_len);
+        t.weights.data = file.data() + e.offset;
+        t.weights.n = e.n;
+        t.weights.k = e.k;
+        t.weights.format = static_cast<kernels::WeightFormat>(e.format);
+        t.weights.layout = ks.layout;
+        t.offset = e.offset;
+        t.nbytes = e.bytes;
+        if (kernels::packed_bytes(e.n, e.k, t.weights.format, ks.layout) != e.bytes) {
+            throw_error(path + ": pack entry size mismatch for '" + std::string(t.name) + "'");
+        }
+        packed.tensors_.push_back(t);
+    }
+    std::sort(packed.tensors_.begin(), packed.tensors_.end(),
+              [](const PackedTensor& a, const PackedTensor& b) { return a.name < b.name; });
+    packed.file_ = std::move(file);
+    return packed;
+}
+
+void PackedModel::build(const ModelFile& model, const kernels::KernelSet& ks, const std::string& path) {
+    std::vector<const TensorView*> selected;
+    for (const TensorView& t : model.tensors()) {
+        if (should_pack(model, t)) {
+            selected.push_back(&t);
+        }
+    }
+
+    const size_t alignment = std::max<size_t>(page_size(), 4096);
+    size_t strings_bytes = 0;
+    for (const TensorView* t : selected) {
+        strings_bytes += t->name.size();
+    }
+
+    PackHeader h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kFormatVersion;
+    h.header_bytes = sizeof(PackHeader);
+    h.variant = static_cast<uint32_t>(ks.variant);
+    h.panel_rows = ks.layout.panel_rows;
+    h.k_interleave = ks.layout.k_interleave;
+    h.tensor_count = static_cast<uint32_t>(selected.size());
+    h.cpu_bits = cpu_features().bits();
+    h.source_size = model.mapping().size();
+    h.source_mtime_ns = model.mapping().mtime_ns();
+    h.source_fingerprint = source_fingerprint(model);
+    h.directory_offset = sizeof(PackHeader);
+    h.strings_offset = h.directory_offset + selected.size() * sizeof(PackEntry);
+    h.data_offset = align_up(h.strings_offset + strings_bytes, alignment);
+    h.data_alignment = alignment;
+
+    std::vector<PackEntry> entries(selected.size());
+    uint64_t name_cursor = h.strings_offset;
+    uint64_t data_cursor = h.data_offset;
+    for (size_t i = 0; i < selected.size(); ++i) {
+        const TensorView& t = *selected[i];
+        const kernels::WeightFormat format = kernels::native_format(t.dtype);
+        PackEntry& e = entries[i];
+        e.name_offset = name_cursor;
+        e.name_len = static_cast<uint32_t>(t.name.size());
+        e.format = static_cast<uint32_t>(format);
+        e.n = t.rows();
+        e.k = t.cols();
+        e.offset = data_cursor;
+        e.bytes = kernels::packed_bytes(e.n, e.k, format, ks.layout);
+        name_cursor += t.name.size();
+        data_cursor = align_up(data_cursor + e.bytes, alignment);
+    }
+    h.file_size = data_cursor;
+
+    const std::filesystem::path target(path);
+    if (target.has_parent_path()) {
+        std::error_code ec;
+        std::filesystem::create_directories(target.parent_path(), ec);
+        if (ec) {
+            throw_error("create " + target.parent_path().string() + ": " + ec.message());
+        }
+    }
+    const std::string tmp = path + ".tmp." + std::to_string(getpid());
+    FdGuard fd(::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+    if (fd.get() < 0) {
+        throw_errno("create " + tmp);
+    }
+    if (ftruncate(fd.get(), static_cast<off_t>(h.file_size)) != 0) {
+        const int saved = errno;
+        ::unlink(tmp.c_str());
+        errno = saved;
+        throw_errno("ftruncate " + tmp);
+    }
+    // Panels are written straight into the page cache through a shared
+    // mapping, so packing never holds a second copy of a tensor in heap.
+    void* addr = mmap(nullptr, h.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (addr == MAP_FAILED) {
+        const int saved = errno;
+        ::unlink(tmp.c_str());
+        errno = saved;
+        throw_errno("mmap " + tmp);
+    }
+    auto* out = static_cast<uint8_t*>(addr);
+    try {
+        std::memcpy(out, &h, sizeof(h));
+        for (size_t i = 0; i < selected.size(); ++i) {
+            const PackEntry& e = entries[i];
+            std::memcpy(out + h.directory_offset + i * sizeof(PackEntry), &e, sizeof(e));
+            std::memcpy(out + e.name_offset, selected[i]->name.data(), e.name_len);
+            kernels::pack_tensor(*selected[i], static_cast<kernels::WeightFormat>(e.format), ks.layout,
+                                 out + e.offset);
+            // Source pages are not needed again once packed.
+            model.advise(*selected[i], Advice::kDontNeed);
+        }
+    } catch (...) {
+        munmap(addr, h.file_size);
+        ::unlink(tmp.c_str());
+        throw;
+    }
+    const bool synced = msync(addr, h.file_size, MS_SYNC) == 0;
+    munmap(addr, h.file_size);
+    if (!synced || fsync(fd.get()) != 0 || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        const int saved = errno;
+        ::unlink(tmp.c_str());
+        errno = saved;
+        throw_errno("write " + path);
+    }
+}
+
+PackedModel PackedModel::open_or_build(const ModelFile& model, const kernels::KernelSet& ks,
+                                       const std::string& cache_dir) {
+    const std::string path = cache_path(model, ks, cache_dir);
+    if (auto packed = try_open(path, model, ks)) {
+        return std::move(*packed);
+    }
+    build(model, ks, path);
+    auto packed = try_open(path, model, ks);
+    if (!packed) {
+        throw_error(path + ": freshly built pack failed validation");
+    }
+    packed->rebuilt_ = true;
+    return std::move(*packed);
+}
+
+const PackedTensor* PackedModel::find(std::string_view name) const {
+    auto it = std::lower_bound(tensors_.begin(), tensors_.end(), name,
+                               [](const PackedTensor& t, std::string_view n) { return t.name < n; });
+    if (it == tensors_.end() || it->name != name) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+const kernels::PackedWeights& PackedModel::require(std::string_view name) const {
+    const PackedTensor* t = find(name);
+    if (t == nullptr) {
+        throw_error(path() + ": no packed weights for '" + std::string(name) + "'");
+    }
+    return t->weights;
+}
+
+std::string default_cache_dir() {
+    if (const char* dir = std::getenv("NEUROCTX_CACHE_DIR"); dir != nullptr && *dir != '\0') {
+        return dir;
+    }
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg != nullptr && *xdg != '\0') {
+        return std::string(xdg) + "/neuroctx";
+    }
+    if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0') {
+        return std::string(home) + "/.cache/neuroctx";
+    }
+    return "/tmp/neuroctx";
+}
+
+} // namespace neuroctx
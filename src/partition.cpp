@@ -0,0 +1,136 @@
+#include "neuroctx/partition.h"
+
+#include "neuroctx/common.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace neuroctx {
+
+namespace {
+
+constexpr double kInfinity = std::numeric_limits<double>::infinity();
+
+// Bytes a node reads and writes in activations.
+double activation_bytes(const Graph& graph, const Node& node, const RowBounds& rows) {
+    const auto& values = graph.values();
+    double bytes = 0;
+    for (int i = 0; i < node.inputs(); ++i) {
+        const Value& v = values[node.in[i]];
+        bytes += double(value_row_bytes(v)) * double(rows[v.rows]);
+    }
+    for (int i = 0; i < node.outputs(); ++i) {
+        const Value& v = values[node.out[i]];
+        bytes += double(value_row_bytes(v)) * double(rows[v.rows]);
+    }
+    return bytes;
+}
+
+} // namespace
+
+double node_seconds(const Graph& graph, const Node& node, const RowBounds& rows, const DeviceProfile& device) {
+    if (!device.supports(node.op)) {
+        return kInfinity;
+    }
+    const Value& out = graph.values()[node.out[0]];
+    const double out_rows = double(rows[out.rows]);
+    double bytes = activation_bytes(graph, node, rows);
+    double int8_ops = 0;
+    double f32_ops = out_rows * double(out.cols);
+    switch (node.op) {
+    case OpType::kMatMul:
+    case OpType::kMatMulRope: {
+        const auto* w = static_cast<const kernels::PackedWeights*>(node.weight);
+        int8_ops = 2.0 * out_rows * double(w->n) * double(w->k);
+        bytes += double(kernels::packed_bytes(w->n, w->k, w->format, w->layout));
+        break;
+    }
+    case OpType::kAttention:
+        // Scores and weighted values against about as many keys as rows;
+        // K/V reads are counted as one row per query row.
+        f32_ops = 4.0 * out_rows * out_rows * double(out.cols);
+        bytes += 2.0 * out_rows * double(out.cols) * 2.0;
+        break;
+    case OpType::kEmbed: bytes = 2.0 * out_rows * double(out.cols) * 4.0; break;
+    default: break;
+    }
+    double seconds = bytes / device.bytes_per_s;
+    if (int8_ops > 0) {
+        seconds = std::max(seconds, int8_ops / device.int8_ops_per_s);
+    }
+    return std::max(seconds, f32_ops / device.f32_ops_per_s);
+}
+
+Placement place_graph(const Graph& graph, const RowBounds& rows, std::span<const DeviceProfile> devices) {
+    if (devices.empty() || devices[0].ops != kAllOps) {
+        throw_error("partition: devices[0] must be a CPU that runs every op");
+    }
+    const auto& nodes = graph.nodes();
+    const size_t n_nodes = nodes.size();
+    const size_t n_dev = devices.size();
+    Placement placement;
+    if (n_nodes == 0) {
+        return placement;
+    }
+
+    // best[n][d]: cheapest time for nodes [0, n] with node n on device d;
+    // from[n][d]: the device of node n - 1 on that path.
+    std::vector<double> best(n_nodes * n_dev, kInfinity);
+    std::vector<int32_t> from(n_nodes * n_dev, 0);
+    std::vector<double> cost(n_nodes * n_dev);
+    for (size_t n = 0; n < n_nodes; ++n) {
+        for (size_t d = 0; d < n_dev; ++d) {
+            cost[n * n_dev + d] = node_seconds(graph, nodes[n], rows, devices[d]);
+        }
+    }
+    // Steps start and end on the CPU (inputs, logits).
+    for (size_t d = 0; d < n_dev; ++d) {
+        const double enter = d == 0 ? 0.0 : devices[d].launch_s + devices[d].sync_s;
+        best[d] = enter + cost[d];
+    }
+    for (size_t n = 1; n < n_nodes; ++n) {
+        for (size_t d = 0; d < n_dev; ++d) {
+            const double c = cost[n * n_dev + d];
+            if (c == kInfinity) {
+                continue;
+            }
+            for (size_t p = 0; p < n_dev; ++p) {
+                const double prev = best[(n - 1) * n_dev + p];
+                const double sw = p == d ? 0.0 : devices[p].sync_s + devices[d].sync_s + devices[d].launch_s;
+                if (prev + sw + c < best[n * n_dev + d]) {
+                    best[n * n_dev + d] = prev + sw + c;
+                    from[n * n_dev + d] = static_cast<int32_t>(p);
+                }
+            }
+        }
+    }
+    int32_t d = 0;
+    double total = kInfinity;
+    for (size_t e = 0; e < n_dev; ++e) {
+        const double t = best[(n_nodes - 1) * n_dev + e] + (e == 0 ? 0.0 : devices[e].sync_s);
+        if (t < total) {
+            total = t;
+            d = static_cast<int32_t>(e);
+        }
+    }
+
+    placement.device.resize(n_nodes);
+    for (size_t n = n_nodes; n-- > 0;) {
+        placement.device[n] = d;
+        d = from[n * n_dev + static_cast<size_t>(d)];
+    }
+    placement.seconds = total;
+    for (size_t n = 0; n < n_nodes; ++n) {
+        const int32_t dev = placement.device[n];
+        if (placement.segments.empty() || placement.segments.back().device != dev) {
+            placement.segments.push_back({dev, static_cast<int32_t>(n), static_cast<int32_t>(n)});
+        }
+        ++placement.segments.back().end;
+        if (dev == 0) {
+            placement.cpu_seconds += cost[n * n_dev];
+        }
+    }
+    return placement;
+}
+
+} // namespace neuroctx
@@ -0,0 +1,439 @@
+#include "neuroctx/quantize.h"
+
+#include "fd_io.h"
+#include "neuroctx/common.h"
+#include "neuroctx/kv_cache.h"
+#include "neuroctx/model.h"
+#include "neuroctx/thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace neuroctx {
+
+namespace {
+
+constexpr uint32_t kGgufMagic = 0x46554747; // "GGUF" little-endian
+constexpr uint32_t kGgufVersion = 3;
+constexpr int64_t kBlock = 32;
+// Candidate roundings per block: the absmax scale stretched by up to
+// +-kTries tenths of a quantization step.
+constexpr int kTries = 9;
+constexpr int64_t kRowsPerTask = 16;
+
+// llama.cpp's general.file_type for what most of the weights are.
+uint32_t file_type(DType type) {
+    switch (type) {
+    case DType::kF32: return 0;
+    case DType::kF16: return 1;
+    case DType::kQ4_0: return 2;
+    case DType::kQ8_0: return 7;
+    default: return 0;
+    }
+}
+
+bool is_target(DType type) {
+    return type == DType::kQ4_0 || type == DType::kQ8_0 || type == DType::kF16 || type == DType::kF32;
+}
+
+// Writes one 32-value block and adds its weighted squared error and signal
+// to err[0] and err[1].
+void quantize_block(const float* x, const float* importance, DType type, uint8_t* dst, double* err) {
+    const bool q4 = type == DType::kQ4_0;
+    const int lo = q4 ? -8 : -127;
+    const int hi = q4 ? 7 : 127;
+    float w[kBlock];
+    float amax = 0.0f;
+    float max = 0.0f;
+    double sigma2 = 0.0;
+    for (int64_t i = 0; i < kBlock; ++i) {
+        sigma2 += static_cast<double>(x[i]) * x[i];
+        if (std::fabs(x[i]) > amax) {
+            amax = std::fabs(x[i]);
+            max = x[i];
+        }
+    }
+    sigma2 /= kBlock;
+    float weight_sum = 0.0f;
+    if (importance != nullptr) {
+        // As llama.cpp's imatrix weighting: the channel's importance times
+        // the value's own magnitude against the block's spread.
+        for (int64_t i = 0; i < kBlock; ++i) {
+            w[i] = importance[i] * std::sqrt(static_cast<float>(sigma2) + x[i] * x[i]);
+            weight_sum += w[i];
+        }
+    }
+    if (weight_sum <= 0.0f) {
+        std::fill(w, w + kBlock, 1.0f);
+    }
+
+    float d = 0.0f;
+    if (amax > 0.0f) {
+        // Q4_0 maps the extreme value to -8, the level the positive side
+        // lacks; Q8_0 is symmetric.
+        const float ref = q4 ? -max : amax;
+        const float base = q4 ? 8.0f : 127.0f;
+        double best = -1.0;
+        for (int t = -kTries; t <= kTries; ++t) {
+            const float iscale = (base + 0.1f * static_cast<float>(t)) / ref;
+            double sumlx = 0.0;
+            double suml2 = 0.0;
+            for (int64_t i = 0; i < kBlock; ++i) {
+                const int l = std::clamp(static_cast<int>(std::nearbyint(iscale * x[i])), lo, hi);
+                sumlx += static_cast<double>(w[i]) * x[i] * l;
+                suml2 += static_cast<double>(w[i]) * l * l;
+            }
+            // The fitted scale sumlx / suml2 leaves an error of
+            // sum(w x^2) - sumlx^2 / suml2: maximize the second term.
+            if (suml2 > 0.0 && sumlx * sumlx / suml2 > best) {
+                best = sumlx * sumlx / suml2;
+                d = static_cast<float>(sumlx / suml2);
+            }
+        }
+    }
+    const uint16_t d16 = fp32_to_fp16(d);
+    const float scale = fp16_to_fp32(d16);
+    const float inv = scale != 0.0f ? 1.0f / scale : 0.0f;
+    std::memcpy(dst, &d16, sizeof(d16));
+    int8_t l[kBlock];
+    for (int64_t i = 0; i < kBlock; ++i) {
+        l[i] = static_cast<int8_t>(std::clamp(static_cast<int>(std::nearbyint(x[i] * inv)), lo, hi));
+        const double e = x[i] - scale * l[i];
+        err[0] += w[i] * e * e;
+        err[1] += w[i] * static_cast<double>(x[i]) * x[i];
+    }
+    if (q4) {
+        for (int64_t i = 0; i < kBlock / 2; ++i) {
+            dst[2 + i] = static_cast<uint8_t>((l[i] + 8) | (l[i + kBlock / 2] + 8) << 4);
+        }
+    } else {
+        std::memcpy(dst + 2, l, kBlock);
+    }
+}
+
+void quantize_row_impl(const float* x, int64_t k, DType type, const float* importance, uint8_t* dst, double* err) {
+    if (type != DType::kQ4_0 && type != DType::kQ8_0) {
+        throw_error(std::string("quantize: unsupported target type ") + dtype_name(type));
+    }
+    if (k % kBlock != 0) {
+        throw_error("quantize: row of " + std::to_string(k) + " values is not a whole number of blocks");
+    }
+    const uint32_t block_bytes = dtype_info(type)->block_bytes;
+    for (int64_t b = 0; b < k / kBlock; ++b) {
+        quantize_block(x + b * kBlock, importance != nullptr ? importance + b * kBlock : nullptr, type,
+                       dst + b * block_bytes, err);
+    }
+}
+
+size_t tensor_bytes(const TensorView& t, DType type) {
+    const DTypeInfo* info = dtype_info(type);
+    return static_cast<size_t>(t.elements() / info->block_elems) * info->block_bytes;
+}
+
+template <typename T>
+void append(std::vector<uint8_t>& out, T value) {
+    const auto* p = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+void append_string(std::vector<uint8_t>& out, std::string_view s) {
+    append(out, static_cast<uint64_t>(s.size()));
+    out.insert(out.end(), s.begin(), s.end());
+}
+
+void append_meta(std::vector<uint8_t>& out, std::string_view key, MetaType type, const void* value, size_t bytes) {
+    append_string(out, key);
+    append(out, static_cast<uint32_t>(type));
+    const auto* p = static_cast<const uint8_t*>(value);
+    out.insert(out.end(), p, p + bytes);
+}
+
+// Metadata this writer sets itself.
+bool replaced_key(std::string_view key) {
+    return key == "general.file_type" || key == "general.quantization_version" || key.starts_with("quantize.");
+}
+
+} // namespace
+
+ActivationStats ActivationStats::collect(Model& model, std::span<const int32_t> tokens, int64_t chunk_tokens,
+                                         ThreadPool* pool) {
+    ActivationStats stats;
+    std::unordered_map<const void*, Entry*> by_weight;
+    for (const PackedTensor& t : model.packed().tensors()) {
+        Entry& e = stats.entries_[std::string(t.name)];
+        e.sum.assign(static_cast<size_t>(t.weights.k), 0.0);
+        by_weight[&t.weights] = &e;
+    }
+    model.set_observer([&](const Node& node, const Executor& executor, const ExecContext& ctx) {
+        if (node.op != OpType::kMatMul && node.op != OpType::kMatMulRope) {
+            return;
+        }
+        const auto it = by_weight.find(node.weight);
+        if (it == by_weight.end()) {
+            return;
+        }
+        Entry& e = *it->second;
+        const kernels::QuantizedRows a =
+            executor.q8(node.in[0], ctx.rows[executor.graph().values()[node.in[0]].rows]);
+        const int64_t blocks = a.k / kernels::kBlock;
+        for (int64_t r = 0; r < a.rows; ++r) {
+            const int8_t* q = a.q + r * a.k;
+            for (int64_t b = 0; b < blocks; ++b) {
+                const double s = a.scales[r * blocks + b];
+                const double s2 = s * s;
+                for (int64_t i = b * kernels::kBlock; i < (b + 1) * kernels::kBlock; ++i) {
+                    e.sum[static_cast<size_t>(i)] += s2 * q[i] * q[i];
+                }
+            }
+        }
+        e.rows += a.rows;
+    });
+
+    try {
+        const ModelConfig& c = model.config();
+        const ModelOptions& o = model.options();
+        chunk_tokens = std::max<int64_t>(chunk_tokens, 1);
+        // f16 K and V of every layer for one chunk, plus a page of slack.
+        const auto per_token = static_cast<size_t>(c.n_layer * c.n_head_kv * c.head_dim * 2 * 2);
+        KvCache kv(model.kv_config(per_token * static_cast<size_t>(chunk_tokens + 32)));
+        std::vector<int32_t> outputs;
+        for (size_t begin = 0; begin < tokens.size(); begin += static_cast<size_t>(chunk_tokens)) {
+            const auto n = static_cast<int64_t>(std::min(tokens.size() - begin, static_cast<size_t>(chunk_tokens)));
+            const SeqId seq = kv.create();
+            if (!kv.reserve(seq, n)) {
+                throw_error("calibration: KV cache cannot hold a chunk of " + std::to_string(n) + " tokens");
+            }
+            for (int64_t pos = 0; pos < n; pos += o.max_batch_tokens) {
+                const int64_t rows = std::min(o.max_batch_tokens, n - pos);
+                // Logits of the last rows, so the output head is measured too.
+                outputs.clear();
+                for (int64_t r = std::max<int64_t>(0, rows - o.max_outputs); r < rows; ++r) {
+                    outputs.push_back(static_cast<int32_t>(r));
+                }
+                const StepSequence s{seq, pos, 0, rows};
+                StepBatch batch;
+                batch.tokens = tokens.subspan(begin + static_cast<size_t>(pos), static_cast<size_t>(rows));
+                batch.sequences = std::span(&s, 1);
+                batch.output_rows = outputs;
+                model.forward(batch, kv, pool);
+            }
+            kv.release(seq);
+            stats.tokens_ += n;
+            ++stats.chunks_;
+        }
+    } catch (...) {
+        model.set_observer({});
+        throw;
+    }
+    model.set_observer({});
+    std::erase_if(stats.entries_, [](const auto& entry) { return entry.second.rows == 0; });
+    return stats;
+}
+
+std::vector<float> ActivationStats::importance(std::string_view weight) const {
+    const auto it = entries_.find(std::string(weight));
+    if (it == entries_.end()) {
+        return {};
+    }
+    const Entry& e = it->second;
+    std::vector<float> mean(e.sum.size());
+    for (size_t i = 0; i < mean.size(); ++i) {
+        mean[i] = static_cast<float>(e.sum[i] / static_cast<double>(e.rows));
+    }
+    return mean;
+}
+
+void quantize_row(const float* x, int64_t k, DType type, const float* importance, uint8_t* dst) {
+    double err[2] = {};
+    quantize_row_impl(x, k, type, importance, dst, err);
+}
+
+QuantizeResult quantize_model(const ModelFile& src, const std::string& path, const QuantizeOptions& options,
+                              ThreadPool* pool) {
+    if (options.type != DType::kQ4_0 && options.type != DType::kQ8_0) {
+        throw_error(std::string("quantize: weights cannot be quantized to ") + dtype_name(options.type));
+    }
+    for (const TensorTypeRule& rule : options.rules) {
+        if (!is_target(rule.type)) {
+            throw_error("quantize: rule '" + rule.pattern + "' names unsupported type " + dtype_name(rule.type));
+        }
+    }
+    const bool tied = src.find("output.weight") == nullptr;
+    const auto target_of = [&](const TensorView& t) {
+        if (t.n_dims != 2 || !t.name.ends_with(".weight") || !can_dequantize(t.dtype) || t.cols() % kBlock != 0) {
+            return t.dtype;
+        }
+        const std::string_view name = tied && t.name == "token_embd.weight" ? "output.weight" : t.name;
+        for (const TensorTypeRule& rule : options.rules) {
+            if (name.find(rule.pattern) != std::string_view::npos ||
+                t.name.find(rule.pattern) != std::string_view::npos) {
+                return rule.type;
+            }
+        }
+        return options.type;
+    };
+
+    QuantizeResult result;
+    std::vector<DType> types;
+    for (const TensorView& t : src.tensors()) {
+        types.push_back(target_of(t));
+        result.tensors.push_back({std::string(t.name), t.dtype, types.back(), 0.0});
+    }
+
+    // Header: the source metadata, then ours, then the tensor records.
+    std::vector<uint8_t> header;
+    append(header, kGgufMagic);
+    append(header, kGgufVersion);
+    append(header, static_cast<uint64_t>(src.tensors().size()));
+    const size_t kv_count_at = header.size();
+    append(header, uint64_t{0});
+    uint64_t kv_count = 0;
+    for (const MetaEntry& entry : src.metadata()) {
+        if (!replaced_key(entry.key)) {
+            const std::span<const uint8_t> bytes = entry.value.bytes();
+            append_meta(header, entry.key, entry.value.type(), bytes.data(), bytes.size());
+            ++kv_count;
+        }
+    }
+    const uint32_t quantization_version = 2;
+    const uint32_t ftype = file_type(options.type);
+    append_meta(header, "general.quantization_version", MetaType::kU32, &quantization_version, 4);
+    append_meta(header, "general.file_type", MetaType::kU32, &ftype, 4);
+    kv_count += 2;
+    if (options.stats != nullptr) {
+        const auto entries = static_cast<int32_t>(options.stats->size());
+        const auto chunks = static_cast<int32_t>(options.stats->chunks());
+        append_meta(header, "quantize.imatrix.entries_count", MetaType::kI32, &entries, 4);
+        append_meta(header, "quantize.imatrix.chunks_count", MetaType::kI32, &chunks, 4);
+        kv_count += 2;
+    }
+    std::memcpy(header.data() + kv_count_at, &kv_count, sizeof(kv_count));
+
+    const size_t alignment = src.alignment();
+    uint64_t data_cursor = 0;
+    std::vector<uint64_t> offsets;
+    for (size_t i = 0; i < src.tensors().size(); ++i) {
+        const TensorView& t = src.tensors()[i];
+        append_string(header, t.name);
+        append(header, t.n_dims);
+        for (uint32_t d = 0; d < t.n_dims; ++d) {
+            append(header, static_cast<uint64_t>(t.ne[d]));
+        }
+        append(header, static_cast<uint32_t>(types[i]));
+        append(header, data_cursor);
+        offsets.push_back(data_cursor);
+        const size_t bytes = tensor_bytes(t, types[i]);
+        result.bytes_in += t.nbytes;
+        result.bytes_out += bytes;
+        data_cursor = align_up(data_cursor + bytes, alignment);
+    }
+    const size_t data_offset = align_up(header.size(), alignment);
+    const size_t file_size = data_offset + data_cursor;
+
+    const std::filesystem::path target(path);
+    if (target.has_parent_path()) {
+        std::error_code ec;
+        std::filesystem::create_directories(target.parent_path(), ec);
+        if (ec) {
+            throw_error("create " + target.parent_path().string() + ": " + ec.message());
+        }
+    }
+    const std::string tmp = path + ".tmp." + std::to_string(getpid());
+    FdGuard fd(::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+    if (fd.get() < 0) {
+        throw_errno("create " + tmp);
+    }
+    if (ftruncate(fd.get(), static_cast<off_t>(file_size)) != 0) {
+        const int saved = errno;
+        ::unlink(tmp.c_str());
+        errno = saved;
+        throw_errno("ftruncate " + tmp);
+    }
+    // As for packed weights, rows go straight into the page cache.
+    void* addr = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+    if (addr == MAP_FAILED) {
+        const int saved = errno;
+        ::unlink(tmp.c_str());
+        errno = saved;
+        throw_errno("mmap " + tmp);
+    }
+    auto* out = static_cast<uint8_t*>(addr);
+    try {
+        std::memcpy(out, header.data(), header.size());
+        const int workers = pool != nullptr ? pool->size() : 1;
+        std::vector<std::vector<float>> rows(static_cast<size_t>(workers));
+        std::vector<std::array<double, 2>> errors(static_cast<size_t>(workers));
+        for (size_t i = 0; i < src.tensors().size(); ++i) {
+            const TensorView& t = src.tensors()[i];
+            const DType type = types[i];
+            uint8_t* dst = out + data_offset + offsets[i];
+            if (type == t.dtype) {
+                std::memcpy(dst, t.data, t.nbytes);
+                continue;
+            }
+            const std::vector<float> importance =
+                options.stats != nullptr ? options.stats->importance(t.name) : std::vector<float>{};
+            const float* imp = importance.size() == static_cast<size_t>(t.cols()) ? importance.data() : nullptr;
+            const size_t out_row = tensor_bytes(t, type) / static_cast<size_t>(t.rows());
+            std::fill(errors.begin(), errors.end(), std::array<double, 2>{});
+            const auto run = [&](int64_t task, int worker) {
+                std::vector<float>& row = rows[static_cast<size_t>(worker)];
+                row.resize(static_cast<size_t>(t.cols()));
+                const int64_t end = std::min(t.rows(), (task + 1) * kRowsPerTask);
+                for (int64_t r = task * kRowsPerTask; r < end; ++r) {
+                    dequantize_row(t, r, row.data());
+                    uint8_t* o = dst + static_cast<size_t>(r) * out_row;
+                    if (type == DType::kF32) {
+                        std::memcpy(o, row.data(), row.size() * sizeof(float));
+                    } else if (type == DType::kF16) {
+                        for (size_t c = 0; c < row.size(); ++c) {
+                            const uint16_t h = fp32_to_fp16(row[c]);
+                            std::memcpy(o + 2 * c, &h, sizeof(h));
+                        }
+                    } else {
+                        quantize_row_impl(row.data(), t.cols(), type, imp, o,
+                                          errors[static_cast<size_t>(worker)].data());
+                    }
+                }
+            };
+            const int64_t tasks = (t.rows() + kRowsPerTask - 1) / kRowsPerTask;
+            if (pool != nullptr && tasks > 1) {
+                pool->parallel_for(tasks, run);
+            } else {
+                for (int64_t task = 0; task < tasks; ++task) {
+                    run(task, 0);
+                }
+            }
+            double err = 0.0;
+            double signal = 0.0;
+            for (const auto& e : errors) {
+                err += e[0];
+                signal += e[1];
+            }
+            result.tensors[i].error = signal > 0.0 ? err / signal : 0.0;
+            src.advise(t, Advice::kDontNeed);
+        }
+    } catch (...) {
+        munmap(addr, file_size);
+        ::unlink(tmp.c_str());
+        throw;
+    }
+    const bool synced = msync(addr, file_size, MS_SYNC) == 0;
+    munmap(addr, file_size);
+    if (!synced || fsync(fd.get()) != 0 || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        const int saved = errno;
+        ::unlink(tmp.c_str());
+        errno = saved;
+        throw_errno("write " + path);
+    }
+    return result;
+}
+
+} // namespace neuroctx
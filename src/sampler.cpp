@@ -0,0 +1,197 @@
+#include "neuroctx/sampler.h"
+
+#include "neuroctx/common.h"
+#include "neuroctx/thread_pool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <string>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace neuroctx {
+
+namespace {
+
+constexpr int64_t kBlock = 16;
+
+// Candidate order: higher logits first, then lower ids, so ties resolve
+// like argmax.
+constexpr auto kBetter = [](const auto& a, const auto& b) {
+    return a.logit > b.logit || (a.logit == b.logit && a.token < b.token);
+};
+
+// splitmix64 as a double in [0, 1).
+double next_uniform(uint64_t& state) {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    z ^= z >> 31;
+    return static_cast<double>(z >> 11) * 0x1.0p-53;
+}
+
+float block_max(const float* p) {
+#if defined(__aarch64__)
+    const float32x4_t a = vmaxq_f32(vld1q_f32(p), vld1q_f32(p + 4));
+    const float32x4_t b = vmaxq_f32(vld1q_f32(p + 8), vld1q_f32(p + 12));
+    return vmaxvq_f32(vmaxq_f32(a, b));
+#else
+    float m = p[0];
+    for (int64_t i = 1; i < kBlock; ++i) {
+        m = std::max(m, p[i]);
+    }
+    return m;
+#endif
+}
+
+// The kBlock bits of `bits` for tokens first .. first + kBlock - 1.
+uint32_t block_bits(std::span<const uint64_t> bits, int64_t first) {
+    return static_cast<uint32_t>(bits[static_cast<size_t>(first / 64)] >> (first % 64)) & 0xffff;
+}
+
+bool test_bit(std::span<const uint64_t> bits, int64_t i) {
+    return (bits[static_cast<size_t>(i / 64)] >> (i % 64) & 1) != 0;
+}
+
+void check_mask(std::span<const float> logits, TokenMask allowed) {
+    if (!allowed.empty() && allowed.size() * 64 < logits.size()) {
+        throw_error("sampler: token mask of " + std::to_string(allowed.size() * 64) + " bits for a vocabulary of " +
+                    std::to_string(logits.size()));
+    }
+}
+
+} // namespace
+
+void Sampler::offer(float logit, int32_t token, size_t k) {
+    if (std::isnan(logit)) {
+        return;
+    }
+    const Candidate c{logit, token};
+    if (heap_.size() < k) {
+        heap_.push_back(c);
+        std::push_heap(heap_.begin(), heap_.end(), kBetter);
+    } else if (kBetter(c, heap_.front())) {
+        std::pop_heap(heap_.begin(), heap_.end(), kBetter);
+        heap_.back() = c;
+        std::push_heap(heap_.begin(), heap_.end(), kBetter);
+    }
+}
+
+int32_t Sampler::sample(std::span<const float> logits, const SamplingParams& params, std::span<const int32_t> recent,
+                        TokenMask allowed, uint64_t& rng) {
+    check_mask(logits, allowed);
+    const auto vocab = static_cast<int64_t>(logits.size());
+    const bool greedy = params.temperature <= 0.0f;
+    const size_t k = greedy ? 1
+                     : params.top_k <= 0 ? static_cast<size_t>(vocab)
+                                         : static_cast<size_t>(std::min<int64_t>(params.top_k, vocab));
+    const bool penalize = params.repetition_penalty != 1.0f && params.penalty_last_n > 0 && !recent.empty();
+    if (penalize) {
+        recent = recent.last(std::min(recent.size(), static_cast<size_t>(params.penalty_last_n)));
+        penalized_.resize(std::max(penalized_.size(), static_cast<size_t>((vocab + 63) / 64)));
+        for (const int32_t t : recent) {
+            if (t >= 0 && t < vocab) {
+                penalized_[static_cast<size_t>(t / 64)] |= uint64_t{1} << (t % 64);
+            }
+        }
+    }
+
+    heap_.clear();
+    const float* row = logits.data();
+    float threshold = -std::numeric_limits<float>::infinity();
+    int64_t i = 0;
+    for (; i + kBlock <= vocab; i += kBlock) {
+        uint32_t bits = allowed.empty() ? 0xffff : block_bits(allowed, i);
+        if (penalize) {
+            bits &= ~block_bits(penalized_, i);
+        }
+        // Nothing in the block can displace the current k-th best (ties
+        // lose to the lower id already held).
+        if (bits == 0 || (heap_.size() == k && block_max(row + i) <= threshold)) {
+            continue;
+        }
+        for (; bits != 0; bits &= bits - 1) {
+            const int64_t t = i + std::countr_zero(bits);
+            offer(row[t], static_cast<int32_t>(t), k);
+        }
+        if (heap_.size() == k) {
+            threshold = heap_.front().logit;
+        }
+    }
+    for (; i < vocab; ++i) {
+        if ((allowed.empty() || test_bit(allowed, i)) && !(penalize && test_bit(penalized_, i))) {
+            offer(row[i], static_cast<int32_t>(i), k);
+        }
+    }
+    if (penalize) {
+        const float penalty = params.repetition_penalty;
+        for (const int32_t t : recent) {
+            if (t < 0 || t >= vocab || !test_bit(penalized_, t)) {
+                continue; // out of range, or a repeat already offered
+            }
+            penalized_[static_cast<size_t>(t / 64)] &= ~(uint64_t{1} << (t % 64));
+            if (allowed.empty() || test_bit(allowed, t)) {
+                const float l = row[t];
+                offer(l > 0.0f ? l / penalty : l * penalty, t, k);
+            }
+        }
+    }
+
+    if (heap_.empty()) {
+        return -1;
+    }
+    if (greedy) {
+        return heap_.front().token;
+    }
+    std::sort_heap(heap_.begin(), heap_.end(), kBetter);
+    // Softmax over the candidates as running sums, cut at top_p of the mass.
+    const float inv_t = 1.0f / params.temperature;
+    const float top = heap_.front().logit;
+    weights_.resize(heap_.size());
+    float total = 0.0f;
+    for (size_t c = 0; c < heap_.size(); ++c) {
+        total += std::exp((heap_[c].logit - top) * inv_t);
+        weights_[c] = total;
+    }
+    const float mass = std::clamp(params.top_p, 0.0f, 1.0f) * total;
+    const size_t kept = static_cast<size_t>(std::lower_bound(weights_.begin(), weights_.end(), mass) - weights_.begin());
+    const size_t last = std::min(kept, heap_.size() - 1);
+    const double u = next_uniform(rng) * weights_[last];
+    const size_t pick = static_cast<size_t>(
+        std::upper_bound(weights_.begin(), weights_.begin() + static_cast<int64_t>(last), static_cast<float>(u)) -
+        weights_.begin());
+    return heap_[pick].token;
+}
+
+void BatchSampler::sample(std::span<SampleJob> jobs, ThreadPool* pool) {
+    for (const SampleJob& job : jobs) {
+        if (job.params != nullptr) {
+            check_mask(job.logits, job.allowed); // before any worker can throw
+        }
+    }
+    const int workers = pool != nullptr && jobs.size() > 1 ? pool->size() : 1;
+    if (samplers_.size() < static_cast<size_t>(workers)) {
+        samplers_.resize(static_cast<size_t>(workers));
+    }
+    const auto run = [&](int64_t i, int worker) {
+        SampleJob& job = jobs[static_cast<size_t>(i)];
+        if (job.params == nullptr) {
+            return;
+        }
+        job.token = samplers_[static_cast<size_t>(worker)].sample(job.logits, *job.params, job.recent, job.allowed,
+                                                                  *job.rng);
+    };
+    if (workers == 1) {
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            run(static_cast<int64_t>(i), 0);
+        }
+        return;
+    }
+    pool->parallel_for(static_cast<int64_t>(jobs.size()), run);
+}
+
+} // namespace neuroctx
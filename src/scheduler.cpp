@@ -0,0 +1,360 @@
+#include "neuroctx/scheduler.h"
+
+#include "neuroctx/common.h"
+#include "neuroctx/hash.h"
+#include "neuroctx/lora.h"
+#include "neuroctx/model.h"
+
+#include <algorithm>
+
+namespace neuroctx {
+
+Scheduler::Scheduler(Model& model, KvCache& kv, ThreadPool* pool, const SchedulerOptions& options)
+    : model_(model), kv_(kv), pool_(pool), options_(options) {
+    options_.max_batch_tokens = std::clamp<int64_t>(options_.max_batch_tokens, 1, model.options().max_batch_tokens);
+    options_.max_running = std::max(options_.max_running, 1);
+    max_outputs_ = model.options().max_outputs;
+    if (max_outputs_ <= 0) {
+        throw_error("scheduler: the model was planned without output rows");
+    }
+    batch_tokens_.reserve(static_cast<size_t>(options_.max_batch_tokens));
+    batch_seqs_.reserve(static_cast<size_t>(options_.max_running));
+    batch_owner_.reserve(static_cast<size_t>(options_.max_running));
+    batch_outputs_.reserve(static_cast<size_t>(max_outputs_));
+    output_owner_.reserve(static_cast<size_t>(max_outputs_));
+    sample_jobs_.reserve(static_cast<size_t>(max_outputs_));
+}
+
+void Scheduler::set_max_batch_tokens(int64_t tokens) {
+    options_.max_batch_tokens = std::clamp<int64_t>(tokens, 1, model_.options().max_batch_tokens);
+    batch_tokens_.reserve(static_cast<size_t>(options_.max_batch_tokens));
+}
+
+void Scheduler::set_memory_pressure(MemoryPressure level) {
+    pressure_ = level;
+    if (level == MemoryPressure::kNone) {
+        return;
+    }
+    if (level == MemoryPressure::kCritical) {
+        // Newest first, so preempt() queues them back in admission order.
+        while (!running_.empty()) {
+            preempt(running_.back());
+            ++stats_.spilled;
+        }
+        model_.release_memory();
+    }
+    kv_.trim();
+}
+
+Scheduler::Request& Scheduler::get(RequestId id) {
+    auto it = requests_.find(id);
+    if (it == requests_.end()) {
+        throw_error("scheduler: unknown request " + std::to_string(id));
+    }
+    return it->second;
+}
+
+const Scheduler::Request& Scheduler::get(RequestId id) const { return const_cast<Scheduler*>(this)->get(id); }
+
+RequestId Scheduler::submit(GenerateRequest request) {
+    if ((request.prompt.empty() && request.input_complete) || request.max_new_tokens <= 0) {
+        throw_error("scheduler: a request needs a prompt and max_new_tokens > 0");
+    }
+    const RequestId id = next_id_++;
+    Request& r = requests_[id];
+    r.tokens = request.prompt;
+    r.prompt_tokens = request.prompt.size();
+    r.input_open = !request.input_complete;
+    r.rng = request.sampling.seed != 0 ? request.sampling.seed : hash_mix(kFnvOffset, static_cast<uint64_t>(id));
+    r.spec = std::move(request);
+    waiting_.push_back(id);
+    return id;
+}
+
+void Scheduler::append_input(RequestId id, std::span<const int32_t> tokens, bool last) {
+    Request& r = get(id);
+    if (!r.input_open) {
+        throw_error("scheduler: request " + std::to_string(id) + " does not take more input");
+    }
+    if (last && r.tokens.empty() && tokens.empty()) {
+        throw_error("scheduler: request " + std::to_string(id) + " closed its input without a prompt");
+    }
+    r.tokens.insert(r.tokens.end(), tokens.begin(), tokens.end());
+    r.prompt_tokens = r.tokens.size();
+    r.input_open = !last;
+}
+
+void Scheduler::cancel(RequestId id) {
+    Request& r = get(id);
+    if (r.state == RequestState::kQueued) {
+        waiting_.erase(std::find(waiting_.begin(), waiting_.end(), id));
+    }
+    if (r.state == RequestState::kQueued || r.state == RequestState::kRunning) {
+        finish(r, RequestState::kCancelled);
+        running_.erase(std::remove(running_.begin(), running_.end(), id), running_.end());
+    }
+}
+
+void Scheduler::release(RequestId id) {
+    const Request& r = get(id);
+    if (r.state == RequestState::kQueued || r.state == RequestState::kRunning) {
+        throw_error("scheduler: request " + std::to_string(id) + " is still active");
+    }
+    requests_.erase(id);
+}
+
+RequestState Scheduler::state(RequestId id) const { return get(id).state; }
+
+std::span<const int32_t> Scheduler::output(RequestId id) const {
+    const Request& r = get(id);
+    return std::span<const int32_t>(r.tokens).subspan(r.prompt_tokens);
+}
+
+void Scheduler::admit() {
+    while (!waiting_.empty() && static_cast<int32_t>(running_.size()) < options_.max_running) {
+        const RequestId id = waiting_.front();
+        Request& r = get(id);
+        // Admit only what can make progress now; otherwise a request would
+        // be admitted just to be preempted again.
+        const KvCacheStats kv = kv_.stats();
+        const int64_t first_chunk = std::min({static_cast<int64_t>(r.tokens.size()), options_.max_batch_tokens,
+                                              options_.prefill_chunk});
+        if (kv.pages_free + kv.pages_cached < kv_.pages_for(first_chunk) + 1 && !running_.empty()) {
+            break;
+        }
+        waiting_.pop_front();
+        r.seq = kv_.create(adapter_salt(r.spec.prefix_salt, r.spec.adapter));
+        r.computed = kv_.match_prefix(r.seq, r.tokens);
+        stats_.prefix_tokens_reused += r.computed;
+        r.state = RequestState::kRunning;
+        running_.push_back(id);
+    }
+}
+
+void Scheduler::preempt(RequestId id) {
+    Request& r = get(id);
+    kv_.release(r.seq);
+    r.seq = -1;
+    r.computed = 0;
+    r.state = RequestState::kQueued;
+    running_.erase(std::find(running_.begin(), running_.end(), id));
+    waiting_.push_front(id);
+    ++stats_.preemptions;
+}
+
+bool Scheduler::in_batch(RequestId id) const {
+    return std::find(batch_owner_.begin(), batch_owner_.end(), id) != batch_owner_.end();
+}
+
+// Reserves KV for `n` positions of `id`, preempting requests that are not
+// part of the step being built. An interactive request evicts background
+// requests first, then interactive ones admitted after it; a background
+// request only evicts background requests admitted after it.
+bool Scheduler::reserve_or_preempt(RequestId id, int64_t n) {
+    Request& r = get(id);
+    const bool interactive = r.spec.priority == RequestPriority::kInteractive;
+    while (!kv_.reserve(r.seq, n)) {
+        auto victim = running_.end();
+        bool older = false; // scanning requests admitted before `id`
+        for (auto it = running_.end(); it != running_.begin();) {
+            --it;
+            if (*it == id) {
+                older = true;
+                continue;
+            }
+            if (in_batch(*it)) {
+                continue;
+            }
+            if (get(*it).spec.priority == RequestPriority::kBackground && (interactive || !older)) {
+                victim = it;
+                break;
+            }
+            if (interactive && !older && victim == running_.end()) {
+                victim = it;
+            }
+        }
+        if (victim == running_.end()) {
+            return false;
+        }
+        preempt(*victim);
+    }
+    return true;
+}
+
+void Scheduler::finish(Request& r, RequestState state) {
+    if (r.seq >= 0) {
+        kv_.release(r.seq);
+        r.seq = -1;
+    }
+    r.state = state;
+}
+
+bool Scheduler::step() {
+    if (pressure_ == MemoryPressure::kCritical) {
+        return false;
+    }
+    admit();
+    if (running_.empty()) {
+        return false;
+    }
+    // Preemption erases from running_ while the loops below walk it; they
+    // walk this copy instead and skip what was preempted.
+    step_order_.assign(running_.begin(), running_.end());
+    batch_tokens_.clear();
+    batch_seqs_.clear();
+    batch_outputs_.clear();
+    batch_owner_.clear();
+    output_owner_.clear();
+    int64_t budget = options_.max_batch_tokens;
+    bool blocked = false; // had work but no KV for it
+
+    const auto add = [&](RequestId id, Request& r, int64_t n) {
+        StepSequence s;
+        s.seq = r.seq;
+        s.pos = r.computed;
+        s.first_row = static_cast<int64_t>(batch_tokens_.size());
+        s.rows = n;
+        s.adapter = r.spec.adapter;
+        batch_tokens_.insert(batch_tokens_.end(), r.tokens.begin() + r.computed, r.tokens.begin() + r.computed + n);
+        if (!r.input_open && r.computed + n == static_cast<int64_t>(r.tokens.size())) {
+            batch_outputs_.push_back(static_cast<int32_t>(s.first_row + n - 1));
+            output_owner_.push_back(id);
+        }
+        batch_seqs_.push_back(s);
+        batch_owner_.push_back(id);
+        budget -= n;
+    };
+    constexpr RequestPriority kOrder[] = {RequestPriority::kInteractive, RequestPriority::kBackground};
+
+    // Decode tokens first: one row each, latency matters most here.
+    bool interactive_decode = false;
+    for (const RequestPriority priority : kOrder) {
+        for (size_t i = 0; i < step_order_.size() && budget > 0; ++i) {
+            const RequestId id = step_order_[i];
+            Request& r = get(id);
+            if (r.state != RequestState::kRunning || r.spec.priority != priority || r.input_open ||
+                static_cast<int64_t>(r.tokens.size()) - r.computed != 1 ||
+                static_cast<int64_t>(batch_outputs_.size()) >= max_outputs_) {
+                continue;
+            }
+            if (!reserve_or_preempt(id, 1)) {
+                blocked = true;
+                continue;
+            }
+            add(id, r, 1);
+            interactive_decode |= priority == RequestPriority::kInteractive;
+        }
+    }
+    // Prompt chunks fill the rest of the budget, interactive and oldest
+    // first. Next to interactive decodes they only get a bounded share, so
+    // a long prompt is spread over several steps instead of stalling them.
+    int64_t prefill_budget = interactive_decode ? std::max<int64_t>(options_.prefill_tokens_with_decode, 1) : budget;
+    for (const RequestPriority priority : kOrder) {
+        for (size_t i = 0; i < step_order_.size() && budget > 0 && prefill_budget > 0; ++i) {
+            const RequestId id = step_order_[i];
+            Request& r = get(id);
+            const int64_t remaining = static_cast<int64_t>(r.tokens.size()) - r.computed;
+            // An open input keeps its last token back: it produces the
+            // first output once the input is closed.
+            const int64_t ready = r.input_open ? remaining - 1 : remaining;
+            if (r.state != RequestState::kRunning || r.spec.priority != priority || ready <= 0 ||
+                (!r.input_open && remaining == 1)) {
+                continue; // waiting for input, or decoding (handled above)
+            }
+            int64_t n = std::min({ready, budget, prefill_budget, std::max<int64_t>(options_.prefill_chunk, 1)});
+            if (!r.input_open && n == remaining && static_cast<int64_t>(batch_outputs_.size()) >= max_outputs_) {
+                --n; // leave the last prompt token for a step with a free output row
+            }
+            if (n <= 0) {
+                continue;
+            }
+            if (!reserve_or_preempt(id, n)) {
+                blocked = true;
+                continue;
+            }
+            add(id, r, n);
+            prefill_budget -= n;
+        }
+    }
+
+    if (batch_seqs_.empty()) {
+        if (!blocked) {
+            return false; // every running request waits for streamed input
+        }
+        // Nothing fits next to the requests holding KV: make room, taking
+        // the newest background request and else the newest one.
+        if (running_.size() > 1) {
+            auto victim = std::find_if(running_.rbegin(), running_.rend(), [&](RequestId id) {
+                return get(id).spec.priority == RequestPriority::kBackground;
+            });
+            preempt(victim != running_.rend() ? *victim : running_.back());
+            return true;
+        }
+        throw_error("scheduler: the KV cache cannot hold a single request");
+    }
+
+    StepBatch batch;
+    batch.tokens = batch_tokens_;
+    batch.sequences = batch_seqs_;
+    batch.output_rows = batch_outputs_;
+    const float* logits = model_.forward(batch, kv_, pool_);
+    ++stats_.steps;
+    stats_.max_step_tokens = std::max(stats_.max_step_tokens, static_cast<int64_t>(batch_tokens_.size()));
+
+    for (size_t i = 0; i < batch_seqs_.size(); ++i) {
+        Request& r = get(batch_owner_[i]);
+        r.computed += batch_seqs_[i].rows;
+        if (batch_seqs_[i].rows == 1 && r.tokens.size() > r.prompt_tokens) {
+            ++stats_.decode_tokens;
+        } else {
+            stats_.prefill_tokens += batch_seqs_[i].rows;
+        }
+    }
+    const auto vocab = static_cast<size_t>(model_.config().n_vocab);
+    sample_jobs_.clear();
+    for (size_t o = 0; o < output_owner_.size(); ++o) {
+        Request& r = get(output_owner_[o]);
+        SampleJob job;
+        if (!r.spec.sample) {
+            job.logits = std::span<const float>(logits + o * vocab, vocab);
+            job.params = &r.spec.sampling;
+            job.recent = r.tokens;
+            job.allowed = r.spec.allowed_tokens ? r.spec.allowed_tokens(output_owner_[o]) : TokenMask{};
+            job.rng = &r.rng;
+        }
+        sample_jobs_.push_back(job);
+    }
+    sampler_.sample(sample_jobs_, pool_);
+    for (size_t o = 0; o < output_owner_.size(); ++o) {
+        const RequestId id = output_owner_[o];
+        Request& r = get(id);
+        const int32_t token = r.spec.sample ? r.spec.sample(std::span<const float>(logits + o * vocab, vocab))
+                                            : sample_jobs_[o].token;
+        if (token < 0) { // the mask allowed nothing
+            finish(r, RequestState::kFinished);
+            running_.erase(std::find(running_.begin(), running_.end(), id));
+            continue;
+        }
+        const bool stop =
+            std::find(r.spec.stop_tokens.begin(), r.spec.stop_tokens.end(), token) != r.spec.stop_tokens.end();
+        bool keep = !stop;
+        if (keep) {
+            r.tokens.push_back(token);
+            if (r.spec.on_token) {
+                keep = r.spec.on_token(id, token);
+            }
+        }
+        if (!keep || static_cast<int64_t>(r.tokens.size() - r.prompt_tokens) >= r.spec.max_new_tokens) {
+            finish(r, RequestState::kFinished);
+            running_.erase(std::find(running_.begin(), running_.end(), id));
+        }
+    }
+    return true;
+}
+
+void Scheduler::run() {
+    while (step()) {
+    }
+}
+
+} // namespace neuroctx
@@ -0,0 +1,246 @@
+#include "neuroctx/session.h"
+
+#include "neuroctx/common.h"
+
+#include <atomic>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace neuroctx {
+
+struct Session::Pending {
+    GenerateRequest request; // moved into the scheduler on admission
+    GenerateControl control;
+    std::coroutine_handle<> waiter;
+    std::atomic<bool> cancelled{false};
+    std::optional<std::stop_callback<std::function<void()>>> on_stop;
+
+    // Engine thread.
+    RequestId id = 0;
+    bool deadline_hit = false;
+
+    // Guarded by Session::mutex_.
+    std::vector<int32_t> fresh; // generated, not yet delivered
+    bool done = false;
+    bool posted = false; // a deliver() is queued on the loop
+    GenerateStatus status = GenerateStatus::kFinished;
+    std::exception_ptr failure;
+
+    // Loop thread.
+    std::vector<int32_t> tokens;
+    std::exception_ptr callback_error;
+};
+
+Session::Session(Model& model, KvCache& kv, EventLoop& loop, ThreadPool* pool, const SchedulerOptions& options)
+    : loop_(loop), pool_(pool), scheduler_(model, kv, pool, options) {
+    engine_ = std::thread([this] { engine_main(); });
+}
+
+Session::~Session() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+    }
+    wake_.notify_one();
+    engine_.join();
+}
+
+Session::GenerateAwaiter Session::generate(GenerateRequest request, GenerateControl control) {
+    if (!request.input_complete) {
+        throw_error("session: streaming input is not supported; submit the whole prompt");
+    }
+    if (request.on_token) {
+        throw_error("session: stream through GenerateControl::on_token, not GenerateRequest::on_token");
+    }
+    if (request.prompt.empty() || request.max_new_tokens <= 0) {
+        throw_error("session: a request needs a prompt and max_new_tokens > 0");
+    }
+    auto p = std::make_shared<Pending>();
+    p->request = std::move(request);
+    p->control = std::move(control);
+    return GenerateAwaiter(this, std::move(p));
+}
+
+SchedulerStats Session::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void Session::between_steps(std::function<void(Scheduler&, ThreadPool*)> fn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tuning_.push_back(std::move(fn));
+    }
+    wake_.notify_one();
+}
+
+void Session::start(const std::shared_ptr<Pending>& p, std::coroutine_handle<> h) {
+    p->waiter = h;
+    if (p->control.stop.stop_possible()) {
+        // Runs at once when stop was already requested.
+        p->on_stop.emplace(p->control.stop, [this, raw = p.get()] { cancel(*raw); });
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        incoming_.push_back(p);
+    }
+    wake_.notify_one();
+}
+
+void Session::cancel(Pending& p) {
+    p.cancelled.store(true, std::memory_order_relaxed);
+    {
+        // Pairs with the engine's predicate check, so the wakeup is not lost.
+        std::lock_guard<std::mutex> lock(mutex_);
+    }
+    wake_.notify_one();
+}
+
+GenerateResult Session::collect(Pending& p) {
+    p.on_stop.reset();
+    if (p.failure) {
+        std::rethrow_exception(p.failure);
+    }
+    if (p.callback_error) {
+        std::rethrow_exception(p.callback_error);
+    }
+    GenerateResult result;
+    result.status = p.status;
+    result.tokens = std::move(p.tokens);
+    return result;
+}
+
+void Session::deliver(const std::shared_ptr<Pending>& p) {
+    std::vector<int32_t> fresh;
+    bool done = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fresh.swap(p->fresh);
+        done = p->done;
+        p->posted = false;
+    }
+    for (const int32_t token : fresh) {
+        p->tokens.push_back(token);
+        if (!p->control.on_token || p->cancelled.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        try {
+            if (!p->control.on_token(token)) {
+                cancel(*p);
+            }
+        } catch (...) {
+            p->callback_error = std::current_exception();
+            cancel(*p);
+        }
+    }
+    if (done && p->waiter) {
+        std::exchange(p->waiter, nullptr).resume();
+    }
+}
+
+void Session::engine_main() {
+    std::vector<std::shared_ptr<Pending>> touched;
+    std::vector<std::shared_ptr<Pending>> rejected;
+    std::vector<std::function<void(Scheduler&, ThreadPool*)>> tuning;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        // Sleep while there is nothing to step; a cancellation of an active
+        // request also wakes the thread, to be acted on below.
+        wake_.wait(lock, [&] { return quit_ || !incoming_.empty() || !active_.empty() || !tuning_.empty(); });
+        if (quit_) {
+            break;
+        }
+        tuning.swap(tuning_);
+        for (auto& p : incoming_) {
+            GenerateRequest request = std::move(p->request);
+            Pending* raw = p.get();
+            request.on_token = [this, raw](RequestId, int32_t token) {
+                std::lock_guard<std::mutex> guard(mutex_);
+                raw->fresh.push_back(token);
+                return !raw->cancelled.load(std::memory_order_relaxed);
+            };
+            try {
+                p->id = scheduler_.submit(std::move(request));
+            } catch (...) {
+                // Fails this request alone; the scheduler has not taken it.
+                p->done = true;
+                p->posted = true;
+                p->failure = std::current_exception();
+                rejected.push_back(std::move(p));
+                continue;
+            }
+            active_.push_back(std::move(p));
+        }
+        incoming_.clear();
+        lock.unlock();
+        for (auto& fn : tuning) {
+            fn(scheduler_, pool_);
+        }
+        tuning.clear();
+
+        const auto now = std::chrono::steady_clock::now();
+        for (auto& p : active_) {
+            const RequestState state = scheduler_.state(p->id);
+            if (state != RequestState::kQueued && state != RequestState::kRunning) {
+                continue;
+            }
+            if (p->cancelled.load(std::memory_order_relaxed)) {
+                scheduler_.cancel(p->id);
+            } else if (now >= p->control.deadline) {
+                p->deadline_hit = true;
+                scheduler_.cancel(p->id);
+            }
+        }
+        std::exception_ptr failure;
+        bool stepped = false;
+        try {
+            stepped = scheduler_.step();
+        } catch (...) {
+            // The scheduler state is unknown after a failed step: fail every
+            // request it holds, the ones it was not stepping included.
+            failure = std::current_exception();
+            for (auto& p : active_) {
+                const RequestState state = scheduler_.state(p->id);
+                if (state == RequestState::kQueued || state == RequestState::kRunning) {
+                    scheduler_.cancel(p->id);
+                }
+            }
+        }
+
+        lock.lock();
+        touched.swap(rejected);
+        rejected.clear();
+        for (auto& p : active_) {
+            const RequestState state = scheduler_.state(p->id);
+            if (state == RequestState::kFinished || state == RequestState::kCancelled) {
+                scheduler_.release(p->id);
+                p->done = true;
+                p->failure = failure;
+                if (p->deadline_hit) {
+                    p->status = GenerateStatus::kDeadline;
+                } else if (p->cancelled.load(std::memory_order_relaxed)) {
+                    p->status = GenerateStatus::kCancelled;
+                }
+            }
+            if ((p->done || !p->fresh.empty()) && !p->posted) {
+                p->posted = true;
+                touched.push_back(p);
+            }
+        }
+        std::erase_if(active_, [](const std::shared_ptr<Pending>& p) { return p->done; });
+        stats_ = scheduler_.stats();
+        lock.unlock();
+        for (auto& p : touched) {
+            loop_.post([this, p] { deliver(p); });
+        }
+        lock.lock();
+        if (!stepped && touched.empty() && incoming_.empty() && tuning_.empty() && !quit_) {
+            // Everything is queued behind the KV budget; poll for
+            // cancellations and deadlines rather than spin.
+            wake_.wait_for(lock, std::chrono::milliseconds(1));
+        }
+    }
+}
+
+} // namespace neuroctx
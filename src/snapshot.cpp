@@ -0,0 +1,249 @@
+#include "neuroctx/snapshot.h"
+
+#include "fd_io.h"
+#include "neuroctx/common.h"
+#include "neuroctx/hash.h"
+#include "neuroctx/mapped_file.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <type_traits>
+#include <unistd.h>
+
+namespace neuroctx {
+
+namespace {
+
+constexpr char kMagic[8] = {'N', 'C', 'T', 'X', 'S', 'N', 'A', 'P'};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    SnapshotKey key;
+    uint64_t values;
+    uint64_t nodes;
+};
+
+static_assert(std::is_trivially_copyable_v<SnapshotKey> && sizeof(SnapshotKey) == 56);
+static_assert(sizeof(SnapshotHeader) == 88);
+
+class Writer {
+public:
+    template <typename T>
+    void put(const T& v) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const auto* p = reinterpret_cast<const uint8_t*>(&v);
+        bytes_.insert(bytes_.end(), p, p + sizeof(T));
+    }
+    void put(const std::string& s) {
+        put(static_cast<uint32_t>(s.size()));
+        bytes_.insert(bytes_.end(), s.begin(), s.end());
+    }
+    std::vector<uint8_t>& bytes() { return bytes_; }
+
+private:
+    std::vector<uint8_t> bytes_;
+};
+
+// Bounds-checked; a short read leaves ok() false and zeroes.
+class Reader {
+public:
+    Reader(const uint8_t* data, size_t size) : p_(data), end_(data + size) {}
+
+    template <typename T>
+    T get() {
+        T v{};
+        if (static_cast<size_t>(end_ - p_) < sizeof(T)) {
+            ok_ = false;
+            p_ = end_;
+            return v;
+        }
+        std::memcpy(&v, p_, sizeof(T));
+        p_ += sizeof(T);
+        return v;
+    }
+    std::string get_string() {
+        const auto n = get<uint32_t>();
+        if (static_cast<size_t>(end_ - p_) < n) {
+            ok_ = false;
+            p_ = end_;
+            return {};
+        }
+        std::string s(reinterpret_cast<const char*>(p_), n);
+        p_ += n;
+        return s;
+    }
+    bool ok() const { return ok_; }
+    bool done() const { return p_ == end_; }
+
+private:
+    const uint8_t* p_;
+    const uint8_t* end_;
+    bool ok_ = true;
+};
+
+// Enums read back from a file must be in range before they are cast.
+template <typename E>
+bool get_enum(Reader& r, E last, E& out) {
+    const auto v = r.get<uint8_t>();
+    out = static_cast<E>(v);
+    return v <= static_cast<uint8_t>(last);
+}
+
+} // namespace
+
+void write_snapshot(const std::string& path, const SnapshotKey& key, const StartupSnapshot& snapshot) {
+    const Graph& g = snapshot.graph;
+    if (snapshot.weights.size() != g.nodes().size() || snapshot.plan.offsets.size() != g.values().size() ||
+        snapshot.plan.sizes.size() != g.values().size()) {
+        throw_error("snapshot: plan or weight names do not match the graph");
+    }
+    SnapshotHeader h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = StartupSnapshot::kFormatVersion;
+    h.key = key;
+    h.values = g.values().size();
+    h.nodes = g.nodes().size();
+
+    Writer w;
+    w.put(h);
+    for (const Value& v : g.values()) {
+        w.put(v.name);
+        w.put(static_cast<uint8_t>(v.type));
+        w.put(static_cast<uint8_t>(v.rows));
+        w.put(static_cast<uint8_t>(v.role));
+        w.put(v.cols);
+    }
+    for (size_t n = 0; n < g.nodes().size(); ++n) {
+        const Node& node = g.nodes()[n];
+        w.put(static_cast<uint8_t>(node.op));
+        w.put(node.in);
+        w.put(node.out);
+        w.put(node.f0);
+        w.put(node.i0);
+        w.put(node.i1);
+        w.put(node.layer);
+        w.put(node.label);
+        w.put(snapshot.weights[n][0]);
+        w.put(snapshot.weights[n][1]);
+    }
+    const MemoryPlan& plan = snapshot.plan;
+    w.put(plan.bounds.max);
+    for (size_t v = 0; v < g.values().size(); ++v) {
+        w.put(static_cast<uint64_t>(plan.offsets[v]));
+        w.put(static_cast<uint64_t>(plan.sizes[v]));
+    }
+    w.put(static_cast<uint64_t>(plan.arena_bytes));
+    w.put(static_cast<uint64_t>(plan.unshared_bytes));
+    w.put(fnv1a64(w.bytes().data(), w.bytes().size()));
+
+    const std::filesystem::path target(path);
+    if (target.has_parent_path()) {
+        std::error_code ec;
+        std::filesystem::create_directories(target.parent_path(), ec);
+        if (ec) {
+            throw_error("create " + target.parent_path().string() + ": " + ec.message());
+        }
+    }
+    const std::string tmp = path + ".tmp." + std::to_string(getpid());
+    bool ok = false;
+    {
+        FdGuard fd(::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+        if (fd.get() < 0) {
+            throw_errno("create " + tmp);
+        }
+        ok = write_all(fd.get(), w.bytes().data(), w.bytes().size()) && fsync(fd.get()) == 0;
+    }
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        const int saved = errno;
+        ::unlink(tmp.c_str());
+        errno = saved;
+        throw_errno("write " + path);
+    }
+}
+
+std::optional<StartupSnapshot> read_snapshot(const std::string& path, const SnapshotKey& key) {
+    if (::access(path.c_str(), R_OK) != 0) {
+        return std::nullopt;
+    }
+    MappedFile file = MappedFile::open(path, Advice::kSequential);
+    if (file.size() < sizeof(SnapshotHeader) + sizeof(uint64_t)) {
+        return std::nullopt;
+    }
+    SnapshotHeader h;
+    std::memcpy(&h, file.data(), sizeof(h));
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != StartupSnapshot::kFormatVersion ||
+        !(h.key == key)) {
+        return std::nullopt;
+    }
+    const size_t body = file.size() - sizeof(uint64_t);
+    uint64_t checksum = 0;
+    std::memcpy(&checksum, file.data() + body, sizeof(checksum));
+    if (checksum != fnv1a64(file.data(), body)) {
+        return std::nullopt;
+    }
+    // Every value and node takes more than one byte, which bounds the
+    // counts before anything is allocated for them.
+    if (h.values > body || h.nodes > body) {
+        return std::nullopt;
+    }
+
+    Reader r(file.data() + sizeof(h), body - sizeof(h));
+    StartupSnapshot s;
+    bool ok = true;
+    std::vector<Value>& values = s.graph.values();
+    values.resize(h.values);
+    for (Value& v : values) {
+        v.name = r.get_string();
+        ok &= get_enum(r, ValueType::kQ8, v.type);
+        ok &= get_enum(r, RowDim::kOne, v.rows);
+        ok &= get_enum(r, ValueRole::kOutput, v.role);
+        v.cols = r.get<int64_t>();
+    }
+    std::vector<Node>& nodes = s.graph.nodes();
+    nodes.resize(h.nodes);
+    s.weights.resize(h.nodes);
+    for (size_t n = 0; n < nodes.size(); ++n) {
+        Node& node = nodes[n];
+        ok &= get_enum(r, OpType::kAddRmsNorm, node.op);
+        node.in = r.get<decltype(node.in)>();
+        node.out = r.get<decltype(node.out)>();
+        node.f0 = r.get<float>();
+        node.i0 = r.get<int64_t>();
+        node.i1 = r.get<int64_t>();
+        node.layer = r.get<int32_t>();
+        node.label = r.get_string();
+        s.weights[n][0] = r.get_string();
+        s.weights[n][1] = r.get_string();
+    }
+    s.plan.bounds.max = r.get<decltype(s.plan.bounds.max)>();
+    s.plan.offsets.resize(h.values);
+    s.plan.sizes.resize(h.values);
+    for (size_t v = 0; v < values.size(); ++v) {
+        s.plan.offsets[v] = static_cast<size_t>(r.get<uint64_t>());
+        s.plan.sizes[v] = static_cast<size_t>(r.get<uint64_t>());
+        ok &= s.plan.offsets[v] + s.plan.sizes[v] >= s.plan.offsets[v];
+    }
+    s.plan.arena_bytes = static_cast<size_t>(r.get<uint64_t>());
+    s.plan.unshared_bytes = static_cast<size_t>(r.get<uint64_t>());
+    if (!ok || !r.ok() || !r.done()) {
+        return std::nullopt;
+    }
+    for (size_t v = 0; v < values.size(); ++v) {
+        if (s.plan.offsets[v] + s.plan.sizes[v] > s.plan.arena_bytes) {
+            return std::nullopt;
+        }
+    }
+    try {
+        s.graph.validate();
+    } catch (const Error&) {
+        return std::nullopt;
+    }
+    return s;
+}
+
+} // namespace neuroctx
@@ -0,0 +1,236 @@
+#include "neuroctx/speculative.h"
+
+#include "neuroctx/common.h"
+#include "neuroctx/hash.h"
+#include "neuroctx/lora.h"
+#include "neuroctx/model.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace neuroctx {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int32_t argmax(const float* logits, int64_t vocab) {
+    return static_cast<int32_t>(std::max_element(logits, logits + vocab) - logits);
+}
+
+// Releases the request's sequences however generate() exits.
+struct SequencePair {
+    KvCache& target_kv;
+    KvCache& draft_kv;
+    SeqId target;
+    SeqId draft;
+
+    ~SequencePair() {
+        target_kv.release(target);
+        draft_kv.release(draft);
+    }
+};
+
+} // namespace
+
+SpeculativeDecoder::SpeculativeDecoder(Model& target, KvCache& target_kv, Model& draft, KvCache& draft_kv,
+                                       ThreadPool* pool, const SpeculativeOptions& options)
+    : target_(target), target_kv_(target_kv), draft_(draft), draft_kv_(draft_kv), pool_(pool), options_(options) {
+    if (target.config().n_vocab != draft.config().n_vocab) {
+        throw_error("speculative: draft vocabulary (" + std::to_string(draft.config().n_vocab) +
+                    ") differs from the target's (" + std::to_string(target.config().n_vocab) + ")");
+    }
+    const int64_t verify_rows = std::min(target.options().max_outputs, target.options().max_batch_tokens);
+    if (verify_rows < 1 || draft.options().max_outputs < 1) {
+        throw_error("speculative: both models must be planned with output rows");
+    }
+    max_draft_ = static_cast<int32_t>(std::clamp<int64_t>(options_.max_draft, 0, verify_rows - 1));
+    options_.smoothing = std::clamp(options_.smoothing, 0.01f, 1.0f);
+    options_.probe_interval = std::max(options_.probe_interval, 1);
+    probe_interval_ = options_.probe_interval;
+    stats_.acceptance = 1.0f;
+    stats_.draft_length = std::clamp(options_.initial_draft, 0, max_draft_);
+    rows_.resize(static_cast<size_t>(max_draft_) + 1);
+    for (size_t i = 0; i < rows_.size(); ++i) {
+        rows_[i] = static_cast<int32_t>(i);
+    }
+}
+
+const float* SpeculativeDecoder::step(Model& model, KvCache& kv, SeqId seq, std::span<const int32_t> tokens,
+                                      int64_t outputs, const LoraAdapter* adapter) {
+    const auto rows = static_cast<int64_t>(tokens.size());
+    if (!kv.reserve(seq, rows)) {
+        throw_error("speculative: KV budget cannot hold the sequence");
+    }
+    // Output rows are the last `outputs` tokens; prefill chunks may be longer
+    // than rows_ but never ask for any.
+    std::span<const int32_t> output_rows;
+    if (outputs > 0) {
+        const int64_t first = rows - outputs;
+        if (first < 0 || rows > static_cast<int64_t>(rows_.size())) {
+            throw_error("speculative: step asks for more output rows than were planned");
+        }
+        output_rows = std::span<const int32_t>(rows_).subspan(static_cast<size_t>(first), static_cast<size_t>(outputs));
+    }
+    const StepSequence s{seq, kv.length(seq), 0, rows, adapter};
+    const StepBatch batch{tokens, std::span<const StepSequence>(&s, 1), output_rows};
+    return model.forward(batch, kv, pool_);
+}
+
+// Computes every token but the last past what the cache already holds, in
+// chunks of the model's planned batch, without logits.
+void SpeculativeDecoder::prefill(Model& model, KvCache& kv, SeqId seq, std::span<const int32_t> tokens,
+                                 const LoraAdapter* adapter) {
+    if (kv.length(seq) == 0) {
+        kv.match_prefix(seq, tokens);
+    }
+    const int64_t chunk = model.options().max_batch_tokens;
+    const auto end = static_cast<int64_t>(tokens.size()) - 1;
+    for (int64_t pos = kv.length(seq); pos < end;) {
+        const int64_t n = std::min<int64_t>(chunk, end - pos);
+        step(model, kv, seq, tokens.subspan(static_cast<size_t>(pos), static_cast<size_t>(n)), 0, adapter);
+        pos += n;
+    }
+}
+
+int32_t SpeculativeDecoder::choose_draft_length() const {
+    if (draft_seconds_ <= 0.0 || verify_seconds_ <= 0.0) {
+        return stats_.draft_length;
+    }
+    const double a = std::min(static_cast<double>(stats_.acceptance), 0.999);
+    int32_t best = 0;
+    double best_rate = 1.0 / verify_seconds_;
+    for (int32_t k = 1; k <= max_draft_; ++k) {
+        const double expected = (1.0 - std::pow(a, k + 1)) / (1.0 - a);
+        const double rate = expected / (k * draft_seconds_ + verify_seconds_ + k * verify_row_seconds_);
+        if (rate > best_rate) {
+            best = k;
+            best_rate = rate;
+        }
+    }
+    return best;
+}
+
+std::vector<int32_t> SpeculativeDecoder::generate(const GenerateRequest& request) {
+    if (request.prompt.empty() || request.max_new_tokens <= 0) {
+        throw_error("speculative: a request needs a prompt and max_new_tokens > 0");
+    }
+    const RequestId id = next_id_++;
+    const int64_t vocab = target_.config().n_vocab;
+    const float w = options_.smoothing;
+    SequencePair seqs{target_kv_, draft_kv_, target_kv_.create(adapter_salt(request.prefix_salt, request.adapter)),
+                      draft_kv_.create(request.prefix_salt)};
+
+    // Both caches hold a prefix of `tokens`; its last token is pending:
+    // known, but not yet run through the target.
+    std::vector<int32_t> tokens = request.prompt;
+    const size_t prompt_tokens = tokens.size();
+    uint64_t rng = request.sampling.seed != 0 ? request.sampling.seed : hash_mix(kFnvOffset, static_cast<uint64_t>(id));
+    prefill(target_, target_kv_, seqs.target, tokens, request.adapter);
+    prefill(draft_, draft_kv_, seqs.draft, tokens);
+
+    std::vector<int32_t> drafts(static_cast<size_t>(max_draft_));
+    std::vector<int32_t> verify(static_cast<size_t>(max_draft_) + 1);
+    bool done = false;
+    while (!done) {
+        const auto remaining = static_cast<int32_t>(request.max_new_tokens -
+                                                    static_cast<int64_t>(tokens.size() - prompt_tokens));
+        // The first round decodes alone to time a one-row target step.
+        int32_t k = verify_seconds_ > 0.0 ? stats_.draft_length : 0;
+        const bool probe = k == 0 && max_draft_ > 0 && verify_seconds_ > 0.0 && ++since_probe_ >= probe_interval_;
+        if (probe) {
+            since_probe_ = 0;
+            k = 1;
+        }
+        k = std::min(k, remaining - 1);
+
+        // Draft: catch the draft cache up to the pending token (it lags after
+        // rounds without drafts), then decode k - 1 more. The last draft's
+        // own K/V is never needed.
+        if (k > 0) {
+            const auto start = Clock::now();
+            prefill(draft_, draft_kv_, seqs.draft, tokens);
+            const float* logits = step(draft_, draft_kv_, seqs.draft, std::span<const int32_t>(&tokens.back(), 1), 1);
+            drafts[0] = argmax(logits, vocab);
+            for (int32_t i = 1; i < k; ++i) {
+                logits = step(draft_, draft_kv_, seqs.draft, std::span<const int32_t>(&drafts[i - 1], 1), 1);
+                drafts[i] = argmax(logits, vocab);
+            }
+            const double per_step = seconds_since(start) / k;
+            draft_seconds_ = draft_seconds_ > 0.0 ? (1.0 - w) * draft_seconds_ + w * per_step : per_step;
+            stats_.draft_steps += k;
+            stats_.drafted += k;
+        }
+
+        // Verify the pending token and every draft in one target pass.
+        const int64_t base = target_kv_.length(seqs.target);
+        verify[0] = tokens.back();
+        std::copy(drafts.begin(), drafts.begin() + k, verify.begin() + 1);
+        const auto start = Clock::now();
+        const float* logits = step(target_, target_kv_, seqs.target,
+                                   std::span<const int32_t>(verify.data(), static_cast<size_t>(k) + 1), k + 1, request.adapter);
+        const double verify_step = seconds_since(start);
+        if (k == 0) {
+            verify_seconds_ = verify_seconds_ > 0.0 ? (1.0 - w) * verify_seconds_ + w * verify_step : verify_step;
+        } else if (verify_seconds_ > 0.0) {
+            const double per_row = std::max(0.0, verify_step - verify_seconds_) / k;
+            verify_row_seconds_ = (1.0 - w) * verify_row_seconds_ + w * per_row;
+        }
+        ++stats_.rounds;
+
+        int32_t accepted = 0;
+        for (int32_t i = 0; i <= k && !done; ++i) {
+            const float* row = logits + static_cast<int64_t>(i) * vocab;
+            const std::span<const float> logits_row(row, static_cast<size_t>(vocab));
+            const int32_t token =
+                request.sample ? request.sample(logits_row)
+                               : sampler_.sample(logits_row, request.sampling, tokens,
+                                                 request.allowed_tokens ? request.allowed_tokens(id) : TokenMask{}, rng);
+            if (token < 0) {
+                done = true;
+                break;
+            }
+            const bool stop = std::find(request.stop_tokens.begin(), request.stop_tokens.end(), token) !=
+                              request.stop_tokens.end();
+            if (stop) {
+                done = true;
+                break;
+            }
+            tokens.push_back(token);
+            ++stats_.generated;
+            done = (request.on_token && !request.on_token(id, token)) ||
+                   static_cast<int64_t>(tokens.size() - prompt_tokens) >= request.max_new_tokens;
+            if (i == k || token != drafts[i]) {
+                break;
+            }
+            ++accepted;
+        }
+        stats_.accepted += accepted;
+        if (k > 0) {
+            const float rate = static_cast<float>(accepted) / static_cast<float>(k);
+            stats_.acceptance = (1.0f - w) * stats_.acceptance + w * rate;
+        }
+        stats_.draft_length = choose_draft_length();
+        if (probe) {
+            // Each failed probe waits twice as long; the draft has to catch
+            // up on every token since the last one.
+            probe_interval_ = stats_.draft_length > 0 ? options_.probe_interval
+                                                      : std::min(probe_interval_ * 2, options_.probe_interval * 16);
+        }
+
+        // Keep the pending token and the accepted drafts; the token the
+        // target picked after them is the new pending one.
+        target_kv_.truncate(seqs.target, base + 1 + accepted);
+        if (draft_kv_.length(seqs.draft) > base + 1 + accepted) {
+            draft_kv_.truncate(seqs.draft, base + 1 + accepted);
+        }
+    }
+    return std::vector<int32_t>(tokens.begin() + static_cast<std::ptrdiff_t>(prompt_tokens), tokens.end());
+}
+
+} // namespace neuroctx
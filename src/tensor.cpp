@@ -0,0 +1,120 @@
+#include "neuroctx/tensor.h"
+
+#include "neuroctx/common.h"
+
+#include <string>
+
+namespace neuroctx {
+
+namespace {
+
+struct DTypeEntry {
+    DType type;
+    DTypeInfo info;
+};
+
+constexpr DTypeEntry kDTypes[] = {
+    {DType::kF32, {"f32", 1, 4}},
+    {DType::kF16, {"f16", 1, 2}},
+    {DType::kQ4_0, {"q4_0", 32, 18}},
+    {DType::kQ4_1, {"q4_1", 32, 20}},
+    {DType::kQ5_0, {"q5_0", 32, 22}},
+    {DType::kQ5_1, {"q5_1", 32, 24}},
+    {DType::kQ8_0, {"q8_0", 32, 34}},
+    {DType::kQ8_1, {"q8_1", 32, 36}},
+    {DType::kQ2_K, {"q2_k", 256, 84}},
+    {DType::kQ3_K, {"q3_k", 256, 110}},
+    {DType::kQ4_K, {"q4_k", 256, 144}},
+    {DType::kQ5_K, {"q5_k", 256, 176}},
+    {DType::kQ6_K, {"q6_k", 256, 210}},
+    {DType::kQ8_K, {"q8_k", 256, 292}},
+    {DType::kIQ2_XXS, {"iq2_xxs", 256, 66}},
+    {DType::kIQ2_XS, {"iq2_xs", 256, 74}},
+    {DType::kIQ3_XXS, {"iq3_xxs", 256, 98}},
+    {DType::kIQ1_S, {"iq1_s", 256, 50}},
+    {DType::kIQ4_NL, {"iq4_nl", 32, 18}},
+    {DType::kIQ3_S, {"iq3_s", 256, 110}},
+    {DType::kIQ2_S, {"iq2_s", 256, 82}},
+    {DType::kIQ4_XS, {"iq4_xs", 256, 136}},
+    {DType::kI8, {"i8", 1, 1}},
+    {DType::kI16, {"i16", 1, 2}},
+    {DType::kI32, {"i32", 1, 4}},
+    {DType::kI64, {"i64", 1, 8}},
+    {DType::kF64, {"f64", 1, 8}},
+    {DType::kIQ1_M, {"iq1_m", 256, 56}},
+    {DType::kBF16, {"bf16", 1, 2}},
+    {DType::kQ4_0_4_4, {"q4_0_4x4", 32, 18}},
+    {DType::kQ4_0_4_8, {"q4_0_4x8", 32, 18}},
+    {DType::kQ4_0_8_8, {"q4_0_8x8", 32, 18}},
+};
+
+} // namespace
+
+const DTypeInfo* dtype_info(DType type) {
+    for (const auto& entry : kDTypes) {
+        if (entry.type == type) {
+            return &entry.info;
+        }
+    }
+    return nullptr;
+}
+
+const char* dtype_name(DType type) {
+    const DTypeInfo* info = dtype_info(type);
+    return info != nullptr ? info->name : "unknown";
+}
+
+bool can_dequantize(DType type) {
+    switch (type) {
+    case DType::kF32:
+    case DType::kF16:
+    case DType::kBF16:
+    case DType::kQ8_0:
+    case DType::kQ4_0: return true;
+    default: return false;
+    }
+}
+
+void dequantize_row(const TensorView& tensor, int64_t row, float* out) {
+    const int64_t k = tensor.cols();
+    const auto* base = static_cast<const uint8_t*>(tensor.data) + static_cast<size_t>(row) * tensor.row_bytes();
+    switch (tensor.dtype) {
+    case DType::kF32: std::memcpy(out, base, static_cast<size_t>(k) * sizeof(float)); return;
+    case DType::kF16:
+    case DType::kBF16:
+        for (int64_t i = 0; i < k; ++i) {
+            uint16_t h;
+            std::memcpy(&h, base + 2 * i, sizeof(h));
+            out[i] = tensor.dtype == DType::kF16 ? fp16_to_fp32(h) : bf16_to_fp32(h);
+        }
+        return;
+    case DType::kQ8_0:
+        for (int64_t b = 0; b < k / 32; ++b) {
+            const uint8_t* blk = base + b * 34;
+            uint16_t d;
+            std::memcpy(&d, blk, sizeof(d));
+            const float scale = fp16_to_fp32(d);
+            for (int64_t i = 0; i < 32; ++i) {
+                out[b * 32 + i] = scale * static_cast<int8_t>(blk[2 + i]);
+            }
+        }
+        return;
+    case DType::kQ4_0:
+        for (int64_t b = 0; b < k / 32; ++b) {
+            const uint8_t* blk = base + b * 18;
+            uint16_t d;
+            std::memcpy(&d, blk, sizeof(d));
+            const float scale = fp16_to_fp32(d);
+            for (int64_t i = 0; i < 16; ++i) {
+                out[b * 32 + i] = scale * static_cast<float>((blk[2 + i] & 0x0f) - 8);
+                out[b * 32 + i + 16] = scale * static_cast<float>((blk[2 + i] >> 4) - 8);
+            }
+        }
+        return;
+    default:
+        throw_error(std::string("cannot dequantize ") + dtype_name(tensor.dtype) + " tensor '" +
+                    std::string(tensor.name) + "'");
+    }
+}
+
+} // namespace neuroctx
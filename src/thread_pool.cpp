@@ -0,0 +1,333 @@
+#include "neuroctx/thread_pool.h"
+
+#include "neuroctx/common.h"
+#include "neuroctx/trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sched.h>
+
+namespace neuroctx {
+
+namespace {
+
+// Spin iterations before a worker parks on the futex. Decode steps issue
+// matmuls tens of microseconds apart, so a short spin avoids most wakeups.
+constexpr int kSpinIterations = 1 << 14;
+
+constexpr uint64_t pack_range(uint32_t begin, uint32_t end) { return begin | uint64_t{end} << 32; }
+constexpr uint32_t range_begin(uint64_t r) { return static_cast<uint32_t>(r); }
+constexpr uint32_t range_end(uint64_t r) { return static_cast<uint32_t>(r >> 32); }
+
+inline void cpu_relax() {
+#if defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#elif defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+bool read_uint(const std::string& path, uint64_t& value) {
+    std::ifstream in(path);
+    return static_cast<bool>(in >> value);
+}
+
+void pin_to(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    // Best effort: a restricted cpuset simply leaves the thread floating.
+    sched_setaffinity(0, sizeof(set), &set);
+}
+
+} // namespace
+
+int CpuTopology::cpu_count() const {
+    int n = 0;
+    for (const CpuCluster& c : clusters) {
+        n += static_cast<int>(c.cpus.size());
+    }
+    return n;
+}
+
+std::string CpuTopology::describe() const {
+    std::string out;
+    for (const CpuCluster& c : clusters) {
+        if (!out.empty()) {
+            out += ' ';
+        }
+        out += std::to_string(c.cpus.size()) + "x" + std::to_string(c.capacity);
+    }
+    return out;
+}
+
+CpuTopology read_cpu_topology(const std::string& sysfs_root) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        CPU_SET(0, &allowed);
+    }
+    std::map<uint32_t, std::vector<int>, std::greater<>> by_capacity;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (!CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        const std::string dir = sysfs_root + "/cpu" + std::to_string(cpu);
+        uint64_t capacity = 0;
+        if (!read_uint(dir + "/cpu_capacity", capacity)) {
+            uint64_t khz = 0;
+            capacity = read_uint(dir + "/cpufreq/cpuinfo_max_freq", khz) ? khz / 1000 : 1024;
+        }
+        by_capacity[static_cast<uint32_t>(std::max<uint64_t>(capacity, 1))].push_back(cpu);
+    }
+    CpuTopology topology;
+    for (auto& [capacity, cpus] : by_capacity) {
+        topology.clusters.push_back({std::move(cpus), capacity});
+    }
+    return topology;
+}
+
+CorePolicy parse_core_policy(std::string_view name) {
+    if (name == "perf") {
+        return CorePolicy::kPerformance;
+    }
+    if (name == "all") {
+        return CorePolicy::kAll;
+    }
+    throw_error("unknown core policy '" + std::string(name) + "' (expected perf or all)");
+}
+
+ThreadPoolOptions ThreadPoolOptions::from_env() {
+    ThreadPoolOptions options;
+    if (const char* cores = std::getenv("NEUROCTX_CORES"); cores != nullptr && *cores != '\0') {
+        options.policy = parse_core_policy(cores);
+    }
+    if (const char* threads = std::getenv("NEUROCTX_THREADS"); threads != nullptr && *threads != '\0') {
+        options.max_threads = static_cast<int>(std::strtol(threads, nullptr, 10));
+    }
+    return options;
+}
+
+ThreadPool::ThreadPool(const ThreadPoolOptions& options) : ThreadPool(read_cpu_topology(), options) {}
+
+ThreadPool::ThreadPool(const CpuTopology& topology, const ThreadPoolOptions& options) : topology_(topology) {
+    if (topology_.clusters.empty()) {
+        topology_.clusters.push_back({{0}, 1024});
+    }
+    start(options);
+}
+
+void ThreadPool::start(const ThreadPoolOptions& options) {
+    size_t clusters = topology_.clusters.size();
+    if (options.policy == CorePolicy::kPerformance && clusters > 1) {
+        --clusters;
+    }
+    for (size_t c = 0; c < clusters; ++c) {
+        for (const int cpu : topology_.clusters[c].cpus) {
+            if (options.max_threads > 0 && static_cast<int>(workers_.size()) >= options.max_threads) {
+                break;
+            }
+            workers_.push_back({cpu, static_cast<int>(c), 0});
+        }
+    }
+    const double fastest = topology_.clusters.front().capacity;
+    for (const CpuCluster& c : topology_.clusters) {
+        cluster_weight_.push_back(c.capacity / fastest);
+    }
+    queues_ = std::vector<Queue>(workers_.size());
+    enabled_.assign(workers_.size(), 1);
+    active_count_ = size();
+    threads_.reserve(workers_.size());
+    for (int i = 1; i < size(); ++i) {
+        threads_.emplace_back([this, i, pin = options.pin] {
+            if (pin) {
+                pin_to(workers_[i].cpu);
+            }
+            worker_main(i);
+        });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    stop_.store(true, std::memory_order_relaxed);
+    generation_.fetch_add(1, std::memory_order_release);
+    generation_.notify_all();
+    for (std::thread& t : threads_) {
+        t.join();
+    }
+}
+
+void ThreadPool::set_active(int threads, int skip_clusters) {
+    int count = 1; // the calling thread
+    for (int i = 1; i < size(); ++i) {
+        const bool on = count < threads && workers_[i].cluster >= skip_clusters;
+        enabled_[i] = on ? 1 : 0;
+        count += on ? 1 : 0;
+    }
+    active_count_ = count;
+}
+
+void ThreadPool::run(int64_t n, TaskFn fn, void* ctx) {
+    if (n <= 0) {
+        return;
+    }
+    if (active_count_ == 1 || n == 1) {
+        for (int64_t t = 0; t < n; ++t) {
+            fn(ctx, t, 0);
+        }
+        return;
+    }
+    if (n > INT32_MAX) {
+        throw_error("thread pool: too many tasks");
+    }
+
+    double total = 0.0;
+    int last = 0;
+    for (int i = 0; i < size(); ++i) {
+        if (enabled_[i] != 0) {
+            total += cluster_weight_[workers_[i].cluster];
+            last = i;
+        }
+    }
+    double cumulative = 0.0;
+    uint32_t begin = 0;
+    for (int i = 0; i < size(); ++i) {
+        workers_[i].done = 0;
+        if (enabled_[i] == 0) {
+            queues_[i].range.store(pack_range(begin, begin), std::memory_order_relaxed);
+            continue;
+        }
+        cumulative += cluster_weight_[workers_[i].cluster];
+        const auto end =
+            i == last ? static_cast<uint32_t>(n) : static_cast<uint32_t>(std::llround(n * cumulative / total));
+        queues_[i].range.store(pack_range(begin, std::max(begin, end)), std::memory_order_relaxed);
+        begin = std::max(begin, end);
+    }
+    fn_ = fn;
+    ctx_ = ctx;
+    active_.store(active_count_ - 1, std::memory_order_relaxed);
+    // A worker takes part only in the generations it is assigned, so one
+    // that wakes late never mistakes a later job for the one it missed.
+    const uint32_t gen = generation_.load(std::memory_order_relaxed) + 1;
+    for (int i = 1; i < size(); ++i) {
+        if (enabled_[i] != 0) {
+            queues_[i].job.store(gen, std::memory_order_relaxed);
+        }
+    }
+    generation_.fetch_add(1, std::memory_order_release);
+    generation_.notify_all();
+
+    work(0);
+    while (active_.load(std::memory_order_acquire) != 0) {
+        cpu_relax();
+    }
+    update_weights(n);
+}
+
+void ThreadPool::worker_main(int index) {
+    uint32_t seen = 0;
+    bool idle = false; // left out of the last job: sleep without spinning
+    for (;;) {
+        uint32_t gen = generation_.load(std::memory_order_acquire);
+        for (int spin = 0; gen == seen && !idle && spin < kSpinIterations; ++spin) {
+            cpu_relax();
+            gen = generation_.load(std::memory_order_acquire);
+        }
+        while (gen == seen) {
+            generation_.wait(seen, std::memory_order_acquire);
+            gen = generation_.load(std::memory_order_acquire);
+        }
+        seen = gen;
+        if (stop_.load(std::memory_order_relaxed)) {
+            return;
+        }
+        idle = queues_[index].job.load(std::memory_order_relaxed) != gen;
+        if (idle) {
+            continue;
+        }
+        work(index);
+        active_.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+void ThreadPool::work(int index) {
+    std::atomic<uint64_t>& own = queues_[index].range;
+    int64_t done = 0;
+    const uint64_t t0 = trace::enabled() ? trace::now() : 0;
+    const uint64_t bytes0 = t0 != 0 ? trace::memory_bytes() : 0;
+    for (;;) {
+        uint64_t r = own.load(std::memory_order_acquire);
+        const uint32_t b = range_begin(r);
+        if (b < range_end(r)) {
+            if (own.compare_exchange_weak(r, pack_range(b + 1, range_end(r)), std::memory_order_acq_rel)) {
+                fn_(ctx_, b, index);
+                ++done;
+            }
+            continue;
+        }
+        if (!steal(index)) {
+            break;
+        }
+    }
+    workers_[index].done = done;
+    if (t0 != 0) {
+        const uint64_t bytes = trace::memory_bytes();
+        trace::record(trace::Kind::kWork, "work", t0, trace::now(), static_cast<int32_t>(done),
+                      bytes >= bytes0 ? bytes - bytes0 : 0);
+    }
+}
+
+bool ThreadPool::steal(int thief) {
+    for (int offset = 1; offset < size(); ++offset) {
+        std::atomic<uint64_t>& victim = queues_[(thief + offset) % size()].range;
+        uint64_t r = victim.load(std::memory_order_acquire);
+        while (range_begin(r) < range_end(r)) {
+            const uint32_t b = range_begin(r);
+            const uint32_t e = range_end(r);
+            const uint32_t take = (e - b + 1) / 2;
+            if (victim.compare_exchange_weak(r, pack_range(b, e - take), std::memory_order_acq_rel)) {
+                queues_[thief].range.store(pack_range(e - take, e), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void ThreadPool::update_weights(int64_t n) {
+    // Small jobs mostly measure wakeup latency, not core speed.
+    if (n < 4 * static_cast<int64_t>(active_count_)) {
+        return;
+    }
+    std::vector<double>& weight = cluster_weight_;
+    double tasks[16] = {};
+    int members[16] = {};
+    const size_t clusters = std::min<size_t>(weight.size(), 16);
+    for (int i = 0; i < size(); ++i) {
+        const Worker& w = workers_[i];
+        if (enabled_[i] != 0 && static_cast<size_t>(w.cluster) < clusters) {
+            tasks[w.cluster] += static_cast<double>(w.done);
+            ++members[w.cluster];
+        }
+    }
+    double best = 0.0;
+    for (size_t c = 0; c < clusters; ++c) {
+        if (members[c] > 0) {
+            best = std::max(best, tasks[c] / members[c]);
+        }
+    }
+    if (best <= 0.0) {
+        return;
+    }
+    for (size_t c = 0; c < clusters; ++c) {
+        if (members[c] > 0) {
+            const double measured = std::max(tasks[c] / members[c] / best, 0.05);
+            weight[c] = 0.75 * weight[c] + 0.25 * measured;
+        }
+    }
+}
+
+} // namespace neuroctx
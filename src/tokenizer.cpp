@@ -0,0 +1,863 @@
+#include "neuroctx/tokenizer.h"
+
+#include "neuroctx/common.h"
+#include "neuroctx/hash.h"
+#include "unicode_ranges.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace neuroctx {
+
+namespace {
+
+// tokenizer.ggml.token_type
+enum TokenType : uint8_t {
+    kNormal = 1,
+    kUnknown = 2,
+    kControl = 3,
+    kUserDefined = 4,
+    kUnused = 5,
+    kByte = 6,
+};
+
+enum CharClass : uint8_t {
+    kOther = 0,
+    kLetter = 1,
+    kNumber = 2,
+    kSpace = 4,
+    kNewline = 8, // \r and \n; also kSpace
+    kEnd = 16,    // past the end of the text
+};
+
+struct Char {
+    uint32_t len;
+    uint8_t cls;
+};
+
+constexpr uint32_t kInvalid = 0xffffffff;
+constexpr std::string_view kWordStart = "\xe2\x96\x81"; // U+2581, SentencePiece's space
+
+constexpr auto kAsciiClass = [] {
+    std::array<uint8_t, 128> t{};
+    for (int c = 'a'; c <= 'z'; ++c) {
+        t[c] = kLetter;
+        t[c - 'a' + 'A'] = kLetter;
+    }
+    for (int c = '0'; c <= '9'; ++c) {
+        t[c] = kNumber;
+    }
+    for (int c : {'\t', '\v', '\f', ' '}) {
+        t[c] = kSpace;
+    }
+    t['\r'] = t['\n'] = kSpace | kNewline;
+    return t;
+}();
+
+// GPT-2's bytes_to_unicode(): printable bytes stand for themselves, the
+// others for U+0100 onwards in byte order.
+constexpr auto kByteChars = [] {
+    std::array<uint16_t, 256> t{};
+    uint16_t next = 256;
+    for (int b = 0; b < 256; ++b) {
+        const bool printable = (b >= 0x21 && b <= 0x7e) || (b >= 0xa1 && b <= 0xac) || b >= 0xae;
+        t[b] = printable ? static_cast<uint16_t>(b) : next++;
+    }
+    return t;
+}();
+
+constexpr auto kCharBytes = [] {
+    std::array<int16_t, 324> t{};
+    t.fill(-1);
+    for (int b = 0; b < 256; ++b) {
+        t[kByteChars[b]] = static_cast<int16_t>(b);
+    }
+    return t;
+}();
+
+// One code point from p[0..n), n > 0. Overlong forms, surrogates, values
+// past U+10FFFF and truncated sequences yield their first byte as kInvalid.
+uint32_t decode_utf8(const uint8_t* p, size_t n, uint32_t& cp) {
+    const uint32_t b0 = p[0];
+    if (b0 < 0x80) {
+        cp = b0;
+        return 1;
+    }
+    const auto cont = [&](size_t i) { return i < n && (p[i] & 0xc0) == 0x80; };
+    const auto bits = [&](size_t i) { return static_cast<uint32_t>(p[i] & 0x3f); };
+    if (b0 >= 0xc2 && b0 < 0xe0 && cont(1)) {
+        cp = (b0 & 0x1f) << 6 | bits(1);
+        return 2;
+    }
+    if (b0 >= 0xe0 && b0 < 0xf0 && cont(1) && cont(2)) {
+        cp = (b0 & 0x0f) << 12 | bits(1) << 6 | bits(2);
+        if (cp >= 0x800 && (cp < 0xd800 || cp > 0xdfff)) {
+            return 3;
+        }
+    } else if (b0 >= 0xf0 && b0 < 0xf5 && cont(1) && cont(2) && cont(3)) {
+        cp = (b0 & 0x07) << 18 | bits(1) << 12 | bits(2) << 6 | bits(3);
+        if (cp >= 0x10000 && cp <= 0x10ffff) {
+            return 4;
+        }
+    }
+    cp = kInvalid;
+    return 1;
+}
+
+void append_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xc0 | cp >> 6);
+        out += static_cast<char>(0x80 | (cp & 0x3f));
+    } else {
+        out += static_cast<char>(0xe0 | cp >> 12);
+        out += static_cast<char>(0x80 | (cp >> 6 & 0x3f));
+        out += static_cast<char>(0x80 | (cp & 0x3f));
+    }
+}
+
+// \s is White_Space, as in the Rust regex engine the patterns come from.
+uint8_t classify(uint32_t cp) {
+    if (cp < 0x80) {
+        return kAsciiClass[cp];
+    }
+    switch (cp) {
+    case 0x85:
+    case 0xa0:
+    case 0x1680:
+    case 0x2028:
+    case 0x2029:
+    case 0x202f:
+    case 0x205f:
+    case 0x3000: return kSpace;
+    default: break;
+    }
+    if (cp >= 0x2000 && cp <= 0x200a) {
+        return kSpace;
+    }
+    const auto* ranges = std::begin(unicode::kLetterNumberRanges);
+    const auto* r = std::upper_bound(ranges, std::end(unicode::kLetterNumberRanges), cp,
+                                     [](uint32_t c, const unicode::Range& range) { return c < range.first; });
+    if (r != ranges && cp <= r[-1].last) {
+        return r[-1].category == unicode::kL ? kLetter : kNumber;
+    }
+    return kOther;
+}
+
+Char char_at(std::string_view s, size_t pos) {
+    if (pos >= s.size()) {
+        return {0, kEnd};
+    }
+    const auto* p = reinterpret_cast<const uint8_t*>(s.data()) + pos;
+    if (*p < 0x80) {
+        return {1, kAsciiClass[*p]};
+    }
+    uint32_t cp = 0;
+    const uint32_t len = decode_utf8(p, s.size() - pos, cp);
+    return {len, cp == kInvalid ? uint8_t{kOther} : classify(cp)};
+}
+
+// ASCII letters at the start of p[0..n).
+size_t ascii_letters(const uint8_t* p, size_t n) {
+    size_t i = 0;
+#if defined(__aarch64__)
+    for (; i + 16 <= n; i += 16) {
+        const uint8x16_t folded = vorrq_u8(vld1q_u8(p + i), vdupq_n_u8(0x20));
+        const uint8x16_t letter = vcleq_u8(vsubq_u8(folded, vdupq_n_u8('a')), vdupq_n_u8('z' - 'a'));
+        // Four bits per byte.
+        const uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(letter), 4)), 0);
+        if (mask != ~uint64_t{0}) {
+            return i + static_cast<size_t>(std::countr_one(mask) / 4);
+        }
+    }
+#endif
+    constexpr uint64_t kHigh = 0x8080808080808080ull;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x;
+        std::memcpy(&x, p + i, 8);
+        // Per byte with the high bit clear: fold case, then compare against
+        // 'a' and '{' by carrying into bit 7.
+        const uint64_t low = (x | 0x2020202020202020ull) & ~kHigh;
+        const uint64_t letter = (low + 0x1f1f1f1f1f1f1f1full) & ~(low + 0x0505050505050505ull) & ~x & kHigh;
+        if (letter != kHigh) {
+            return i + static_cast<size_t>(std::countr_one(letter | ~kHigh) / 8);
+        }
+    }
+    while (i < n && p[i] < 0x80 && kAsciiClass[p[i]] == kLetter) {
+        ++i;
+    }
+    return i;
+}
+
+// End of the \p{L}+ run starting at pos.
+size_t letters_end(std::string_view s, size_t pos) {
+    const auto* p = reinterpret_cast<const uint8_t*>(s.data());
+    while (pos < s.size()) {
+        pos += ascii_letters(p + pos, s.size() - pos);
+        if (pos == s.size() || p[pos] < 0x80) {
+            break;
+        }
+        const Char c = char_at(s, pos);
+        if (!(c.cls & kLetter)) {
+            break;
+        }
+        pos += c.len;
+    }
+    return pos;
+}
+
+// End of the run from pos of at most `limit` characters whose class passes `in_run`.
+template <typename Pred>
+size_t run_end(std::string_view s, size_t pos, Pred in_run, size_t limit = SIZE_MAX) {
+    for (size_t n = 0; n < limit; ++n) {
+        const Char c = char_at(s, pos);
+        if (c.cls == kEnd || !in_run(c.cls)) {
+            break;
+        }
+        pos += c.len;
+    }
+    return pos;
+}
+
+// Length of 's 't 're 've 'm 'll 'd at s[pos] == '\'', or 0.
+size_t contraction(std::string_view s, size_t pos, bool fold_case) {
+    const auto at = [&](size_t i) -> char {
+        const char c = pos + i < s.size() ? s[pos + i] : '\0';
+        return fold_case && c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+    };
+    const char a = at(1);
+    if (a == 's' || a == 't' || a == 'm' || a == 'd') {
+        return 2;
+    }
+    const char b = at(2);
+    return (a == 'r' && b == 'e') || (a == 'v' && b == 'e') || (a == 'l' && b == 'l') ? 3 : 0;
+}
+
+uint64_t pair_key(int32_t left, int32_t right) {
+    return uint64_t{static_cast<uint32_t>(left)} << 32 | static_cast<uint32_t>(right);
+}
+
+// Heap order of merge candidates: highest priority first, then leftmost.
+constexpr auto kMergesAfter = [](const auto& a, const auto& b) {
+    return a.priority < b.priority || (a.priority == b.priority && a.left > b.left);
+};
+
+size_t table_size(size_t entries) {
+    return std::bit_ceil(std::max<size_t>(entries * 2, 16));
+}
+
+int hex_digit(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+} // namespace
+
+Tokenizer Tokenizer::from_gguf(const ModelFile& file, const TokenizerOptions& options) {
+    Tokenizer t;
+    const std::string& path = file.path();
+    const std::string_view model = file.meta_string("tokenizer.ggml.model");
+    if (model == "gpt2") {
+        t.model_ = TokenizerModel::kBytePair;
+    } else if (model == "llama") {
+        t.model_ = TokenizerModel::kSentencePiece;
+    } else if (model.empty()) {
+        throw_error("tokenizer: " + path + " has no tokenizer.ggml.model");
+    } else {
+        throw_error("tokenizer: " + path + ": unsupported tokenizer model " + std::string(model));
+    }
+    const bool spm = t.model_ == TokenizerModel::kSentencePiece;
+
+    const MetaValue* tokens = file.meta("tokenizer.ggml.tokens");
+    const auto vocab = tokens != nullptr ? tokens->as_array() : std::nullopt;
+    if (!vocab || vocab->elem_type() != MetaType::kString || vocab->size() == 0 || vocab->size() > INT32_MAX) {
+        throw_error("tokenizer: " + path + " has no tokenizer.ggml.tokens");
+    }
+    const size_t n = vocab->size();
+    t.tokens_.reserve(n);
+    std::string_view text;
+    for (auto cursor = vocab->strings(); cursor.next(text);) {
+        t.tokens_.push_back(text);
+    }
+    if (t.tokens_.size() != n) {
+        throw_error("tokenizer: " + path + ": truncated tokenizer.ggml.tokens");
+    }
+    t.types_.assign(n, kNormal);
+    if (const MetaValue* v = file.meta("tokenizer.ggml.token_type")) {
+        if (const auto types = v->as_array(); types && types->size() == n) {
+            for (size_t i = 0; i < n; ++i) {
+                t.types_[i] = static_cast<uint8_t>(types->int_at(i).value_or(kNormal));
+            }
+        }
+    }
+    t.index_vocabulary();
+
+    const auto token_id = [&](std::string_view key) {
+        const int64_t id = file.meta_int(key, -1);
+        return id >= 0 && id < static_cast<int64_t>(n) ? static_cast<int32_t>(id) : -1;
+    };
+    t.bos_ = token_id("tokenizer.ggml.bos_token_id");
+    t.eos_ = token_id("tokenizer.ggml.eos_token_id");
+    t.unk_ = token_id("tokenizer.ggml.unknown_token_id");
+    t.add_bos_ = file.meta_int("tokenizer.ggml.add_bos_token", spm ? 1 : 0) != 0;
+    t.add_space_prefix_ = spm && file.meta_int("tokenizer.ggml.add_space_prefix", 1) != 0;
+
+    const std::string_view pre = file.meta_string("tokenizer.ggml.pre", "default");
+    if (pre == "llama3" || pre == "llama-bpe") {
+        t.pre_ = PreTokenizer::kLlama3;
+        t.ignore_merges_ = true;
+    } else if (pre == "qwen2") {
+        t.pre_ = PreTokenizer::kQwen2;
+    }
+
+    if (!spm) {
+        std::string joined;
+        for (int b = 0; b < 256; ++b) {
+            joined.clear();
+            append_utf8(joined, kByteChars[b]);
+            t.byte_tokens_[b] = t.lookup(joined);
+        }
+        const MetaValue* merges = file.meta("tokenizer.ggml.merges");
+        const auto list = merges != nullptr ? merges->as_array() : std::nullopt;
+        if (list && list->elem_type() == MetaType::kString && list->size() > 0) {
+            t.merges_.assign(table_size(list->size()), Merge{});
+            int64_t rank = 0;
+            for (auto cursor = list->strings(); cursor.next(text); ++rank) {
+                // Byte-level tokens never contain a space: it is mapped to U+0120.
+                const size_t space = text.find(' ');
+                if (space == std::string_view::npos) {
+                    continue;
+                }
+                const int32_t left = t.lookup(text.substr(0, space));
+                const int32_t right = t.lookup(text.substr(space + 1));
+                joined.assign(text.substr(0, space)).append(text.substr(space + 1));
+                const int32_t result = t.lookup(joined);
+                if (left >= 0 && right >= 0 && result >= 0) {
+                    t.add_merge(left, right, -static_cast<float>(rank), result);
+                }
+            }
+        }
+    } else {
+        std::vector<float> scores(n, 0.0f);
+        if (const MetaValue* v = file.meta("tokenizer.ggml.scores")) {
+            if (const auto list = v->as_array(); list && list->size() == n) {
+                for (size_t i = 0; i < n; ++i) {
+                    scores[i] = static_cast<float>(list->float_at(i).value_or(0.0));
+                }
+            }
+        }
+        for (int b = 0; b < 256; ++b) {
+            char name[8];
+            std::snprintf(name, sizeof(name), "<0x%02X>", b);
+            t.byte_tokens_[b] = t.lookup(name);
+        }
+        // SentencePiece scores pieces, not pairs: every split of a piece
+        // into two pieces at a character boundary merges into it.
+        std::vector<Merge> pairs;
+        for (size_t id = 0; id < n; ++id) {
+            if (t.types_[id] != kNormal && t.types_[id] != kUserDefined) {
+                continue;
+            }
+            const std::string_view piece = t.tokens_[id];
+            const auto* bytes = reinterpret_cast<const uint8_t*>(piece.data());
+            uint32_t cp = 0;
+            for (size_t i = decode_utf8(bytes, piece.size(), cp); i < piece.size();
+                 i += decode_utf8(bytes + i, piece.size() - i, cp)) {
+                const int32_t left = t.lookup(piece.substr(0, i));
+                const int32_t right = t.lookup(piece.substr(i));
+                if (left >= 0 && right >= 0) {
+                    pairs.push_back({pair_key(left, right), scores[id], static_cast<int32_t>(id)});
+                }
+                // A piece running from inside a word into the next one
+                // would merge across the split.
+                if (piece.compare(i, kWordStart.size(), kWordStart) == 0 &&
+                    !(i >= kWordStart.size() && piece.compare(i - kWordStart.size(), kWordStart.size(), kWordStart) == 0)) {
+                    t.split_words_ = false;
+                }
+            }
+        }
+        t.merges_.assign(table_size(pairs.size()), Merge{});
+        for (const Merge& m : pairs) {
+            t.add_merge(static_cast<int32_t>(m.pair >> 32), static_cast<int32_t>(m.pair & 0xffffffff), m.priority,
+                        m.result);
+        }
+    }
+
+    t.special_trie_.emplace_back();
+    for (size_t id = 0; id < n; ++id) {
+        if ((t.types_[id] != kControl && t.types_[id] != kUserDefined) || t.tokens_[id].empty()) {
+            continue;
+        }
+        int32_t node = 0;
+        for (const char c : t.tokens_[id]) {
+            const auto b = static_cast<uint8_t>(c);
+            auto& children = t.special_trie_[static_cast<size_t>(node)].children;
+            auto it = std::lower_bound(children.begin(), children.end(), b,
+                                       [](const std::pair<uint8_t, int32_t>& e, uint8_t v) { return e.first < v; });
+            if (it == children.end() || it->first != b) {
+                const auto child = static_cast<int32_t>(t.special_trie_.size());
+                children.insert(it, {b, child});
+                t.special_trie_.emplace_back(); // invalidates `children`
+                node = child;
+            } else {
+                node = it->second;
+            }
+        }
+        if (t.special_trie_[static_cast<size_t>(node)].token < 0) {
+            t.special_trie_[static_cast<size_t>(node)].token = static_cast<int32_t>(id);
+        }
+        t.special_first_[static_cast<uint8_t>(t.tokens_[id][0])] = true;
+    }
+
+    if (options.cache_words > 0) {
+        const size_t entries = std::min<size_t>(options.cache_words, INT32_MAX / 2);
+        t.cache_.resize(entries);
+        t.buckets_.assign(std::bit_ceil(entries), -1);
+    }
+    return t;
+}
+
+void Tokenizer::index_vocabulary() {
+    index_.assign(table_size(tokens_.size()), -1);
+    const size_t mask = index_.size() - 1;
+    for (size_t id = 0; id < tokens_.size(); ++id) {
+        const std::string_view token = tokens_[id];
+        for (size_t i = fnv1a64(token.data(), token.size()) & mask;; i = (i + 1) & mask) {
+            if (index_[i] < 0) {
+                index_[i] = static_cast<int32_t>(id);
+                break;
+            }
+            if (tokens_[static_cast<size_t>(index_[i])] == token) {
+                break; // duplicates resolve to the lowest id
+            }
+        }
+    }
+}
+
+int32_t Tokenizer::lookup(std::string_view token) const {
+    const size_t mask = index_.size() - 1;
+    for (size_t i = fnv1a64(token.data(), token.size()) & mask;; i = (i + 1) & mask) {
+        const int32_t id = index_[i];
+        if (id < 0 || tokens_[static_cast<size_t>(id)] == token) {
+            return id;
+        }
+    }
+}
+
+std::optional<int32_t> Tokenizer::find(std::string_view token) const {
+    const int32_t id = lookup(token);
+    return id >= 0 ? std::optional<int32_t>(id) : std::nullopt;
+}
+
+void Tokenizer::add_merge(int32_t left, int32_t right, float priority, int32_t result) {
+    const uint64_t key = pair_key(left, right);
+    const size_t mask = merges_.size() - 1;
+    for (size_t i = hash_mix(kFnvOffset, key) & mask;; i = (i + 1) & mask) {
+        Merge& m = merges_[i];
+        if (m.pair == ~uint64_t{0}) {
+            m = {key, priority, result};
+            return;
+        }
+        if (m.pair == key) {
+            if (priority > m.priority) {
+                m.priority = priority;
+                m.result = result;
+            }
+            return;
+        }
+    }
+}
+
+const Tokenizer::Merge* Tokenizer::find_merge(int32_t left, int32_t right) const {
+    if (merges_.empty()) {
+        return nullptr;
+    }
+    const uint64_t key = pair_key(left, right);
+    const size_t mask = merges_.size() - 1;
+    for (size_t i = hash_mix(kFnvOffset, key) & mask;; i = (i + 1) & mask) {
+        const Merge& m = merges_[i];
+        if (m.pair == key) {
+            return &m;
+        }
+        if (m.pair == ~uint64_t{0}) {
+            return nullptr;
+        }
+    }
+}
+
+std::pair<int32_t, size_t> Tokenizer::match_special(std::string_view text, size_t pos, bool parse_special) const {
+    std::pair<int32_t, size_t> best{-1, 0};
+    size_t node = 0;
+    for (size_t i = pos; i < text.size(); ++i) {
+        const auto& children = special_trie_[node].children;
+        const auto b = static_cast<uint8_t>(text[i]);
+        const auto it = std::lower_bound(children.begin(), children.end(), b,
+                                         [](const std::pair<uint8_t, int32_t>& e, uint8_t v) { return e.first < v; });
+        if (it == children.end() || it->first != b) {
+            break;
+        }
+        node = static_cast<size_t>(it->second);
+        const int32_t id = special_trie_[node].token;
+        if (id >= 0 && (parse_special || types_[static_cast<size_t>(id)] == kUserDefined)) {
+            best = {id, i + 1 - pos};
+        }
+    }
+    return best;
+}
+
+void Tokenizer::encode(std::string_view text, std::vector<int32_t>& out, bool add_bos, bool parse_special) {
+    if (add_bos && bos_ >= 0) {
+        out.push_back(bos_);
+    }
+    size_t start = 0;
+    for (size_t pos = 0; pos < text.size();) {
+        if (!special_first_[static_cast<uint8_t>(text[pos])]) {
+            ++pos;
+            continue;
+        }
+        const auto [id, len] = match_special(text, pos, parse_special);
+        if (id < 0) {
+            ++pos;
+            continue;
+        }
+        encode_fragment(text.substr(start, pos - start), out, add_space_prefix_);
+        out.push_back(id);
+        pos += len;
+        start = pos;
+    }
+    encode_fragment(text.substr(start), out, add_space_prefix_);
+}
+
+void Tokenizer::encode_fragment(std::string_view text, std::vector<int32_t>& out, bool space_prefix) {
+    if (text.empty()) {
+        return;
+    }
+    if (model_ == TokenizerModel::kBytePair) {
+        for (size_t pos = 0; pos < text.size();) {
+            const size_t end = next_word(text, pos);
+            encode_word(text.substr(pos, end - pos), out);
+            pos = end;
+        }
+        return;
+    }
+
+    text_.clear();
+    if (space_prefix) {
+        text_ += kWordStart;
+    }
+    for (size_t pos = 0; pos < text.size();) {
+        const size_t space = std::min(text.find(' ', pos), text.size());
+        text_.append(text.substr(pos, space - pos));
+        if (space < text.size()) {
+            text_ += kWordStart;
+        }
+        pos = space + 1;
+    }
+    const std::string_view escaped = text_;
+    if (!split_words_) {
+        encode_word(escaped, out);
+        return;
+    }
+    // Words start at a U+2581 that follows anything else: "▁a▁▁▁b" is
+    // "▁a" "▁▁▁b".
+    size_t word = 0;
+    for (size_t i = escaped.find(kWordStart, 1); i != std::string_view::npos;
+         i = escaped.find(kWordStart, i + kWordStart.size())) {
+        if (i >= kWordStart.size() && escaped.compare(i - kWordStart.size(), kWordStart.size(), kWordStart) == 0) {
+            continue;
+        }
+        encode_word(escaped.substr(word, i - word), out);
+        word = i;
+    }
+    encode_word(escaped.substr(word), out);
+}
+
+size_t Tokenizer::next_word(std::string_view s, size_t pos) const {
+    const auto letter = [](uint8_t cls) { return (cls & kLetter) != 0; };
+    const auto number = [](uint8_t cls) { return (cls & kNumber) != 0; };
+    const auto other = [](uint8_t cls) { return cls == kOther; };
+    if (s[pos] == '\'') {
+        if (const size_t len = contraction(s, pos, pre_ != PreTokenizer::kGpt2)) {
+            return pos + len;
+        }
+    }
+    const Char c0 = char_at(s, pos);
+    const size_t next = pos + c0.len;
+    const Char c1 = char_at(s, next);
+
+    if (pre_ == PreTokenizer::kGpt2) {
+        // ' ?\p{L}+', ' ?\p{N}+', ' ?[^\s\p{L}\p{N}]+'
+        const bool lead = s[pos] == ' ' && c1.cls != kEnd && !(c1.cls & kSpace);
+        const size_t start = lead ? next : pos;
+        const uint8_t cls = lead ? c1.cls : c0.cls;
+        if (letter(cls)) {
+            return letters_end(s, start);
+        }
+        if (number(cls)) {
+            return run_end(s, start, number);
+        }
+        if (other(cls)) {
+            return run_end(s, start, other);
+        }
+    } else {
+        // '[^\r\n\p{L}\p{N}]?\p{L}+'
+        if (letter(c0.cls)) {
+            return letters_end(s, pos);
+        }
+        if (!(c0.cls & (kNumber | kNewline)) && letter(c1.cls)) {
+            return letters_end(s, next);
+        }
+        // '\p{N}{1,3}' or '\p{N}'
+        if (number(c0.cls)) {
+            return run_end(s, pos, number, pre_ == PreTokenizer::kQwen2 ? 1 : 3);
+        }
+        // ' ?[^\s\p{L}\p{N}]+[\r\n]*'
+        if (other(c0.cls) || (s[pos] == ' ' && other(c1.cls))) {
+            size_t end = run_end(s, other(c0.cls) ? pos : next, other);
+            while (end < s.size() && (s[end] == '\r' || s[end] == '\n')) {
+                ++end;
+            }
+            return end;
+        }
+    }
+
+    // Whitespace.
+    size_t end = pos;
+    size_t last = pos;
+    size_t newline = std::string_view::npos;
+    for (Char c = c0; c.cls & kSpace; c = char_at(s, end)) {
+        if (c.cls & kNewline) {
+            newline = end;
+        }
+        last = end;
+        end += c.len;
+    }
+    if (pre_ != PreTokenizer::kGpt2 && newline != std::string_view::npos) {
+        return newline + 1; // '\s*[\r\n]+'
+    }
+    // '\s+(?!\S)' leaves the last whitespace character to the word after it.
+    return end < s.size() && last > pos ? last : end;
+}
+
+void Tokenizer::encode_word(std::string_view word, std::vector<int32_t>& out) {
+    ++stats_.words;
+    const bool cacheable = !cache_.empty() && word.size() <= kCacheWordBytes;
+    uint64_t hash = 0;
+    if (cacheable) {
+        hash = fnv1a64(word.data(), word.size());
+        if (const int32_t e = cache_find(word, hash); e >= 0) {
+            ++stats_.cache_hits;
+            const CacheEntry& entry = cache_[static_cast<size_t>(e)];
+            out.insert(out.end(), entry.tokens, entry.tokens + entry.n_tokens);
+            return;
+        }
+    }
+    const size_t first = out.size();
+    merge_word(word, out);
+    if (cacheable && out.size() - first <= kCacheTokens) {
+        cache_insert(word, hash, std::span<const int32_t>(out).subspan(first));
+    }
+}
+
+void Tokenizer::merge_word(std::string_view word, std::vector<int32_t>& out) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(word.data());
+    symbols_.clear();
+    if (model_ == TokenizerModel::kBytePair) {
+        if (ignore_merges_ && word.size() > 1) {
+            word_.clear();
+            for (const uint8_t b : std::span(bytes, word.size())) {
+                append_utf8(word_, kByteChars[b]);
+            }
+            if (const int32_t id = lookup(word_); id >= 0) {
+                out.push_back(id);
+                return;
+            }
+        }
+        for (uint32_t i = 0; i < word.size(); ++i) {
+            symbols_.push_back({byte_tokens_[bytes[i]], static_cast<int32_t>(i) - 1, static_cast<int32_t>(i) + 1, i, 1});
+        }
+    } else {
+        for (uint32_t i = 0; i < word.size();) {
+            uint32_t cp = 0;
+            const uint32_t len = decode_utf8(bytes + i, word.size() - i, cp);
+            int32_t id = cp == kInvalid ? -1 : lookup(word.substr(i, len));
+            if (id >= 0 && types_[static_cast<size_t>(id)] != kNormal && types_[static_cast<size_t>(id)] != kUserDefined) {
+                id = -1;
+            }
+            const auto index = static_cast<int32_t>(symbols_.size());
+            symbols_.push_back({id, index - 1, index + 1, i, len});
+            i += len;
+        }
+    }
+    symbols_.back().next = -1;
+
+    heap_.clear();
+    for (size_t i = 0; i + 1 < symbols_.size(); ++i) {
+        push_candidate(static_cast<int32_t>(i), static_cast<int32_t>(i + 1));
+    }
+    while (!heap_.empty()) {
+        std::pop_heap(heap_.begin(), heap_.end(), kMergesAfter);
+        const Candidate c = heap_.back();
+        heap_.pop_back();
+        Symbol& left = symbols_[static_cast<size_t>(c.left)];
+        // Skip pairs a merge since they were queued has changed.
+        if (left.len == 0 || left.id != c.left_id || left.next < 0 ||
+            symbols_[static_cast<size_t>(left.next)].id != c.right_id) {
+            continue;
+        }
+        Symbol& right = symbols_[static_cast<size_t>(left.next)];
+        left.id = c.result;
+        left.len += right.len;
+        left.next = right.next;
+        right.len = 0;
+        if (left.next >= 0) {
+            symbols_[static_cast<size_t>(left.next)].prev = c.left;
+            push_candidate(c.left, left.next);
+        }
+        if (left.prev >= 0) {
+            push_candidate(left.prev, c.left);
+        }
+    }
+
+    for (int32_t i = 0; i >= 0; i = symbols_[static_cast<size_t>(i)].next) {
+        const Symbol& s = symbols_[static_cast<size_t>(i)];
+        if (s.id >= 0) {
+            out.push_back(s.id);
+            continue;
+        }
+        for (uint32_t b = s.offset; b < s.offset + s.len; ++b) {
+            const int32_t id = byte_tokens_[bytes[b]] >= 0 ? byte_tokens_[bytes[b]] : unk_;
+            if (id >= 0) {
+                out.push_back(id);
+            }
+        }
+    }
+}
+
+void Tokenizer::push_candidate(int32_t left, int32_t right) {
+    const int32_t a = symbols_[static_cast<size_t>(left)].id;
+    const int32_t b = symbols_[static_cast<size_t>(right)].id;
+    if (a < 0 || b < 0) {
+        return;
+    }
+    if (const Merge* m = find_merge(a, b)) {
+        heap_.push_back({m->priority, left, a, b, m->result});
+        std::push_heap(heap_.begin(), heap_.end(), kMergesAfter);
+    }
+}
+
+int32_t Tokenizer::cache_find(std::string_view word, uint64_t hash) {
+    for (int32_t e = buckets_[hash & (buckets_.size() - 1)]; e >= 0; e = cache_[static_cast<size_t>(e)].chain) {
+        const CacheEntry& entry = cache_[static_cast<size_t>(e)];
+        if (entry.hash == hash && entry.word_len == word.size() && std::memcmp(entry.word, word.data(), word.size()) == 0) {
+            if (e != newest_) {
+                cache_unlink(e);
+                cache_push(e);
+            }
+            return e;
+        }
+    }
+    return -1;
+}
+
+void Tokenizer::cache_insert(std::string_view word, uint64_t hash, std::span<const int32_t> tokens) {
+    int32_t e = 0;
+    if (cache_used_ < static_cast<int32_t>(cache_.size())) {
+        e = cache_used_++;
+    } else {
+        e = oldest_;
+        cache_unlink(e);
+        int32_t* link = &buckets_[cache_[static_cast<size_t>(e)].hash & (buckets_.size() - 1)];
+        while (*link != e) {
+            link = &cache_[static_cast<size_t>(*link)].chain;
+        }
+        *link = cache_[static_cast<size_t>(e)].chain;
+        ++stats_.cache_evictions;
+    }
+    CacheEntry& entry = cache_[static_cast<size_t>(e)];
+    entry.hash = hash;
+    entry.word_len = static_cast<uint8_t>(word.size());
+    entry.n_tokens = static_cast<uint8_t>(tokens.size());
+    std::memcpy(entry.word, word.data(), word.size());
+    std::copy(tokens.begin(), tokens.end(), entry.tokens);
+    int32_t& bucket = buckets_[hash & (buckets_.size() - 1)];
+    entry.chain = bucket;
+    bucket = e;
+    cache_push(e);
+}
+
+void Tokenizer::cache_unlink(int32_t e) {
+    CacheEntry& entry = cache_[static_cast<size_t>(e)];
+    (entry.newer >= 0 ? cache_[static_cast<size_t>(entry.newer)].older : newest_) = entry.older;
+    (entry.older >= 0 ? cache_[static_cast<size_t>(entry.older)].newer : oldest_) = entry.newer;
+}
+
+void Tokenizer::cache_push(int32_t e) {
+    CacheEntry& entry = cache_[static_cast<size_t>(e)];
+    entry.newer = -1;
+    entry.older = newest_;
+    if (newest_ >= 0) {
+        cache_[static_cast<size_t>(newest_)].newer = e;
+    }
+    newest_ = e;
+    if (oldest_ < 0) {
+        oldest_ = e;
+    }
+}
+
+void Tokenizer::decode(std::span<const int32_t> tokens, std::string& out, bool special) const {
+    for (const int32_t id : tokens) {
+        if (id < 0 || id >= size()) {
+            continue;
+        }
+        const uint8_t type = types_[static_cast<size_t>(id)];
+        const std::string_view text = tokens_[static_cast<size_t>(id)];
+        if (type == kControl || type == kUnused) {
+            if (special) {
+                out.append(text);
+            }
+        } else if (type == kUserDefined) {
+            out.append(text);
+        } else if (model_ == TokenizerModel::kBytePair) {
+            const auto* bytes = reinterpret_cast<const uint8_t*>(text.data());
+            for (size_t i = 0; i < text.size();) {
+                uint32_t cp = 0;
+                const size_t len = decode_utf8(bytes + i, text.size() - i, cp);
+                if (cp < kCharBytes.size() && kCharBytes[cp] >= 0) {
+                    out += static_cast<char>(kCharBytes[cp]);
+                } else {
+                    out.append(text.substr(i, len));
+                }
+                i += len;
+            }
+        } else if (type == kByte && text.size() == 6 && hex_digit(text[3]) >= 0 && hex_digit(text[4]) >= 0) {
+            out += static_cast<char>(hex_digit(text[3]) << 4 | hex_digit(text[4])); // <0xXX>
+        } else {
+            for (size_t pos = 0; pos < text.size();) {
+                const size_t mark = std::min(text.find(kWordStart, pos), text.size());
+                out.append(text.substr(pos, mark - pos));
+                if (mark < text.size()) {
+                    out += ' ';
+                }
+                pos = mark + kWordStart.size();
+            }
+        }
+    }
+}
+
+} // namespace neuroctx
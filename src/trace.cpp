@@ -0,0 +1,347 @@
+#include "neuroctx/trace.h"
+
+#include "neuroctx/common.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <fstream>
+#include <linux/perf_event.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace neuroctx::trace {
+
+namespace {
+
+struct ThreadBuffer {
+    std::vector<Event> events;
+    uint64_t mask = 0;
+    std::atomic<uint64_t> head{0};    // written by the owning thread only
+    std::atomic<uint64_t> cleared{0}; // events before it were dropped by clear()
+    int tid = 0;
+};
+
+struct Registry {
+    std::mutex mutex;
+    // Never freed, so a thread's events outlive it until the next clear().
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    size_t buffer_events = TraceOptions().buffer_events;
+    // Bumped by every enable() with PMU counters, 0 without; threads reopen
+    // their counter when it changes.
+    std::atomic<uint64_t> pmu_epoch{0};
+    uint64_t last_epoch = 0;
+    std::atomic<bool> pmu_requested{false}; // by the last enable(), kept past disable()
+    std::atomic<bool> pmu_denied{false};
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+thread_local ThreadBuffer* t_buffer = nullptr;
+
+// The calling thread's own perf counter, opened and read only by it, so
+// reading it takes no lock; closed when the thread exits.
+struct ThreadCounter {
+    int fd = -1;
+    uint64_t epoch = 0;
+    ~ThreadCounter() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+};
+
+thread_local ThreadCounter t_counter;
+
+ThreadBuffer* register_thread() {
+    auto buffer = std::make_unique<ThreadBuffer>();
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    buffer->events.resize(std::bit_ceil(std::max<size_t>(r.buffer_events, 16)));
+    buffer->mask = buffer->events.size() - 1;
+    buffer->tid = static_cast<int>(syscall(SYS_gettid));
+    t_buffer = buffer.get();
+    r.buffers.push_back(std::move(buffer));
+    return t_buffer;
+}
+
+int open_memory_counter() {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+double to_us(uint64_t ticks) { return double(ticks) * 1e6 / double(ticks_per_second()); }
+
+// Events still in a ring, oldest first.
+template <typename F>
+void for_each_event(const ThreadBuffer& b, F&& f) {
+    const uint64_t head = b.head.load(std::memory_order_acquire);
+    const uint64_t size = b.events.size();
+    const uint64_t first = std::max(b.cleared.load(std::memory_order_relaxed), head > size ? head - size : 0);
+    for (uint64_t i = first; i < head; ++i) {
+        f(b.events[i & b.mask]);
+    }
+}
+
+const char* category(Kind kind) {
+    switch (kind) {
+    case Kind::kOp: return "op";
+    case Kind::kLayer: return "layer";
+    case Kind::kWork: return "pool";
+    case Kind::kScope: break;
+    }
+    return "scope";
+}
+
+std::string json_string(const char* s) {
+    std::string out = "\"";
+    for (; *s != '\0'; ++s) {
+        const auto c = static_cast<unsigned char>(*s);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    return out + "\"";
+}
+
+} // namespace
+
+uint64_t ticks_per_second() {
+#if defined(__aarch64__)
+    static const uint64_t freq = [] {
+        uint64_t v;
+        asm volatile("mrs %0, cntfrq_el0" : "=r"(v));
+        return v;
+    }();
+    return freq;
+#else
+    using Period = std::chrono::steady_clock::period;
+    return static_cast<uint64_t>(Period::den / Period::num);
+#endif
+}
+
+void enable(const TraceOptions& options) {
+    Registry& r = registry();
+    {
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.buffer_events = options.buffer_events;
+        r.pmu_requested.store(options.pmu, std::memory_order_relaxed);
+        r.pmu_denied.store(false, std::memory_order_relaxed);
+        r.pmu_epoch.store(options.pmu ? ++r.last_epoch : 0, std::memory_order_relaxed);
+    }
+    detail::g_enabled.store(true, std::memory_order_relaxed);
+}
+
+void disable() {
+    detail::g_enabled.store(false, std::memory_order_relaxed);
+    registry().pmu_epoch.store(0, std::memory_order_relaxed);
+}
+
+void clear() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (const auto& b : r.buffers) {
+        b->cleared.store(b->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+bool pmu_available() {
+    const Registry& r = registry();
+    return r.pmu_requested.load(std::memory_order_relaxed) && !r.pmu_denied.load(std::memory_order_relaxed);
+}
+
+void record(Kind kind, const char* name, uint64_t begin, uint64_t end, int32_t arg, uint64_t bytes) {
+    if (!enabled()) {
+        return;
+    }
+    ThreadBuffer* b = t_buffer != nullptr ? t_buffer : register_thread();
+    const uint64_t h = b->head.load(std::memory_order_relaxed);
+    b->events[h & b->mask] = Event{name, begin, end, bytes, arg, kind};
+    b->head.store(h + 1, std::memory_order_release);
+}
+
+uint64_t memory_bytes() {
+    Registry& r = registry();
+    const uint64_t epoch = r.pmu_epoch.load(std::memory_order_relaxed);
+    ThreadCounter& c = t_counter;
+    if (c.epoch != epoch) {
+        if (c.fd >= 0) {
+            ::close(c.fd);
+        }
+        c.fd = epoch != 0 ? open_memory_counter() : -1;
+        c.epoch = epoch;
+        if (epoch != 0 && c.fd < 0) {
+            // Not permitted or not supported.
+            r.pmu_denied.store(true, std::memory_order_relaxed);
+        }
+    }
+    uint64_t misses = 0;
+    if (c.fd < 0 || ::read(c.fd, &misses, sizeof(misses)) != ssize_t(sizeof(misses))) {
+        return 0;
+    }
+    return misses * kCacheLine;
+}
+
+void LayerMeter::enter(int32_t layer) {
+    if (layer == layer_) {
+        return;
+    }
+    const uint64_t t = now();
+    const uint64_t bytes = memory_bytes();
+    if (layer_ >= 0) {
+        // A counter reopened by enable() starts again from 0.
+        record(Kind::kLayer, "layer", begin_, t, layer_, bytes >= bytes_ ? bytes - bytes_ : 0);
+    }
+    layer_ = layer;
+    begin_ = t;
+    bytes_ = bytes;
+}
+
+namespace {
+
+// Pool work spans of other threads, for adding their traffic to the layer
+// spans they started in. Call with the registry locked.
+struct WorkTraffic {
+    struct Span {
+        uint64_t begin;
+        uint64_t bytes;
+        int tid;
+    };
+    std::vector<Span> spans; // by begin
+
+    explicit WorkTraffic(const Registry& r) {
+        for (const auto& b : r.buffers) {
+            for_each_event(*b, [&](const Event& e) {
+                if (e.kind == Kind::kWork && e.bytes != 0) {
+                    spans.push_back({e.begin, e.bytes, b->tid});
+                }
+            });
+        }
+        std::sort(spans.begin(), spans.end(), [](const Span& a, const Span& b) { return a.begin < b.begin; });
+    }
+
+    // Bytes of a kLayer event recorded by `tid`: its own plus those of
+    // other threads' work that began during it.
+    uint64_t layer_bytes(const Event& e, int tid) const {
+        uint64_t bytes = e.bytes;
+        auto it = std::lower_bound(spans.begin(), spans.end(), e.begin,
+                                   [](const Span& s, uint64_t t) { return s.begin < t; });
+        for (; it != spans.end() && it->begin < e.end; ++it) {
+            bytes += it->tid != tid ? it->bytes : 0;
+        }
+        return bytes;
+    }
+};
+
+} // namespace
+
+void write_chrome_trace(const std::string& path) {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    uint64_t origin = UINT64_MAX;
+    for (const auto& b : r.buffers) {
+        for_each_event(*b, [&](const Event& e) { origin = std::min(origin, e.begin); });
+    }
+    const WorkTraffic traffic(r);
+    std::ofstream out(path);
+    if (!out) {
+        throw_error("trace: cannot write " + path);
+    }
+    const int pid = static_cast<int>(getpid());
+    char buf[256];
+    bool first = true;
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    const auto emit = [&](const std::string& event) {
+        out << (first ? "\n" : ",\n") << event;
+        first = false;
+    };
+    for (const auto& b : r.buffers) {
+        std::snprintf(buf, sizeof(buf),
+                      "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"neuroctx %d\"}}",
+                      pid, b->tid, b->tid);
+        emit(buf);
+        for_each_event(*b, [&](const Event& e) {
+            const double ts = to_us(e.begin - origin);
+            const double dur = to_us(e.end - e.begin);
+            std::string name = e.kind == Kind::kLayer ? "layer " + std::to_string(e.arg) : e.name;
+            std::string args;
+            if (e.kind == Kind::kOp) {
+                args = "\"layer\":" + std::to_string(e.arg);
+            } else if (e.kind == Kind::kWork) {
+                args = "\"tasks\":" + std::to_string(e.arg);
+            } else if (e.kind == Kind::kLayer) {
+                const uint64_t bytes = traffic.layer_bytes(e, b->tid);
+                const double gbps = dur > 0 ? double(bytes) / (dur * 1e3) : 0.0;
+                std::snprintf(buf, sizeof(buf), "\"bytes\":%llu,\"gbps\":%.3f",
+                              static_cast<unsigned long long>(bytes), gbps);
+                args = buf;
+                if (bytes != 0) {
+                    std::snprintf(buf, sizeof(buf),
+                                  "{\"name\":\"memory read GB/s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%d,"
+                                  "\"args\":{\"GB/s\":%.3f}}",
+                                  ts, pid, gbps);
+                    emit(buf);
+                }
+            }
+            std::snprintf(buf, sizeof(buf), "\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d",
+                          category(e.kind), ts, dur, pid, b->tid);
+            emit("{\"name\":" + json_string(name.c_str()) + "," + buf + ",\"args\":{" + args + "}}");
+        });
+    }
+    out << "\n]}\n";
+    if (!out.flush()) {
+        throw_error("trace: cannot write " + path);
+    }
+}
+
+std::vector<OpProfile> profile() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    std::map<std::string, OpProfile> by_name;
+    std::map<int32_t, OpProfile> by_layer;
+    const WorkTraffic traffic(r);
+    for (const auto& b : r.buffers) {
+        for_each_event(*b, [&](const Event& e) {
+            OpProfile& p = e.kind == Kind::kLayer ? by_layer[e.arg] : by_name[e.name];
+            if (p.calls == 0) {
+                p.name = e.name;
+                p.layer = e.kind == Kind::kLayer ? e.arg : -1;
+            }
+            const double us = to_us(e.end - e.begin);
+            ++p.calls;
+            p.total_us += us;
+            p.max_us = std::max(p.max_us, us);
+            p.bytes += e.kind == Kind::kLayer ? traffic.layer_bytes(e, b->tid) : e.bytes;
+        });
+    }
+    std::vector<OpProfile> out;
+    for (auto& [name, p] : by_name) {
+        out.push_back(std::move(p));
+    }
+    for (auto& [layer, p] : by_layer) {
+        out.push_back(std::move(p));
+    }
+    std::stable_sort(out.begin(), out.end(),
+                     [](const OpProfile& a, const OpProfile& b) { return a.total_us > b.total_us; });
+    return out;
+}
+
+} // namespace neuroctx::trace
@@ -0,0 +1,163 @@
+#include "neuroctx/tuning.h"
+
+#include "neuroctx/attention.h"
+#include "neuroctx/common.h"
+#include "neuroctx/cpu_features.h"
+#include "neuroctx/hash.h"
+#include "neuroctx/kernels.h"
+#include "neuroctx/packed_model.h"
+#include "neuroctx/thread_pool.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
+
+namespace neuroctx {
+
+namespace {
+
+int64_t parse_value(const std::string& path, const std::string& key, const std::string& value) {
+    char* end = nullptr;
+    const long long v = std::strtoll(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0') {
+        throw_error("tuning: " + path + ": bad value for " + key + ": " + value);
+    }
+    return v;
+}
+
+struct State {
+    TuningProfile profile;
+    std::string source = "defaults";
+};
+
+State load() {
+    State s;
+    const std::string path = tuning_profile_path();
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) {
+        s.source = "defaults (no " + path + ")";
+        return s;
+    }
+    try {
+        std::string device;
+        const TuningProfile p = read_tuning_profile(path, &device);
+        if (device != tuning_device()) {
+            s.source = "defaults (" + path + " was tuned on " + device + ")";
+            return s;
+        }
+        s.profile = p;
+        s.source = path;
+    } catch (const Error& e) {
+        s.source = std::string("defaults (") + e.what() + ")";
+    }
+    return s;
+}
+
+State& state() {
+    static State s = load();
+    return s;
+}
+
+} // namespace
+
+std::string tuning_device() {
+    const std::string features = cpu_features().describe();
+    return std::string(kernels::active().name) + " | " + (features.empty() ? "-" : features) + " | " +
+           read_cpu_topology().describe();
+}
+
+std::string tuning_profile_path() {
+    if (const char* path = std::getenv("NEUROCTX_TUNING"); path != nullptr && *path != '\0') {
+        return path;
+    }
+    const std::string device = tuning_device();
+    char name[64];
+    std::snprintf(name, sizeof(name), "tuning-%016llx.txt",
+                  static_cast<unsigned long long>(fnv1a64(device.data(), device.size())));
+    return (std::filesystem::path(default_cache_dir()) / name).string();
+}
+
+TuningProfile read_tuning_profile(const std::string& path, std::string* device) {
+    std::ifstream in(path);
+    if (!in) {
+        throw_error("tuning: cannot read " + path);
+    }
+    TuningProfile p;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        const size_t space = line.find(' ');
+        const std::string key = line.substr(0, space);
+        const std::string value = space == std::string::npos ? "" : line.substr(space + 1);
+        if (key == "device") {
+            if (device != nullptr) {
+                *device = value;
+            }
+        } else if (key == "gemm_row_tile") {
+            p.gemm_row_tile = std::clamp<int64_t>(parse_value(path, key, value), 1, kernels::kRowTile);
+        } else if (key == "tasks_per_worker") {
+            p.tasks_per_worker = static_cast<int32_t>(std::clamp<int64_t>(parse_value(path, key, value), 1, 64));
+        } else if (key == "attention_query_tile") {
+            p.attention_query_tile =
+                static_cast<int32_t>(std::clamp<int64_t>(parse_value(path, key, value), 1, kMaxQueryTile));
+        } else if (key == "attention_key_tile") {
+            p.attention_key_tile =
+                static_cast<int32_t>(std::clamp<int64_t>(parse_value(path, key, value), 1, kMaxKeyTile));
+        } else if (key == "fixed_gemv") {
+            p.fixed_gemv = parse_value(path, key, value) != 0;
+        }
+    }
+    return p;
+}
+
+void write_tuning_profile(const TuningProfile& p, const std::string& path) {
+    const std::filesystem::path target(path);
+    if (target.has_parent_path()) {
+        std::error_code ec;
+        std::filesystem::create_directories(target.parent_path(), ec);
+        if (ec) {
+            throw_error("create " + target.parent_path().string() + ": " + ec.message());
+        }
+    }
+    const std::string tmp = path + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream out(tmp);
+        out << "# neuroctx tuning profile, written by neuroctx_bench --tune\n"
+            << "device " << tuning_device() << "\n"
+            << "gemm_row_tile " << p.gemm_row_tile << "\n"
+            << "tasks_per_worker " << p.tasks_per_worker << "\n"
+            << "attention_query_tile " << p.attention_query_tile << "\n"
+            << "attention_key_tile " << p.attention_key_tile << "\n"
+            << "fixed_gemv " << (p.fixed_gemv ? 1 : 0) << "\n";
+        if (!out.flush()) {
+            ::unlink(tmp.c_str());
+            throw_error("tuning: cannot write " + tmp);
+        }
+    }
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        const int saved = errno;
+        ::unlink(tmp.c_str());
+        errno = saved;
+        throw_errno("write " + path);
+    }
+}
+
+const TuningProfile& tuning() { return state().profile; }
+
+const std::string& tuning_source() { return state().source; }
+
+void set_tuning(const TuningProfile& profile) { state().profile = profile; }
+
+int64_t panels_per_task(int64_t panels, int workers, int64_t align) {
+    const int64_t wanted = int64_t(workers) * tuning().tasks_per_worker;
+    const int64_t tasks = std::clamp<int64_t>(wanted, 1, std::max<int64_t>(panels, 1));
+    return ((panels + tasks - 1) / tasks + align - 1) / align * align;
+}
+
+} // namespace neuroctx
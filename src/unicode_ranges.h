@@ -0,0 +1,217 @@
+#pragma once
+
+// Code point ranges above U+007F in general categories L* (letters) and N*
+// (numbers), from the Unicode 14.0.0 character database; the \p{L} and \p{N}
+// classes of the pre-tokenizer patterns. Sorted and disjoint.
+
+#include <cstdint>
+
+namespace neuroctx::unicode {
+
+enum : uint8_t { kL = 1, kN = 2 };
+
+struct Range {
+    uint32_t first;
+    uint32_t last;
+    uint8_t category;
+};
+
+inline constexpr Range kLetterNumberRanges[] = {
+    {0x000aa, 0x000aa, kL}, {0x000b2, 0x000b3, kN}, {0x000b5, 0x000b5, kL}, {0x000b9, 0x000b9, kN},
+    {0x000ba, 0x000ba, kL}, {0x000bc, 0x000be, kN}, {0x000c0, 0x000d6, kL}, {0x000d8, 0x000f6, kL},
+    {0x000f8, 0x002c1, kL}, {0x002c6, 0x002d1, kL}, {0x002e0, 0x002e4, kL}, {0x002ec, 0x002ec, kL},
+    {0x002ee, 0x002ee, kL}, {0x00370, 0x00374, kL}, {0x00376, 0x00377, kL}, {0x0037a, 0x0037d, kL},
+    {0x0037f, 0x0037f, kL}, {0x00386, 0x00386, kL}, {0x00388, 0x0038a, kL}, {0x0038c, 0x0038c, kL},
+    {0x0038e, 0x003a1, kL}, {0x003a3, 0x003f5, kL}, {0x003f7, 0x00481, kL}, {0x0048a, 0x0052f, kL},
+    {0x00531, 0x00556, kL}, {0x00559, 0x00559, kL}, {0x00560, 0x00588, kL}, {0x005d0, 0x005ea, kL},
+    {0x005ef, 0x005f2, kL}, {0x00620, 0x0064a, kL}, {0x00660, 0x00669, kN}, {0x0066e, 0x0066f, kL},
+    {0x00671, 0x006d3, kL}, {0x006d5, 0x006d5, kL}, {0x006e5, 0x006e6, kL}, {0x006ee, 0x006ef, kL},
+    {0x006f0, 0x006f9, kN}, {0x006fa, 0x006fc, kL}, {0x006ff, 0x006ff, kL}, {0x00710, 0x00710, kL},
+    {0x00712, 0x0072f, kL}, {0x0074d, 0x007a5, kL}, {0x007b1, 0x007b1, kL}, {0x007c0, 0x007c9, kN},
+    {0x007ca, 0x007ea, kL}, {0x007f4, 0x007f5, kL}, {0x007fa, 0x007fa, kL}, {0x00800, 0x00815, kL},
+    {0x0081a, 0x0081a, kL}, {0x00824, 0x00824, kL}, {0x00828, 0x00828, kL}, {0x00840, 0x00858, kL},
+    {0x00860, 0x0086a, kL}, {0x00870, 0x00887, kL}, {0x00889, 0x0088e, kL}, {0x008a0, 0x008c9, kL},
+    {0x00904, 0x00939, kL}, {0x0093d, 0x0093d, kL}, {0x00950, 0x00950, kL}, {0x00958, 0x00961, kL},
+    {0x00966, 0x0096f, kN}, {0x00971, 0x00980, kL}, {0x00985, 0x0098c, kL}, {0x0098f, 0x00990, kL},
+    {0x00993, 0x009a8, kL}, {0x009aa, 0x009b0, kL}, {0x009b2, 0x009b2, kL}, {0x009b6, 0x009b9, kL},
+    {0x009bd, 0x009bd, kL}, {0x009ce, 0x009ce, kL}, {0x009dc, 0x009dd, kL}, {0x009df, 0x009e1, kL},
+    {0x009e6, 0x009ef, kN}, {0x009f0, 0x009f1, kL}, {0x009f4, 0x009f9, kN}, {0x009fc, 0x009fc, kL},
+    {0x00a05, 0x00a0a, kL}, {0x00a0f, 0x00a10, kL}, {0x00a13, 0x00a28, kL}, {0x00a2a, 0x00a30, kL},
+    {0x00a32, 0x00a33, kL}, {0x00a35, 0x00a36, kL}, {0x00a38, 0x00a39, kL}, {0x00a59, 0x00a5c, kL},
+    {0x00a5e, 0x00a5e, kL}, {0x00a66, 0x00a6f, kN}, {0x00a72, 0x00a74, kL}, {0x00a85, 0x00a8d, kL},
+    {0x00a8f, 0x00a91, kL}, {0x00a93, 0x00aa8, kL}, {0x00aaa, 0x00ab0, kL}, {0x00ab2, 0x00ab3, kL},
+    {0x00ab5, 0x00ab9, kL}, {0x00abd, 0x00abd, kL}, {0x00ad0, 0x00ad0, kL}, {0x00ae0, 0x00ae1, kL},
+    {0x00ae6, 0x00aef, kN}, {0x00af9, 0x00af9, kL}, {0x00b05, 0x00b0c, kL}, {0x00b0f, 0x00b10, kL},
+    {0x00b13, 0x00b28, kL}, {0x00b2a, 0x00b30, kL}, {0x00b32, 0x00b33, kL}, {0x00b35, 0x00b39, kL},
+    {0x00b3d, 0x00b3d, kL}, {0x00b5c, 0x00b5d, kL}, {0x00b5f, 0x00b61, kL}, {0x00b66, 0x00b6f, kN},
+    {0x00b71, 0x00b71, kL}, {0x00b72, 0x00b77, kN}, {0x00b83, 0x00b83, kL}, {0x00b85, 0x00b8a, kL},
+    {0x00b8e, 0x00b90, kL}, {0x00b92, 0x00b95, kL}, {0x00b99, 0x00b9a, kL}, {0x00b9c, 0x00b9c, kL},
+    {0x00b9e, 0x00b9f, kL}, {0x00ba3, 0x00ba4, kL}, {0x00ba8, 0x00baa, kL}, {0x00bae, 0x00bb9, kL},
+    {0x00bd0, 0x00bd0, kL}, {0x00be6, 0x00bf2, kN}, {0x00c05, 0x00c0c, kL}, {0x00c0e, 0x00c10, kL},
+    {0x00c12, 0x00c28, kL}, {0x00c2a, 0x00c39, kL}, {0x00c3d, 0x00c3d, kL}, {0x00c58, 0x00c5a, kL},
+    {0x00c5d, 0x00c5d, kL}, {0x00c60, 0x00c61, kL}, {0x00c66, 0x00c6f, kN}, {0x00c78, 0x00c7e, kN},
+    {0x00c80, 0x00c80, kL}, {0x00c85, 0x00c8c, kL}, {0x00c8e, 0x00c90, kL}, {0x00c92, 0x00ca8, kL},
+    {0x00caa, 0x00cb3, kL}, {0x00cb5, 0x00cb9, kL}, {0x00cbd, 0x00cbd, kL}, {0x00cdd, 0x00cde, kL},
+    {0x00ce0, 0x00ce1, kL}, {0x00ce6, 0x00cef, kN}, {0x00cf1, 0x00cf2, kL}, {0x00d04, 0x00d0c, kL},
+    {0x00d0e, 0x00d10, kL}, {0x00d12, 0x00d3a, kL}, {0x00d3d, 0x00d3d, kL}, {0x00d4e, 0x00d4e, kL},
+    {0x00d54, 0x00d56, kL}, {0x00d58, 0x00d5e, kN}, {0x00d5f, 0x00d61, kL}, {0x00d66, 0x00d78, kN},
+    {0x00d7a, 0x00d7f, kL}, {0x00d85, 0x00d96, kL}, {0x00d9a, 0x00db1, kL}, {0x00db3, 0x00dbb, kL},
+    {0x00dbd, 0x00dbd, kL}, {0x00dc0, 0x00dc6, kL}, {0x00de6, 0x00def, kN}, {0x00e01, 0x00e30, kL},
+    {0x00e32, 0x00e33, kL}, {0x00e40, 0x00e46, kL}, {0x00e50, 0x00e59, kN}, {0x00e81, 0x00e82, kL},
+    {0x00e84, 0x00e84, kL}, {0x00e86, 0x00e8a, kL}, {0x00e8c, 0x00ea3, kL}, {0x00ea5, 0x00ea5, kL},
+    {0x00ea7, 0x00eb0, kL}, {0x00eb2, 0x00eb3, kL}, {0x00ebd, 0x00ebd, kL}, {0x00ec0, 0x00ec4, kL},
+    {0x00ec6, 0x00ec6, kL}, {0x00ed0, 0x00ed9, kN}, {0x00edc, 0x00edf, kL}, {0x00f00, 0x00f00, kL},
+    {0x00f20, 0x00f33, kN}, {0x00f40, 0x00f47, kL}, {0x00f49, 0x00f6c, kL}, {0x00f88, 0x00f8c, kL},
+    {0x01000, 0x0102a, kL}, {0x0103f, 0x0103f, kL}, {0x01040, 0x01049, kN}, {0x01050, 0x01055, kL},
+    {0x0105a, 0x0105d, kL}, {0x01061, 0x01061, kL}, {0x01065, 0x01066, kL}, {0x0106e, 0x01070, kL},
+    {0x01075, 0x01081, kL}, {0x0108e, 0x0108e, kL}, {0x01090, 0x01099, kN}, {0x010a0, 0x010c5, kL},
+    {0x010c7, 0x010c7, kL}, {0x010cd, 0x010cd, kL}, {0x010d0, 0x010fa, kL}, {0x010fc, 0x01248, kL},
+    {0x0124a, 0x0124d, kL}, {0x01250, 0x01256, kL}, {0x01258, 0x01258, kL}, {0x0125a, 0x0125d, kL},
+    {0x01260, 0x01288, kL}, {0x0128a, 0x0128d, kL}, {0x01290, 0x012b0, kL}, {0x012b2, 0x012b5, kL},
+    {0x012b8, 0x012be, kL}, {0x012c0, 0x012c0, kL}, {0x012c2, 0x012c5, kL}, {0x012c8, 0x012d6, kL},
+    {0x012d8, 0x01310, kL}, {0x01312, 0x01315, kL}, {0x01318, 0x0135a, kL}, {0x01369, 0x0137c, kN},
+    {0x01380, 0x0138f, kL}, {0x013a0, 0x013f5, kL}, {0x013f8, 0x013fd, kL}, {0x01401, 0x0166c, kL},
+    {0x0166f, 0x0167f, kL}, {0x01681, 0x0169a, kL}, {0x016a0, 0x016ea, kL}, {0x016ee, 0x016f0, kN},
+    {0x016f1, 0x016f8, kL}, {0x01700, 0x01711, kL}, {0x0171f, 0x01731, kL}, {0x01740, 0x01751, kL},
+    {0x01760, 0x0176c, kL}, {0x0176e, 0x01770, kL}, {0x01780, 0x017b3, kL}, {0x017d7, 0x017d7, kL},
+    {0x017dc, 0x017dc, kL}, {0x017e0, 0x017e9, kN}, {0x017f0, 0x017f9, kN}, {0x01810, 0x01819, kN},
+    {0x01820, 0x01878, kL}, {0x01880, 0x01884, kL}, {0x01887, 0x018a8, kL}, {0x018aa, 0x018aa, kL},
+    {0x018b0, 0x018f5, kL}, {0x01900, 0x0191e, kL}, {0x01946, 0x0194f, kN}, {0x01950, 0x0196d, kL},
+    {0x01970, 0x01974, kL}, {0x01980, 0x019ab, kL}, {0x019b0, 0x019c9, kL}, {0x019d0, 0x019da, kN},
+    {0x01a00, 0x01a16, kL}, {0x01a20, 0x01a54, kL}, {0x01a80, 0x01a89, kN}, {0x01a90, 0x01a99, kN},
+    {0x01aa7, 0x01aa7, kL}, {0x01b05, 0x01b33, kL}, {0x01b45, 0x01b4c, kL}, {0x01b50, 0x01b59, kN},
+    {0x01b83, 0x01ba0, kL}, {0x01bae, 0x01baf, kL}, {0x01bb0, 0x01bb9, kN}, {0x01bba, 0x01be5, kL},
+    {0x01c00, 0x01c23, kL}, {0x01c40, 0x01c49, kN}, {0x01c4d, 0x01c4f, kL}, {0x01c50, 0x01c59, kN},
+    {0x01c5a, 0x01c7d, kL}, {0x01c80, 0x01c88, kL}, {0x01c90, 0x01cba, kL}, {0x01cbd, 0x01cbf, kL},
+    {0x01ce9, 0x01cec, kL}, {0x01cee, 0x01cf3, kL}, {0x01cf5, 0x01cf6, kL}, {0x01cfa, 0x01cfa, kL},
+    {0x01d00, 0x01dbf, kL}, {0x01e00, 0x01f15, kL}, {0x01f18, 0x01f1d, kL}, {0x01f20, 0x01f45, kL},
+    {0x01f48, 0x01f4d, kL}, {0x01f50, 0x01f57, kL}, {0x01f59, 0x01f59, kL}, {0x01f5b, 0x01f5b, kL},
+    {0x01f5d, 0x01f5d, kL}, {0x01f5f, 0x01f7d, kL}, {0x01f80, 0x01fb4, kL}, {0x01fb6, 0x01fbc, kL},
+    {0x01fbe, 0x01fbe, kL}, {0x01fc2, 0x01fc4, kL}, {0x01fc6, 0x01fcc, kL}, {0x01fd0, 0x01fd3, kL},
+    {0x01fd6, 0x01fdb, kL}, {0x01fe0, 0x01fec, kL}, {0x01ff2, 0x01ff4, kL}, {0x01ff6, 0x01ffc, kL},
+    {0x02070, 0x02070, kN}, {0x02071, 0x02071, kL}, {0x02074, 0x02079, kN}, {0x0207f, 0x0207f, kL},
+    {0x02080, 0x02089, kN}, {0x02090, 0x0209c, kL}, {0x02102, 0x02102, kL}, {0x02107, 0x02107, kL},
+    {0x0210a, 0x02113, kL}, {0x02115, 0x02115, kL}, {0x02119, 0x0211d, kL}, {0x02124, 0x02124, kL},
+    {0x02126, 0x02126, kL}, {0x02128, 0x02128, kL}, {0x0212a, 0x0212d, kL}, {0x0212f, 0x02139, kL},
+    {0x0213c, 0x0213f, kL}, {0x02145, 0x02149, kL}, {0x0214e, 0x0214e, kL}, {0x02150, 0x02182, kN},
+    {0x02183, 0x02184, kL}, {0x02185, 0x02189, kN}, {0x02460, 0x0249b, kN}, {0x024ea, 0x024ff, kN},
+    {0x02776, 0x02793, kN}, {0x02c00, 0x02ce4, kL}, {0x02ceb, 0x02cee, kL}, {0x02cf2, 0x02cf3, kL},
+    {0x02cfd, 0x02cfd, kN}, {0x02d00, 0x02d25, kL}, {0x02d27, 0x02d27, kL}, {0x02d2d, 0x02d2d, kL},
+    {0x02d30, 0x02d67, kL}, {0x02d6f, 0x02d6f, kL}, {0x02d80, 0x02d96, kL}, {0x02da0, 0x02da6, kL},
+    {0x02da8, 0x02dae, kL}, {0x02db0, 0x02db6, kL}, {0x02db8, 0x02dbe, kL}, {0x02dc0, 0x02dc6, kL},
+    {0x02dc8, 0x02dce, kL}, {0x02dd0, 0x02dd6, kL}, {0x02dd8, 0x02dde, kL}, {0x02e2f, 0x02e2f, kL},
+    {0x03005, 0x03006, kL}, {0x03007, 0x03007, kN}, {0x03021, 0x03029, kN}, {0x03031, 0x03035, kL},
+    {0x03038, 0x0303a, kN}, {0x0303b, 0x0303c, kL}, {0x03041, 0x03096, kL}, {0x0309d, 0x0309f, kL},
+    {0x030a1, 0x030fa, kL}, {0x030fc, 0x030ff, kL}, {0x03105, 0x0312f, kL}, {0x03131, 0x0318e, kL},
+    {0x03192, 0x03195, kN}, {0x031a0, 0x031bf, kL}, {0x031f0, 0x031ff, kL}, {0x03220, 0x03229, kN},
+    {0x03248, 0x0324f, kN}, {0x03251, 0x0325f, kN}, {0x03280, 0x03289, kN}, {0x032b1, 0x032bf, kN},
+    {0x03400, 0x04dbf, kL}, {0x04e00, 0x0a48c, kL}, {0x0a4d0, 0x0a4fd, kL}, {0x0a500, 0x0a60c, kL},
+    {0x0a610, 0x0a61f, kL}, {0x0a620, 0x0a629, kN}, {0x0a62a, 0x0a62b, kL}, {0x0a640, 0x0a66e, kL},
+    {0x0a67f, 0x0a69d, kL}, {0x0a6a0, 0x0a6e5, kL}, {0x0a6e6, 0x0a6ef, kN}, {0x0a717, 0x0a71f, kL},
+    {0x0a722, 0x0a788, kL}, {0x0a78b, 0x0a7ca, kL}, {0x0a7d0, 0x0a7d1, kL}, {0x0a7d3, 0x0a7d3, kL},
+    {0x0a7d5, 0x0a7d9, kL}, {0x0a7f2, 0x0a801, kL}, {0x0a803, 0x0a805, kL}, {0x0a807, 0x0a80a, kL},
+    {0x0a80c, 0x0a822, kL}, {0x0a830, 0x0a835, kN}, {0x0a840, 0x0a873, kL}, {0x0a882, 0x0a8b3, kL},
+    {0x0a8d0, 0x0a8d9, kN}, {0x0a8f2, 0x0a8f7, kL}, {0x0a8fb, 0x0a8fb, kL}, {0x0a8fd, 0x0a8fe, kL},
+    {0x0a900, 0x0a909, kN}, {0x0a90a, 0x0a925, kL}, {0x0a930, 0x0a946, kL}, {0x0a960, 0x0a97c, kL},
+    {0x0a984, 0x0a9b2, kL}, {0x0a9cf, 0x0a9cf, kL}, {0x0a9d0, 0x0a9d9, kN}, {0x0a9e0, 0x0a9e4, kL},
+    {0x0a9e6, 0x0a9ef, kL}, {0x0a9f0, 0x0a9f9, kN}, {0x0a9fa, 0x0a9fe, kL}, {0x0aa00, 0x0aa28, kL},
+    {0x0aa40, 0x0aa42, kL}, {0x0aa44, 0x0aa4b, kL}, {0x0aa50, 0x0aa59, kN}, {0x0aa60, 0x0aa76, kL},
+    {0x0aa7a, 0x0aa7a, kL}, {0x0aa7e, 0x0aaaf, kL}, {0x0aab1, 0x0aab1, kL}, {0x0aab5, 0x0aab6, kL},
+    {0x0aab9, 0x0aabd, kL}, {0x0aac0, 0x0aac0, kL}, {0x0aac2, 0x0aac2, kL}, {0x0aadb, 0x0aadd, kL},
+    {0x0aae0, 0x0aaea, kL}, {0x0aaf2, 0x0aaf4, kL}, {0x0ab01, 0x0ab06, kL}, {0x0ab09, 0x0ab0e, kL},
+    {0x0ab11, 0x0ab16, kL}, {0x0ab20, 0x0ab26, kL}, {0x0ab28, 0x0ab2e, kL}, {0x0ab30, 0x0ab5a, kL},
+    {0x0ab5c, 0x0ab69, kL}, {0x0ab70, 0x0abe2, kL}, {0x0abf0, 0x0abf9, kN}, {0x0ac00, 0x0d7a3, kL},
+    {0x0d7b0, 0x0d7c6, kL}, {0x0d7cb, 0x0d7fb, kL}, {0x0f900, 0x0fa6d, kL}, {0x0fa70, 0x0fad9, kL},
+    {0x0fb00, 0x0fb06, kL}, {0x0fb13, 0x0fb17, kL}, {0x0fb1d, 0x0fb1d, kL}, {0x0fb1f, 0x0fb28, kL},
+    {0x0fb2a, 0x0fb36, kL}, {0x0fb38, 0x0fb3c, kL}, {0x0fb3e, 0x0fb3e, kL}, {0x0fb40, 0x0fb41, kL},
+    {0x0fb43, 0x0fb44, kL}, {0x0fb46, 0x0fbb1, kL}, {0x0fbd3, 0x0fd3d, kL}, {0x0fd50, 0x0fd8f, kL},
+    {0x0fd92, 0x0fdc7, kL}, {0x0fdf0, 0x0fdfb, kL}, {0x0fe70, 0x0fe74, kL}, {0x0fe76, 0x0fefc, kL},
+    {0x0ff10, 0x0ff19, kN}, {0x0ff21, 0x0ff3a, kL}, {0x0ff41, 0x0ff5a, kL}, {0x0ff66, 0x0ffbe, kL},
+    {0x0ffc2, 0x0ffc7, kL}, {0x0ffca, 0x0ffcf, kL}, {0x0ffd2, 0x0ffd7, kL}, {0x0ffda, 0x0ffdc, kL},
+    {0x10000, 0x1000b, kL}, {0x1000d, 0x10026, kL}, {0x10028, 0x1003a, kL}, {0x1003c, 0x1003d, kL},
+    {0x1003f, 0x1004d, kL}, {0x10050, 0x1005d, kL}, {0x10080, 0x100fa, kL}, {0x10107, 0x10133, kN},
+    {0x10140, 0x10178, kN}, {0x1018a, 0x1018b, kN}, {0x10280, 0x1029c, kL}, {0x102a0, 0x102d0, kL},
+    {0x102e1, 0x102fb, kN}, {0x10300, 0x1031f, kL}, {0x10320, 0x10323, kN}, {0x1032d, 0x10340, kL},
+    {0x10341, 0x10341, kN}, {0x10342, 0x10349, kL}, {0x1034a, 0x1034a, kN}, {0x10350, 0x10375, kL},
+    {0x10380, 0x1039d, kL}, {0x103a0, 0x103c3, kL}, {0x103c8, 0x103cf, kL}, {0x103d1, 0x103d5, kN},
+    {0x10400, 0x1049d, kL}, {0x104a0, 0x104a9, kN}, {0x104b0, 0x104d3, kL}, {0x104d8, 0x104fb, kL},
+    {0x10500, 0x10527, kL}, {0x10530, 0x10563, kL}, {0x10570, 0x1057a, kL}, {0x1057c, 0x1058a, kL},
+    {0x1058c, 0x10592, kL}, {0x10594, 0x10595, kL}, {0x10597, 0x105a1, kL}, {0x105a3, 0x105b1, kL},
+    {0x105b3, 0x105b9, kL}, {0x105bb, 0x105bc, kL}, {0x10600, 0x10736, kL}, {0x10740, 0x10755, kL},
+    {0x10760, 0x10767, kL}, {0x10780, 0x10785, kL}, {0x10787, 0x107b0, kL}, {0x107b2, 0x107ba, kL},
+    {0x10800, 0x10805, kL}, {0x10808, 0x10808, kL}, {0x1080a, 0x10835, kL}, {0x10837, 0x10838, kL},
+    {0x1083c, 0x1083c, kL}, {0x1083f, 0x10855, kL}, {0x10858, 0x1085f, kN}, {0x10860, 0x10876, kL},
+    {0x10879, 0x1087f, kN}, {0x10880, 0x1089e, kL}, {0x108a7, 0x108af, kN}, {0x108e0, 0x108f2, kL},
+    {0x108f4, 0x108f5, kL}, {0x108fb, 0x108ff, kN}, {0x10900, 0x10915, kL}, {0x10916, 0x1091b, kN},
+    {0x10920, 0x10939, kL}, {0x10980, 0x109b7, kL}, {0x109bc, 0x109bd, kN}, {0x109be, 0x109bf, kL},
+    {0x109c0, 0x109cf, kN}, {0x109d2, 0x109ff, kN}, {0x10a00, 0x10a00, kL}, {0x10a10, 0x10a13, kL},
+    {0x10a15, 0x10a17, kL}, {0x10a19, 0x10a35, kL}, {0x10a40, 0x10a48, kN}, {0x10a60, 0x10a7c, kL},
+    {0x10a7d, 0x10a7e, kN}, {0x10a80, 0x10a9c, kL}, {0x10a9d, 0x10a9f, kN}, {0x10ac0, 0x10ac7, kL},
+    {0x10ac9, 0x10ae4, kL}, {0x10aeb, 0x10aef, kN}, {0x10b00, 0x10b35, kL}, {0x10b40, 0x10b55, kL},
+    {0x10b58, 0x10b5f, kN}, {0x10b60, 0x10b72, kL}, {0x10b78, 0x10b7f, kN}, {0x10b80, 0x10b91, kL},
+    {0x10ba9, 0x10baf, kN}, {0x10c00, 0x10c48, kL}, {0x10c80, 0x10cb2, kL}, {0x10cc0, 0x10cf2, kL},
+    {0x10cfa, 0x10cff, kN}, {0x10d00, 0x10d23, kL}, {0x10d30, 0x10d39, kN}, {0x10e60, 0x10e7e, kN},
+    {0x10e80, 0x10ea9, kL}, {0x10eb0, 0x10eb1, kL}, {0x10f00, 0x10f1c, kL}, {0x10f1d, 0x10f26, kN},
+    {0x10f27, 0x10f27, kL}, {0x10f30, 0x10f45, kL}, {0x10f51, 0x10f54, kN}, {0x10f70, 0x10f81, kL},
+    {0x10fb0, 0x10fc4, kL}, {0x10fc5, 0x10fcb, kN}, {0x10fe0, 0x10ff6, kL}, {0x11003, 0x11037, kL},
+    {0x11052, 0x1106f, kN}, {0x11071, 0x11072, kL}, {0x11075, 0x11075, kL}, {0x11083, 0x110af, kL},
+    {0x110d0, 0x110e8, kL}, {0x110f0, 0x110f9, kN}, {0x11103, 0x11126, kL}, {0x11136, 0x1113f, kN},
+    {0x11144, 0x11144, kL}, {0x11147, 0x11147, kL}, {0x11150, 0x11172, kL}, {0x11176, 0x11176, kL},
+    {0x11183, 0x111b2, kL}, {0x111c1, 0x111c4, kL}, {0x111d0, 0x111d9, kN}, {0x111da, 0x111da, kL},
+    {0x111dc, 0x111dc, kL}, {0x111e1, 0x111f4, kN}, {0x11200, 0x11211, kL}, {0x11213, 0x1122b, kL},
+    {0x11280, 0x11286, kL}, {0x11288, 0x11288, kL}, {0x1128a, 0x1128d, kL}, {0x1128f, 0x1129d, kL},
+    {0x1129f, 0x112a8, kL}, {0x112b0, 0x112de, kL}, {0x112f0, 0x112f9, kN}, {0x11305, 0x1130c, kL},
+    {0x1130f, 0x11310, kL}, {0x11313, 0x11328, kL}, {0x1132a, 0x11330, kL}, {0x11332, 0x11333, kL},
+    {0x11335, 0x11339, kL}, {0x1133d, 0x1133d, kL}, {0x11350, 0x11350, kL}, {0x1135d, 0x11361, kL},
+    {0x11400, 0x11434, kL}, {0x11447, 0x1144a, kL}, {0x11450, 0x11459, kN}, {0x1145f, 0x11461, kL},
+    {0x11480, 0x114af, kL}, {0x114c4, 0x114c5, kL}, {0x114c7, 0x114c7, kL}, {0x114d0, 0x114d9, kN},
+    {0x11580, 0x115ae, kL}, {0x115d8, 0x115db, kL}, {0x11600, 0x1162f, kL}, {0x11644, 0x11644, kL},
+    {0x11650, 0x11659, kN}, {0x11680, 0x116aa, kL}, {0x116b8, 0x116b8, kL}, {0x116c0, 0x116c9, kN},
+    {0x11700, 0x1171a, kL}, {0x11730, 0x1173b, kN}, {0x11740, 0x11746, kL}, {0x11800, 0x1182b, kL},
+    {0x118a0, 0x118df, kL}, {0x118e0, 0x118f2, kN}, {0x118ff, 0x11906, kL}, {0x11909, 0x11909, kL},
+    {0x1190c, 0x11913, kL}, {0x11915, 0x11916, kL}, {0x11918, 0x1192f, kL}, {0x1193f, 0x1193f, kL},
+    {0x11941, 0x11941, kL}, {0x11950, 0x11959, kN}, {0x119a0, 0x119a7, kL}, {0x119aa, 0x119d0, kL},
+    {0x119e1, 0x119e1, kL}, {0x119e3, 0x119e3, kL}, {0x11a00, 0x11a00, kL}, {0x11a0b, 0x11a32, kL},
+    {0x11a3a, 0x11a3a, kL}, {0x11a50, 0x11a50, kL}, {0x11a5c, 0x11a89, kL}, {0x11a9d, 0x11a9d, kL},
+    {0x11ab0, 0x11af8, kL}, {0x11c00, 0x11c08, kL}, {0x11c0a, 0x11c2e, kL}, {0x11c40, 0x11c40, kL},
+    {0x11c50, 0x11c6c, kN}, {0x11c72, 0x11c8f, kL}, {0x11d00, 0x11d06, kL}, {0x11d08, 0x11d09, kL},
+    {0x11d0b, 0x11d30, kL}, {0x11d46, 0x11d46, kL}, {0x11d50, 0x11d59, kN}, {0x11d60, 0x11d65, kL},
+    {0x11d67, 0x11d68, kL}, {0x11d6a, 0x11d89, kL}, {0x11d98, 0x11d98, kL}, {0x11da0, 0x11da9, kN},
+    {0x11ee0, 0x11ef2, kL}, {0x11fb0, 0x11fb0, kL}, {0x11fc0, 0x11fd4, kN}, {0x12000, 0x12399, kL},
+    {0x12400, 0x1246e, kN}, {0x12480, 0x12543, kL}, {0x12f90, 0x12ff0, kL}, {0x13000, 0x1342e, kL},
+    {0x14400, 0x14646, kL}, {0x16800, 0x16a38, kL}, {0x16a40, 0x16a5e, kL}, {0x16a60, 0x16a69, kN},
+    {0x16a70, 0x16abe, kL}, {0x16ac0, 0x16ac9, kN}, {0x16ad0, 0x16aed, kL}, {0x16b00, 0x16b2f, kL},
+    {0x16b40, 0x16b43, kL}, {0x16b50, 0x16b59, kN}, {0x16b5b, 0x16b61, kN}, {0x16b63, 0x16b77, kL},
+    {0x16b7d, 0x16b8f, kL}, {0x16e40, 0x16e7f, kL}, {0x16e80, 0x16e96, kN}, {0x16f00, 0x16f4a, kL},
+    {0x16f50, 0x16f50, kL}, {0x16f93, 0x16f9f, kL}, {0x16fe0, 0x16fe1, kL}, {0x16fe3, 0x16fe3, kL},
+    {0x17000, 0x187f7, kL}, {0x18800, 0x18cd5, kL}, {0x18d00, 0x18d08, kL}, {0x1aff0, 0x1aff3, kL},
+    {0x1aff5, 0x1affb, kL}, {0x1affd, 0x1affe, kL}, {0x1b000, 0x1b122, kL}, {0x1b150, 0x1b152, kL},
+    {0x1b164, 0x1b167, kL}, {0x1b170, 0x1b2fb, kL}, {0x1bc00, 0x1bc6a, kL}, {0x1bc70, 0x1bc7c, kL},
+    {0x1bc80, 0x1bc88, kL}, {0x1bc90, 0x1bc99, kL}, {0x1d2e0, 0x1d2f3, kN}, {0x1d360, 0x1d378, kN},
+    {0x1d400, 0x1d454, kL}, {0x1d456, 0x1d49c, kL}, {0x1d49e, 0x1d49f, kL}, {0x1d4a2, 0x1d4a2, kL},
+    {0x1d4a5, 0x1d4a6, kL}, {0x1d4a9, 0x1d4ac, kL}, {0x1d4ae, 0x1d4b9, kL}, {0x1d4bb, 0x1d4bb, kL},
+    {0x1d4bd, 0x1d4c3, kL}, {0x1d4c5, 0x1d505, kL}, {0x1d507, 0x1d50a, kL}, {0x1d50d, 0x1d514, kL},
+    {0x1d516, 0x1d51c, kL}, {0x1d51e, 0x1d539, kL}, {0x1d53b, 0x1d53e, kL}, {0x1d540, 0x1d544, kL},
+    {0x1d546, 0x1d546, kL}, {0x1d54a, 0x1d550, kL}, {0x1d552, 0x1d6a5, kL}, {0x1d6a8, 0x1d6c0, kL},
+    {0x1d6c2, 0x1d6da, kL}, {0x1d6dc, 0x1d6fa, kL}, {0x1d6fc, 0x1d714, kL}, {0x1d716, 0x1d734, kL},
+    {0x1d736, 0x1d74e, kL}, {0x1d750, 0x1d76e, kL}, {0x1d770, 0x1d788, kL}, {0x1d78a, 0x1d7a8, kL},
+    {0x1d7aa, 0x1d7c2, kL}, {0x1d7c4, 0x1d7cb, kL}, {0x1d7ce, 0x1d7ff, kN}, {0x1df00, 0x1df1e, kL},
+    {0x1e100, 0x1e12c, kL}, {0x1e137, 0x1e13d, kL}, {0x1e140, 0x1e149, kN}, {0x1e14e, 0x1e14e, kL},
+    {0x1e290, 0x1e2ad, kL}, {0x1e2c0, 0x1e2eb, kL}, {0x1e2f0, 0x1e2f9, kN}, {0x1e7e0, 0x1e7e6, kL},
+    {0x1e7e8, 0x1e7eb, kL}, {0x1e7ed, 0x1e7ee, kL}, {0x1e7f0, 0x1e7fe, kL}, {0x1e800, 0x1e8c4, kL},
+    {0x1e8c7, 0x1e8cf, kN}, {0x1e900, 0x1e943, kL}, {0x1e94b, 0x1e94b, kL}, {0x1e950, 0x1e959, kN},
+    {0x1ec71, 0x1ecab, kN}, {0x1ecad, 0x1ecaf, kN}, {0x1ecb1, 0x1ecb4, kN}, {0x1ed01, 0x1ed2d, kN},
+    {0x1ed2f, 0x1ed3d, kN}, {0x1ee00, 0x1ee03, kL}, {0x1ee05, 0x1ee1f, kL}, {0x1ee21, 0x1ee22, kL},
+    {0x1ee24, 0x1ee24, kL}, {0x1ee27, 0x1ee27, kL}, {0x1ee29, 0x1ee32, kL}, {0x1ee34, 0x1ee37, kL},
+    {0x1ee39, 0x1ee39, kL}, {0x1ee3b, 0x1ee3b, kL}, {0x1ee42, 0x1ee42, kL}, {0x1ee47, 0x1ee47, kL},
+    {0x1ee49, 0x1ee49, kL}, {0x1ee4b, 0x1ee4b, kL}, {0x1ee4d, 0x1ee4f, kL}, {0x1ee51, 0x1ee52, kL},
+    {0x1ee54, 0x1ee54, kL}, {0x1ee57, 0x1ee57, kL}, {0x1ee59, 0x1ee59, kL}, {0x1ee5b, 0x1ee5b, kL},
+    {0x1ee5d, 0x1ee5d, kL}, {0x1ee5f, 0x1ee5f, kL}, {0x1ee61, 0x1ee62, kL}, {0x1ee64, 0x1ee64, kL},
+    {0x1ee67, 0x1ee6a, kL}, {0x1ee6c, 0x1ee72, kL}, {0x1ee74, 0x1ee77, kL}, {0x1ee79, 0x1ee7c, kL},
+    {0x1ee7e, 0x1ee7e, kL}, {0x1ee80, 0x1ee89, kL}, {0x1ee8b, 0x1ee9b, kL}, {0x1eea1, 0x1eea3, kL},
+    {0x1eea5, 0x1eea9, kL}, {0x1eeab, 0x1eebb, kL}, {0x1f100, 0x1f10c, kN}, {0x1fbf0, 0x1fbf9, kN},
+    {0x20000, 0x2a6df, kL}, {0x2a700, 0x2b738, kL}, {0x2b740, 0x2b81d, kL}, {0x2b820, 0x2cea1, kL},
+    {0x2ceb0, 0x2ebe0, kL}, {0x2f800, 0x2fa1d, kL}, {0x30000, 0x3134a, kL},
+};
+
+} // namespace neuroctx::unicode
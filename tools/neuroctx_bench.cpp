@@ -0,0 +1,1047 @@
+// Benchmarks: neuroctx_bench [MODEL.gguf | DIR]... [--threads N] [--prompt N] [--gen N] [--reps N]
+//                            [--rows N] [--ctx N] [--kv f16|int8|fp8] [--cache-dir DIR] [--out FILE]
+//                            [--draft MODEL.gguf] [--trace FILE] [--stream N] [--tune]
+//
+// For every model (a directory means every .gguf in it) this measures the
+// matmul kernels at the model's projection shapes for each supported
+// kernel variant, paged attention at decode and prefill shapes, tokenizer
+// encode speed, per-token sampling cost and end-to-end prefill and decode throughput. Without a
+// model only the kernels run, at a llama-1B-like shape. The report is JSON on stdout (or
+// --out) with stable keys so runs can be diffed; a summary goes to stderr.
+// With --draft, decode is also measured speculatively with that model
+// drafting for each model of the same vocabulary. --trace records the run
+// (see neuroctx/trace.h), writes the newest events as a Perfetto-readable
+// Chrome trace and prints the slowest ops. --stream N loads every model
+// with only N layers resident (ModelOptions::stream_layers). --tune first
+// searches the kernel tile parameters (neuroctx/tuning.h) for this device
+// at the models' shapes, writes the profile where the runtime loads it
+// from and benchmarks with it.
+//
+// Peak RSS is VmHWM, reset per model through /proc/self/clear_refs. Energy
+// is read from a powercap zone or the battery gauge when the platform
+// exposes one, and is null otherwise.
+
+#include "neuroctx/attention.h"
+#include "neuroctx/backend.h"
+#include "neuroctx/common.h"
+#include "neuroctx/kernels.h"
+#include "neuroctx/kv_cache.h"
+#include "neuroctx/model.h"
+#include "neuroctx/sampler.h"
+#include "neuroctx/speculative.h"
+#include "neuroctx/thread_pool.h"
+#include "neuroctx/tokenizer.h"
+#include "neuroctx/trace.h"
+#include "neuroctx/tuning.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace neuroctx;
+using Clock = std::chrono::steady_clock;
+
+int usage() {
+    std::fprintf(stderr,
+                 "usage: neuroctx_bench [MODEL.gguf | DIR]... [--threads N] [--prompt N] [--gen N] [--reps N]\n"
+                 "                      [--rows N] [--ctx N] [--kv f16|int8|fp8] [--cache-dir DIR] [--out FILE]\n"
+                 "                      [--draft MODEL.gguf] [--trace FILE] [--stream N] [--tune]\n");
+    return 2;
+}
+
+struct Options {
+    std::vector<std::string> models;
+    int threads = 0;
+    int64_t prompt = 512;
+    int64_t gen = 128;
+    int reps = 3;
+    int64_t rows = 64; // GEMM rows, also the prefill chunk
+    int64_t ctx = 1024;
+    KvDType kv = KvDType::kF16;
+    std::string cache_dir;
+    std::string out;
+    std::string draft;
+    std::string trace;
+    int32_t stream = 0;
+    bool tune = false;
+};
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Latency samples in seconds.
+struct Samples {
+    std::vector<double> values;
+
+    void add(double s) { values.push_back(s); }
+    double total() const {
+        double t = 0;
+        for (double v : values) {
+            t += v;
+        }
+        return t;
+    }
+    double percentile(double p) const {
+        if (values.empty()) {
+            return 0;
+        }
+        std::vector<double> sorted = values;
+        std::sort(sorted.begin(), sorted.end());
+        const auto i = static_cast<size_t>(std::ceil(p / 100.0 * double(sorted.size()))) - 1;
+        return sorted[std::min(i, sorted.size() - 1)];
+    }
+};
+
+// Minimal JSON writer: objects and arrays nest, commas are implicit.
+class Json {
+public:
+    void begin_object(const char* key = nullptr) { open(key, '{'); }
+    void end_object() { close('}'); }
+    void begin_array(const char* key = nullptr) { open(key, '['); }
+    void end_array() { close(']'); }
+
+    void field(const char* key, const std::string& value) {
+        prefix(key);
+        out_ += '"';
+        for (const char c : value) {
+            if (c == '"' || c == '\\') {
+                out_ += '\\';
+            }
+            if (static_cast<unsigned char>(c) >= 0x20) {
+                out_ += c;
+            }
+        }
+        out_ += '"';
+    }
+    void field(const char* key, const char* value) { field(key, std::string(value)); }
+    void field(const char* key, int64_t value) {
+        prefix(key);
+        out_ += std::to_string(value);
+    }
+    void field(const char* key, double value) {
+        prefix(key);
+        if (!std::isfinite(value)) {
+            out_ += "null";
+            return;
+        }
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.6g", value);
+        out_ += buf;
+    }
+    void field(const char* key, std::optional<double> value) {
+        if (value) {
+            field(key, *value);
+        } else {
+            prefix(key);
+            out_ += "null";
+        }
+    }
+    void latency(const char* key, const Samples& s) {
+        begin_object(key);
+        field("count", static_cast<int64_t>(s.values.size()));
+        field("p50_ms", s.percentile(50) * 1e3);
+        field("p99_ms", s.percentile(99) * 1e3);
+        field("mean_ms", s.values.empty() ? 0.0 : s.total() / double(s.values.size()) * 1e3);
+        end_object();
+    }
+
+    const std::string& str() const { return out_; }
+
+private:
+    void prefix(const char* key) {
+        if (!first_) {
+            out_ += ',';
+        }
+        first_ = false;
+        out_ += '\n';
+        out_.append(depth_ * 2, ' ');
+        if (key != nullptr) {
+            out_ += '"';
+            out_ += key;
+            out_ += "\": ";
+        }
+    }
+    void open(const char* key, char c) {
+        if (depth_ > 0) {
+            prefix(key);
+        }
+        out_ += c;
+        ++depth_;
+        first_ = true;
+    }
+    void close(char c) {
+        --depth_;
+        out_ += '\n';
+        out_.append(depth_ * 2, ' ');
+        out_ += c;
+        first_ = false;
+    }
+
+    std::string out_;
+    size_t depth_ = 0;
+    bool first_ = true;
+};
+
+// Peak resident set size in bytes since the last reset_peak_rss().
+int64_t peak_rss() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::stoll(line.substr(6)) * 1024;
+        }
+    }
+    return 0;
+}
+
+void reset_peak_rss() {
+    std::ofstream clear("/proc/self/clear_refs");
+    clear << "5";
+}
+
+// Cumulative energy counter in joules, from the first readable source.
+class EnergyMeter {
+public:
+    EnergyMeter() {
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        // RAPL-style powercap zones (also exposed by some Arm SoCs).
+        for (const auto& entry : fs::directory_iterator("/sys/class/powercap", ec)) {
+            const std::string name = entry.path().filename().string();
+            if (std::count(name.begin(), name.end(), ':') == 1 && fs::exists(entry.path() / "energy_uj")) {
+                path_ = (entry.path() / "energy_uj").string();
+                source_ = "powercap:" + name;
+                scale_ = 1e-6;
+                return;
+            }
+        }
+        // Battery gauges report energy_now in uWh; coarse, but covers phones.
+        for (const auto& entry : fs::directory_iterator("/sys/class/power_supply", ec)) {
+            if (fs::exists(entry.path() / "energy_now")) {
+                path_ = (entry.path() / "energy_now").string();
+                source_ = "battery:" + entry.path().filename().string();
+                scale_ = 3.6e-3;
+                return;
+            }
+        }
+    }
+
+    const std::string& source() const { return source_; }
+    std::optional<double> read() const {
+        if (path_.empty()) {
+            return std::nullopt;
+        }
+        std::ifstream f(path_);
+        double v = 0;
+        if (!(f >> v)) {
+            return std::nullopt;
+        }
+        return v * scale_;
+    }
+    // Joules used since `start`; nullopt when unavailable. Battery gauges
+    // count down, powercap counters up.
+    std::optional<double> since(std::optional<double> start) const {
+        const std::optional<double> now = read();
+        if (!start || !now) {
+            return std::nullopt;
+        }
+        return std::abs(*now - *start);
+    }
+
+private:
+    std::string path_;
+    std::string source_;
+    double scale_ = 1;
+};
+
+struct MatShape {
+    const char* name;
+    int64_t n; // output channels
+    int64_t k;
+};
+
+std::vector<MatShape> mat_shapes(const ModelConfig& c) {
+    return {
+        {"attn_q", c.n_head * c.head_dim, c.n_embd},
+        {"attn_kv", c.n_head_kv * c.head_dim, c.n_embd},
+        {"attn_output", c.n_embd, c.n_head * c.head_dim},
+        {"ffn_up", c.n_ff, c.n_embd},
+        {"ffn_down", c.n_embd, c.n_ff},
+        {"output", c.n_vocab, c.n_embd},
+    };
+}
+
+ModelConfig default_config() {
+    ModelConfig c;
+    c.architecture = "synthetic";
+    c.n_vocab = 32000;
+    c.n_embd = 2048;
+    c.n_layer = 1;
+    c.n_head = 32;
+    c.n_head_kv = 8;
+    c.head_dim = 64;
+    c.n_ff = 8192;
+    return c;
+}
+
+// Times `fn` at least three times and until `iters` samples or ~1 s.
+template <typename F>
+Samples repeat(int iters, F&& fn) {
+    fn(); // warm caches and page in the weights
+    Samples s;
+    const Clock::time_point budget = Clock::now();
+    while (static_cast<int>(s.values.size()) < std::max(iters, 3) &&
+           (s.values.size() < 3 || seconds_since(budget) < 1.0)) {
+        const Clock::time_point t = Clock::now();
+        fn();
+        s.add(seconds_since(t));
+    }
+    return s;
+}
+
+// Times C = A * W^T split across the pool like the executor splits it, with
+// `fn` on every panel range, or matmul_panels() when it is null.
+Samples time_matmul(ThreadPool& pool, const kernels::KernelSet& ks, const kernels::PackedWeights& w,
+                    const kernels::QuantizedRows& a, float* c, kernels::GemmFn fn, int iters) {
+    return repeat(iters, [&] {
+        const int64_t panels = w.panels();
+        const int64_t per_task = panels_per_task(panels, pool.size());
+        pool.parallel_for((panels + per_task - 1) / per_task, [&](int64_t task, int) {
+            const int64_t begin = task * per_task;
+            const int64_t end = std::min(panels, begin + per_task);
+            if (fn != nullptr) {
+                fn(w, a, c, w.n, begin, end);
+            } else {
+                kernels::matmul_panels(ks, w, a, c, w.n, begin, end);
+            }
+        });
+    });
+}
+
+void bench_kernels(Json& json, const ModelConfig& config, const Options& opt, ThreadPool& pool,
+                   std::mt19937& rng) {
+    std::uniform_int_distribution<int> value(-8, 7);
+    std::uniform_real_distribution<float> act(-1.0f, 1.0f);
+    json.begin_array("kernels");
+    for (const MatShape& shape : mat_shapes(config)) {
+        if (shape.k % kernels::kBlock != 0) {
+            continue;
+        }
+        std::vector<int8_t> wq(static_cast<size_t>(shape.n * shape.k));
+        std::vector<float> ws(static_cast<size_t>(shape.n * shape.k / kernels::kBlock), 0.01f);
+        for (int8_t& v : wq) {
+            v = static_cast<int8_t>(value(rng));
+        }
+        std::vector<float> x(static_cast<size_t>(opt.rows * shape.k));
+        for (float& v : x) {
+            v = act(rng);
+        }
+        std::vector<int8_t> aq(x.size());
+        std::vector<float> as(x.size() / kernels::kBlock);
+        kernels::quantize_rows(x.data(), opt.rows, shape.k, aq.data(), as.data());
+        std::vector<float> c(static_cast<size_t>(opt.rows * shape.n));
+
+        for (const kernels::KernelSet* ks : kernels::supported_kernels(cpu_features())) {
+            for (const kernels::WeightFormat format : {kernels::WeightFormat::kInt8, kernels::WeightFormat::kInt4}) {
+                std::vector<uint8_t> packed(kernels::packed_bytes(shape.n, shape.k, format, ks->layout));
+                kernels::pack_quantized(wq.data(), ws.data(), shape.n, shape.k, format, ks->layout, packed.data());
+                const kernels::PackedWeights w{packed.data(), shape.n, shape.k, format, ks->layout};
+                // A fixed-shape GEMV replaces the generic one in matmul_panels();
+                // time the generic one too to show what it buys.
+                const kernels::GemmFn generic = format == kernels::WeightFormat::kInt8 ? ks->gemv_i8 : ks->gemv_i4;
+                const bool fixed = ks->fixed_gemv != nullptr && ks->fixed_gemv(shape.k, format) != nullptr;
+                struct Run {
+                    const char* op;
+                    int64_t rows;
+                    kernels::GemmFn fn; // nullptr: matmul_panels()
+                };
+                std::vector<Run> runs = {{fixed ? "gemv_fixed" : "gemv", 1, nullptr}};
+                if (fixed) {
+                    runs.push_back({"gemv", 1, generic});
+                }
+                runs.push_back({"gemm", opt.rows, nullptr});
+                for (const Run& run : runs) {
+                    const int64_t rows = run.rows;
+                    const kernels::QuantizedRows a{aq.data(), as.data(), rows, shape.k};
+                    const Samples s = time_matmul(pool, *ks, w, a, c.data(), run.fn, 20);
+                    const double ops = 2.0 * double(rows) * double(shape.n) * double(shape.k);
+                    json.begin_object();
+                    json.field("op", run.op);
+                    json.field("shape", shape.name);
+                    json.field("variant", ks->name);
+                    json.field("format", format == kernels::WeightFormat::kInt8 ? "int8" : "int4");
+                    json.field("m", rows);
+                    json.field("n", shape.n);
+                    json.field("k", shape.k);
+                    json.latency("latency", s);
+                    json.field("gops", ops / s.percentile(50) * 1e-9);
+                    json.field("weight_gbps", double(packed.size()) / s.percentile(50) * 1e-9);
+                    json.end_object();
+                }
+            }
+        }
+    }
+    json.end_array();
+}
+
+KvCacheConfig attention_kv_config(const ModelConfig& config, const Options& opt) {
+    KvCacheConfig kvc;
+    kvc.n_layers = 1;
+    kvc.n_kv_heads = static_cast<int32_t>(config.n_head_kv);
+    kvc.head_dim = static_cast<int32_t>(config.head_dim);
+    kvc.dtype = opt.kv;
+    const size_t positions = size_t(opt.ctx + opt.rows);
+    const size_t row_bytes = size_t(kvc.n_kv_heads) * size_t(kvc.head_dim) * 2 * 4;
+    kvc.budget_bytes = (positions + 2 * size_t(kvc.page_tokens)) * row_bytes * 2;
+    return kvc;
+}
+
+// One layer of `config`'s attention over a cache of opt.ctx + opt.rows
+// random positions.
+class AttentionWorkload {
+public:
+    AttentionWorkload(const ModelConfig& config, const Options& opt, std::mt19937& rng)
+        : kv_(attention_kv_config(config, opt)), positions_(opt.ctx + opt.rows),
+          q_cols_(config.n_head * config.head_dim) {
+        seq_ = kv_.create();
+        if (!kv_.reserve(seq_, positions_)) {
+            throw_error("bench: attention KV does not fit");
+        }
+        std::normal_distribution<float> dist(0.0f, 1.0f);
+        const int64_t kv_cols = config.n_head_kv * config.head_dim;
+        std::vector<float> k(static_cast<size_t>(positions_ * kv_cols));
+        std::vector<float> v(k.size());
+        for (size_t i = 0; i < k.size(); ++i) {
+            k[i] = dist(rng);
+            v[i] = dist(rng);
+        }
+        kv_.store(seq_, 0, 0, positions_, k.data(), v.data());
+        const std::vector<int32_t> tokens(static_cast<size_t>(positions_), 1);
+        kv_.commit(seq_, tokens);
+
+        q_.resize(static_cast<size_t>(opt.rows * q_cols_));
+        for (float& x : q_) {
+            x = dist(rng);
+        }
+        out_.resize(q_.size());
+        shape_.n_head = static_cast<int32_t>(config.n_head);
+        shape_.n_kv_head = static_cast<int32_t>(config.n_head_kv);
+        shape_.head_dim = static_cast<int32_t>(config.head_dim);
+        shape_.scale = 1.0f / std::sqrt(static_cast<float>(config.head_dim));
+    }
+
+    // The last `rows` positions attending to everything before them.
+    Samples run(const kernels::KernelSet& ks, ThreadPool& pool, int64_t rows, int iters) {
+        const int64_t pos0 = positions_ - rows;
+        const int64_t row_tile = attention_row_tile(shape_);
+        const int64_t tiles = (rows + row_tile - 1) / row_tile;
+        return repeat(iters, [&] {
+            pool.parallel_for(tiles * shape_.n_kv_head, [&](int64_t task, int) {
+                const int64_t r = task / shape_.n_kv_head * row_tile;
+                paged_attention(ks, kv_, seq_, 0, shape_, pos0, r, std::min(rows, r + row_tile),
+                                static_cast<int32_t>(task % shape_.n_kv_head), q_.data(), q_cols_, out_.data(),
+                                q_cols_);
+            });
+        });
+    }
+
+    const AttentionShape& shape() const { return shape_; }
+    int64_t positions() const { return positions_; }
+
+private:
+    KvCache kv_;
+    SeqId seq_ = 0;
+    int64_t positions_;
+    int64_t q_cols_;
+    std::vector<float> q_;
+    std::vector<float> out_;
+    AttentionShape shape_;
+};
+
+void bench_attention(Json& json, const ModelConfig& config, const Options& opt, ThreadPool& pool,
+                     std::mt19937& rng) {
+    AttentionWorkload work(config, opt, rng);
+    const AttentionShape& shape = work.shape();
+    json.begin_array("attention");
+    for (const kernels::KernelSet* ks : kernels::supported_kernels(cpu_features())) {
+        for (const int64_t rows : {int64_t(1), opt.rows}) {
+            const Samples s = work.run(*ks, pool, rows, 20);
+            json.begin_object();
+            json.field("op", rows == 1 ? "decode" : "prefill");
+            json.field("variant", ks->name);
+            json.field("kv_dtype", kv_dtype_name(opt.kv));
+            json.field("rows", rows);
+            json.field("context", work.positions());
+            json.field("n_head", int64_t(shape.n_head));
+            json.field("n_kv_head", int64_t(shape.n_kv_head));
+            json.field("head_dim", int64_t(shape.head_dim));
+            json.latency("latency", s);
+            json.end_object();
+        }
+    }
+    json.end_array();
+}
+
+// --tune: coordinate search over the TuningProfile on the active kernels,
+// at the matmul and attention shapes of every model. Each parameter is
+// swept with the others at their best so far, on the workload it affects;
+// a value replaces the incumbent only when it is at least 3% faster, so
+// noise cannot talk the profile away from the defaults.
+TuningProfile tune(Json& json, const std::vector<ModelConfig>& configs, const Options& opt, ThreadPool& pool,
+                   std::mt19937& rng) {
+    const kernels::KernelSet& ks = kernels::active();
+    std::uniform_int_distribution<int> value(-8, 7);
+    std::uniform_real_distribution<float> act(-1.0f, 1.0f);
+
+    struct Problem {
+        std::vector<uint8_t> packed;
+        kernels::PackedWeights w;
+    };
+    std::vector<std::unique_ptr<Problem>> problems;
+    std::vector<std::pair<int64_t, int64_t>> seen;
+    int64_t max_n = 0;
+    int64_t max_k = 0;
+    for (const ModelConfig& config : configs) {
+        for (const MatShape& shape : mat_shapes(config)) {
+            const std::pair<int64_t, int64_t> nk{shape.n, shape.k};
+            if (shape.k % kernels::kBlock != 0 || std::find(seen.begin(), seen.end(), nk) != seen.end()) {
+                continue;
+            }
+            seen.push_back(nk);
+            max_n = std::max(max_n, shape.n);
+            max_k = std::max(max_k, shape.k);
+            std::vector<int8_t> wq(static_cast<size_t>(shape.n * shape.k));
+            std::vector<float> ws(static_cast<size_t>(shape.n * shape.k / kernels::kBlock), 0.01f);
+            for (int8_t& v : wq) {
+                v = static_cast<int8_t>(value(rng));
+            }
+            for (const kernels::WeightFormat format : {kernels::WeightFormat::kInt8, kernels::WeightFormat::kInt4}) {
+                auto p = std::make_unique<Problem>();
+                p->packed.resize(kernels::packed_bytes(shape.n, shape.k, format, ks.layout));
+                kernels::pack_quantized(wq.data(), ws.data(), shape.n, shape.k, format, ks.layout, p->packed.data());
+                p->w = kernels::PackedWeights{p->packed.data(), shape.n, shape.k, format, ks.layout};
+                problems.push_back(std::move(p));
+            }
+        }
+    }
+    std::vector<float> x(static_cast<size_t>(opt.rows * max_k));
+    for (float& v : x) {
+        v = act(rng);
+    }
+    std::vector<int8_t> aq(x.size());
+    std::vector<float> as(x.size() / kernels::kBlock);
+    std::vector<float> c(static_cast<size_t>(opt.rows * max_n));
+    std::vector<std::unique_ptr<AttentionWorkload>> attention;
+    for (const ModelConfig& config : configs) {
+        attention.push_back(std::make_unique<AttentionWorkload>(config, opt, rng));
+    }
+
+    // Seconds per pass over every problem, median of the repeats.
+    const auto matmuls = [&](int64_t rows) {
+        double total = 0;
+        for (const auto& p : problems) {
+            kernels::quantize_rows(x.data(), rows, p->w.k, aq.data(), as.data());
+            const kernels::QuantizedRows a{aq.data(), as.data(), rows, p->w.k};
+            total += time_matmul(pool, ks, p->w, a, c.data(), nullptr, 5).percentile(50);
+        }
+        return total;
+    };
+    const auto decode = [&] { return matmuls(1); };
+    const auto prefill = [&] { return matmuls(opt.rows); };
+    const auto both = [&] { return decode() + prefill(); };
+    const auto attend = [&] {
+        double total = 0;
+        for (const auto& work : attention) {
+            total += work->run(ks, pool, 1, 5).percentile(50) + work->run(ks, pool, opt.rows, 5).percentile(50);
+        }
+        return total;
+    };
+
+    TuningProfile best;
+    set_tuning(best);
+    json.begin_object("tuning");
+    json.field("device", tuning_device());
+    json.begin_array("sweeps");
+    const auto sweep = [&](const char* name, std::initializer_list<int64_t> values,
+                           void (*set)(TuningProfile&, int64_t), const auto& cost) {
+        double incumbent = cost();
+        for (const int64_t v : values) {
+            TuningProfile candidate = best;
+            set(candidate, v);
+            double secs = incumbent;
+            if (!(candidate == best)) {
+                set_tuning(candidate);
+                secs = cost();
+                if (secs < incumbent * 0.97) {
+                    best = candidate;
+                    incumbent = secs;
+                }
+                set_tuning(best);
+            }
+            json.begin_object();
+            json.field("param", name);
+            json.field("value", v);
+            json.field("ms", secs * 1e3);
+            json.end_object();
+        }
+        std::fprintf(stderr, "neuroctx_bench: tuned %s\n", name);
+    };
+    sweep("fixed_gemv", {1, 0}, [](TuningProfile& p, int64_t v) { p.fixed_gemv = v != 0; }, decode);
+    sweep("gemm_row_tile", {64, 32, 16, 8}, [](TuningProfile& p, int64_t v) { p.gemm_row_tile = v; }, prefill);
+    sweep("tasks_per_worker", {4, 1, 2, 8}, [](TuningProfile& p, int64_t v) { p.tasks_per_worker = int32_t(v); },
+          both);
+    sweep("attention_key_tile", {16, 8, 32},
+          [](TuningProfile& p, int64_t v) { p.attention_key_tile = int32_t(v); }, attend);
+    sweep("attention_query_tile", {16, 8, 32},
+          [](TuningProfile& p, int64_t v) { p.attention_query_tile = int32_t(v); }, attend);
+    json.end_array();
+    json.begin_object("profile");
+    json.field("gemm_row_tile", best.gemm_row_tile);
+    json.field("tasks_per_worker", int64_t(best.tasks_per_worker));
+    json.field("attention_query_tile", int64_t(best.attention_query_tile));
+    json.field("attention_key_tile", int64_t(best.attention_key_tile));
+    json.field("fixed_gemv", int64_t(best.fixed_gemv ? 1 : 0));
+    json.end_object();
+    json.end_object();
+    return best;
+}
+
+// Encodes ~64 KB of text decoded from random vocabulary tokens, once with
+// an empty word cache and then warm.
+void bench_tokenizer(Json& json, const ModelFile& file, std::mt19937& rng) {
+    if (file.meta("tokenizer.ggml.model") == nullptr) {
+        return;
+    }
+    const Clock::time_point load_start = Clock::now();
+    Tokenizer tok = Tokenizer::from_gguf(file);
+    const double load_secs = seconds_since(load_start);
+    std::string text;
+    std::uniform_int_distribution<int32_t> pick(0, tok.size() - 1);
+    while (text.size() < 64 * 1024) {
+        const int32_t id = pick(rng);
+        tok.decode(std::span(&id, 1), text);
+    }
+    const double kb = double(text.size()) / 1024;
+    std::vector<int32_t> out;
+    out.reserve(text.size());
+    const Clock::time_point cold_start = Clock::now();
+    tok.encode(text, out, false, false);
+    const double cold_secs = seconds_since(cold_start);
+    const Samples warm = repeat(5, [&] {
+        out.clear();
+        tok.encode(text, out, false, false);
+    });
+    const TokenizerStats& st = tok.stats();
+
+    json.begin_object("tokenizer");
+    json.field("model", tok.model() == TokenizerModel::kBytePair ? "bpe" : "spm");
+    json.field("n_vocab", int64_t(tok.size()));
+    json.field("load_s", load_secs);
+    json.field("bytes", int64_t(text.size()));
+    json.field("tokens", int64_t(out.size()));
+    json.field("cold_us_per_kb", cold_secs * 1e6 / kb);
+    json.field("warm_us_per_kb", warm.percentile(50) * 1e6 / kb);
+    json.field("cache_hit_rate", st.words > 0 ? double(st.cache_hits) / double(st.words) : 0.0);
+    json.end_object();
+}
+
+// Picks a token from a random logits row of the model's vocabulary, greedy
+// and with top-k/top-p plus a repetition penalty over 64 recent tokens.
+void bench_sampler(Json& json, const ModelConfig& config, std::mt19937& rng) {
+    std::vector<float> logits(static_cast<size_t>(config.n_vocab));
+    std::normal_distribution<float> dist(0.0f, 4.0f);
+    for (float& l : logits) {
+        l = dist(rng);
+    }
+    std::vector<int32_t> recent(64);
+    std::uniform_int_distribution<int32_t> pick(0, static_cast<int32_t>(config.n_vocab - 1));
+    for (int32_t& t : recent) {
+        t = pick(rng);
+    }
+    Sampler sampler;
+    uint64_t state = 1;
+    const SamplingParams greedy;
+    SamplingParams nucleus;
+    nucleus.temperature = 0.8f;
+    nucleus.repetition_penalty = 1.1f;
+    const Samples g = repeat(50, [&] { sampler.sample(logits, greedy, {}, {}, state); });
+    const Samples n = repeat(50, [&] { sampler.sample(logits, nucleus, recent, {}, state); });
+
+    json.begin_object("sampler");
+    json.latency("greedy", g);
+    json.latency("top_k_top_p", n);
+    json.end_object();
+}
+
+void bench_end_to_end(Json& json, Model& model, const Options& opt, ThreadPool& pool, const EnergyMeter& energy,
+                      std::mt19937& rng) {
+    const ModelConfig& c = model.config();
+    const int64_t tokens = opt.prompt + opt.gen;
+    const size_t row_bytes = size_t(c.n_layer) * size_t(c.n_head_kv) * size_t(c.head_dim) * 2 * 4;
+    KvCache kv(model.kv_config((size_t(tokens) + 32) * row_bytes * 2, opt.kv));
+    std::uniform_int_distribution<int32_t> vocab(0, static_cast<int32_t>(c.n_vocab - 1));
+    std::vector<int32_t> prompt(static_cast<size_t>(opt.prompt));
+
+    Samples prefill_chunks;
+    Samples first_token;
+    Samples decode;
+    double prefill_secs = 0;
+    double decode_secs = 0;
+    std::optional<double> prefill_joules = 0.0;
+    std::optional<double> decode_joules = 0.0;
+    const auto accumulate = [](std::optional<double>& sum, std::optional<double> v) {
+        sum = sum && v ? std::optional<double>(*sum + *v) : std::nullopt;
+    };
+
+    for (int rep = 0; rep < opt.reps; ++rep) {
+        for (int32_t& t : prompt) {
+            t = vocab(rng);
+        }
+        // A distinct salt per repetition keeps the prefix cache out of it.
+        const SeqId seq = kv.create(static_cast<uint64_t>(rep) + 1);
+        const float* logits = nullptr;
+        std::optional<double> e0 = energy.read();
+        Clock::time_point start = Clock::now();
+        for (int64_t pos = 0; pos < opt.prompt; pos += opt.rows) {
+            const int64_t n = std::min(opt.rows, opt.prompt - pos);
+            if (!kv.reserve(seq, n)) {
+                throw_error("bench: KV budget too small for the prompt");
+            }
+            const StepSequence s{seq, pos, 0, n};
+            const int32_t last = static_cast<int32_t>(n - 1);
+            StepBatch batch;
+            batch.tokens = std::span<const int32_t>(prompt).subspan(static_cast<size_t>(pos), static_cast<size_t>(n));
+            batch.sequences = std::span<const StepSequence>(&s, 1);
+            batch.output_rows = std::span<const int32_t>(&last, 1);
+            const Clock::time_point t = Clock::now();
+            logits = model.forward(batch, kv, &pool);
+            prefill_chunks.add(seconds_since(t));
+        }
+        prefill_secs += seconds_since(start);
+        first_token.add(seconds_since(start));
+        accumulate(prefill_joules, energy.since(e0));
+
+        e0 = energy.read();
+        start = Clock::now();
+        for (int64_t i = 0; i < opt.gen; ++i) {
+            const auto token = static_cast<int32_t>(std::max_element(logits, logits + c.n_vocab) - logits);
+            if (!kv.reserve(seq, 1)) {
+                throw_error("bench: KV budget too small for decoding");
+            }
+            const StepSequence s{seq, opt.prompt + i, 0, 1};
+            const int32_t row = 0;
+            StepBatch batch;
+            batch.tokens = std::span<const int32_t>(&token, 1);
+            batch.sequences = std::span<const StepSequence>(&s, 1);
+            batch.output_rows = std::span<const int32_t>(&row, 1);
+            const Clock::time_point t = Clock::now();
+            logits = model.forward(batch, kv, &pool);
+            decode.add(seconds_since(t));
+        }
+        decode_secs += seconds_since(start);
+        accumulate(decode_joules, energy.since(e0));
+        kv.release(seq);
+    }
+
+    const double reps = opt.reps;
+    std::fprintf(stderr, "  prefill %.1f tok/s (chunk p50 %.2f ms), decode %.1f tok/s (p50 %.2f ms, p99 %.2f ms)\n",
+                 double(opt.prompt) * reps / prefill_secs, prefill_chunks.percentile(50) * 1e3,
+                 double(opt.gen) * reps / decode_secs, decode.percentile(50) * 1e3, decode.percentile(99) * 1e3);
+    json.begin_object("prefill");
+    json.field("tokens", opt.prompt);
+    json.field("chunk", opt.rows);
+    json.field("tokens_per_s", double(opt.prompt) * reps / prefill_secs);
+    json.latency("chunk_latency", prefill_chunks);
+    json.latency("time_to_first_token", first_token);
+    json.field("joules_per_token",
+               prefill_joules ? std::optional<double>(*prefill_joules / (double(opt.prompt) * reps)) : std::nullopt);
+    json.end_object();
+    json.begin_object("decode");
+    json.field("tokens", opt.gen);
+    json.field("tokens_per_s", double(opt.gen) * reps / decode_secs);
+    json.latency("token_latency", decode);
+    json.field("joules_per_token",
+               decode_joules ? std::optional<double>(*decode_joules / (double(opt.gen) * reps)) : std::nullopt);
+    json.end_object();
+}
+
+void bench_speculative(Json& json, Model& target, Model& draft, const Options& opt, ThreadPool& pool,
+                       std::mt19937& rng) {
+    const auto kv_for = [&](const Model& m) {
+        const ModelConfig& c = m.config();
+        const size_t row_bytes = size_t(c.n_layer) * size_t(c.n_head_kv) * size_t(c.head_dim) * 2 * 4;
+        return m.kv_config((size_t(opt.prompt + opt.gen) + 64) * row_bytes * 2, opt.kv);
+    };
+    KvCache target_kv(kv_for(target));
+    KvCache draft_kv(kv_for(draft));
+    SpeculativeDecoder decoder(target, target_kv, draft, draft_kv, &pool);
+    std::uniform_int_distribution<int32_t> vocab(0, static_cast<int32_t>(target.config().n_vocab - 1));
+
+    double secs = 0;
+    int64_t generated = 0;
+    for (int rep = 0; rep < opt.reps; ++rep) {
+        GenerateRequest request;
+        request.prompt.resize(static_cast<size_t>(opt.prompt));
+        for (int32_t& t : request.prompt) {
+            t = vocab(rng);
+        }
+        request.max_new_tokens = static_cast<int32_t>(opt.gen);
+        request.prefix_salt = static_cast<uint64_t>(rep) + 1;
+        // Decode time runs from the first token, which ends the prefill.
+        std::optional<Clock::time_point> first;
+        Clock::time_point last;
+        request.on_token = [&](RequestId, int32_t) {
+            last = Clock::now();
+            if (!first) {
+                first = last;
+            }
+            return true;
+        };
+        generated += static_cast<int64_t>(decoder.generate(request).size()) - 1;
+        secs += std::chrono::duration<double>(last - *first).count();
+    }
+
+    const SpeculativeStats& st = decoder.stats();
+    std::fprintf(stderr, "  speculative decode %.1f tok/s, acceptance %.2f, %.2f tokens/round, k %d\n",
+                 secs > 0 ? double(generated) / secs : 0.0, st.acceptance, st.tokens_per_round(), st.draft_length);
+    json.begin_object("speculative");
+    json.field("draft", std::filesystem::path(opt.draft).filename().string());
+    json.field("tokens", opt.gen);
+    json.field("tokens_per_s", secs > 0 ? double(generated) / secs : 0.0);
+    json.field("acceptance", double(st.acceptance));
+    json.field("tokens_per_round", st.tokens_per_round());
+    json.field("draft_length", int64_t(st.draft_length));
+    json.end_object();
+}
+
+std::vector<std::string> expand_models(const std::vector<std::string>& args) {
+    namespace fs = std::filesystem;
+    std::vector<std::string> out;
+    for (const std::string& arg : args) {
+        if (!fs::is_directory(arg)) {
+            out.push_back(arg);
+            continue;
+        }
+        std::vector<std::string> found;
+        for (const auto& entry : fs::directory_iterator(arg)) {
+            if (entry.path().extension() == ".gguf") {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        out.insert(out.end(), found.begin(), found.end());
+    }
+    return out;
+}
+
+bool parse_int(const char* s, int64_t& out, int64_t min) {
+    char* end = nullptr;
+    const long long v = std::strtoll(s, &end, 10);
+    if (end == s || *end != '\0' || v < min) {
+        return false;
+    }
+    out = v;
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options opt;
+    std::string kv_name = "f16";
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        int64_t v = 0;
+        const bool has_value = i + 1 < argc;
+        if (arg == "--threads" && has_value && parse_int(argv[i + 1], v, 1)) {
+            opt.threads = static_cast<int>(v);
+        } else if (arg == "--prompt" && has_value && parse_int(argv[i + 1], v, 1)) {
+            opt.prompt = v;
+        } else if (arg == "--gen" && has_value && parse_int(argv[i + 1], v, 1)) {
+            opt.gen = v;
+        } else if (arg == "--reps" && has_value && parse_int(argv[i + 1], v, 1)) {
+            opt.reps = static_cast<int>(v);
+        } else if (arg == "--rows" && has_value && parse_int(argv[i + 1], v, 2)) {
+            opt.rows = v;
+        } else if (arg == "--ctx" && has_value && parse_int(argv[i + 1], v, 1)) {
+            opt.ctx = v;
+        } else if (arg == "--kv" && has_value) {
+            kv_name = argv[i + 1];
+        } else if (arg == "--cache-dir" && has_value) {
+            opt.cache_dir = argv[i + 1];
+        } else if (arg == "--out" && has_value) {
+            opt.out = argv[i + 1];
+        } else if (arg == "--draft" && has_value) {
+            opt.draft = argv[i + 1];
+        } else if (arg == "--stream" && has_value && parse_int(argv[i + 1], v, 1)) {
+            opt.stream = static_cast<int32_t>(v);
+        } else if (arg == "--trace" && has_value) {
+            opt.trace = argv[i + 1];
+        } else if (arg == "--tune") {
+            opt.tune = true;
+            continue;
+        } else if (!arg.empty() && arg[0] != '-') {
+            opt.models.push_back(arg);
+            continue;
+        } else {
+            return usage();
+        }
+        ++i;
+    }
+
+    try {
+        opt.kv = parse_kv_dtype(kv_name);
+        ThreadPoolOptions pool_options = ThreadPoolOptions::from_env();
+        if (opt.threads > 0) {
+            pool_options.max_threads = opt.threads;
+        }
+        ThreadPool pool(pool_options);
+        if (!opt.trace.empty()) {
+            trace::enable();
+        }
+        const EnergyMeter energy;
+        std::mt19937 rng(1234);
+
+        Json json;
+        json.begin_object();
+        json.field("schema", int64_t(1));
+        json.begin_object("system");
+        json.field("cpu", cpu_features().describe());
+        json.field("topology", pool.topology().describe());
+        json.field("threads", int64_t(pool.size()));
+        json.field("kernels", kernels::active().name);
+        json.field("tuning", tuning_source());
+        json.field("energy_source", energy.source().empty() ? std::string("none") : energy.source());
+        json.begin_array("accelerators");
+        for (const AcceleratorInfo& a : probe_accelerators()) {
+            json.begin_object();
+            json.field("kind", device_kind_name(a.kind));
+            json.field("name", a.name);
+            json.field("path", a.path);
+            json.end_object();
+        }
+        json.end_array();
+        json.end_object();
+        json.begin_object("config");
+        json.field("prompt", opt.prompt);
+        json.field("gen", opt.gen);
+        json.field("reps", int64_t(opt.reps));
+        json.field("rows", opt.rows);
+        json.field("ctx", opt.ctx);
+        json.field("kv_dtype", kv_dtype_name(opt.kv));
+        json.field("stream_layers", int64_t(opt.stream));
+        json.end_object();
+
+        const std::vector<std::string> models = expand_models(opt.models);
+        if (opt.tune) {
+            std::vector<ModelConfig> configs;
+            for (const std::string& path : models) {
+                configs.push_back(ModelConfig::from_gguf(ModelFile::open(path)));
+            }
+            if (configs.empty()) {
+                configs.push_back(default_config());
+            }
+            const std::string path = tuning_profile_path();
+            write_tuning_profile(tune(json, configs, opt, pool, rng), path);
+            std::fprintf(stderr, "neuroctx_bench: wrote tuning profile %s\n", path.c_str());
+        }
+
+        json.begin_array("models");
+        std::unique_ptr<Model> draft;
+        if (!opt.draft.empty()) {
+            ModelOptions mo;
+            mo.max_batch_tokens = opt.rows;
+            mo.max_outputs = 1;
+            mo.cache_dir = opt.cache_dir;
+            draft = Model::load(opt.draft, mo);
+        }
+        if (models.empty()) {
+            reset_peak_rss();
+            json.begin_object();
+            json.field("name", "synthetic");
+            bench_kernels(json, default_config(), opt, pool, rng);
+            bench_attention(json, default_config(), opt, pool, rng);
+            json.field("peak_rss_bytes", peak_rss());
+            json.end_object();
+        }
+        for (const std::string& path : models) {
+            reset_peak_rss();
+            ModelOptions mo;
+            mo.max_batch_tokens = opt.rows;
+            mo.max_outputs = draft ? SpeculativeOptions().max_draft + 1 : 1;
+            mo.cache_dir = opt.cache_dir;
+            mo.stream_layers = opt.stream;
+            const Clock::time_point load_start = Clock::now();
+            const std::unique_ptr<Model> model = Model::load(path, mo);
+            const double load_secs = seconds_since(load_start);
+            const ModelConfig& c = model->config();
+            std::fprintf(stderr, "neuroctx_bench: %s (%s, %lld layers)\n", path.c_str(), c.architecture.c_str(),
+                         static_cast<long long>(c.n_layer));
+
+            json.begin_object();
+            json.field("name", std::filesystem::path(path).filename().string());
+            json.field("architecture", c.architecture);
+            json.field("n_layer", c.n_layer);
+            json.field("n_embd", c.n_embd);
+            json.field("n_vocab", c.n_vocab);
+            json.field("load_s", load_secs);
+            json.field("arena_bytes", static_cast<int64_t>(model->plan().arena_bytes));
+            if (const LayerStreamer* s = model->streamer()) {
+                json.field("stream_window_bytes", static_cast<int64_t>(s->stats().window_bytes));
+            }
+            bench_kernels(json, c, opt, pool, rng);
+            bench_attention(json, c, opt, pool, rng);
+            bench_tokenizer(json, model->file(), rng);
+            bench_sampler(json, c, rng);
+            bench_end_to_end(json, *model, opt, pool, energy, rng);
+            if (draft && draft->config().n_vocab == c.n_vocab) {
+                bench_speculative(json, *model, *draft, opt, pool, rng);
+            }
+            json.field("peak_rss_bytes", peak_rss());
+            json.end_object();
+        }
+        json.end_array();
+        json.end_object();
+
+        if (!opt.trace.empty()) {
+            trace::disable();
+            trace::write_chrome_trace(opt.trace);
+            std::fprintf(stderr, "neuroctx_bench: wrote %s; slowest ops%s:\n", opt.trace.c_str(),
+                         trace::pmu_available() ? "" : " (no PMU access, no memory traffic)");
+            int shown = 0;
+            for (const trace::OpProfile& p : trace::profile()) {
+                if (p.layer >= 0) {
+                    continue;
+                }
+                if (shown++ == 10) {
+                    break;
+                }
+                std::fprintf(stderr, "  %-14s %8llu calls %10.1f ms total %8.1f us max\n", p.name.c_str(),
+                             static_cast<unsigned long long>(p.calls), p.total_us / 1e3, p.max_us);
+            }
+        }
+
+        const std::string report = json.str() + "\n";
+        if (opt.out.empty()) {
+            std::fwrite(report.data(), 1, report.size(), stdout);
+        } else {
+            std::ofstream(opt.out) << report;
+            std::fprintf(stderr, "neuroctx_bench: wrote %s\n", opt.out.c_str());
+        }
+    } catch (const Error& e) {
+        std::fprintf(stderr, "neuroctx_bench: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+// Offline packing: neuroctx_pack MODEL.gguf [--cache-dir DIR | --out FILE] [--kernels NAME]
+//
+// Writes the kernel-native blob that the runtime would otherwise build on
+// first launch. --kernels selects a variant other than the detected one
+// (it must be supported by this CPU, since layouts can depend on it).
+
+#include "neuroctx/common.h"
+#include "neuroctx/kernels.h"
+#include "neuroctx/model_file.h"
+#include "neuroctx/packed_model.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace {
+
+int usage() {
+    std::fprintf(stderr, "usage: neuroctx_pack MODEL.gguf [--cache-dir DIR | --out FILE] [--kernels NAME]\n");
+    return 2;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    using namespace neuroctx;
+    std::string model_path;
+    std::string cache_dir = default_cache_dir();
+    std::string out;
+    std::string variant;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--cache-dir" && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            out = argv[++i];
+        } else if (arg == "--kernels" && i + 1 < argc) {
+            variant = argv[++i];
+        } else if (!arg.empty() && arg[0] != '-' && model_path.empty()) {
+            model_path = arg;
+        } else {
+            return usage();
+        }
+    }
+    if (model_path.empty()) {
+        return usage();
+    }
+
+    try {
+        const kernels::KernelSet* ks = &kernels::active();
+        if (!variant.empty()) {
+            ks = nullptr;
+            for (const kernels::KernelSet* candidate : kernels::supported_kernels(cpu_features())) {
+                if (variant == candidate->name) {
+                    ks = candidate;
+                }
+            }
+            if (ks == nullptr) {
+                std::fprintf(stderr, "neuroctx_pack: kernels '%s' not supported on this CPU\n", variant.c_str());
+                return 1;
+            }
+        }
+        const ModelFile model = ModelFile::open(model_path, Advice::kSequential);
+        if (out.empty()) {
+            out = PackedModel::cache_path(model, *ks, cache_dir);
+        }
+        const auto start = std::chrono::steady_clock::now();
+        PackedModel::build(model, *ks, out);
+        const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const auto packed = PackedModel::try_open(out, model, *ks);
+        if (!packed) {
+            std::fprintf(stderr, "neuroctx_pack: %s failed validation\n", out.c_str());
+            return 1;
+        }
+        std::printf("%s: %zu tensors, %zu bytes, kernels=%s (%s), %.2fs\n", out.c_str(), packed->tensors().size(),
+                    packed->mapping().size(), ks->name, cpu_features().describe().c_str(), secs);
+    } catch (const Error& e) {
+        std::fprintf(stderr, "neuroctx_pack: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+// Offline quantization: neuroctx_quantize IN.gguf OUT.gguf [--type q4_0|q8_0] [--tensor-type PATTERN=TYPE]...
+//                                        [--uniform] [--calibrate TEXT] [--calib-tokens N] [--calib-ctx N]
+//                                        [--threads N] [--cache-dir DIR] [--kernels NAME] [--no-pack]
+//
+// Requantizes the 2-D weights of a model to Q4_0 or Q8_0 (32-value groups,
+// fp16 scales). Unless --uniform, the output head and value projections
+// stay at q8_0; --tensor-type overrides the type of tensors whose name
+// contains PATTERN (q4_0, q8_0, f16 or f32) and takes precedence. With
+// --calibrate the source model first runs over the text file, in chunks of
+// --calib-ctx tokens up to --calib-tokens, and every block is rounded to
+// minimize the error weighted by its input channels' activations. The
+// result is then packed for the kernels (see neuroctx_pack), so the runtime
+// maps it without a first-run repack.
+
+#include "neuroctx/common.h"
+#include "neuroctx/kernels.h"
+#include "neuroctx/model.h"
+#include "neuroctx/model_file.h"
+#include "neuroctx/packed_model.h"
+#include "neuroctx/quantize.h"
+#include "neuroctx/thread_pool.h"
+#include "neuroctx/tokenizer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace neuroctx;
+
+int usage() {
+    std::fprintf(stderr,
+                 "usage: neuroctx_quantize IN.gguf OUT.gguf [--type q4_0|q8_0] [--tensor-type PATTERN=TYPE]...\n"
+                 "                         [--uniform] [--calibrate TEXT] [--calib-tokens N] [--calib-ctx N]\n"
+                 "                         [--threads N] [--cache-dir DIR] [--kernels NAME] [--no-pack]\n");
+    return 2;
+}
+
+std::optional<DType> parse_type(const std::string& name) {
+    for (const DType type : {DType::kQ4_0, DType::kQ8_0, DType::kF16, DType::kF32}) {
+        if (name == dtype_name(type)) {
+            return type;
+        }
+    }
+    return std::nullopt;
+}
+
+bool parse_int(const char* s, int64_t& out, int64_t min) {
+    char* end = nullptr;
+    const long long v = std::strtoll(s, &end, 10);
+    if (end == s || *end != '\0' || v < min) {
+        return false;
+    }
+    out = v;
+    return true;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> paths;
+    QuantizeOptions options;
+    std::vector<TensorTypeRule> rules;
+    bool uniform = false;
+    std::string calibrate;
+    int64_t calib_tokens = 8192;
+    int64_t calib_ctx = 512;
+    int64_t threads = 0;
+    std::string cache_dir = default_cache_dir();
+    std::string variant;
+    bool pack = true;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--type" && has_value) {
+            const auto type = parse_type(argv[++i]);
+            if (!type || (*type != DType::kQ4_0 && *type != DType::kQ8_0)) {
+                return usage();
+            }
+            options.type = *type;
+        } else if (arg == "--tensor-type" && has_value) {
+            const std::string rule = argv[++i];
+            const size_t eq = rule.rfind('=');
+            const auto type = eq != std::string::npos ? parse_type(rule.substr(eq + 1)) : std::nullopt;
+            if (!type || eq == 0) {
+                return usage();
+            }
+            rules.push_back({rule.substr(0, eq), *type});
+        } else if (arg == "--uniform") {
+            uniform = true;
+        } else if (arg == "--calibrate" && has_value) {
+            calibrate = argv[++i];
+        } else if (arg == "--calib-tokens" && has_value && parse_int(argv[i + 1], calib_tokens, 1)) {
+            ++i;
+        } else if (arg == "--calib-ctx" && has_value && parse_int(argv[i + 1], calib_ctx, 1)) {
+            ++i;
+        } else if (arg == "--threads" && has_value && parse_int(argv[i + 1], threads, 1)) {
+            ++i;
+        } else if (arg == "--cache-dir" && has_value) {
+            cache_dir = argv[++i];
+        } else if (arg == "--kernels" && has_value) {
+            variant = argv[++i];
+        } else if (arg == "--no-pack") {
+            pack = false;
+        } else if (!arg.empty() && arg[0] != '-' && paths.size() < 2) {
+            paths.push_back(arg);
+        } else {
+            return usage();
+        }
+    }
+    if (paths.size() != 2) {
+        return usage();
+    }
+    if (uniform) {
+        options.rules.clear();
+    }
+    options.rules.insert(options.rules.begin(), rules.begin(), rules.end());
+
+    try {
+        const kernels::KernelSet* ks = &kernels::active();
+        if (!variant.empty()) {
+            ks = nullptr;
+            for (const kernels::KernelSet* candidate : kernels::supported_kernels(cpu_features())) {
+                if (variant == candidate->name) {
+                    ks = candidate;
+                }
+            }
+            if (ks == nullptr) {
+                std::fprintf(stderr, "neuroctx_quantize: kernels '%s' not supported on this CPU\n", variant.c_str());
+                return 1;
+            }
+        }
+        ThreadPoolOptions pool_options = ThreadPoolOptions::from_env();
+        if (threads > 0) {
+            pool_options.max_threads = static_cast<int>(threads);
+        }
+        ThreadPool pool(pool_options);
+
+        std::optional<ActivationStats> stats;
+        if (!calibrate.empty()) {
+            const auto start = std::chrono::steady_clock::now();
+            std::ifstream in(calibrate, std::ios::binary);
+            if (!in) {
+                throw_errno("open " + calibrate);
+            }
+            std::stringstream text;
+            text << in.rdbuf();
+            ModelOptions mo;
+            mo.kernels = ks;
+            mo.cache_dir = cache_dir;
+            mo.max_batch_tokens = std::min<int64_t>(calib_ctx, 128);
+            mo.max_outputs = mo.max_batch_tokens;
+            std::unique_ptr<Model> model = Model::load(paths[0], mo);
+            Tokenizer tok = Tokenizer::from_gguf(model->file());
+            std::vector<int32_t> ids;
+            tok.encode(text.str(), ids, tok.adds_bos());
+            ids.resize(std::min(ids.size(), static_cast<size_t>(calib_tokens)));
+            stats = ActivationStats::collect(*model, ids, calib_ctx, &pool);
+            options.stats = &*stats;
+            std::fprintf(stderr, "neuroctx_quantize: calibrated on %lld tokens in %lld chunks, %.2fs\n",
+                         static_cast<long long>(stats->tokens()), static_cast<long long>(stats->chunks()),
+                         seconds_since(start));
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const ModelFile src = ModelFile::open(paths[0], Advice::kSequential);
+        const QuantizeResult result = quantize_model(src, paths[1], options, &pool);
+        for (const QuantizedTensor& t : result.tensors) {
+            if (t.from != t.to) {
+                std::printf("%-32s %5s -> %-5s error %.3e\n", t.name.c_str(), dtype_name(t.from), dtype_name(t.to),
+                            t.error);
+            }
+        }
+        std::printf("%s: %.1f MiB -> %.1f MiB, %.2fs\n", paths[1].c_str(), double(result.bytes_in) / (1 << 20),
+                    double(result.bytes_out) / (1 << 20), seconds_since(start));
+
+        if (pack) {
+            const ModelFile model = ModelFile::open(paths[1], Advice::kSequential);
+            const std::string out = PackedModel::cache_path(model, *ks, cache_dir);
+            PackedModel::build(model, *ks, out);
+            if (!PackedModel::try_open(out, model, *ks)) {
+                std::fprintf(stderr, "neuroctx_quantize: %s failed validation\n", out.c_str());
+                return 1;
+            }
+            std::printf("%s: kernels=%s\n", out.c_str(), ks->name);
+        }
+    } catch (const Error& e) {
+        std::fprintf(stderr, "neuroctx_quantize: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}